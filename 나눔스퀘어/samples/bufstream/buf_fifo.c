@@ -131,6 +131,12 @@ void free_fifo_buf(fifo_stream_tt *buf_fifo)
 }
 
 
+uint32_t lend_fifo_buf(fifo_stream_tt *buf_fifo, fifo_desc_tt *desc)
+{
+  return fifo_w_lend(buf_fifo->fifo, desc);
+}
+
+
 fifo_stream_tt *new_fifo_buf(uint32_t buf_size,  uint32_t chunk_size)
 {
   bufstream_tt *bs;
@@ -31,6 +31,9 @@ extern "C" {
 void free_fifo_buf(fifo_stream_tt *buf_fifo);
 fifo_stream_tt *new_fifo_buf(uint32_t buf_size, uint32_t chunk_size);
 
+// hands a buffer to the reading side without copying it, see fifo_w_lend
+uint32_t lend_fifo_buf(fifo_stream_tt *buf_fifo, fifo_desc_tt *desc);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,299 @@
+/* ----------------------------------------------------------------------------
+ * File: buf_replay.c
+ *
+ * Desc: Buffered stream which records the start of an input and replays it
+ *
+ * Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "auxinfo.h"
+#include "buf_replay.h"
+
+#define REPLAY_MIN_ALLOC  (64 * 1024)
+
+
+// implementation structure
+struct impl_stream
+{
+  bufstream_tt *source;
+
+  uint8_t *bfr;
+  uint32_t idx;          // read index
+  uint32_t bfr_count;    // filled size
+  uint32_t bfr_size;     // allocated size
+  uint32_t prefix_limit;
+  int32_t recording;     // everything read is kept until the rewind
+  uint64_t bytecount;
+};
+
+
+// make room for numbytes bytes following the read index
+static int32_t reserve(struct impl_stream *p, uint32_t numbytes)
+{
+  uint32_t needed;
+  uint8_t *bfr;
+
+  // once recording stopped, the bytes already read are not needed any more
+  if (!p->recording && p->idx)
+  {
+    memmove(p->bfr, p->bfr + p->idx, p->bfr_count - p->idx);
+    p->bfr_count -= p->idx;
+    p->idx = 0;
+  }
+
+  needed = p->idx + numbytes;
+  if (needed <= p->bfr_size)
+    return BS_OK;
+
+  if (p->recording && needed > p->prefix_limit)
+    return BS_ERROR;
+
+  if (needed < p->bfr_size * 2)
+    needed = p->bfr_size * 2;
+  if (needed < REPLAY_MIN_ALLOC)
+    needed = REPLAY_MIN_ALLOC;
+  if (p->recording && needed > p->prefix_limit)
+    needed = p->prefix_limit;
+
+  bfr = (uint8_t*)realloc(p->bfr, needed);
+  if (!bfr)
+    return BS_ERROR;
+
+  p->bfr = bfr;
+  p->bfr_size = needed;
+  return BS_OK;
+}
+
+
+// drop the replayed prefix as soon as it is consumed
+static void release(struct impl_stream *p)
+{
+  if (p->recording || p->idx != p->bfr_count || p->bfr_size <= REPLAY_MIN_ALLOC)
+    return;
+
+  free(p->bfr);
+  p->bfr = NULL;
+  p->bfr_size = 0;
+  p->bfr_count = 0;
+  p->idx = 0;
+}
+
+
+static uint32_t fr_usable_bytes(bufstream_tt *bs)
+{
+  struct impl_stream* p = bs->Buf_IO_struct;
+  return p->bfr_count - p->idx;
+}
+
+
+static uint8_t *fr_request(bufstream_tt *bs, uint32_t numbytes)
+{
+  struct impl_stream* p = bs->Buf_IO_struct;
+
+  if (p->idx + numbytes <= p->bfr_count)
+    return p->bfr + p->idx;
+
+  if (reserve(p, numbytes) != BS_OK)
+    return NULL;
+
+  p->bfr_count += p->source->copybytes(p->source, p->bfr + p->bfr_count, p->idx + numbytes - p->bfr_count);
+
+  if (p->idx + numbytes <= p->bfr_count)
+    return p->bfr + p->idx;
+  else
+    return NULL;
+}
+
+
+static uint32_t fr_confirm(bufstream_tt *bs, uint32_t numbytes)
+{
+  struct impl_stream* p = bs->Buf_IO_struct;
+
+  if (numbytes > p->bfr_count - p->idx)
+    numbytes = p->bfr_count - p->idx;
+
+  p->idx += numbytes;
+  p->bytecount += numbytes;
+  release(p);
+  return numbytes;
+}
+
+
+static uint32_t fr_copybytes(bufstream_tt *bs, uint8_t *ptr, uint32_t numbytes)
+{
+  struct impl_stream* p = bs->Buf_IO_struct;
+  uint32_t n = p->bfr_count - p->idx;
+  uint32_t c;
+
+  // serve what is buffered first, which is the recorded prefix after the rewind
+  if (n > numbytes)
+    n = numbytes;
+
+  if (n)
+  {
+    memcpy(ptr, p->bfr + p->idx, n);
+    p->idx += n;
+    p->bytecount += n;
+    release(p);
+  }
+
+  if (n == numbytes)
+    return n;
+
+  if (!p->recording)
+  {
+    // past the prefix the reads go straight to the source
+    c = p->source->copybytes(p->source, ptr + n, numbytes - n);
+    p->bytecount += c;
+    return n + c;
+  }
+
+  if (reserve(p, numbytes - n) != BS_OK)
+    return n;
+
+  c = p->source->copybytes(p->source, p->bfr + p->bfr_count, numbytes - n);
+  memcpy(ptr + n, p->bfr + p->bfr_count, c);
+  p->bfr_count += c;
+  p->idx += c;
+  p->bytecount += c;
+  return n + c;
+}
+
+
+static uint32_t fr_chunksize(bufstream_tt *bs)
+{
+  struct impl_stream* p = bs->Buf_IO_struct;
+  return p->source->chunksize(p->source);
+}
+
+
+static uint32_t fr_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, void *info_ptr, uint32_t info_size)
+{
+  struct impl_stream* p = bs->Buf_IO_struct;
+
+  switch (info_ID)
+  {
+    case BYTECOUNT_INFO:
+      {
+        uint64_t *ptr = (uint64_t*)info_ptr;
+        if (ptr && (info_size == sizeof(uint64_t)))
+          *ptr = p->bytecount;
+      }
+      return BS_OK;
+  }
+
+  // everything else describes the input itself
+  return p->source->auxinfo(p->source, offs, info_ID, info_ptr, info_size);
+}
+
+
+static uint32_t fr_split(bufstream_tt *bs)
+{
+  if (!bs){};
+  return 0;
+}
+
+
+static void fr_done(bufstream_tt *bs, int32_t Abort)
+{
+  struct impl_stream* p = bs->Buf_IO_struct;
+
+  p->source->done(p->source, Abort);
+  p->source->free(p->source);
+
+  if (p->bfr)
+    free(p->bfr);
+  free(p);
+  bs->Buf_IO_struct = NULL;
+}
+
+
+static void fr_free(bufstream_tt *bs)
+{
+  if (bs->Buf_IO_struct)
+    bs->done(bs, 0);
+
+  free(bs);
+}
+
+
+int32_t replay_buf_rewind(bufstream_tt *bs)
+{
+  struct impl_stream* p = bs->Buf_IO_struct;
+
+  if (!p->recording)
+    return BS_ERROR;
+
+  p->recording = 0;
+  p->idx = 0;
+  p->bytecount = 0;
+  return BS_OK;
+}
+
+
+int32_t init_replay_buf_read(bufstream_tt *bs, bufstream_tt *source, uint32_t prefix_limit, void (*DisplayError)(char *txt))
+{
+  if (DisplayError){};  // remove compile warning
+
+  bs->Buf_IO_struct = (struct impl_stream*)malloc(sizeof(struct impl_stream));
+  if (!(bs->Buf_IO_struct) || !source)
+  {
+    if (bs->Buf_IO_struct)
+      free(bs->Buf_IO_struct);
+    bs->Buf_IO_struct = NULL;
+    return BS_ERROR;
+  }
+
+  memset(bs->Buf_IO_struct, 0, sizeof(struct impl_stream));
+  bs->Buf_IO_struct->source       = source;
+  bs->Buf_IO_struct->prefix_limit = prefix_limit;
+  bs->Buf_IO_struct->recording    = 1;
+
+  bs->usable_bytes = fr_usable_bytes;
+  bs->request      = fr_request;
+  bs->confirm      = fr_confirm;
+  bs->copybytes    = fr_copybytes;
+  bs->split        = fr_split;
+  bs->chunksize    = fr_chunksize;
+  bs->free         = fr_free;
+  bs->auxinfo      = fr_auxinfo;
+  bs->done         = fr_done;
+  bs->drive_ptr    = NULL;
+  bs->drive        = NULL;
+
+  bs->state        = NULL;
+  bs->flags        = 0;
+  return BS_OK;
+}
+
+
+bufstream_tt *open_replay_buf_read(bufstream_tt *source, uint32_t prefix_limit, void (*DisplayError)(char *txt))
+{
+  bufstream_tt *p;
+  p = (bufstream_tt*)malloc(sizeof(bufstream_tt));
+  if (p)
+  {
+    if (BS_OK != init_replay_buf_read(p, source, prefix_limit, DisplayError))
+    {
+      free(p);
+      p = NULL;
+    }
+  }
+  return p;
+}
+
+
+void close_replay_buf(bufstream_tt* bs, int32_t Abort)
+{
+  bs->done(bs, Abort);
+  bs->free(bs);
+}
@@ -0,0 +1,41 @@
+/* ----------------------------------------------------------------------------
+ * File: buf_replay.h
+ *
+ * Desc: Buffered stream which records the start of an input and replays it
+ *
+ * Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ *
+ * ----------------------------------------------------------------------------
+ */
+
+#include "bufstrm.h"
+
+// The replay bufstream reads from a source bufstream and keeps everything
+// read in memory until replay_buf_rewind() is called. After the rewind the
+// recorded prefix is read once more and reading continues from the source,
+// so stream detection does not need to reopen or seek the input.
+// Once opened, the replay bufstream owns the source bufstream and closes it.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// prefix_limit - maximum number of bytes recorded, reading past it fails
+//                until replay_buf_rewind() is called
+bufstream_tt *open_replay_buf_read(bufstream_tt *source,
+                                   uint32_t prefix_limit,
+                                   void (*DisplayError)(char *txt));
+
+// stops recording and starts reading from the beginning of the prefix
+int32_t replay_buf_rewind(bufstream_tt *bs);
+
+void close_replay_buf(bufstream_tt* bs, int32_t Abort);
+
+#ifdef __cplusplus
+}
+#endif
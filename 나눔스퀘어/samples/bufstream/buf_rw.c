@@ -21,6 +21,7 @@
 #else
     #include <unistd.h>
 #endif
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -35,11 +36,9 @@
     #define rw_file_seek _lseeki64
     #define rw_file_write _write
 #else
-    #ifdef __linux__
-        #define rw_file_seek lseek64
-    #else
-        #define rw_file_seek lseek
-    #endif
+    // 64 bit offsets with _FILE_OFFSET_BITS=64, which the sample builds define
+    #define rw_file_seek   lseek
+    #define rw_file_pwrite pwrite
 
     #define rw_file_read  read 
     #define rw_file_close close
@@ -283,9 +282,10 @@ static void bs_free(bufstream_tt *pBS)
 }
 
 
-static int32_t bs_seek(bufstream_tt *pBS, int32_t origin, int64_t pos)
+// moves the file position, the buffer is flushed in write mode and dropped in read mode
+static int32_t file_seek(struct impl_stream *pImp, int32_t origin, int64_t pos)
 {
-    struct impl_stream *pImp = pBS->Buf_IO_struct;
+    int64_t newpos;
     int32_t n;
 
     if ((pImp->mode == BS_FILE_WRITE_MODE) && (pImp->idx > 0))
@@ -297,15 +297,87 @@ static int32_t bs_seek(bufstream_tt *pBS, int32_t origin, int64_t pos)
         }
     }
 
-    if (rw_file_seek(pImp->io, pos, origin_values[origin]) == -1)
+    newpos = rw_file_seek(pImp->io, pos, origin_values[origin]);
+    if (newpos == -1)
     {
         return BS_ERROR;
     }
 
-    pImp->idx = 0;
-    pImp->bytecount = pos;
-        
+    pImp->idx       = 0;
+    pImp->bfr_count = 0;
+    pImp->bytecount = newpos;
+
+    return BS_OK;
+}
+
+
+static int32_t bs_seek(bufstream_tt *pBS, int32_t origin, int64_t pos)
+{
+    struct impl_stream *pImp = pBS->Buf_IO_struct;
+
+    if ((pImp->mode == BS_FILE_READ_MODE) && (origin != BS_SEEK_END))
+    {
+        // the read buffer holds the file data from bfr_start on and the file position is at its end,
+        // a seek inside of it only moves idx, one outside is done from the start of the file
+        uint64_t bfr_start = pImp->bytecount - pImp->idx;
+
+        if (origin == BS_SEEK_CURRENT)
+        {
+            pos += (int64_t)pImp->bytecount;
+            origin = BS_SEEK_START;
+        }
+
+        if ((pos >= (int64_t)bfr_start) && (pos <= (int64_t)(bfr_start + pImp->bfr_count)))
+        {
+            pImp->idx       = (uint32_t)(pos - bfr_start);
+            pImp->bytecount = pos;
+            return BS_OK;
+        }
+    }
+
+    return file_seek(pImp, origin, pos);
+}
+
+
+// pwrite() with retries, the file position is not changed
+static int32_t file_pwrite(struct impl_stream *pImp, const uint8_t *pPtr, uint32_t numbytes, uint64_t pos)
+{
+#if !defined(__APPLE__) && !defined(__linux__)
+    int64_t curpos;
+    int32_t n;
+
+    // no positional write, seek there and back
+    curpos = rw_file_seek(pImp->io, 0, SEEK_CUR);
+    if ((curpos == -1) || (rw_file_seek(pImp->io, pos, SEEK_SET) == -1))
+    {
+        return BS_ERROR;
+    }
+    n = rw_file_write(pImp->io, pPtr, numbytes);
+    if (rw_file_seek(pImp->io, curpos, SEEK_SET) == -1)
+    {
+        return BS_ERROR;
+    }
+
+    return (n == (int32_t)numbytes) ? BS_OK : BS_ERROR;
+#else
+    while (numbytes)
+    {
+        ssize_t n = rw_file_pwrite(pImp->io, pPtr, numbytes, (off_t)pos);
+        if ((n < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return BS_ERROR;
+        }
+        pPtr     += n;
+        numbytes -= (uint32_t)n;
+        pos      += n;
+    }
+
     return BS_OK;
+#endif
 }
 
 
@@ -315,7 +387,7 @@ static int32_t bs_switch_mode(bufstream_tt *pBS, uint8_t mode)
 
     if (pImp->mode != mode)
     {
-        if (bs_seek(pBS, BS_SEEK_START, pImp->bytecount) == BS_ERROR)
+        if (file_seek(pImp, BS_SEEK_START, pImp->bytecount) == BS_ERROR)
         {
             return BS_ERROR;
         }
@@ -338,37 +410,57 @@ static int32_t bs_switch_mode(bufstream_tt *pBS, uint8_t mode)
 }
 
 
+// back-patches already written data, the file position, the bytecount and the buffer state are kept
 static int32_t bs_seek_info(bufstream_tt *pBS, struct buf_seek_info *pSeekInfo)
 {
     struct impl_stream *pImp = pBS->Buf_IO_struct;
-    uint64_t bytecount = pImp->bytecount;
-    int32_t n;
+    uint64_t patch_start = pSeekInfo->seek_pos;
+    uint64_t patch_end   = patch_start + pSeekInfo->bfr_size;
+    uint64_t bfr_start   = pImp->bytecount - pImp->idx;
+    uint64_t bfr_end;
+    uint64_t start, end;
 
-    if ((pImp->mode == BS_FILE_WRITE_MODE) && (pImp->idx > 0))
+    // unflushed data in write mode, data read ahead in read mode
+    if (pImp->mode == BS_FILE_WRITE_MODE)
     {
-        n = rw_file_write(pImp->io, pImp->pBfr, pImp->idx);
-        if (n != (int32_t)pImp->idx)
-        {
-            return BS_ERROR;
-        }
-        bytecount = pImp->bytecount + pImp->idx;
-        pImp->idx = 0;
+        bfr_end = pImp->bytecount;
+    }
+    else
+    {
+        bfr_end = bfr_start + pImp->bfr_count;
     }
 
-    if (bs_seek(pBS, BS_SEEK_START, pSeekInfo->seek_pos) == BS_ERROR)
+    // the part of the patch inside of the buffer is overwritten there
+    start = (patch_start > bfr_start) ? patch_start : bfr_start;
+    end   = (patch_end < bfr_end) ? patch_end : bfr_end;
+    if (start < end)
     {
-        return BS_ERROR;
+        memcpy(pImp->pBfr + (start - bfr_start), pSeekInfo->bfr + (start - patch_start), (size_t)(end - start));
+    }
+    else
+    {
+        start = end = patch_end;
+    }
+
+    if (pImp->mode == BS_FILE_READ_MODE)
+    {
+        // the buffer is only a copy
+        return file_pwrite(pImp, pSeekInfo->bfr, pSeekInfo->bfr_size, patch_start);
     }
 
-    n = rw_file_write(pImp->io, pSeekInfo->bfr, pSeekInfo->bfr_size);
-    if (n != (int32_t)pSeekInfo->bfr_size)
+    // the rest goes to the file directly, the buffered part is written with the next flush
+    if ((patch_start < start) &&
+        (file_pwrite(pImp, pSeekInfo->bfr, (uint32_t)(start - patch_start), patch_start) == BS_ERROR))
+    {
+        return BS_ERROR;
+    }
+    if ((end < patch_end) &&
+        (file_pwrite(pImp, pSeekInfo->bfr + (end - patch_start), (uint32_t)(patch_end - end), end) == BS_ERROR))
     {
-        // see if we can seek back to the original position
-        bs_seek(pBS, BS_SEEK_START, bytecount);
         return BS_ERROR;
     }
 
-    return bs_seek(pBS, BS_SEEK_START, bytecount);
+    return BS_OK;
 }
 
 
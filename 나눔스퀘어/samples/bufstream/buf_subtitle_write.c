@@ -23,6 +23,12 @@
 #define SUBTITLE_BUFFER_SIZE	1024 * 1024
 #define BS_DEFAULT_DURATION		2700000			// 100ms?
 
+// room for the text around a cue (counter, timestamps, filepos)
+#define SUBTITLE_CUE_RESERVE	256
+
+// the VobSub picture data is collected and written in blocks of this size
+#define VSUB_BUFFER_SIZE		1024 * 1024
+
 struct subtitle_au_s
 {
 	uint8_t *pPtr;
@@ -39,7 +45,10 @@ struct subtitle_variables_s
 	mc_stream_format_t format;
 	mc_subtitle_format_t subtitle_format;
 
+	// the cues are formatted straight into this buffer, it is written when
+	// the next cue does not fit anymore and at the end
 	uint8_t subtitle_buffer[SUBTITLE_BUFFER_SIZE];
+	uint32_t subtitle_idx;
 
 	uint8_t headers_written;
 
@@ -50,6 +59,8 @@ struct subtitle_variables_s
 	// for VSUB
 	FILE *vsub_fp;
 	uint64_t filepos;
+	uint8_t *vsub_buffer;
+	uint32_t vsub_idx;
 
 	uint32_t total_sample_bytes;
 };
@@ -75,112 +86,204 @@ static void get_iso_639_1_from_639_2(uint16_t *pSrc, uint8_t *pDst);
 
 //---------------------------------------------------------------------------
 //
-// process_dxsb
+// output buffers
 //
 //---------------------------------------------------------------------------
 
-static uint32_t process_dxsb(struct subtitle_variables_s* s_vars, struct subtitle_au_s *pAU)
+static uint32_t flush_subtitle(struct impl_stream *p)
 {
-	// just copy it for now
-	memcpy(s_vars->subtitle_buffer, pAU->pPtr, pAU->len);
-	return pAU->len;
+	struct subtitle_variables_s* s_vars = &p->s_vars;
+
+	if (s_vars->subtitle_idx > 0)
+	{
+		if (fwrite(s_vars->subtitle_buffer, sizeof(uint8_t), s_vars->subtitle_idx, p->io) != s_vars->subtitle_idx)
+			return 1;
+		s_vars->subtitle_idx = 0;
+	}
+
+	return 0;
+}
+
+
+static uint32_t flush_vsub(struct subtitle_variables_s* s_vars)
+{
+	if (s_vars->vsub_idx > 0)
+	{
+		if (fwrite(s_vars->vsub_buffer, sizeof(uint8_t), s_vars->vsub_idx, s_vars->vsub_fp) != s_vars->vsub_idx)
+			return 1;
+		s_vars->vsub_idx = 0;
+	}
+
+	return 0;
+}
+
+
+static uint32_t write_vsub(struct subtitle_variables_s* s_vars, uint8_t *pPtr, uint32_t len)
+{
+	if (s_vars->vsub_idx + len > VSUB_BUFFER_SIZE)
+	{
+		if (flush_vsub(s_vars))
+			return 1;
+
+		// larger than the buffer, no need to copy it
+		if (len > VSUB_BUFFER_SIZE)
+			return fwrite(pPtr, sizeof(uint8_t), len, s_vars->vsub_fp) != len;
+	}
+
+	memcpy(&s_vars->vsub_buffer[s_vars->vsub_idx], pPtr, len);
+	s_vars->vsub_idx += len;
+
+	return 0;
 }
 
 
 //---------------------------------------------------------------------------
 //
-// process_utf8 (srt)
+// number formatting, same output as "%0*u" and "%0*X"
 //
 //---------------------------------------------------------------------------
 
-static void format_time_utf8(int64_t time, char *sz)
+static uint32_t put_dec(uint8_t *pDst, uint32_t value, uint32_t width)
 {
-	int64_t ptime = time < 0 ? -time : time;
-	int64_t time_ms = ptime / 27000;
+	uint8_t tmp[10];
+	uint32_t n = 0, len = 0;
 
-	int32_t	Hour = (int32_t)(time_ms / (1000 * 60 * 60));
-	int32_t	Sec = (int32_t)((time_ms / 1000) % 60);
-	int32_t	Min = (int32_t)((time_ms / (1000 * 60)) % 60);
+	do
+	{
+		tmp[n++] = (uint8_t)('0' + value % 10);
+		value /= 10;
+	} while (value);
 
-	int32_t Ms = (int32_t)(((ptime % 27000000) / 27000.0) + 0.5);
+	while (len + n < width)
+		pDst[len++] = '0';
 
-	if (time < 0)
-		sprintf(sz, "-%02d:%02d:%02d,%03d", Hour, Min, Sec, Ms);
-	else
-		sprintf(sz, "%02d:%02d:%02d,%03d", Hour, Min, Sec, Ms);
+	while (n > 0)
+		pDst[len++] = tmp[--n];
+
+	return len;
 }
 
 
-static uint32_t process_utf8(struct subtitle_variables_s* s_vars, struct subtitle_au_s *pAU)
+static uint32_t put_hex(uint8_t *pDst, uint32_t value, uint32_t width)
 {
-	char str[132], str1[25], str2[25];
-	uint32_t idx = 0;
+	static const char hexChars[] = "0123456789ABCDEF";
+	uint8_t tmp[8];
+	uint32_t n = 0, len = 0;
+
+	do
+	{
+		tmp[n++] = hexChars[value & 0x0F];
+		value >>= 4;
+	} while (value);
 
-	sprintf(str, "%u\n", s_vars->au_count + 1);
-	memcpy(s_vars->subtitle_buffer, str, strlen(str));
-	idx += (uint32_t)strlen(str);
+	while (len + n < width)
+		pDst[len++] = '0';
 
-	format_time_utf8(pAU->pts, str1);
-	format_time_utf8(pAU->pts + pAU->duration, str2);
-	sprintf(str, "%s --> %s\n", str1, str2);
-	memcpy(&s_vars->subtitle_buffer[idx], str, strlen(str));
-	idx += (uint32_t)strlen(str);
+	while (n > 0)
+		pDst[len++] = tmp[--n];
+
+	return len;
+}
 
-	memcpy(&s_vars->subtitle_buffer[idx], pAU->pPtr, pAU->len);
-	idx += pAU->len;
 
-	s_vars->subtitle_buffer[idx] = 0;
-	idx++;
+static uint32_t put_str(uint8_t *pDst, const char *str)
+{
+	uint32_t len = (uint32_t)strlen(str);
 
-	strcpy(str, "\n");
-	memcpy(&s_vars->subtitle_buffer[idx], str, strlen(str));
-	idx += (uint32_t)strlen(str);
+	memcpy(pDst, str, len);
+	return len;
+}
 
-	// and again
-	memcpy(&s_vars->subtitle_buffer[idx], str, strlen(str));
-	idx += (uint32_t)strlen(str);
 
-	return idx;
+// [-]H:MM:SS<sep>F from 27 MHz, the fraction is rounded to frac_div units
+static uint32_t format_time(int64_t time, uint8_t *pDst, uint32_t hour_width, uint8_t sep, uint32_t frac_div, uint32_t frac_width)
+{
+	int64_t ptime = time < 0 ? -time : time;
+	int64_t time_ms = ptime / 27000;
+	uint32_t len = 0;
+
+	uint32_t Hour = (uint32_t)(time_ms / (1000 * 60 * 60));
+	uint32_t Sec = (uint32_t)((time_ms / 1000) % 60);
+	uint32_t Min = (uint32_t)((time_ms / (1000 * 60)) % 60);
+
+	uint32_t Frac = (uint32_t)(((ptime % 27000000) + frac_div / 2) / frac_div);
+
+	if (time < 0)
+		pDst[len++] = '-';
+
+	len += put_dec(&pDst[len], Hour, hour_width);
+	pDst[len++] = ':';
+	len += put_dec(&pDst[len], Min, 2);
+	pDst[len++] = ':';
+	len += put_dec(&pDst[len], Sec, 2);
+	pDst[len++] = sep;
+	len += put_dec(&pDst[len], Frac, frac_width);
+
+	return len;
 }
 
 
 //---------------------------------------------------------------------------
 //
-// process_ssa
+// process_dxsb
 //
 //---------------------------------------------------------------------------
 
-static void format_time_ssa(int64_t time, char *sz)
+static uint32_t process_dxsb(struct subtitle_au_s *pAU, uint8_t *pDst)
 {
-	int64_t ptime = time < 0 ? -time : time;
-	int64_t time_ms = ptime / 27000;
+	// just copy it for now
+	memcpy(pDst, pAU->pPtr, pAU->len);
+	return pAU->len;
+}
 
-	int32_t	Hour = (int32_t)(time_ms / (1000 * 60 * 60));
-	int32_t	Sec = (int32_t)((time_ms / 1000) % 60);
-	int32_t	Min = (int32_t)((time_ms / (1000 * 60)) % 60);
 
-	int32_t Cs = (int32_t)(((ptime % 27000000) / 270000.0) + 0.5);
+//---------------------------------------------------------------------------
+//
+// process_utf8 (srt)
+//
+//---------------------------------------------------------------------------
 
-	if (time < 0)
-		sprintf(sz, "-%01d:%02d:%02d.%02d", Hour, Min, Sec, Cs);
-	else
-		sprintf(sz, "%01d:%02d:%02d.%02d", Hour, Min, Sec, Cs);
+static uint32_t process_utf8(struct subtitle_variables_s* s_vars, struct subtitle_au_s *pAU, uint8_t *pDst)
+{
+	uint32_t idx = 0;
+
+	idx += put_dec(&pDst[idx], s_vars->au_count + 1, 1);
+	pDst[idx++] = '\n';
+
+	idx += format_time(pAU->pts, &pDst[idx], 2, ',', 27000, 3);
+	idx += put_str(&pDst[idx], " --> ");
+	idx += format_time(pAU->pts + pAU->duration, &pDst[idx], 2, ',', 27000, 3);
+	pDst[idx++] = '\n';
+
+	memcpy(&pDst[idx], pAU->pPtr, pAU->len);
+	idx += pAU->len;
+
+	pDst[idx++] = 0;
+	pDst[idx++] = '\n';
+
+	// and again
+	pDst[idx++] = '\n';
+
+	return idx;
 }
 
 
-static uint32_t process_ssa(struct subtitle_variables_s* s_vars, struct subtitle_au_s *pAU)
+//---------------------------------------------------------------------------
+//
+// process_ssa
+//
+//---------------------------------------------------------------------------
+
+static uint32_t process_ssa(struct subtitle_au_s *pAU, uint8_t *pDst)
 {
-	char str[132], str1[25], str2[25];
 	uint32_t i, idx = 0;
 	uint8_t *pPtr = pAU->pPtr;
 	int32_t len = pAU->len;
 
-	format_time_ssa(pAU->pts, str1);
-	format_time_ssa(pAU->pts + pAU->duration, str2);
-
-	sprintf(str, "Dialogue: Marked=0,%s,%s", str1, str2);
-	memcpy(&s_vars->subtitle_buffer[idx], str, strlen(str));
-	idx += (uint32_t)strlen(str);
+	idx += put_str(&pDst[idx], "Dialogue: Marked=0,");
+	idx += format_time(pAU->pts, &pDst[idx], 1, '.', 270000, 2);
+	pDst[idx++] = ',';
+	idx += format_time(pAU->pts + pAU->duration, &pDst[idx], 1, '.', 270000, 2);
 
 	// skip the leading number and first comma
 	i = 0;
@@ -199,18 +302,16 @@ static uint32_t process_ssa(struct subtitle_variables_s* s_vars, struct subtitle
 	if (len == 0)
 	{
 		// not found?
-		memcpy(&s_vars->subtitle_buffer[idx], pAU->pPtr, pAU->len);
+		memcpy(&pDst[idx], pAU->pPtr, pAU->len);
 		idx += pAU->len;
 	}
 	else
 	{
-		memcpy(&s_vars->subtitle_buffer[idx], pPtr, len);
+		memcpy(&pDst[idx], pPtr, len);
 		idx += len;
 	}
 
-	strcpy(str, "\n");
-	memcpy(&s_vars->subtitle_buffer[idx], str, strlen(str));
-	idx += (uint32_t)strlen(str);
+	pDst[idx++] = '\n';
 
 	return idx;
 }
@@ -222,10 +323,10 @@ static uint32_t process_ssa(struct subtitle_variables_s* s_vars, struct subtitle
 //
 //---------------------------------------------------------------------------
 
-static uint32_t process_usf(struct subtitle_variables_s* s_vars, struct subtitle_au_s *pAU)
+static uint32_t process_usf(struct subtitle_au_s *pAU, uint8_t *pDst)
 {
 	// just copy it for now
-	memcpy(s_vars->subtitle_buffer, pAU->pPtr, pAU->len);
+	memcpy(pDst, pAU->pPtr, pAU->len);
 	return pAU->len;
 }
 
@@ -236,44 +337,23 @@ static uint32_t process_usf(struct subtitle_variables_s* s_vars, struct subtitle
 //
 //---------------------------------------------------------------------------
 
-static void format_time_vsub(int64_t time, char *sz)
+static uint32_t process_vsub(struct subtitle_variables_s* s_vars, struct subtitle_au_s *pAU, uint8_t *pDst)
 {
-	int64_t ptime = time < 0 ? -time : time;
-	int64_t time_ms = ptime / 27000;
-
-	int32_t	Hour = (int32_t)(time_ms / (1000 * 60 * 60));
-	int32_t	Sec = (int32_t)((time_ms / 1000) % 60);
-	int32_t	Min = (int32_t)((time_ms / (1000 * 60)) % 60);
-
-	int32_t Ms = (int32_t)(((ptime % 27000000) / 27000.0) + 0.5);
-
-	if (time < 0)
-		sprintf(sz, "-%02d:%02d:%02d:%03d", Hour, Min, Sec, Ms);
-	else
-		sprintf(sz, "%02d:%02d:%02d:%03d", Hour, Min, Sec, Ms);
-}
-
-
-static uint32_t process_vsub(struct subtitle_variables_s* s_vars, struct subtitle_au_s *pAU)
-{
-	char str[132], str1[25];
-	uint32_t i, idx = 0;
-	uint8_t *pPtr = pAU->pPtr;
-	int32_t len = pAU->len;
+	uint32_t idx = 0;
 
 	// write entry to index file
-	format_time_vsub(pAU->pts, str1);
-
-	sprintf(str, "timestamp: %s, filepos: %01X%08X\n", str1, (uint32_t)(s_vars->filepos >> 32), (uint32_t)(s_vars->filepos & 0xFFFFFFFF));
-	memcpy(&s_vars->subtitle_buffer[idx], str, strlen(str));
-	idx += (uint32_t)strlen(str);
+	idx += put_str(&pDst[idx], "timestamp: ");
+	idx += format_time(pAU->pts, &pDst[idx], 2, ':', 27000, 3);
+	idx += put_str(&pDst[idx], ", filepos: ");
+	idx += put_hex(&pDst[idx], (uint32_t)(s_vars->filepos >> 32), 1);
+	idx += put_hex(&pDst[idx], (uint32_t)(s_vars->filepos & 0xFFFFFFFF), 8);
+	pDst[idx++] = '\n';
 
 	// copy data to sub file
-	i = (uint32_t)fwrite(pPtr, sizeof(uint8_t), len, s_vars->vsub_fp);
-	if (i != len)
+	if (write_vsub(s_vars, pAU->pPtr, pAU->len))
 		return 0;
 
-	s_vars->filepos += len;
+	s_vars->filepos += pAU->len;
 
 	return idx;
 }
@@ -289,27 +369,38 @@ static uint32_t write_subtitle(bufstream_tt *bs, struct subtitle_au_s *pAU)
 {
 	struct impl_stream* p = bs->Buf_IO_struct;
 	struct subtitle_variables_s* s_vars = &p->s_vars;
-	uint32_t i;
+	uint8_t *pDst;
 	uint32_t subtitle_size = 0;
 
+	if (s_vars->subtitle_idx + pAU->len + SUBTITLE_CUE_RESERVE > SUBTITLE_BUFFER_SIZE)
+	{
+		if (flush_subtitle(p))
+			return 1;
+
+		if (pAU->len + SUBTITLE_CUE_RESERVE > SUBTITLE_BUFFER_SIZE)
+			return 1;
+	}
+
+	pDst = &s_vars->subtitle_buffer[s_vars->subtitle_idx];
+
 	// convert the subtitle
 	switch (s_vars->subtitle_info.pFormat->stream_mediatype)
 	{
 	case mctDXSB_Subtitles:
-		subtitle_size = process_dxsb(s_vars, pAU);
+		subtitle_size = process_dxsb(pAU, pDst);
 		break;
 	case mctUTF8_Subtitles:
-		subtitle_size = process_utf8(s_vars, pAU);
+		subtitle_size = process_utf8(s_vars, pAU, pDst);
 		break;
 	case mctSSA_Subtitles:
 	case mctASS_Subtitles:
-		subtitle_size = process_ssa(s_vars, pAU);
+		subtitle_size = process_ssa(pAU, pDst);
 		break;
 	case mctUSF_Subtitles:
-		subtitle_size = process_usf(s_vars, pAU);
+		subtitle_size = process_usf(pAU, pDst);
 		break;
 	case mctVSUB_Subtitles:
-		subtitle_size = process_vsub(s_vars, pAU);
+		subtitle_size = process_vsub(s_vars, pAU, pDst);
 		break;
 	default:
 		return 1;
@@ -317,12 +408,9 @@ static uint32_t write_subtitle(bufstream_tt *bs, struct subtitle_au_s *pAU)
 
 	if (subtitle_size > 0)
 	{
-		i = (uint32_t)fwrite(&s_vars->subtitle_buffer[0], sizeof(uint8_t), subtitle_size, p->io);
-		if (i != subtitle_size)
-			return 1;
-
-		s_vars->total_sample_bytes += i;
-		p->bytecount += i;
+		s_vars->subtitle_idx += subtitle_size;
+		s_vars->total_sample_bytes += subtitle_size;
+		p->bytecount += subtitle_size;
 		s_vars->au_count++;
 	}
 	else
@@ -353,9 +441,8 @@ static uint32_t write_headers(bufstream_tt *bs)
 	struct subtitle_variables_s* s_vars = &p->s_vars;
 	char str[132];
 	int32_t idx;
-	size_t bytes_written;
 
-	// write the header
+	// the headers are the first output, they are built at the start of the buffer
 	switch (s_vars->subtitle_info.pFormat->stream_mediatype)
 	{
 	case mctDXSB_Subtitles:
@@ -396,12 +483,9 @@ static uint32_t write_headers(bufstream_tt *bs)
 			}
 		}
 
-		bytes_written = fwrite(s_vars->subtitle_buffer, sizeof(uint8_t), idx, p->io);
-		if (bytes_written != idx)
-			return 1;
-
-		s_vars->total_sample_bytes += (uint32_t)bytes_written;
-		p->bytecount += bytes_written;
+		s_vars->subtitle_idx = idx;
+		s_vars->total_sample_bytes += idx;
+		p->bytecount += idx;
 		break;
 	case mctUSF_Subtitles:
 		break;
@@ -429,12 +513,9 @@ static uint32_t write_headers(bufstream_tt *bs)
 		memcpy(&s_vars->subtitle_buffer[idx], str, strlen(str));
 		idx += (int32_t)strlen(str);
 
-		bytes_written = fwrite(s_vars->subtitle_buffer, sizeof(uint8_t), idx, p->io);
-		if (bytes_written != idx)
-			return 1;
-
-		s_vars->total_sample_bytes += (uint32_t)bytes_written;
-		p->bytecount += bytes_written;
+		s_vars->subtitle_idx = idx;
+		s_vars->total_sample_bytes += idx;
+		p->bytecount += idx;
 		break;
 	default:
 		return 1;
@@ -664,6 +745,8 @@ static void fw_done(bufstream_tt *bs, int32_t abort)
 
     if (abort){};  // remove compile warning
 
+	flush_subtitle(p);
+
 	if (p->idx > 0)
 	{
 		fwrite(p->bfr, sizeof(uint8_t), p->idx, p->io);
@@ -675,7 +758,13 @@ static void fw_done(bufstream_tt *bs, int32_t abort)
 		free(s_vars->format.pbExtraData);
 
 	if (s_vars->vsub_fp)
+	{
+		flush_vsub(s_vars);
 		fclose(s_vars->vsub_fp);
+	}
+
+	if (s_vars->vsub_buffer)
+		free(s_vars->vsub_buffer);
 
 	free(p);
 	bs->Buf_IO_struct = NULL;
@@ -747,6 +836,15 @@ static int32_t init_file_buf_write(bufstream_tt *bs,
 
 	if (subtitle_info->pFormat->stream_mediatype == mctVSUB_Subtitles)
 	{
+		s_vars->vsub_buffer = (uint8_t*)malloc(VSUB_BUFFER_SIZE);
+		if (!s_vars->vsub_buffer)
+		{
+			if (s_vars->format.pbExtraData)
+				free(s_vars->format.pbExtraData);
+			free(p_impl);
+			return BS_ERROR;
+		}
+
 #ifdef _BS_UNICODE
 		s_vars->vsub_fp = _wfopen(vsub_filename, L"wb");
 #else
@@ -760,6 +858,7 @@ static int32_t init_file_buf_write(bufstream_tt *bs,
 		{
 			if (s_vars->format.pbExtraData)
 				free(s_vars->format.pbExtraData);
+			free(s_vars->vsub_buffer);
 			free(p_impl);
 			return BS_ERROR;
 		}
@@ -780,6 +879,8 @@ static int32_t init_file_buf_write(bufstream_tt *bs,
 			free(s_vars->format.pbExtraData);
 		if (s_vars->vsub_fp)
 			fclose(s_vars->vsub_fp);
+		if (s_vars->vsub_buffer)
+			free(s_vars->vsub_buffer);
 		free(p_impl);
 		return BS_ERROR;
 	}
@@ -0,0 +1,631 @@
+/* ----------------------------------------------------------------------------
+ * File: buf_vbin.c
+ *
+ * Desc: Buffered stream splitter for binary index output of a video stream,
+ *       and a reader for the index
+ *
+ * Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if (defined(__APPLE__) ||  defined(__linux__))
+#include <unistd.h>
+#include <sys/mman.h>
+#else
+#include <windows.h>
+#endif
+
+#include "buf_vbin.h"
+#include "vau_parser.h"
+
+#define VBIN_OUTPUT_BUFFER (64 * 1024)
+
+static const char vbin_magic[8] = { 'M', 'C', 'V', 'B', 'I', 'N', '0', '1' };
+
+//implementation structure
+struct impl_stream
+{
+  bufstream_tt      *video_bs;       // bufstream the index is written to
+  int32_t            initOutput;
+  struct vau_parser  parser;         // access unit of the video passed to main_bs
+  uint8_t           *outBuffer;      // index output, passed on in large blocks
+  uint32_t           outCount;
+  uint64_t           outPos;         // index bytes written so far
+  struct byte_arena  gopTable;       // GOP records, written in done
+  uint32_t           gopCount;
+  uint32_t           frameCount;
+};
+
+
+static void put_le32(uint8_t *ptr, uint32_t value)
+{
+  ptr[0] = (uint8_t)value;
+  ptr[1] = (uint8_t)(value >> 8);
+  ptr[2] = (uint8_t)(value >> 16);
+  ptr[3] = (uint8_t)(value >> 24);
+}
+
+static void put_le64(uint8_t *ptr, uint64_t value)
+{
+  put_le32(ptr, (uint32_t)value);
+  put_le32(ptr + 4, (uint32_t)(value >> 32));
+}
+
+static uint32_t get_le32(const uint8_t *ptr)
+{
+  return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) | ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static uint64_t get_le64(const uint8_t *ptr)
+{
+  return (uint64_t)get_le32(ptr) | ((uint64_t)get_le32(ptr + 4) << 32);
+}
+
+
+static void out_flush(struct impl_stream* p)
+{
+  if(p->outCount)
+  {
+    p->video_bs->copybytes(p->video_bs, p->outBuffer, p->outCount);
+    p->outCount = 0;
+  }
+}
+
+static void out_write(struct impl_stream* p, const uint8_t *ptr, uint32_t numbytes)
+{
+  p->outPos += numbytes;
+
+  if(p->outCount + numbytes > VBIN_OUTPUT_BUFFER)
+  {
+    out_flush(p);
+    if(numbytes > VBIN_OUTPUT_BUFFER)
+    {
+      p->video_bs->copybytes(p->video_bs, (uint8_t*)ptr, numbytes);
+      return;
+    }
+  }
+
+  memcpy(p->outBuffer + p->outCount, ptr, numbytes);
+  p->outCount += numbytes;
+}
+
+
+static uint32_t idx_usable_bytes(bufstream_tt *bs)
+{
+  return bs->Buf_IO_struct->parser.main_bs->usable_bytes (bs->Buf_IO_struct->parser.main_bs);
+}
+
+static uint8_t *idx_request(bufstream_tt *bs, uint32_t numbytes)
+{
+  return vau_parser_request(&bs->Buf_IO_struct->parser, numbytes);
+}
+
+static uint32_t idx_confirm(bufstream_tt *bs, uint32_t numbytes)
+{
+  return vau_parser_confirm(&bs->Buf_IO_struct->parser, numbytes);
+}
+
+static uint32_t idx_copybytes(bufstream_tt *bs, uint8_t *ptr, uint32_t numbytes)
+{
+  return bs->Buf_IO_struct->parser.main_bs->copybytes (bs->Buf_IO_struct->parser.main_bs, ptr, numbytes);
+}
+
+static uint32_t idx_split (bufstream_tt *bs)
+{
+  return bs->Buf_IO_struct->parser.main_bs->split (bs->Buf_IO_struct->parser.main_bs);
+}
+
+static uint32_t idx_chunksize(bufstream_tt *bs)
+{
+  return bs->Buf_IO_struct->parser.main_bs->chunksize (bs->Buf_IO_struct->parser.main_bs);
+}
+
+
+static void write_file_header(struct impl_stream* p)
+{
+  uint8_t hdr[VBIN_HEADER_SIZE];
+
+  memcpy(hdr, vbin_magic, 8);
+  put_le32(hdr + 8, VBIN_GOP_RECORD_SIZE);
+  put_le32(hdr + 12, VBIN_FRAME_RECORD_SIZE);
+  out_write(p, hdr, VBIN_HEADER_SIZE);
+  p->initOutput = 1;
+}
+
+
+// writes the frame records and the header blob of the GOP, the GOP record is kept for the table
+static int32_t write_vau_info(bufstream_tt *bs)
+{
+  struct impl_stream* p = bs->Buf_IO_struct;
+  struct vau_unit *aunit = &p->parser.aunit;
+  uint8_t rec[VBIN_GOP_RECORD_SIZE];
+  uint64_t frame_offset, blob_offset;
+  uint32_t frames = 0;
+  int64_t gop_duration;
+  int32_t i;
+
+  if(!p->initOutput)
+    write_file_header(p);
+
+  if(bs->flags == 0)
+  {
+    for(i = 0; i < MAXN; i++)
+    {
+      if(aunit->frames[i].present)
+        frames++;
+    }
+  }
+
+  frame_offset = p->outPos;
+  blob_offset = frame_offset + (uint64_t)frames * VBIN_FRAME_RECORD_SIZE;
+
+  if(frames)
+  {
+    for(i = 0; i < MAXN; i++)
+    {
+      struct vau_picture *pic = &aunit->frames[i];
+
+      if(pic->present)
+      {
+        put_le64(rec, (uint64_t)pic->relPosition);
+        put_le64(rec + 8, blob_offset + pic->headerData.offset);
+        put_le32(rec + 16, pic->headerData.len);
+        put_le32(rec + 20, i);
+        out_write(p, rec, VBIN_FRAME_RECORD_SIZE);
+      }
+    }
+    out_write(p, aunit->headers.data, aunit->headers.len);
+  }
+
+  gop_duration = vau_parser_finish_unit(&p->parser);
+
+  put_le64(rec, (uint64_t)aunit->gopPosition);
+  put_le64(rec + 8, (uint64_t)(aunit->firstPTS / 300));
+  put_le64(rec + 16, (uint64_t)(gop_duration / 300));
+  put_le64(rec + 24, frame_offset);
+  put_le64(rec + 32, frames ? blob_offset + aunit->headerData.offset : 0);
+  put_le32(rec + 40, aunit->gopSize);
+  put_le32(rec + 44, frames ? aunit->headerData.len : 0);
+  put_le32(rec + 48, frames);
+  put_le32(rec + 52, (aunit->unitType & SEQHDR_FLAG) ? 1 : 0);
+
+  if(byte_arena_add(&p->gopTable, rec, VBIN_GOP_RECORD_SIZE) < 0)
+    return BS_ERROR;
+
+  p->gopCount++;
+  p->frameCount += frames;
+  return BS_OK;
+}
+
+
+
+static uint32_t idx_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, void *info_ptr, uint32_t info_size)
+{
+  struct impl_stream* p = bs->Buf_IO_struct;
+
+  switch(info_ID)
+  {
+    case FLUSH_BUFFER:
+      if(p->video_bs)
+      {
+        out_flush(p);
+        p->video_bs->auxinfo(p->video_bs, 0, info_ID, NULL, 0);
+      }
+      break;
+
+    case VIDEO_AU_CODE:
+      if(p->video_bs)
+      {
+        struct v_au_struct *pau = (struct v_au_struct*)info_ptr;
+
+        // send out previous GOP info
+        if(vau_parser_unit_done(&p->parser, pau))
+          write_vau_info(bs);
+
+        vau_parser_add_au(&p->parser, pau);
+      }
+      break;
+  }
+  vau_parser_auxinfo(&p->parser, info_ID, info_ptr);
+
+  // pass on everything to main_bs
+  if(p->parser.main_bs)
+    p->parser.main_bs->auxinfo(p->parser.main_bs, offs, info_ID, info_ptr, info_size);
+  return BS_OK;
+}
+
+
+static void idx_done(bufstream_tt *bs, int32_t Abort)
+{
+  struct impl_stream* p = bs->Buf_IO_struct;
+
+  if(p->video_bs)
+  {
+    uint8_t trailer[VBIN_TRAILER_SIZE];
+    uint64_t table_offset;
+
+    if(!Abort)
+    {
+      if(p->parser.aunit.firstPTS >= 0)
+        write_vau_info(bs);
+    }
+
+    if(!p->initOutput)
+      write_file_header(p);
+
+    table_offset = p->outPos;
+    out_write(p, p->gopTable.data, p->gopTable.len);
+
+    memcpy(trailer, vbin_magic, 8);
+    put_le64(trailer + 8, table_offset);
+    put_le32(trailer + 16, p->gopCount);
+    put_le32(trailer + 20, p->frameCount);
+    put_le64(trailer + 24, (uint64_t)(p->parser.duration / 300));
+    put_le64(trailer + 32, (uint64_t)p->parser.byteCount);
+    out_write(p, trailer, VBIN_TRAILER_SIZE);
+
+    out_flush(p);
+  }
+
+  vau_parser_free(&p->parser);
+  byte_arena_free(&p->gopTable);
+
+  if(p->outBuffer)
+    free(p->outBuffer);
+
+  free(p);
+  bs->Buf_IO_struct = NULL;
+}
+
+
+static void idx_free(bufstream_tt *bs)
+{
+  if(bs->Buf_IO_struct)
+    bs->done(bs,0);
+
+  free(bs);
+}
+
+
+int32_t init_bufstream_write_with_vbin_index(
+                                            bufstream_tt *bs,
+                                            bufstream_tt *main_bs,
+                                            bufstream_tt *video_bs,
+                                            uint32_t flag,
+                                            void (*DisplayError)(char *txt))
+{
+  if (DisplayError){};  // remove compile warning
+
+  if(!main_bs)
+  {
+    return BS_ERROR;
+  }
+
+  memset (bs, 0, sizeof (bufstream_tt));
+
+  bs->Buf_IO_struct = (struct impl_stream*)malloc(sizeof(struct impl_stream));
+  if(!bs->Buf_IO_struct)
+  {
+    return BS_ERROR;
+  }
+  memset (bs->Buf_IO_struct, 0, sizeof(struct impl_stream));
+
+
+  bs->usable_bytes = idx_usable_bytes;
+  bs->request      = idx_request;
+  bs->confirm      = idx_confirm;
+  bs->copybytes    = idx_copybytes;
+  bs->split        = idx_split;
+  bs->chunksize    = idx_chunksize;
+  bs->free         = idx_free;
+  bs->auxinfo      = idx_auxinfo;
+  bs->done         = idx_done;
+  bs->state        = NULL;
+  bs->drive_ptr    = NULL;
+  bs->drive        = NULL;
+
+  bs->flags        = flag;
+
+  vau_parser_init(&bs->Buf_IO_struct->parser, main_bs);
+
+
+  if(video_bs)
+  {
+    bs->Buf_IO_struct->video_bs = video_bs;
+    bs->Buf_IO_struct->outBuffer = (uint8_t*)malloc(VBIN_OUTPUT_BUFFER);
+    if(!bs->Buf_IO_struct->outBuffer)
+    {
+      free(bs->Buf_IO_struct);
+      return BS_ERROR;
+    }
+  }
+
+  return BS_OK;
+}
+
+
+bufstream_tt *open_bufstream_write_with_vbin_index(bufstream_tt *main_bs,
+                                                   bufstream_tt *video_idx,
+                                                   uint32_t flag,
+                                                   void (*DisplayError)(char *txt))
+{
+  bufstream_tt *p;
+  p=(bufstream_tt*)malloc(sizeof(bufstream_tt));
+  if(p)
+  {
+    if(BS_OK != init_bufstream_write_with_vbin_index (p, main_bs, video_idx, flag, DisplayError))
+    {
+      free(p);
+      p = NULL;
+    }
+  }
+  return p;
+}
+
+
+
+void close_bufstream_write_with_vbin_index(bufstream_tt* bs, int32_t Abort)
+{
+  bs->done(bs, Abort);
+  bs->free(bs);
+}
+
+
+/* ----------------------------------------------------------------------------
+ * reader
+ * ----------------------------------------------------------------------------
+ */
+
+struct vbin_index
+{
+  const uint8_t *data;
+  uint64_t       size;
+  const uint8_t *gops;
+  uint32_t       gop_count;
+  uint32_t       gop_record_size;
+  uint32_t       frame_record_size;
+  int64_t        duration;
+#if (!defined(__APPLE__) && !defined(__linux__))
+  HANDLE         file;
+  HANDLE         mapping;
+#endif
+};
+
+
+#ifdef _BS_UNICODE
+vbin_index_tt *vbin_index_open(const wchar_t *filename)
+#else
+vbin_index_tt *vbin_index_open(const char *filename)
+#endif
+{
+  vbin_index_tt *idx;
+  const uint8_t *trailer;
+  uint64_t table_offset;
+
+  idx = (vbin_index_tt*)malloc(sizeof(vbin_index_tt));
+  if(!idx)
+    return NULL;
+  memset(idx, 0, sizeof(vbin_index_tt));
+
+#if (defined(__APPLE__) ||  defined(__linux__))
+  {
+    struct stat st;
+    void *map;
+    int fd = open(filename, O_RDONLY);
+
+    if(fd < 0)
+    {
+      free(idx);
+      return NULL;
+    }
+
+    if((fstat(fd, &st) < 0) || (st.st_size < VBIN_HEADER_SIZE + VBIN_TRAILER_SIZE) ||
+       ((uint64_t)(size_t)st.st_size != (uint64_t)st.st_size))
+    {
+      close(fd);
+      free(idx);
+      return NULL;
+    }
+
+    // the mapping stays valid after the file is closed
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+      free(idx);
+      return NULL;
+    }
+    idx->data = (const uint8_t*)map;
+    idx->size = (uint64_t)st.st_size;
+  }
+#else
+  {
+    LARGE_INTEGER size;
+
+#ifdef _BS_UNICODE
+    idx->file = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+    idx->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#endif
+    if(idx->file == INVALID_HANDLE_VALUE)
+    {
+      free(idx);
+      return NULL;
+    }
+
+    if(!GetFileSizeEx(idx->file, &size) || (size.QuadPart < VBIN_HEADER_SIZE + VBIN_TRAILER_SIZE) ||
+       ((uint64_t)(SIZE_T)size.QuadPart != (uint64_t)size.QuadPart))
+    {
+      CloseHandle(idx->file);
+      free(idx);
+      return NULL;
+    }
+
+    idx->mapping = CreateFileMapping(idx->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(idx->mapping)
+      idx->data = (const uint8_t*)MapViewOfFile(idx->mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!idx->data)
+    {
+      if(idx->mapping)
+        CloseHandle(idx->mapping);
+      CloseHandle(idx->file);
+      free(idx);
+      return NULL;
+    }
+    idx->size = (uint64_t)size.QuadPart;
+  }
+#endif
+
+  // older readers skip fields appended to the records later
+  idx->gop_record_size = get_le32(idx->data + 8);
+  idx->frame_record_size = get_le32(idx->data + 12);
+
+  trailer = idx->data + idx->size - VBIN_TRAILER_SIZE;
+  table_offset = get_le64(trailer + 8);
+  idx->gop_count = get_le32(trailer + 16);
+  idx->duration = (int64_t)get_le64(trailer + 24);
+
+  if(memcmp(idx->data, vbin_magic, 8) || memcmp(trailer, vbin_magic, 8) ||
+     (idx->gop_record_size < VBIN_GOP_RECORD_SIZE) || (idx->frame_record_size < VBIN_FRAME_RECORD_SIZE) ||
+     (table_offset > idx->size - VBIN_TRAILER_SIZE) ||
+     ((uint64_t)idx->gop_count * idx->gop_record_size > idx->size - VBIN_TRAILER_SIZE - table_offset))
+  {
+    vbin_index_close(idx);
+    return NULL;
+  }
+
+  idx->gops = idx->data + table_offset;
+  return idx;
+}
+
+
+void vbin_index_close(vbin_index_tt *idx)
+{
+  if(!idx)
+    return;
+
+#if (defined(__APPLE__) ||  defined(__linux__))
+  munmap((void*)idx->data, (size_t)idx->size);
+#else
+  UnmapViewOfFile(idx->data);
+  CloseHandle(idx->mapping);
+  CloseHandle(idx->file);
+#endif
+  free(idx);
+}
+
+
+uint32_t vbin_index_gop_count(vbin_index_tt *idx)
+{
+  return idx->gop_count;
+}
+
+
+int64_t vbin_index_duration(vbin_index_tt *idx)
+{
+  return idx->duration;
+}
+
+
+// checks that a range of the file is inside of the mapping
+static const uint8_t *index_range(vbin_index_tt *idx, uint64_t offset, uint64_t size)
+{
+  if((offset > idx->size) || (size > idx->size - offset))
+    return NULL;
+  return idx->data + offset;
+}
+
+
+int32_t vbin_index_get_gop(vbin_index_tt *idx, uint32_t gop, struct vbin_gop_info *info)
+{
+  const uint8_t *rec;
+
+  if(gop >= idx->gop_count)
+    return BS_ERROR;
+
+  rec = idx->gops + (uint64_t)gop * idx->gop_record_size;
+  info->position    = (int64_t)get_le64(rec);
+  info->pts         = (int64_t)get_le64(rec + 8);
+  info->duration    = (int64_t)get_le64(rec + 16);
+  info->size        = get_le32(rec + 40);
+  info->header_len  = get_le32(rec + 44);
+  info->frame_count = get_le32(rec + 48);
+  info->unit_type   = get_le32(rec + 52);
+
+  info->header = index_range(idx, get_le64(rec + 32), info->header_len);
+  if(!info->header && info->header_len)
+    return BS_ERROR;
+
+  return BS_OK;
+}
+
+
+int32_t vbin_index_get_frame(vbin_index_tt *idx, uint32_t gop, uint32_t frame, struct vbin_frame_info *info)
+{
+  const uint8_t *gop_rec;
+  const uint8_t *rec;
+
+  if(gop >= idx->gop_count)
+    return BS_ERROR;
+
+  gop_rec = idx->gops + (uint64_t)gop * idx->gop_record_size;
+  if(frame >= get_le32(gop_rec + 48))
+    return BS_ERROR;
+
+  rec = index_range(idx, get_le64(gop_rec + 24) + (uint64_t)frame * idx->frame_record_size, idx->frame_record_size);
+  if(!rec)
+    return BS_ERROR;
+
+  info->offset     = (int64_t)get_le64(rec);
+  info->header_len = get_le32(rec + 16);
+  info->temp_ref   = get_le32(rec + 20);
+
+  info->header = index_range(idx, get_le64(rec + 8), info->header_len);
+  if(!info->header && info->header_len)
+    return BS_ERROR;
+
+  return BS_OK;
+}
+
+
+// binary search over the GOP table, field is the offset of an ascending int64 in the records
+static int32_t find_gop(vbin_index_tt *idx, uint32_t field, int64_t value)
+{
+  uint32_t lo = 0;
+  uint32_t hi = idx->gop_count;
+
+  while(lo < hi)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+
+    if((int64_t)get_le64(idx->gops + (uint64_t)mid * idx->gop_record_size + field) <= value)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return (int32_t)lo - 1;
+}
+
+
+int32_t vbin_index_find_pts(vbin_index_tt *idx, int64_t pts)
+{
+  return find_gop(idx, 8, pts);
+}
+
+
+int32_t vbin_index_find_position(vbin_index_tt *idx, int64_t position)
+{
+  return find_gop(idx, 0, position);
+}
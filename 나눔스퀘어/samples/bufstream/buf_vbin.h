@@ -0,0 +1,107 @@
+/* ----------------------------------------------------------------------------
+ * File: buf_vbin.h
+ *
+ * Desc: Buffered stream splitter for binary index output of a video stream,
+ *       and a reader for the index
+ *
+ * Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ *
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef BUF_VBIN_H
+#define BUF_VBIN_H
+
+#include "bufstrm.h"
+
+//------------------------------------------------------------------------------
+
+// The index holds the same data as the VXML index (buf_vxml.h), all numbers little-endian:
+//
+//   file header      "MCVBIN01", uint32 GOP record size, uint32 frame record size
+//   per GOP          frame records (in temp ref order), then the header blob with
+//                    the GOP headers and the picture headers, as they are in the stream
+//   GOP table        one record per GOP, in stream order
+//   trailer          "MCVBIN01", uint64 GOP table offset, uint32 GOP count,
+//                    uint32 frame count, int64 stream duration, int64 stream size
+//
+// GOP record: int64 position, int64 PTS, int64 duration (both 90 kHz), uint64 offset of the
+// frame records, uint64 offset of the GOP headers, uint32 size, uint32 header length,
+// uint32 frame count, uint32 unit type (1 = SEQ)
+//
+// frame record: int64 offset from the GOP position, uint64 offset of the picture headers,
+// uint32 header length, uint32 temp ref
+
+#define VBIN_GOP_RECORD_SIZE    56
+#define VBIN_FRAME_RECORD_SIZE  24
+#define VBIN_HEADER_SIZE        16
+#define VBIN_TRAILER_SIZE       40
+
+typedef struct vbin_index vbin_index_tt;
+
+struct vbin_gop_info
+{
+  int64_t        position;
+  int64_t        pts;
+  int64_t        duration;
+  uint32_t       size;
+  uint32_t       unit_type;
+  uint32_t       frame_count;
+  uint32_t       header_len;
+  const uint8_t *header;       // points into the mapped index
+};
+
+struct vbin_frame_info
+{
+  int64_t        offset;
+  uint32_t       temp_ref;
+  uint32_t       header_len;
+  const uint8_t *header;       // points into the mapped index
+};
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bufstream_tt *open_bufstream_write_with_vbin_index (
+  bufstream_tt *main_bs,
+  bufstream_tt *video_idx,
+  uint32_t flag,
+  void (*DisplayError)(char *txt));
+
+void close_bufstream_write_with_vbin_index (
+  bufstream_tt* bs,
+  int32_t Abort);
+
+
+// the reader maps the whole index, opening costs the same for any index size
+#ifdef _BS_UNICODE
+vbin_index_tt *vbin_index_open(const wchar_t *filename);
+#else
+vbin_index_tt *vbin_index_open(const char *filename);
+#endif
+
+void vbin_index_close(vbin_index_tt *idx);
+
+uint32_t vbin_index_gop_count(vbin_index_tt *idx);
+int64_t  vbin_index_duration(vbin_index_tt *idx);
+
+int32_t vbin_index_get_gop(vbin_index_tt *idx, uint32_t gop, struct vbin_gop_info *info);
+int32_t vbin_index_get_frame(vbin_index_tt *idx, uint32_t gop, uint32_t frame, struct vbin_frame_info *info);
+
+// the last GOP starting at or before pts (90 kHz) or position, -1 if there is none
+int32_t vbin_index_find_pts(vbin_index_tt *idx, int64_t pts);
+int32_t vbin_index_find_position(vbin_index_tt *idx, int64_t position);
+
+#ifdef __cplusplus
+}
+#endif
+
+//------------------------------------------------------------------------------
+
+#endif // BUF_VBIN_H
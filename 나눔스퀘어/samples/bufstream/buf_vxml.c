@@ -17,445 +17,133 @@
 #include <stdio.h>
 
 #include "buf_vxml.h"
-#include "auxinfo.h"
-#include "mcdefs.h"
+#include "xml_writer.h"
+#include "vau_parser.h"
 
 #define DO_BASE64   // represent the header data in base64, else ASCII
 
-#ifdef MC_LITTLEENDIAN
-#define BS_INT32(x) ((((x)&0x000000FF)<<24)|(((x)&0x0000FF00)<<8)|(((x)&0x00FF0000)>>8)|(((x)&0xFF000000)>>24))
-#else
-#define BS_INT32(x) (x)
-#endif
-
-static int32_t picture_rates[16] =
-{
-  0,
-  1126125,
-  1125000,
-  1080000,
-  900900,
-  900000,
-  540000,
-  450450,
-  450000,
-  0,0,0,0,0,0,0
-};
-
-struct header
-{
-  int32_t  len;
-  int32_t  size;
-  uint8_t *data;
-};
-
-
-struct picture_data
-{
-  int32_t       present;
-  struct header headerData;
-  int64_t       relPosition;
-};
-
-
-struct access_unit
-{
-  int32_t             unitType;
-  int64_t             gopPosition;
-  int64_t             firstPTS;
-  int64_t             lastPTS;
-  int64_t             gopDuration;
-  int32_t             gopSize;
-  int32_t             rffFlag;
-  struct header       headerData;
-  struct picture_data frames[MAXN];
-};
-
 //implementation structure
 struct impl_stream
 {
-  bufstream_tt      *main_bs;        // bufstream to pass video info to
   bufstream_tt      *video_bs;       // bufstream to pass video info to
-  uint8_t           *picBuffer;      // pointer to the buffer the picture is written to
-  int64_t            byteCount;      // current byte count
-  int64_t            duration;
-  struct header      curGOPHeader;
-  struct header      curPICHeader;
-  int64_t            curGOPPos;
-  int64_t            curPICPos;
   int32_t            initOutput;
-  int64_t            clocks_per_frame;
-  int64_t            clocks_per_field;
-  int32_t            curRFFFlag;
-  uint8_t            bPicStartFlag;
-  uint8_t            bPicGotHdrFlag;
-  char              *workBuffer;     // for encoding and formatting
-  uint32_t           workBufferSize; // size of the work buffer
-  struct access_unit aunit;          // buffer for video au info
+  struct vau_parser  parser;         // access unit of the video passed to main_bs
+  struct xml_writer  out;            // output to video_bs
 };
 
 
-static int32_t sprintf_int64(char *str, int64_t value)
+static void write_header_data(struct xml_writer *w, struct byte_arena *headers, struct vau_header_copy *hdr, int32_t indent)
 {
-  uint64_t data;
-  uint64_t place_mask = INT64_C(1000000000000000000);
-  int32_t idx = 0;
-  uint8_t data_flag = 0;
-  int8_t place_value;
-
-  if (value == 0)
-  {
-    str[0] = '0';
-    str[1] = 0;
-    return 1;
-  }
-
-  str[0] = 0;
-  if (value < 0)
-  {
-    str[idx++] = '-';
-    if (value == INT64_C(0x8000000000000000))
-      data = INT64_C(0x8000000000000000);
-    else
-      data = (uint64_t)(-value);
-  }
-  else
-  {
-    data = (uint64_t)value;
-  }
-
-  while (place_mask > 0)
-  {
-    place_value = (uint8_t)(data / place_mask);
-    if (place_value > 0)
-    {
-      data_flag = 1;
-      data -= place_value * place_mask;
-      str[idx++] = '0' + (char)place_value;
-    }
-    else if (data_flag)
-    {
-      str[idx++] = '0';
-    }
-    place_mask /= 10;
-  }
-
-  str[idx] = 0;
-
-  return idx;
-}
-
+  const uint8_t *ptr = byte_arena_ptr(headers, hdr->offset);
 
 #ifdef DO_BASE64
-
-// base64 encoding stuff
-static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-// encode 3 8-bit binary bytes as 4 '6-bit' characters
-static void encode_block(uint8_t in[3], uint8_t out[4], int32_t len)
-{
-  out[0] = b64[ in[0] >> 2 ];
-  out[1] = b64[ ((in[0] & 0x03) << 4) | ((in[1] & 0xf0) >> 4) ];
-  out[2] = (uint8_t) (len > 1 ? b64[ ((in[1] & 0x0f) << 2) | ((in[2] & 0xc0) >> 6) ] : '=');
-  out[3] = (uint8_t) (len > 2 ? b64[ in[2] & 0x3f ] : '=');
-}
-
-// base64 encode a stream adding padding and line breaks
-static void b64_encode(bufstream_tt *bs, uint8_t *ptr, int32_t length, int32_t indent)
-{
-  struct impl_stream* p = bs->Buf_IO_struct;
-  uint8_t in[3], out[4];
-  int32_t i, j, len, blocksout = 0, iLen = 0;
-  uint32_t encoded_len = length / 3 * 4 + 64;
-
-  if(encoded_len > p->workBufferSize)
-  {
-    if(p->workBufferSize)
-      free(p->workBuffer);
-    p->workBuffer = (char*)malloc(encoded_len);
-    p->workBufferSize = encoded_len;
-  }
-
-  for(i = 0; i < indent; i++)
-    p->workBuffer[i] = ' ';
-  p->workBuffer[i] = 0;
-
-  strcat(p->workBuffer, "<HeaderData>");
-
-  j = (int32_t)strlen(p->workBuffer);
-  while(iLen < length)
-  {
-    len = 0;
-    for(i = 0; i < 3; i++)
-    {
-      if(iLen < length)
-      {
-        in[i] = ptr[iLen];
-        len++;
-      }
-      else
-        in[i] = 0;
-      iLen++;
-    }
-
-    if(len)
-    {
-      encode_block(in, out, len);
-      for(i = 0; i < 4; i++)
-        p->workBuffer[j++] = out[i];
-      blocksout++;
-    }
-  }
-
-  p->workBuffer[j] = 0;
-  strcat(p->workBuffer, "</HeaderData>\n");
-  p->video_bs->copybytes(p->video_bs, (uint8_t*)&p->workBuffer[0], (uint32_t)strlen(p->workBuffer));
-}
-
+  xml_writer_indent(w, indent);
+  xml_writer_str(w, "<HeaderData>");
+  xml_writer_base64(w, ptr, hdr->len);
+  xml_writer_str(w, "</HeaderData>\n");
 #else
-
-static void ascii_encode(bufstream_tt *bs, uint8_t *ptr, int32_t length, int32_t indent)
-{
-  struct impl_stream* p = bs->Buf_IO_struct;
-  int32_t i, j;
-  static const char hexChars[] = "0123456789ABCDEF";
-  uint32_t encoded_len = length * 2 + 64;
-
-  if(encoded_len > p->workBufferSize)
-  {
-    if(p->workBufferSize)
-      free(p->workBuffer);
-    p->workBuffer = (uint8_t*)malloc(encoded_len);
-    p->workBufferSize = encoded_len;
-  }
-
-  for(i = 0; i < indent; i++)
-    p->workBuffer[i] = ' ';
-  p->workBuffer[i] = 0;
-  strcat(p->workBuffer, "<HeaderData>\n");
-  p->video_bs->copybytes(p->video_bs, (uint8_t*)&p->workBuffer[0], strlen(p->workBuffer));
-
-  for(i = 0; i <= indent; i++)
-    p->workBuffer[i] = ' ';
-  p->workBuffer[i] = 0;
-
-  j = i;
-
-  for(i = 0; i < length; i++)
-  {
-    p->workBuffer[j++] = hexChars[ptr[i] >> 4];
-    p->workBuffer[j++] = hexChars[ptr[i] & 0x0F];
-  }
-  p->workBuffer[j] = 0;
-  strcat(p->workBuffer, "\n");
-  p->video_bs->copybytes(p->video_bs, (uint8_t*)&p->workBuffer[0], strlen(p->workBuffer));
-
-  for(i = 0; i < indent; i++)
-    p->workBuffer[i] = ' ';
-  p->workBuffer[i] = 0;
-  strcat(p->workBuffer, "</HeaderData>\n");
-  p->video_bs->copybytes(p->video_bs, (uint8_t*)&p->workBuffer[0], strlen(p->workBuffer));
-}
-
+  xml_writer_indent(w, indent);
+  xml_writer_str(w, "<HeaderData>\n");
+  xml_writer_indent(w, indent + 1);
+  xml_writer_hex(w, ptr, hdr->len);
+  xml_writer_str(w, "\n");
+  xml_writer_indent(w, indent);
+  xml_writer_str(w, "</HeaderData>\n");
 #endif
+}
 
 
 static uint32_t idx_usable_bytes(bufstream_tt *bs)
 {
-  return bs->Buf_IO_struct->main_bs->usable_bytes (bs->Buf_IO_struct->main_bs);
+  return bs->Buf_IO_struct->parser.main_bs->usable_bytes (bs->Buf_IO_struct->parser.main_bs);
 }
 
 static uint8_t *idx_request(bufstream_tt *bs, uint32_t numbytes)
 {
-  struct impl_stream* p = bs->Buf_IO_struct;
-
-  p->picBuffer = p->main_bs->request (p->main_bs, numbytes);
-  return p->picBuffer;
-}
-
-static int32_t save_header_bytes(struct impl_stream* p, uint8_t *ptr, int32_t numbytes)
-{
-    if(p->curGOPHeader.len + numbytes > p->curGOPHeader.size)
-    {
-      uint8_t *pPtr = (uint8_t*)malloc(p->curGOPHeader.len + numbytes);
-      if (!pPtr)
-          return 1;
-      if (p->curGOPHeader.data && (p->curGOPHeader.len > 0))
-        memcpy(pPtr, p->curGOPHeader.data, p->curGOPHeader.len);
-      if(p->curGOPHeader.data)
-        free(p->curGOPHeader.data);
-      p->curGOPHeader.data = pPtr;
-      p->curGOPHeader.size = p->curGOPHeader.len + numbytes;
-    }
-
-    memcpy(p->curGOPHeader.data + p->curGOPHeader.len, ptr, numbytes);
-    if (p->curGOPHeader.len == 0)
-      p->curGOPPos = p->byteCount;
-    p->curGOPHeader.len += numbytes;
-    return 0;
+  return vau_parser_request(&bs->Buf_IO_struct->parser, numbytes);
 }
 
 static uint32_t idx_confirm(bufstream_tt *bs, uint32_t numbytes)
 {
-  struct impl_stream* p = bs->Buf_IO_struct;
-  uint8_t *ptr = bs->Buf_IO_struct->picBuffer;
-  int32_t leftnumbytes = numbytes;
-
-  if(!ptr || !numbytes)
-    return 0;
-
-  if (p->bPicStartFlag)
-  {
-    if (!p->bPicGotHdrFlag)
-    {
-      int32_t i = 0;
-
-      while((i < leftnumbytes-3) &&
-            (BS_INT32(*(uint32_t*)&(ptr[i])) != 0x00000100))
-        i++;
-
-      if (i > 0)
-      {
-        if (save_header_bytes(p, ptr, i))
-          return 0;
-
-        // set ptr to point to the picture header
-        ptr += i;
-        leftnumbytes -= i;
-        i = 0;
-      }
-
-      while((i + 3 < leftnumbytes) &&
-            (((BS_INT32(*(uint32_t*)&(ptr[i])) & 0xFFFFFF00) != 0x00000100) ||
-             (ptr[i + 3] < 0x01) || (ptr[i + 3] > 0xAF)))
-        i++;
-
-      if(i > 0)
-      {
-        // found the picture headers, save them to the curPICHeader
-        if (i + 3 == leftnumbytes)
-          i = leftnumbytes;    // no slice header was found so just use to the end of the buffer
-
-        if(i > p->curPICHeader.size)
-        {
-          if(p->curPICHeader.size)
-            free(p->curPICHeader.data);
-          p->curPICHeader.data = (uint8_t*)malloc(i);
-          p->curPICHeader.size = i;
-        }
-
-        memcpy(p->curPICHeader.data, ptr, i);
-        p->curPICHeader.len = i;
-        p->curPICPos = p->byteCount;
-      }
-
-      p->bPicGotHdrFlag = 1;
-    }
-  }
-  else
-  {
-    if (save_header_bytes(p, ptr, numbytes))
-      return 0;
-  }
-
-  p->byteCount += numbytes;
-
-  return p->main_bs->confirm (p->main_bs, numbytes);
+  return vau_parser_confirm(&bs->Buf_IO_struct->parser, numbytes);
 }
 
 static uint32_t idx_copybytes(bufstream_tt *bs, uint8_t *ptr, uint32_t numbytes)
 {
-  return bs->Buf_IO_struct->main_bs->copybytes (bs->Buf_IO_struct->main_bs, ptr, numbytes);
+  return bs->Buf_IO_struct->parser.main_bs->copybytes (bs->Buf_IO_struct->parser.main_bs, ptr, numbytes);
 }
 
 static uint32_t idx_split (bufstream_tt *bs)
 {
-  return bs->Buf_IO_struct->main_bs->split (bs->Buf_IO_struct->main_bs);
+  return bs->Buf_IO_struct->parser.main_bs->split (bs->Buf_IO_struct->parser.main_bs);
 }
 
 static uint32_t idx_chunksize(bufstream_tt *bs)
 {
-  return bs->Buf_IO_struct->main_bs->chunksize (bs->Buf_IO_struct->main_bs);
+  return bs->Buf_IO_struct->parser.main_bs->chunksize (bs->Buf_IO_struct->parser.main_bs);
 }
 
 static int32_t write_vau_info(bufstream_tt *bs)
 {
   struct impl_stream* p = bs->Buf_IO_struct;
-  char tmpStr[1024];
-  char numStr[32];
+  struct xml_writer *w = &p->out;
+  struct vau_unit *aunit = &p->parser.aunit;
   int32_t i;
 
   if(!p->initOutput)
   {
-    strcpy(tmpStr, "<Stream>\n");
-    p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(w, "<Stream>\n");
     p->initOutput = 1;
   }
 
-  strcpy(tmpStr, " <AccessUnit>\n");
-  p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+  xml_writer_str(w, " <AccessUnit>\n");
 
-  if(p->aunit.unitType & SEQHDR_FLAG)
-    strcpy(tmpStr, "  <UnitType>SEQ</UnitType>\n");
+  if(aunit->unitType & SEQHDR_FLAG)
+    xml_writer_str(w, "  <UnitType>SEQ</UnitType>\n");
   else
-    strcpy(tmpStr, "  <UnitType>GOP</UnitType>\n");
-  p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(w, "  <UnitType>GOP</UnitType>\n");
 
   if(bs->flags == 0)
   {
-    sprintf_int64(numStr, p->aunit.gopPosition);
-    sprintf(tmpStr, "  <Position>%s</Position>\n", numStr);
-    p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
-
-    sprintf_int64(numStr, p->aunit.firstPTS / 300);
-    sprintf(tmpStr, "  <PTS>%s</PTS>\n", numStr);
-    p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
-
-    p->aunit.gopDuration = p->aunit.lastPTS - p->aunit.firstPTS + p->clocks_per_frame;
-    if(p->aunit.rffFlag)
-      p->aunit.gopDuration += p->clocks_per_field;
-
-    p->duration += p->aunit.gopDuration;
-    sprintf_int64(numStr, p->aunit.gopDuration / 300);
-    sprintf(tmpStr, "  <Duration>%s</Duration>\n", numStr);
-    p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(w, "  <Position>");
+    xml_writer_int64(w, aunit->gopPosition);
+    xml_writer_str(w, "</Position>\n");
+
+    xml_writer_str(w, "  <PTS>");
+    xml_writer_int64(w, aunit->firstPTS / 300);
+    xml_writer_str(w, "</PTS>\n");
+
+    xml_writer_str(w, "  <Duration>");
+    xml_writer_int64(w, vau_parser_finish_unit(&p->parser) / 300);
+    xml_writer_str(w, "</Duration>\n");
   }
 
-  sprintf(tmpStr, "  <Size>%d</Size>\n", p->aunit.gopSize);
-  p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+  xml_writer_str(w, "  <Size>");
+  xml_writer_int64(w, aunit->gopSize);
+  xml_writer_str(w, "</Size>\n");
 
   if(bs->flags == 0)
   {
-#ifdef DO_BASE64
-    b64_encode(bs, &p->aunit.headerData.data[0], p->aunit.headerData.len, 2);
-#else
-    ascii_encode(bs, &p->aunit.headerData.data[0], p->aunit.headerData.len, 2);
-#endif
+    write_header_data(w, &aunit->headers, &aunit->headerData, 2);
 
     for(i = 0; i < MAXN; i++)
     {
-      if(p->aunit.frames[i].present)
+      if(aunit->frames[i].present)
       {
-        strcpy(tmpStr, "  <PictureData>\n");
-        p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+        xml_writer_str(w, "  <PictureData>\n");
 
-#ifdef DO_BASE64
-        b64_encode(bs, &p->aunit.frames[i].headerData.data[0], p->aunit.frames[i].headerData.len, 3);
-#else
-        ascii_encode(bs, &p->aunit.frames[i].headerData.data[0], p->aunit.frames[i].headerData.len, 3);
-#endif
+        write_header_data(w, &aunit->headers, &aunit->frames[i].headerData, 3);
 
-        sprintf(tmpStr, "   <Offset>%d</Offset>\n", (int32_t)p->aunit.frames[i].relPosition);
-        p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+        xml_writer_str(w, "   <Offset>");
+        xml_writer_int64(w, (int32_t)aunit->frames[i].relPosition);
+        xml_writer_str(w, "</Offset>\n");
 
-        strcpy(tmpStr, "  </PictureData>\n");
-        p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+        xml_writer_str(w, "  </PictureData>\n");
       }
     }
   }
 
-  strcpy(tmpStr, " </AccessUnit>\n");
-  p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+  xml_writer_str(w, " </AccessUnit>\n");
 
   return BS_OK;
 }
@@ -470,15 +158,9 @@ static uint32_t idx_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, v
   {
     case FLUSH_BUFFER:
       if(p->video_bs)
-        p->video_bs->auxinfo(p->video_bs, 0, info_ID, NULL, 0);
-      break;
-
-    case ID_PICTURE_START_CODE:
       {
-        struct pic_start_info *pph = (struct pic_start_info*)info_ptr;
-
-        p->curRFFFlag = pph->repeat_first_field;
-        p->bPicStartFlag = 1;
+        xml_writer_flush(&p->out);
+        p->video_bs->auxinfo(p->video_bs, 0, info_ID, NULL, 0);
       }
       break;
 
@@ -486,168 +168,66 @@ static uint32_t idx_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, v
       if(p->video_bs)
       {
         struct v_au_struct *pau = (struct v_au_struct*)info_ptr;
-        int32_t i, j;
-
-        if((pau->flags & SEQHDR_FLAG) || (pau->flags & GOPHDR_FLAG))
-        {
-          // send out previous GOP info
-          if(p->aunit.firstPTS >= 0)
-            write_vau_info(bs);
-
-          // clear out all the existing picture present flags
-          for(i = 0; i < MAXN; i++)
-            p->aunit.frames[i].present = 0;
-
-          p->aunit.unitType = pau->flags;
-          p->aunit.gopPosition = p->curGOPPos;
-          p->aunit.gopSize = 0;
-          p->aunit.firstPTS = -1;
-
-          i = p->curGOPHeader.len;
-          if(i > p->aunit.headerData.size)
-          {
-            if(p->aunit.headerData.size)
-              free(p->aunit.headerData.data);
-            p->aunit.headerData.data = (uint8_t*)malloc(i);
-            p->aunit.headerData.size = i;
-          }
-
-          memcpy(p->aunit.headerData.data, p->curGOPHeader.data, i);
-          p->aunit.headerData.len = i;
-          p->curGOPHeader.len = 0;
-        }
 
-        if ((p->curPICHeader.data != NULL) && (p->curPICHeader.len > 6))
-        {
-          // get the temp ref of the current picture
-          i = ((p->curPICHeader.data[4] << 8) | p->curPICHeader.data[5]) >> 6;
-          if(i < MAXN)
-          {
-            // we got a valid picture
-            p->aunit.frames[i].present = 1;
-            if((p->aunit.firstPTS < 0) ||
-               (pau->PTS < p->aunit.firstPTS))
-              p->aunit.firstPTS = pau->PTS;
-
-            if(pau->PTS > p->aunit.lastPTS)
-            {
-              p->aunit.lastPTS = pau->PTS;
-              p->aunit.rffFlag = p->curRFFFlag;
-            }
-
-            p->aunit.frames[i].relPosition = p->curPICPos - p->aunit.gopPosition;
-
-            j = p->curPICHeader.len;
-            if(j > p->aunit.frames[i].headerData.size)
-            {
-              if(p->aunit.frames[i].headerData.size)
-                free(p->aunit.frames[i].headerData.data);
-              p->aunit.frames[i].headerData.data = (uint8_t*)malloc(j);
-              p->aunit.frames[i].headerData.size = j;
-            }
-            memcpy(p->aunit.frames[i].headerData.data, p->curPICHeader.data, j);
-            p->aunit.frames[i].headerData.len = j;
-
-            p->aunit.gopSize += pau->length;
-          }
-        }
-        p->bPicStartFlag = 0;
-        p->bPicGotHdrFlag = 0;
-      }
-      break;
+        // send out previous GOP info
+        if(vau_parser_unit_done(&p->parser, pau))
+          write_vau_info(bs);
 
-    case ID_SEQ_START_CODE:
-      if(!p->clocks_per_frame)
-      {
-        struct seq_start_info *psh = (struct seq_start_info*)info_ptr;
-
-        if((psh->pulldown_flag == PULLDOWN_32) ||
-           (psh->pulldown_flag == PULLDOWN_23))
-          p->clocks_per_frame = (int64_t)picture_rates[FRAMERATE29];
-        else
-          p->clocks_per_frame = (int64_t)picture_rates[psh->frame_rate_code];
-        p->clocks_per_field = p->clocks_per_frame / 2;
+        vau_parser_add_au(&p->parser, pau);
       }
-      p->bPicStartFlag = 0;
-      p->bPicGotHdrFlag = 0;
-      break;
-
-    case ID_GOP_START_CODE:
-      p->bPicStartFlag = 0;
-      p->bPicGotHdrFlag = 0;
       break;
 
     case SESSION_USER_DATA:
       if(p->video_bs && (info_size == sizeof(struct tag_session_user_data_tt)))
       {
         struct tag_session_user_data_tt *ud = (struct tag_session_user_data_tt*)info_ptr;
-        char tmpStr[1024];
 
         if(!p->initOutput)
         {
-          strcpy(tmpStr, "<Stream>\n");
-          p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+          xml_writer_str(&p->out, "<Stream>\n");
           p->initOutput = 1;
         }
 
-        strcpy(tmpStr, "<UserData>");
-        p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
-        p->video_bs->copybytes(p->video_bs, ud->udata, ud->udata_len);
-        strcpy(tmpStr, "</UserData>\n");
-        p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+        xml_writer_str(&p->out, "<UserData>");
+        xml_writer_write(&p->out, (const char*)ud->udata, ud->udata_len);
+        xml_writer_str(&p->out, "</UserData>\n");
       }
       break;
   }
+  vau_parser_auxinfo(&p->parser, info_ID, info_ptr);
+
   // pass on everything to main_bs
-  if(p->main_bs)
-    p->main_bs->auxinfo(p->main_bs, offs, info_ID, info_ptr, info_size);
+  if(p->parser.main_bs)
+    p->parser.main_bs->auxinfo(p->parser.main_bs, offs, info_ID, info_ptr, info_size);
   return BS_OK;
 }
 
 
 static void idx_done(bufstream_tt *bs, int32_t Abort)
 {
-  int32_t i;
   struct impl_stream* p = bs->Buf_IO_struct;
-  char tmpStr[256];
-  char numStr[32];
 
   if(p->video_bs)
   {
     if(!Abort)
     {
-      if(p->aunit.firstPTS >= 0)
+      if(p->parser.aunit.firstPTS >= 0)
         write_vau_info(bs);
     }
-    sprintf_int64(numStr, p->duration / 300);
-    sprintf(tmpStr, " <StreamDuration>%s</StreamDuration>\n", numStr);
-    p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(&p->out, " <StreamDuration>");
+    xml_writer_int64(&p->out, p->parser.duration / 300);
+    xml_writer_str(&p->out, "</StreamDuration>\n");
 
-    sprintf_int64(numStr, p->byteCount);
-    sprintf(tmpStr, " <StreamSize>%s</StreamSize>\n", numStr);
-    p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(&p->out, " <StreamSize>");
+    xml_writer_int64(&p->out, p->parser.byteCount);
+    xml_writer_str(&p->out, "</StreamSize>\n");
 
-    strcpy(tmpStr, "</Stream>\n");
-    p->video_bs->copybytes(p->video_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(&p->out, "</Stream>\n");
+    xml_writer_flush(&p->out);
   }
 
-  for(i = 0; i < MAXN; i++)
-  {
-    if(p->aunit.frames[i].headerData.size)
-      free(p->aunit.frames[i].headerData.data);
-  }
-
-  if(p->aunit.headerData.size)
-    free(p->aunit.headerData.data);
-
-  if(p->curGOPHeader.size)
-    free(p->curGOPHeader.data);
-
-  if(p->curPICHeader.size)
-    free(p->curPICHeader.data);
-
-  if(p->workBuffer)
-    free(p->workBuffer);
+  xml_writer_free(&p->out);
+  vau_parser_free(&p->parser);
 
   free(p);
   bs->Buf_IO_struct = NULL;
@@ -702,14 +282,17 @@ int32_t init_bufstream_write_with_vxml_index(
 
   bs->flags        = flag;
 
-  bs->Buf_IO_struct->main_bs = main_bs;
+  vau_parser_init(&bs->Buf_IO_struct->parser, main_bs);
 
 
   if(video_bs)
   {
     bs->Buf_IO_struct->video_bs = video_bs;
-    memset(&bs->Buf_IO_struct->aunit, 0, sizeof(struct access_unit));
-    bs->Buf_IO_struct->aunit.firstPTS = -1;
+    if(xml_writer_init(&bs->Buf_IO_struct->out, video_bs) != BS_OK)
+    {
+      free(bs->Buf_IO_struct);
+      return BS_ERROR;
+    }
   }
 
   return BS_OK;
@@ -15,6 +15,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "buf_xml.h"
+#include "xml_writer.h"
+#include "byte_arena.h"
 #include "auxinfo.h"
 #include "mcdefs.h"
 
@@ -48,11 +50,19 @@ struct header
 };
 
 
+// header bytes copied to the arena of the access unit
+struct header_copy
+{
+  int32_t offset;
+  int32_t len;
+};
+
+
 struct picture_data
 {
-  int32_t       present;
-  struct header headerData;
-  int64_t       relPosition;
+  int32_t            present;
+  struct header_copy headerData;
+  int64_t            relPosition;
 };
 
 
@@ -67,8 +77,9 @@ struct access_unit
   int64_t             gopDuration;
   int32_t             gopSize;
   int32_t             rffFlag;
-  struct header       headerData;
+  struct header_copy  headerData;
   struct picture_data frames[MAXN];
+  struct byte_arena   arena;           // header copies, reset for every access unit
 };
 
 //implementation structure
@@ -93,156 +104,40 @@ struct impl_stream
   int32_t            vID;
   int32_t            aID;
   struct access_unit aunit;            // buffer for video au info
+  struct xml_writer  v_out;            // output to v_xml_bs
+  struct xml_writer  a_out;            // output to a_xml_bs
 };
 
 
-static int32_t sprintf_int64(char *str, int64_t value)
+static void write_header_data(struct xml_writer *w, struct byte_arena *arena, struct header_copy *hdr, int32_t indent)
 {
-  uint64_t data;
-  uint64_t place_mask = INT64_C(1000000000000000000);
-  int32_t idx = 0;
-  uint8_t data_flag = 0;
-  int8_t place_value;
-
-  if (value == 0)
-  {
-    str[0] = '0';
-    str[1] = 0;
-    return 1;
-  }
-
-  str[0] = 0;
-  if (value < 0)
-  {
-    str[idx++] = '-';
-    if (value == INT64_C(0x8000000000000000))
-      data = INT64_C(0x8000000000000000);
-    else
-      data = (uint64_t)(-value);
-  }
-  else
-  {
-    data = (uint64_t)value;
-  }
-
-  while (place_mask > 0)
-  {
-    place_value = (uint8_t)(data / place_mask);
-    if (place_value > 0)
-    {
-      data_flag = 1;
-      data -= place_value * place_mask;
-      str[idx++] = '0' + (char)place_value;
-    }
-    else if (data_flag)
-    {
-      str[idx++] = '0';
-    }
-    place_mask /= 10;
-  }
-
-  str[idx] = 0;
-
-  return idx;
-}
-
+  const uint8_t *ptr = byte_arena_ptr(arena, hdr->offset);
 
 #ifdef DO_BASE64
-
-// base64 encoding stuff
-static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-// encode 3 8-bit binary bytes as 4 '6-bit' characters
-static void encode_block(uint8_t in[3], uint8_t out[4], int32_t len)
-{
-  out[0] = b64[ in[0] >> 2 ];
-  out[1] = b64[ ((in[0] & 0x03) << 4) | ((in[1] & 0xf0) >> 4) ];
-  out[2] = (uint8_t) (len > 1 ? b64[ ((in[1] & 0x0f) << 2) | ((in[2] & 0xc0) >> 6) ] : '=');
-  out[3] = (uint8_t) (len > 2 ? b64[ in[2] & 0x3f ] : '=');
-}
-
-// base64 encode a stream adding padding and line breaks
-static void b64_encode(bufstream_tt *bs, uint8_t *ptr, int32_t length, int32_t indent)
-{
-  struct impl_stream* p = bs->Buf_IO_struct;
-  uint8_t in[3], out[4];
-  int32_t i, j, len, blocksout = 0, iLen = 0;
-  char tmpStr[2048];
-
-  for(i = 0; i < indent; i++)
-    tmpStr[i] = ' ';
-  tmpStr[i] = 0;
-  strcat(tmpStr, "<HeaderData>");
-
-  j = (int32_t)strlen(tmpStr);
-  while(iLen < length)
-  {
-    len = 0;
-    for(i = 0; i < 3; i++)
-    {
-      if(iLen < length)
-      {
-        in[i] = ptr[iLen];
-        len++;
-      }
-      else
-        in[i] = 0;
-      iLen++;
-    }
-
-    if(len)
-    {
-      encode_block(in, out, len);
-      for(i = 0; i < 4; i++)
-        tmpStr[j++] = out[i];
-      blocksout++;
-    }
-  }
-
-  tmpStr[j] = 0;
-  strcat(tmpStr, "</HeaderData>\n");
-  p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+  xml_writer_indent(w, indent);
+  xml_writer_str(w, "<HeaderData>");
+  xml_writer_base64(w, ptr, hdr->len);
+  xml_writer_str(w, "</HeaderData>\n");
+#else
+  xml_writer_indent(w, indent);
+  xml_writer_str(w, "<HeaderData>\n");
+  xml_writer_indent(w, indent + 1);
+  xml_writer_hex(w, ptr, hdr->len);
+  xml_writer_str(w, "\n");
+  xml_writer_indent(w, indent);
+  xml_writer_str(w, "</HeaderData>\n");
+#endif
 }
 
-#else
 
-static void ascii_encode(bufstream_tt *bs, uint8_t *ptr, int32_t length, int32_t indent)
+static void copy_header(struct byte_arena *arena, struct header_copy *hdr, const uint8_t *ptr, int32_t len)
 {
-  struct impl_stream* p = bs->Buf_IO_struct;
-  int32_t i, j;
-  static const char hexChars[] = "0123456789ABCDEF";
-  char tmpStr[1024];
-
-  for(i = 0; i < indent; i++)
-    tmpStr[i] = ' ';
-  tmpStr[i] = 0;
-  strcat(tmpStr, "<HeaderData>\n");
-  p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], strlen(tmpStr));
-
-  for(i = 0; i <= indent; i++)
-    tmpStr[i] = ' ';
-  tmpStr[i] = 0;
-
-  j = i;
-
-  for(i = 0; i < length; i++)
-  {
-    tmpStr[j++] = hexChars[ptr[i] >> 4];
-    tmpStr[j++] = hexChars[ptr[i] & 0x0F];
-  }
-  tmpStr[j] = 0;
-  strcat(tmpStr, "\n");
-  p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], strlen(tmpStr));
-
-  for(i = 0; i < indent; i++)
-    tmpStr[i] = ' ';
-  tmpStr[i] = 0;
-  strcat(tmpStr, "</HeaderData>\n");
-  p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], strlen(tmpStr));
+  hdr->offset = len ? byte_arena_add(arena, ptr, len) : 0;
+  hdr->len = (hdr->offset < 0) ? 0 : len;
+  if(hdr->offset < 0)
+    hdr->offset = 0;
 }
 
-#endif
-
 
 static uint32_t idx_usable_bytes(bufstream_tt *bs)
 {
@@ -277,123 +172,109 @@ static uint32_t idx_chunksize(bufstream_tt *bs)
 static int32_t write_vau_info(bufstream_tt *bs)
 {
   struct impl_stream* p = bs->Buf_IO_struct;
-  char tmpStr[1024];
-  char numStr[32];
+  struct xml_writer *w;
   int32_t i;
   int64_t duration;
 
   if(p->v_xml_bs)
   {
+    w = &p->v_out;
+
     if(!p->vInitOutput)
     {
-      strcpy(tmpStr, "<Stream>\n");
-      p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+      xml_writer_str(w, "<Stream>\n");
       p->vInitOutput = 1;
     }
 
-    strcpy(tmpStr, " <AccessUnit>\n");
-    p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(w, " <AccessUnit>\n");
 
     if(p->aunit.unitType & SEQHDR_FLAG)
-      strcpy(tmpStr, "  <UnitType>SEQ</UnitType>\n");
+      xml_writer_str(w, "  <UnitType>SEQ</UnitType>\n");
     else
-      strcpy(tmpStr, "  <UnitType>GOP</UnitType>\n");
-    p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+      xml_writer_str(w, "  <UnitType>GOP</UnitType>\n");
 
     if(bs->flags == 0)
     {
-      sprintf_int64(numStr, p->aunit.gopPosition);
-      sprintf(tmpStr, "  <Position>%s</Position>\n", numStr);
-      p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+      xml_writer_str(w, "  <Position>");
+      xml_writer_int64(w, p->aunit.gopPosition);
+      xml_writer_str(w, "</Position>\n");
 
-      sprintf_int64(numStr, p->aunit.firstVPTS / 300);
-      sprintf(tmpStr, "  <PTS>%s</PTS>\n", numStr);
-      p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+      xml_writer_str(w, "  <PTS>");
+      xml_writer_int64(w, p->aunit.firstVPTS / 300);
+      xml_writer_str(w, "</PTS>\n");
 
       p->aunit.gopDuration = p->aunit.lastVPTS - p->aunit.firstVPTS + p->clocks_per_frame;
       if(p->aunit.rffFlag)
         p->aunit.gopDuration += p->clocks_per_field;
 
       p->vDuration += p->aunit.gopDuration;
-      sprintf_int64(numStr, p->aunit.gopDuration / 300);
-      sprintf(tmpStr, "  <Duration>%s</Duration>\n", numStr);
-      p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+      xml_writer_str(w, "  <Duration>");
+      xml_writer_int64(w, p->aunit.gopDuration / 300);
+      xml_writer_str(w, "</Duration>\n");
     }
 
-    sprintf(tmpStr, "  <Size>%d</Size>\n", p->aunit.gopSize);
-    p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(w, "  <Size>");
+    xml_writer_int64(w, p->aunit.gopSize);
+    xml_writer_str(w, "</Size>\n");
 
     if(bs->flags == 0)
     {
-#ifdef DO_BASE64
-      b64_encode(bs, &p->aunit.headerData.data[0], p->aunit.headerData.len, 2);
-#else
-      ascii_encode(bs, &p->aunit.headerData.data[0], p->aunit.headerData.len, 2);
-#endif
+      write_header_data(w, &p->aunit.arena, &p->aunit.headerData, 2);
 
       for(i = 0; i < MAXN; i++)
       {
         if(p->aunit.frames[i].present)
         {
-          strcpy(tmpStr, "  <PictureData>\n");
-          p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+          xml_writer_str(w, "  <PictureData>\n");
 
-#ifdef DO_BASE64
-          b64_encode(bs, &p->aunit.frames[i].headerData.data[0], p->aunit.frames[i].headerData.len, 3);
-#else
-          ascii_encode(bs, &p->aunit.frames[i].headerData.data[0], p->aunit.frames[i].headerData.len, 3);
-#endif
+          write_header_data(w, &p->aunit.arena, &p->aunit.frames[i].headerData, 3);
 
-          sprintf_int64(numStr, p->aunit.frames[i].relPosition);
-          sprintf(tmpStr, "   <Offset>%s</Offset>\n", numStr);
-          p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+          xml_writer_str(w, "   <Offset>");
+          xml_writer_int64(w, p->aunit.frames[i].relPosition);
+          xml_writer_str(w, "</Offset>\n");
 
-          strcpy(tmpStr, "  </PictureData>\n");
-          p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+          xml_writer_str(w, "  </PictureData>\n");
         }
       }
     }
 
-    strcpy(tmpStr, " </AccessUnit>\n");
-    p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(w, " </AccessUnit>\n");
   }
 
   // audio items
   if(p->a_xml_bs && p->aunit.firstAPTS >= 0)
   {
+    w = &p->a_out;
+
     if(!p->aInitOutput)
     {
-      strcpy(tmpStr, "<Stream>\n");
-      p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+      xml_writer_str(w, "<Stream>\n");
       p->aInitOutput = 1;
     }
 
-    strcpy(tmpStr, " <AudioUnit>\n");
-    p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(w, " <AudioUnit>\n");
 
     if(p->aunit.unitType & SEQHDR_FLAG)
-      strcpy(tmpStr, "  <UnitType>SEQ</UnitType>\n");
+      xml_writer_str(w, "  <UnitType>SEQ</UnitType>\n");
     else
-      strcpy(tmpStr, "  <UnitType>GOP</UnitType>\n");
-    p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+      xml_writer_str(w, "  <UnitType>GOP</UnitType>\n");
 
-    sprintf_int64(numStr, p->aunit.gopPosition);
-    sprintf(tmpStr, "  <Position>%s</Position>\n", numStr);
-    p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(w, "  <Position>");
+    xml_writer_int64(w, p->aunit.gopPosition);
+    xml_writer_str(w, "</Position>\n");
 
-    sprintf_int64(numStr, p->aunit.firstAPTS / 300);
-    sprintf(tmpStr, "  <PTS>%s</PTS>\n", numStr);
-    p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(w, "  <PTS>");
+    xml_writer_int64(w, p->aunit.firstAPTS / 300);
+    xml_writer_str(w, "</PTS>\n");
 
     duration = p->aunit.lastAPTS - p->aunit.firstAPTS + p->clocks_per_audio_frame;
     p->aDuration += duration;
 
-    sprintf_int64(numStr, duration / 300);
-    sprintf(tmpStr, "  <Duration>%s</Duration>\n", numStr);
-    p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(w, "  <Duration>");
+    xml_writer_int64(w, duration / 300);
+    xml_writer_str(w, "</Duration>\n");
 
-    strcpy(tmpStr, " </AudioUnit>\n");
-    p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(w, " </AudioUnit>\n");
   }
 
   return BS_OK;
@@ -408,9 +289,15 @@ static uint32_t idx_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, v
   {
     case FLUSH_BUFFER:
       if(p->v_xml_bs)
+      {
+        xml_writer_flush(&p->v_out);
         p->v_xml_bs->auxinfo(p->v_xml_bs, 0, info_ID, NULL, 0);
+      }
       if(p->a_xml_bs)
+      {
+        xml_writer_flush(&p->a_out);
         p->a_xml_bs->auxinfo(p->a_xml_bs, 0, info_ID, NULL, 0);
+      }
       break;
 
     case VIDEO_STREAM_INFO:
@@ -425,7 +312,7 @@ static uint32_t idx_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, v
       if(p->v_xml_bs)
       {
         struct video_au_info_xml *pau = (struct video_au_info_xml*)info_ptr;
-        int32_t i, j;
+        int32_t i;
         uint8_t *ptr;
         int32_t pauhdrlength = pau->hdr_length;
 
@@ -448,6 +335,7 @@ static uint32_t idx_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, v
           p->aunit.firstAPTS = -1;
 
           p->curPICPos = 0;
+          byte_arena_reset(&p->aunit.arena);
 
           i = 0;
           while((i < pau->hdr_length-3) &&
@@ -475,17 +363,7 @@ static uint32_t idx_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, v
             i = 0;
           }
 
-          i = p->curGOPHeader.len;
-          if(i > p->aunit.headerData.size)
-          {
-            if(p->aunit.headerData.size)
-              free(p->aunit.headerData.data);
-            p->aunit.headerData.data = (uint8_t*)malloc(i);
-            p->aunit.headerData.size = i;
-          }
-
-          memcpy(p->aunit.headerData.data, p->curGOPHeader.data, i);
-          p->aunit.headerData.len = i;
+          copy_header(&p->aunit.arena, &p->aunit.headerData, p->curGOPHeader.data, p->curGOPHeader.len);
         }
         else
           p->curPICPos = pau->filePos;
@@ -531,16 +409,7 @@ static uint32_t idx_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, v
 
             p->aunit.frames[i].relPosition = p->curPICPos; // - p->aunit.gopPosition;
 
-            j = p->curPICHeader.len;
-            if(j > p->aunit.frames[i].headerData.size)
-            {
-              if(p->aunit.frames[i].headerData.size)
-                free(p->aunit.frames[i].headerData.data);
-              p->aunit.frames[i].headerData.data = (uint8_t*)malloc(j);
-              p->aunit.frames[i].headerData.size = j;
-            }
-            memcpy(p->aunit.frames[i].headerData.data, p->curPICHeader.data, j);
-            p->aunit.frames[i].headerData.len = j;
+            copy_header(&p->aunit.arena, &p->aunit.frames[i].headerData, p->curPICHeader.data, p->curPICHeader.len);
 
             p->aunit.gopSize += pau->length;
           }
@@ -596,20 +465,16 @@ static uint32_t idx_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, v
       if(p->v_xml_bs && (info_size == sizeof(struct tag_session_user_data_tt)))
       {
         struct tag_session_user_data_tt *ud = (struct tag_session_user_data_tt*)info_ptr;
-        char tmpStr[1024];
 
         if(!p->vInitOutput)
         {
-          strcpy(tmpStr, "<Stream>\n");
-          p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+          xml_writer_str(&p->v_out, "<Stream>\n");
           p->vInitOutput = 1;
         }
 
-        strcpy(tmpStr, "<UserData>");
-        p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
-        p->v_xml_bs->copybytes(p->v_xml_bs, ud->udata, ud->udata_len);
-        strcpy(tmpStr, "</UserData>\n");
-        p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+        xml_writer_str(&p->v_out, "<UserData>");
+        xml_writer_write(&p->v_out, (const char*)ud->udata, ud->udata_len);
+        xml_writer_str(&p->v_out, "</UserData>\n");
       }
       break;
 
@@ -617,20 +482,16 @@ static uint32_t idx_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, v
       if(p->a_xml_bs && (info_size == sizeof(struct tag_session_user_data_tt)))
       {
         struct tag_session_user_data_tt *ud = (struct tag_session_user_data_tt*)info_ptr;
-        char tmpStr[1024];
 
         if(!p->aInitOutput)
         {
-          strcpy(tmpStr, "<Stream>\n");
-          p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+          xml_writer_str(&p->a_out, "<Stream>\n");
           p->aInitOutput = 1;
         }
 
-        strcpy(tmpStr, "<UserData>");
-        p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
-        p->a_xml_bs->copybytes(p->a_xml_bs, ud->udata, ud->udata_len);
-        strcpy(tmpStr, "</UserData>\n");
-        p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+        xml_writer_str(&p->a_out, "<UserData>");
+        xml_writer_write(&p->a_out, (const char*)ud->udata, ud->udata_len);
+        xml_writer_str(&p->a_out, "</UserData>\n");
       }
       break;
   }
@@ -643,10 +504,7 @@ static uint32_t idx_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, v
 
 static void idx_done(bufstream_tt *bs, int32_t Abort)
 {
-  int32_t i;
   struct impl_stream* p = bs->Buf_IO_struct;
-  char tmpStr[256];
-  char numStr[32];
 
   if(p->v_xml_bs)
   {
@@ -656,46 +514,43 @@ static void idx_done(bufstream_tt *bs, int32_t Abort)
         write_vau_info(bs);
     }
 
-    sprintf_int64(numStr, p->vDuration / 300);
-    sprintf(tmpStr, " <StreamDuration>%s</StreamDuration>\n", numStr);
-    p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(&p->v_out, " <StreamDuration>");
+    xml_writer_int64(&p->v_out, p->vDuration / 300);
+    xml_writer_str(&p->v_out, "</StreamDuration>\n");
 
-    sprintf_int64(numStr, p->vByteCount);
-    sprintf(tmpStr, " <StreamSize>%s</StreamSize>\n", numStr);
-    p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(&p->v_out, " <StreamSize>");
+    xml_writer_int64(&p->v_out, p->vByteCount);
+    xml_writer_str(&p->v_out, "</StreamSize>\n");
 
-    sprintf(tmpStr, " <StreamId>%d</StreamId>\n", p->vID);
-    p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(&p->v_out, " <StreamId>");
+    xml_writer_int64(&p->v_out, p->vID);
+    xml_writer_str(&p->v_out, "</StreamId>\n");
 
-    strcpy(tmpStr, "</Stream>\n");
-    p->v_xml_bs->copybytes(p->v_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(&p->v_out, "</Stream>\n");
+    xml_writer_flush(&p->v_out);
   }
 
   if(p->a_xml_bs)
   {
-    sprintf_int64(numStr, p->aDuration / 300);
-    sprintf(tmpStr, " <StreamDuration>%s</StreamDuration>\n", numStr);
-    p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(&p->a_out, " <StreamDuration>");
+    xml_writer_int64(&p->a_out, p->aDuration / 300);
+    xml_writer_str(&p->a_out, "</StreamDuration>\n");
 
-    sprintf_int64(numStr, p->aByteCount);
-    sprintf(tmpStr, " <StreamSize>%s</StreamSize>\n", numStr);
-    p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(&p->a_out, " <StreamSize>");
+    xml_writer_int64(&p->a_out, p->aByteCount);
+    xml_writer_str(&p->a_out, "</StreamSize>\n");
 
-    sprintf(tmpStr, " <StreamId>%d</StreamId>\n", p->aID);
-    p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(&p->a_out, " <StreamId>");
+    xml_writer_int64(&p->a_out, p->aID);
+    xml_writer_str(&p->a_out, "</StreamId>\n");
 
-    strcpy(tmpStr, "</Stream>\n");
-    p->a_xml_bs->copybytes(p->a_xml_bs, (uint8_t*)&tmpStr[0], (uint32_t)strlen(tmpStr));
+    xml_writer_str(&p->a_out, "</Stream>\n");
+    xml_writer_flush(&p->a_out);
   }
 
-  for(i = 0; i < MAXN; i++)
-  {
-    if(p->aunit.frames[i].headerData.size)
-      free(p->aunit.frames[i].headerData.data);
-  }
-
-  if(p->aunit.headerData.size)
-    free(p->aunit.headerData.data);
+  xml_writer_free(&p->v_out);
+  xml_writer_free(&p->a_out);
+  byte_arena_free(&p->aunit.arena);
 
   if(p->curGOPHeader.size)
     free(p->curGOPHeader.data);
@@ -760,11 +615,24 @@ int32_t init_bufstream_write_with_xml_index(bufstream_tt *bs,
 
 
   if(v_xml_bs)
+  {
     bs->Buf_IO_struct->v_xml_bs = v_xml_bs;
+    if(xml_writer_init(&bs->Buf_IO_struct->v_out, v_xml_bs) != BS_OK)
+    {
+      free(bs->Buf_IO_struct);
+      return BS_ERROR;
+    }
+  }
 
   if(a_xml_bs)
   {
     bs->Buf_IO_struct->a_xml_bs = a_xml_bs;
+    if(xml_writer_init(&bs->Buf_IO_struct->a_out, a_xml_bs) != BS_OK)
+    {
+      xml_writer_free(&bs->Buf_IO_struct->v_out);
+      free(bs->Buf_IO_struct);
+      return BS_ERROR;
+    }
     memset(&bs->Buf_IO_struct->aunit, 0, sizeof(struct access_unit));
     bs->Buf_IO_struct->aunit.firstVPTS = -1;
     bs->Buf_IO_struct->aunit.firstAPTS = -1;
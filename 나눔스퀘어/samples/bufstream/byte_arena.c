@@ -0,0 +1,54 @@
+/* ----------------------------------------------------------------------------
+ * File: byte_arena.c
+ *
+ * Desc: growing byte storage shared by the index writers
+ *
+ * Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "byte_arena.h"
+
+
+int32_t byte_arena_add(struct byte_arena *a, const uint8_t *ptr, uint32_t len)
+{
+  int32_t offset;
+
+  if(a->len + len > a->size)
+  {
+    uint32_t size = a->size ? a->size : 4096;
+    uint8_t *data;
+
+    while(a->len + len > size)
+      size *= 2;
+
+    data = (uint8_t*)realloc(a->data, size);
+    if(!data)
+      return -1;
+    a->data = data;
+    a->size = size;
+  }
+
+  memcpy(a->data + a->len, ptr, len);
+  offset = (int32_t)a->len;
+  a->len += len;
+  return offset;
+}
+
+
+void byte_arena_free(struct byte_arena *a)
+{
+  if(a->data)
+    free(a->data);
+  a->data = NULL;
+  a->len = 0;
+  a->size = 0;
+}
@@ -0,0 +1,44 @@
+/* ----------------------------------------------------------------------------
+ * File: byte_arena.h
+ *
+ * Desc: growing byte storage shared by the index writers
+ *
+ * Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef BYTE_ARENA_H
+#define BYTE_ARENA_H
+
+#include "mctypes.h"
+
+// copies of bytes that live until the next reset, referenced by offset
+// since the data can move when the arena grows
+struct byte_arena
+{
+  uint8_t  *data;
+  uint32_t  len;
+  uint32_t  size;
+};
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// returns the offset of the copy or -1
+int32_t byte_arena_add(struct byte_arena *a, const uint8_t *ptr, uint32_t len);
+void    byte_arena_free(struct byte_arena *a);
+
+#define byte_arena_reset(a) ((a)->len = 0)
+#define byte_arena_ptr(a, offset) ((a)->data + (offset))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BYTE_ARENA_H */
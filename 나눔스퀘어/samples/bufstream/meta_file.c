@@ -8,6 +8,10 @@
  *       Use where multiple files are to written in parallel to avoid performance degradation because of 
  *       concurent disk access, e.g P2 mxf multiplexing or multiple encoding sessions
  *
+ *       Every metadata stream is kept in its own file <name>.md<stream_nr>, there can be any number
+ *       of streams. Writes are collected in a large buffer per stream and appended as a whole, the
+ *       size of a stream is counted, and a stream opened for reading is mapped and read from memory.
+ *
  * Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
  *
  * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.  
@@ -20,22 +24,50 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #if (defined(__APPLE__) ||  defined(__linux__))
 #include <unistd.h>
+#include <sys/mman.h>
+#else
+#include <io.h>
+#include <windows.h>
 #endif
 #include "meta_file.h"
 
-#define MAX_METADATA_NUM (12)
+// initial size of the stream table, it grows with the stream numbers used
+#define METADATA_STREAMS_ALLOC (12)
+
+// append buffer of every stream opened for writing
+#define METADATA_WRITE_BUFFER (256 * 1024)
+
+#define METADATA_CLOSED (0)
+#define METADATA_WRITING (1)
+#define METADATA_READING (2)
 
 #ifndef LOCAL
 #define LOCAL static
 #endif
 
+struct metadata_stream
+{
+  uint32_t state;
+  FILE *file;
+  uint64_t size;              // written or mapped bytes, buffered ones included
+  uint64_t pos;               // read or write position
+  uint8_t *bfr;               // append buffer while writing, holds the data from bfr_pos on
+  uint32_t bfr_count;
+  uint64_t bfr_pos;
+  uint8_t *map;               // the whole file while reading, NULL if it could not be mapped
+#if (!defined(__APPLE__) && !defined(__linux__))
+  HANDLE map_handle;
+#endif
+};
+
 struct impl_stream
 {
   bufstream_tt *filtered;
-  uint32_t metadata_state[MAX_METADATA_NUM];
-  FILE *metadata_file[MAX_METADATA_NUM];
+  struct metadata_stream *streams;
+  uint32_t stream_count;
 #ifdef _BS_UNICODE
   wchar_t base_filename[_BS_MAX_PATH];
 #else
@@ -45,126 +77,297 @@ struct impl_stream
 };
 
 
-LOCAL uint32_t auxinfo_metadata_file(metadata_storage_tt *md, 
-                      uint32_t stream_nr, uint32_t info_ID, 
-                      void *info_ptr, uint32_t info_size)
+// the entry of stream_nr, the table is extended as needed
+LOCAL struct metadata_stream *get_stream(struct impl_stream *instance, uint32_t stream_nr)
 {
+  if(stream_nr >= instance->stream_count)
+  {
+    uint32_t count = instance->stream_count ? instance->stream_count : METADATA_STREAMS_ALLOC;
+    struct metadata_stream *streams;
+
+    while(count <= stream_nr)
+    {
+      if(count > 0x7FFFFFFF / sizeof(struct metadata_stream))
+        return NULL;
+      count *= 2;
+    }
+
+    streams = (struct metadata_stream *)realloc(instance->streams, count * sizeof(struct metadata_stream));
+    if(streams == NULL)
+      return NULL;
+
+    memset(streams + instance->stream_count, 0, (count - instance->stream_count) * sizeof(struct metadata_stream));
+    instance->streams = streams;
+    instance->stream_count = count;
+  }
+
+  return &instance->streams[stream_nr];
+}
+
+
 #ifdef _BS_UNICODE
-  wchar_t filename[_BS_MAX_PATH + 4];
+LOCAL void stream_filename(struct impl_stream *instance, uint32_t stream_nr, wchar_t *filename)
+{
+  swprintf(filename,_BS_MAX_PATH + 16, L"%s.md%u", instance->base_filename, stream_nr);
+}
 #else
-  char filename[_BS_MAX_PATH + 4];
+LOCAL void stream_filename(struct impl_stream *instance, uint32_t stream_nr, char *filename)
+{
+  sprintf(filename,"%s.md%u", instance->base_filename, stream_nr);
+}
 #endif
-  struct impl_stream *instance;
 
-  instance = md->Buf_IO_struct;
 
-  if(stream_nr >= MAX_METADATA_NUM)
-    return ((uint32_t)(~0));
-
-  switch(info_ID)
+// writes the append buffer at its position in the file
+LOCAL int32_t flush_stream(struct metadata_stream *s)
+{
+  if(s->bfr_count)
   {
-    case METADATA_OPEN_WRITE:
+    if(fwrite(s->bfr, s->bfr_count, 1, s->file) != 1)
+      return -1;
 
-      if(instance->metadata_file[stream_nr] == NULL)
-      {
-#ifdef _BS_UNICODE
-        swprintf(filename,_BS_MAX_PATH + 4, L"%s.md%d", instance->base_filename, (int32_t)stream_nr);
+    s->bfr_pos += s->bfr_count;
+    s->bfr_count = 0;
+  }
+  return 0;
+}
+
+
+LOCAL uint64_t file_size(FILE *file)
+{
+#if (defined(__APPLE__) ||  defined(__linux__))
+  struct stat st;
+
+  if(fstat(fileno(file), &st) < 0)
+    return 0;
 #else
-        sprintf(filename,"%s.md%d", instance->base_filename, (int32_t)stream_nr);
+  struct _stati64 st;
+
+  if(_fstati64(_fileno(file), &st) < 0)
+    return 0;
 #endif
+  return (uint64_t)st.st_size;
+}
 
-#ifdef _BS_UNICODE
-        instance->metadata_file[stream_nr] = _wfopen(filename,L"wb");
-#else
-#ifndef __QNX__
-        instance->metadata_file[stream_nr] = fopen(filename,"wb");
-#else
-        instance->metadata_file[stream_nr] = fopen64(filename,"wb");
+
+// maps the file of a stream opened for reading, it is read with fread() if that fails
+LOCAL void map_stream(struct metadata_stream *s)
+{
+  if(!s->size || ((uint64_t)(size_t)s->size != s->size))
+    return;
+
+#if (defined(__APPLE__) ||  defined(__linux__))
+  {
+    void *map = mmap(NULL, (size_t)s->size, PROT_READ, MAP_PRIVATE, fileno(s->file), 0);
+
+    if(map == MAP_FAILED)
+      return;
+#if defined(__linux__)
+    madvise(map, (size_t)s->size, MADV_SEQUENTIAL);
 #endif
+    s->map = (uint8_t *)map;
+  }
+#else
+  s->map_handle = CreateFileMapping((HANDLE)_get_osfhandle(_fileno(s->file)), NULL, PAGE_READONLY, 0, 0, NULL);
+  if(s->map_handle == NULL)
+    return;
+
+  s->map = (uint8_t *)MapViewOfFile(s->map_handle, FILE_MAP_READ, 0, 0, 0);
+  if(s->map == NULL)
+  {
+    CloseHandle(s->map_handle);
+    s->map_handle = NULL;
+  }
 #endif
+}
 
-        if( instance->metadata_file[stream_nr] == NULL)
-          return ((uint32_t)(~0));
 
-        instance->metadata_state[stream_nr]= 0;
-      }
-      else
-        return ((uint32_t)(~0));
+LOCAL void unmap_stream(struct metadata_stream *s)
+{
+  if(s->map)
+  {
+#if (defined(__APPLE__) ||  defined(__linux__))
+    munmap(s->map, (size_t)s->size);
+#else
+    UnmapViewOfFile(s->map);
+    CloseHandle(s->map_handle);
+    s->map_handle = NULL;
+#endif
+    s->map = NULL;
+  }
+}
 
-      break;
-      
-    case METADATA_OPEN_READ:
 
-      if(instance->metadata_file[stream_nr] == NULL)
-      {
+LOCAL uint32_t open_stream(struct impl_stream *instance, uint32_t stream_nr, struct metadata_stream *s, uint32_t state)
+{
 #ifdef _BS_UNICODE
-        swprintf(filename,_BS_MAX_PATH + 4, L"%s.md%d", instance->base_filename, (int32_t)stream_nr);
+  wchar_t filename[_BS_MAX_PATH + 16];
 #else
-        sprintf(filename,"%s.md%d", instance->base_filename, (int32_t)stream_nr);
+  char filename[_BS_MAX_PATH + 16];
 #endif
 
+  if(s->state != METADATA_CLOSED)
+    return ((uint32_t)(~0));
+
+  stream_filename(instance, stream_nr, filename);
+
 #ifdef _BS_UNICODE
-        instance->metadata_file[stream_nr] = _wfopen(filename,L"rb");
+  s->file = _wfopen(filename, (state == METADATA_WRITING) ? L"wb" : L"rb");
 #else
 #ifndef __QNX__
-        instance->metadata_file[stream_nr] = fopen(filename,"rb");
+  s->file = fopen(filename, (state == METADATA_WRITING) ? "wb" : "rb");
 #else
-        instance->metadata_file[stream_nr] = fopen64(filename,"rb");
+  s->file = fopen64(filename, (state == METADATA_WRITING) ? "wb" : "rb");
 #endif
 #endif
-        if( instance->metadata_file[stream_nr] == NULL)
-          return ((uint32_t)(~0));
 
-        instance->metadata_state[stream_nr]= 0;
-      }
-      else
+  if(s->file == NULL)
+    return ((uint32_t)(~0));
+
+  s->pos = 0;
+  s->bfr_count = 0;
+  s->bfr_pos = 0;
+
+  if(state == METADATA_WRITING)
+  {
+    s->size = 0;
+    if(s->bfr == NULL)
+      s->bfr = (uint8_t *)malloc(METADATA_WRITE_BUFFER);
+    if(s->bfr == NULL)
+    {
+      fclose(s->file);
+      s->file = NULL;
+      return ((uint32_t)(~0));
+    }
+  }
+  else
+  {
+    s->size = file_size(s->file);
+    map_stream(s);
+  }
+
+  s->state = state;
+  return 0;
+}
+
+
+LOCAL void close_stream(struct metadata_stream *s)
+{
+  if(s->state == METADATA_WRITING)
+    flush_stream(s);
+
+  unmap_stream(s);
+  if(s->file)
+    fclose(s->file);
+
+  free(s->bfr);
+  s->bfr = NULL;
+  s->file = NULL;
+  s->state = METADATA_CLOSED;
+}
+
+
+LOCAL uint32_t write_stream(struct metadata_stream *s, const uint8_t *ptr, uint32_t size)
+{
+  if(s->bfr_count + size > METADATA_WRITE_BUFFER)
+  {
+    if(flush_stream(s))
+      return ((uint32_t)(~0));
+  }
+
+  if(size >= METADATA_WRITE_BUFFER)
+  {
+    if(fwrite(ptr, size, 1, s->file) != 1)
+      return ((uint32_t)(~0));
+    s->bfr_pos += size;
+  }
+  else
+  {
+    memcpy(s->bfr + s->bfr_count, ptr, size);
+    s->bfr_count += size;
+  }
+
+  // after a rewind the data is overwritten, the file keeps its size
+  s->pos += size;
+  if(s->pos > s->size)
+    s->size = s->pos;
+  return 0;
+}
+
+
+LOCAL uint32_t read_stream(struct metadata_stream *s, uint8_t *ptr, uint32_t size)
+{
+  if(s->pos + size > s->size)
+    return ((uint32_t)(~0));
+
+  if(s->map)
+    memcpy(ptr, s->map + s->pos, size);
+  else if(fread(ptr, size, 1, s->file) != 1)
+    return ((uint32_t)(~0));
+
+  s->pos += size;
+  return 0;
+}
+
+
+LOCAL uint32_t auxinfo_metadata_file(metadata_storage_tt *md, 
+                      uint32_t stream_nr, uint32_t info_ID, 
+                      void *info_ptr, uint32_t info_size)
+{
+  struct impl_stream *instance;
+  struct metadata_stream *s;
+
+  instance = md->Buf_IO_struct;
+
+  switch(info_ID)
+  {
+    case METADATA_OPEN_WRITE:
+
+      s = get_stream(instance, stream_nr);
+      if(s == NULL)
         return ((uint32_t)(~0));
 
-      break;
+      return open_stream(instance, stream_nr, s, METADATA_WRITING);
+      
+    case METADATA_OPEN_READ:
+
+      s = get_stream(instance, stream_nr);
+      if(s == NULL)
+        return ((uint32_t)(~0));
+
+      return open_stream(instance, stream_nr, s, METADATA_READING);
 
     case METADATA_CLOSE:
 
-      if(instance->metadata_file[stream_nr])
-      {
-        fclose(instance->metadata_file[stream_nr]);
-        instance->metadata_file[stream_nr] = NULL;
-        instance->metadata_state[stream_nr]= 0;
-      }
+      if(stream_nr < instance->stream_count)
+        close_stream(&instance->streams[stream_nr]);
       break;
 
     case METADATA_WRITE:
 
-      if(instance->metadata_file[stream_nr])
-      {
-        size_t n = fwrite(info_ptr, info_size, 1, instance->metadata_file[stream_nr]);
-
-        if( n != 1)
-          return ((uint32_t)(~0));
-      }
+      if((stream_nr < instance->stream_count) && (instance->streams[stream_nr].state == METADATA_WRITING))
+        return write_stream(&instance->streams[stream_nr], (const uint8_t *)info_ptr, info_size);
       else
         return ((uint32_t)(~0));
 
-      break;
-
     case METADATA_READ:
 
-      if(instance->metadata_file[stream_nr])
-      {
-        size_t n = fread(info_ptr, info_size, 1, instance->metadata_file[stream_nr]);
-
-        if( n != 1)
-          return ((uint32_t)(~0));
-      }
+      if((stream_nr < instance->stream_count) && (instance->streams[stream_nr].state == METADATA_READING))
+        return read_stream(&instance->streams[stream_nr], (uint8_t *)info_ptr, info_size);
       else
         return ((uint32_t)(~0));
 
-      break;
-
     case METADATA_REWIND:
 
-      if(instance->metadata_file[stream_nr])
+      if((stream_nr < instance->stream_count) && (instance->streams[stream_nr].state != METADATA_CLOSED))
       {
-        rewind(instance->metadata_file[stream_nr]);
+        s = &instance->streams[stream_nr];
+        if((s->state == METADATA_WRITING) && flush_stream(s))
+          return ((uint32_t)(~0));
+
+        rewind(s->file);
+        s->pos = 0;
+        s->bfr_pos = 0;
       }
       else
         return ((uint32_t)(~0));
@@ -173,15 +376,9 @@ LOCAL uint32_t auxinfo_metadata_file(metadata_storage_tt *md,
 
     case METADATA_GET_SIZE:
 
-      if(instance->metadata_file[stream_nr] && info_ptr)
+      if((stream_nr < instance->stream_count) && (instance->streams[stream_nr].state != METADATA_CLOSED) && info_ptr)
       {
-        // store current position
-        int32_t pos = ftell(instance->metadata_file[stream_nr]);
-
-        fseek(instance->metadata_file[stream_nr], 0, SEEK_END);
-        *((uint32_t *)info_ptr) = (uint32_t)ftell(instance->metadata_file[stream_nr]);
-
-        fseek(instance->metadata_file[stream_nr], pos, SEEK_SET);
+        *((uint32_t *)info_ptr) = (uint32_t)instance->streams[stream_nr].size;
       }
       else
         return ((uint32_t)(~0));
@@ -190,29 +387,26 @@ LOCAL uint32_t auxinfo_metadata_file(metadata_storage_tt *md,
 
     case METADATA_DESTROY:
 
-      if(instance->metadata_file[stream_nr] == NULL)
+      if((stream_nr >= instance->stream_count) || (instance->streams[stream_nr].state == METADATA_CLOSED))
       {
-#if (!defined(__APPLE__) && !defined(__linux__))
-        FILE * fil;
-#endif
-          
 #ifdef _BS_UNICODE
-        swprintf(filename,_BS_MAX_PATH + 4, L"%s.md%d", instance->base_filename, (int32_t)stream_nr);
+        wchar_t filename[_BS_MAX_PATH + 16];
 #else
-        sprintf(filename,"%s.md%d", instance->base_filename, (int32_t)stream_nr);
+        char filename[_BS_MAX_PATH + 16];
+#endif
+#if (!defined(__APPLE__) && !defined(__linux__))
+        FILE * fil;
 #endif
 
+        stream_filename(instance, stream_nr, filename);
+
 #if (defined(__APPLE__) ||  defined(__linux__))
         unlink(filename);
 #else
 #ifdef _BS_UNICODE
         fil = _wfopen(filename,L"wD");
 #else
-#ifndef __linux__
         fil = fopen(filename,"wD");
-#else
-        fil = fopen64(filename,"wD");
-#endif
 #endif
 
         if(fil)
@@ -238,18 +432,18 @@ LOCAL uint32_t auxinfo_metadata_file(metadata_storage_tt *md,
   return (0);
 }
 
-  
-LOCAL void done_metadata_file(metadata_storage_tt *md, int32_t abort)
+
+// closes all streams, the files of the ones used are removed after METADATA_DESTROY_ALL
+LOCAL void close_metadata_streams(metadata_storage_tt *md)
 {
-  int32_t i;
+  uint32_t i;
   struct impl_stream *instance;
 
   instance = md->Buf_IO_struct;
 
-//we don't cache anything in metadata-instance. nothing to do with "abort"-parameter
-  for(i = 0; i<MAX_METADATA_NUM; i++)
+  for(i = 0; i<instance->stream_count; i++)
   {
-    if(instance->metadata_file[i])
+    if(instance->streams[i].state != METADATA_CLOSED)
     {
       md->auxinfo(md, i, METADATA_CLOSE, NULL, 0);
     }
@@ -258,6 +452,17 @@ LOCAL void done_metadata_file(metadata_storage_tt *md, int32_t abort)
       md->auxinfo(md, i, METADATA_DESTROY, NULL, 0);
 	}
   }
+}
+
+  
+LOCAL void done_metadata_file(metadata_storage_tt *md, int32_t abort)
+{
+  struct impl_stream *instance;
+
+  instance = md->Buf_IO_struct;
+
+//the buffered writes are written in any case, nothing to do with "abort"-parameter
+  close_metadata_streams(md);
 
   if(instance->filtered)
   {
@@ -268,28 +473,18 @@ LOCAL void done_metadata_file(metadata_storage_tt *md, int32_t abort)
 
 LOCAL void free_metadata_file(metadata_storage_tt *md)
 {
-  int32_t i;
   struct impl_stream *instance;
 
   instance = md->Buf_IO_struct;
 
-  for(i = 0; i<MAX_METADATA_NUM; i++)
-  {
-    if(instance->metadata_file[i])
-    {
-      md->auxinfo(md, i, METADATA_CLOSE, NULL, 0);
-    }
-	if(instance->destroy_when_closed)
-	{
-      md->auxinfo(md, i, METADATA_DESTROY, NULL, 0);
-	}
-  }
+  close_metadata_streams(md);
 
   if(instance->filtered)
   {
     instance->filtered->free(instance->filtered);
   }
 
+  free(instance->streams);
   free(md);
 }
 
@@ -316,20 +511,15 @@ metadata_storage_tt* new_metadata_file(char *name)
 
     if(instance)
     {
-      int32_t i;
-
       memset(instance, 0, sizeof(*instance));
 
       instance->metadata.done    = done_metadata_file;
       instance->metadata.free    = free_metadata_file;
       instance->metadata.auxinfo = auxinfo_metadata_file;
       instance->metadata.Buf_IO_struct = &instance->metadata_storage;
-  
-      for(i = 0; i<MAX_METADATA_NUM; i++)
-      {
-        instance->metadata_storage.metadata_file[i] = NULL;
-        instance->metadata_storage.metadata_state[i] = 0;
-      }
+
+      instance->metadata_storage.streams = NULL;
+      instance->metadata_storage.stream_count = 0;
 #ifdef _BS_UNICODE
       wcscpy(instance->metadata_storage.base_filename, name);
 #else
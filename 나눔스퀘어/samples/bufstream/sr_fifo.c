@@ -15,6 +15,12 @@
 // sampbegin - get-index
 // sampend   - put-index
 // sampmax   - full-buffer size
+//
+// besides the samples copied into buf the writer can lend buffers
+// (fifo_w_lend), the reader gets pointers right into them and they are
+// released as soon as they are read. sampput/sampgot count the samples
+// going through buf, so each lent buffer knows which samples of buf
+// have to be read in front of it
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -58,6 +64,12 @@ fifo_tt *fifo_new(uint32_t sampcached, uint32_t sampchunk, size_t sampsize)
   p->sampsize  = sampsize;
   p->bufsize   = bufsize;
   p->samptoput = 0;
+  p->lentbegin = 0;
+  p->lentend   = 0;
+  p->lentpos   = 0;
+  p->sampput   = 0;
+  p->sampgot   = 0;
+  p->seam      = NULL;
   return p;
 }
 
@@ -66,6 +78,12 @@ uint32_t fifo_free(fifo_tt *fifo)
 {
   if(fifo)
   {
+    // give back what was lent but never read
+    while(fifo->lentbegin != fifo->lentend)
+      fifo_desc_release(fifo->lent[fifo->lentbegin++ % FIFO_MAX_LENT].desc);
+
+    if(fifo->seam)
+      free(fifo->seam);
     if(fifo->buf)
       free(fifo->buf);
     free(fifo);
@@ -74,7 +92,20 @@ uint32_t fifo_free(fifo_tt *fifo)
 }
 
 
-uint32_t fifo_r_filled(fifo_tt *fifo)
+void fifo_desc_addref(fifo_desc_tt *desc)
+{
+  desc->refs++;
+}
+
+
+void fifo_desc_release(fifo_desc_tt *desc)
+{
+  if(--desc->refs == 0 && desc->release)
+    desc->release(desc->context, desc);
+}
+
+
+static uint32_t ring_filled(fifo_tt *fifo)
 {
   uint32_t filled;
   uint32_t sampend  =*(volatile uint32_t *)&fifo->sampend;
@@ -96,7 +127,7 @@ uint32_t fifo_r_filled(fifo_tt *fifo)
 
 // {numSamples} MUST be smaller then {sampchunk}
 //
-uint8_t *fifo_r_sampbuf(fifo_tt *fifo, uint32_t numSamples)
+static uint8_t *ring_sampbuf(fifo_tt *fifo, uint32_t numSamples)
 {
   uint32_t sampend=*(volatile uint32_t *)(&fifo->sampend);
   uint32_t sampbegin=fifo->sampbegin;
@@ -140,7 +171,7 @@ exit:
 }
 
 
-uint32_t fifo_r_remove(fifo_tt *fifo, uint32_t numSamples)
+static uint32_t ring_remove(fifo_tt *fifo, uint32_t numSamples)
 {
   uint32_t sampend=*(volatile uint32_t *)(&fifo->sampend);
   uint32_t sampbegin=fifo->sampbegin;
@@ -183,11 +214,177 @@ uint32_t fifo_r_remove(fifo_tt *fifo, uint32_t numSamples)
     sampbegin+=numSamples;
   }
 
+  fifo->sampgot+=numSamples;
   *(volatile uint32_t *)(&fifo->sampbegin)=sampbegin;
   return numSamples;
 }
 
 
+// copy samples of buf starting {offset} samples after sampbegin,
+// the caller makes sure they are filled
+static void ring_peek(fifo_tt *fifo, uint32_t offset, uint8_t *dst, uint32_t numSamples)
+{
+  uint32_t pos=fifo->sampbegin+offset;
+  uint32_t rest;
+
+  if(pos >= fifo->sampmax)
+    pos=fifo->sampchunk+(pos-fifo->sampmax);
+
+  rest=fifo->sampmax-pos;
+  if(rest > numSamples)
+    rest=numSamples;
+
+  memcpy(dst, fifo->buf+pos*fifo->sampsize, rest*fifo->sampsize);
+  if(numSamples > rest)
+    memcpy(dst+rest*fifo->sampsize,
+           fifo->buf+fifo->sampchunk*fifo->sampsize,
+           (numSamples-rest)*fifo->sampsize);
+}
+
+
+// samples of buf to be read in front of the first lent buffer
+static uint32_t ring_ahead(fifo_tt *fifo)
+{
+  uint32_t filled=ring_filled(fifo);
+
+  if(fifo->lentbegin != *(volatile uint32_t *)(&fifo->lentend))
+  {
+    uint32_t ahead=fifo->lent[fifo->lentbegin % FIFO_MAX_LENT].mark-fifo->sampgot;
+    if(ahead < filled)
+      filled=ahead;
+  }
+  return filled;
+}
+
+
+uint32_t fifo_r_filled(fifo_tt *fifo)
+{
+  uint32_t lentend=*(volatile uint32_t *)(&fifo->lentend);
+  uint32_t filled=ring_filled(fifo);
+  uint32_t i;
+
+  for(i=fifo->lentbegin; i != lentend; i++)
+    filled+=fifo->lent[i % FIFO_MAX_LENT].desc->numSamples;
+
+  return filled-fifo->lentpos;
+}
+
+
+// a read spanning buf and lent buffers is copied together, it is
+// limited to {sampchunk} like the reads wrapping over sampmax
+static uint8_t *seam_sampbuf(fifo_tt *fifo, uint32_t numSamples)
+{
+  uint32_t lentend=*(volatile uint32_t *)(&fifo->lentend);
+  uint32_t i=fifo->lentbegin;
+  uint32_t lentpos=fifo->lentpos;
+  uint32_t sampgot=fifo->sampgot;
+  uint32_t got=0;
+
+  if(numSamples > fifo->sampchunk+1 || fifo_r_filled(fifo) < numSamples)
+    return NULL;
+
+  if(!fifo->seam)
+  {
+    fifo->seam=(uint8_t *) malloc((fifo->sampchunk+1)*fifo->sampsize);
+    if(!fifo->seam)
+      return NULL;
+  }
+
+  while(got < numSamples)
+  {
+    fifo_desc_tt *desc;
+    uint32_t n=numSamples-got;
+
+    if(i != lentend)
+    {
+      uint32_t ahead=fifo->lent[i % FIFO_MAX_LENT].mark-sampgot;
+      if(ahead < n)
+        n=ahead;
+    }
+
+    if(n)
+    {
+      ring_peek(fifo, sampgot-fifo->sampgot, fifo->seam+got*fifo->sampsize, n);
+      sampgot+=n;
+      got+=n;
+      continue;
+    }
+
+    desc=fifo->lent[i++ % FIFO_MAX_LENT].desc;
+    n=desc->numSamples-lentpos;
+    if(n > numSamples-got)
+      n=numSamples-got;
+
+    memcpy(fifo->seam+got*fifo->sampsize,
+           desc->ptr+lentpos*fifo->sampsize,
+           n*fifo->sampsize);
+    lentpos=0;
+    got+=n;
+  }
+
+  return fifo->seam;
+}
+
+
+// {numSamples} MUST be smaller then {sampchunk}
+//
+uint8_t *fifo_r_sampbuf(fifo_tt *fifo, uint32_t numSamples)
+{
+  fifo_desc_tt *desc;
+  uint32_t ahead;
+
+  if(fifo->lentbegin == *(volatile uint32_t *)(&fifo->lentend))
+    return ring_sampbuf(fifo, numSamples);
+
+  ahead=ring_ahead(fifo);
+  if(ahead >= numSamples)
+    return ring_sampbuf(fifo, numSamples);
+
+  desc=fifo->lent[fifo->lentbegin % FIFO_MAX_LENT].desc;
+  if(!ahead && fifo->lentpos+numSamples <= desc->numSamples)
+    return desc->ptr+fifo->lentpos*fifo->sampsize;
+
+  return seam_sampbuf(fifo, numSamples);
+}
+
+
+uint32_t fifo_r_remove(fifo_tt *fifo, uint32_t numSamples)
+{
+  uint32_t removed=0;
+
+  while(removed < numSamples)
+  {
+    fifo_desc_tt *desc;
+    uint32_t ahead, n=numSamples-removed;
+
+    if(fifo->lentbegin == *(volatile uint32_t *)(&fifo->lentend))
+      return removed+ring_remove(fifo, n);
+
+    ahead=ring_ahead(fifo);
+    if(ahead)
+    {
+      removed+=ring_remove(fifo, ahead < n ? ahead : n);
+      continue;
+    }
+
+    desc=fifo->lent[fifo->lentbegin % FIFO_MAX_LENT].desc;
+    if(n > desc->numSamples-fifo->lentpos)
+      n=desc->numSamples-fifo->lentpos;
+
+    fifo->lentpos+=n;
+    removed+=n;
+
+    if(fifo->lentpos == desc->numSamples)
+    {
+      fifo->lentpos=0;
+      *(volatile uint32_t *)(&fifo->lentbegin)=fifo->lentbegin+1;
+      fifo_desc_release(desc);
+    }
+  }
+  return removed;
+}
+
+
 
 uint32_t fifo_w_empty(fifo_tt *fifo)
 {
@@ -258,6 +455,7 @@ uint32_t fifo_w_sampput(fifo_tt *fifo, uint8_t *src, uint32_t numSamples)
     }
   }
 
+  fifo->sampput+=numSamples;
   *(volatile uint32_t *)(&fifo->sampend)=sampend;
   return numSamples;
 }
@@ -324,7 +522,8 @@ uint8_t * fifo_w_sampbuf(fifo_tt *fifo, uint32_t numSamples)
   {
 // free area can be splitted
     uint32_t rest = fifo->sampmax-sampend;
-    uint32_t free = rest+(sampbegin>fifo->sampchunk?sampbegin-fifo->sampchunk:0);
+    // one sample stays free, a wrapped sampend reaching sampbegin would read as empty
+    uint32_t free = rest+(sampbegin>fifo->sampchunk?sampbegin-fifo->sampchunk-1:0);
 
     if(rest >= numSamples)
     {
@@ -388,7 +587,26 @@ uint32_t fifo_w_commit(fifo_tt *fifo, uint32_t numSamples)
   }
 
 
+  fifo->sampput+=numSamples;
   *(volatile uint32_t *)(&fifo->sampend)=sampend;
 
   return numSamples;
 }
+
+
+// the fifo takes over the reference of the caller, the buffer must stay
+// untouched until it is released
+uint32_t fifo_w_lend(fifo_tt *fifo, fifo_desc_tt *desc)
+{
+  uint32_t lentbegin=*(volatile uint32_t *)(&fifo->lentbegin);
+  uint32_t lentend=fifo->lentend;
+
+  if(!desc->numSamples || lentend-lentbegin >= FIFO_MAX_LENT)
+    return 0;
+
+  fifo->lent[lentend % FIFO_MAX_LENT].desc=desc;
+  fifo->lent[lentend % FIFO_MAX_LENT].mark=fifo->sampput;
+  *(volatile uint32_t *)(&fifo->lentend)=lentend+1;
+
+  return desc->numSamples;
+}
@@ -14,6 +14,22 @@
 #include "mctypes.h"
 
 typedef struct fifo_struct fifo_tt;
+typedef struct fifo_desc_struct fifo_desc_tt;
+
+// buffer lent to the fifo instead of copying it in, the reader gets
+// pointers right into it. release is called once the last reference
+// is dropped, the reference count is not atomic so lending and reading
+// must be serialized by the caller
+struct fifo_desc_struct
+{
+  uint8_t *ptr;
+  uint32_t numSamples;
+  int32_t  refs;
+  void   (*release)(void *context, fifo_desc_tt *desc);
+  void    *context;
+};
+
+#define FIFO_MAX_LENT  16
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,6 +47,10 @@ uint32_t  fifo_w_empty  (fifo_tt *fifo);
 uint32_t  fifo_w_sampput(fifo_tt *fifo, uint8_t *src, uint32_t numSamples);
 uint8_t  *fifo_w_sampbuf(fifo_tt *fifo, uint32_t numSamples);
 uint32_t  fifo_w_commit (fifo_tt *fifo, uint32_t numSamples);
+uint32_t  fifo_w_lend   (fifo_tt *fifo, fifo_desc_tt *desc);
+
+void      fifo_desc_addref (fifo_desc_tt *desc);
+void      fifo_desc_release(fifo_desc_tt *desc);
 
 #ifdef __cplusplus
 }
@@ -51,4 +71,17 @@ struct fifo_struct
   uint32_t sampend;
   uint32_t sampmax;
   uint32_t samptoput;
+
+// lent buffers, each one follows the samples committed before it was lent
+  struct
+  {
+    fifo_desc_tt *desc;
+    uint32_t      mark;   // sampput when the buffer was lent
+  } lent[FIFO_MAX_LENT];
+  uint32_t lentbegin;
+  uint32_t lentend;
+  uint32_t lentpos;       // samples of the first lent buffer already read
+  uint32_t sampput;       // samples committed to buf, wraps around
+  uint32_t sampgot;       // samples removed from buf, wraps around
+  uint8_t *seam;          // a read spanning a lent buffer is assembled here
 };
@@ -0,0 +1,271 @@
+/* ----------------------------------------------------------------------------
+ * File: vau_parser.c
+ *
+ * Desc: video access unit parser shared by the VXML and the binary index writers
+ *
+ * Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "vau_parser.h"
+
+#ifdef MC_LITTLEENDIAN
+#define BS_INT32(x) ((((x)&0x000000FF)<<24)|(((x)&0x0000FF00)<<8)|(((x)&0x00FF0000)>>8)|(((x)&0xFF000000)>>24))
+#else
+#define BS_INT32(x) (x)
+#endif
+
+static int32_t picture_rates[16] =
+{
+  0,
+  1126125,
+  1125000,
+  1080000,
+  900900,
+  900000,
+  540000,
+  450450,
+  450000,
+  0,0,0,0,0,0,0
+};
+
+
+void vau_parser_init(struct vau_parser *p, bufstream_tt *main_bs)
+{
+  memset(p, 0, sizeof(struct vau_parser));
+  p->main_bs = main_bs;
+  p->aunit.firstPTS = -1;
+}
+
+
+void vau_parser_free(struct vau_parser *p)
+{
+  byte_arena_free(&p->aunit.headers);
+
+  if(p->curGOPHeader.size)
+    free(p->curGOPHeader.data);
+
+  if(p->curPICHeader.size)
+    free(p->curPICHeader.data);
+
+  p->curGOPHeader.size = 0;
+  p->curPICHeader.size = 0;
+}
+
+
+static void copy_header(struct byte_arena *arena, struct vau_header_copy *hdr, const uint8_t *ptr, int32_t len)
+{
+  hdr->offset = len ? byte_arena_add(arena, ptr, len) : 0;
+  hdr->len = (hdr->offset < 0) ? 0 : len;
+  if(hdr->offset < 0)
+    hdr->offset = 0;
+}
+
+
+uint8_t *vau_parser_request(struct vau_parser *p, uint32_t numbytes)
+{
+  p->picBuffer = p->main_bs->request (p->main_bs, numbytes);
+  return p->picBuffer;
+}
+
+static int32_t save_header_bytes(struct vau_parser *p, uint8_t *ptr, int32_t numbytes)
+{
+    if(p->curGOPHeader.len + numbytes > p->curGOPHeader.size)
+    {
+      uint8_t *pPtr = (uint8_t*)malloc(p->curGOPHeader.len + numbytes);
+      if (!pPtr)
+          return 1;
+      if (p->curGOPHeader.data && (p->curGOPHeader.len > 0))
+        memcpy(pPtr, p->curGOPHeader.data, p->curGOPHeader.len);
+      if(p->curGOPHeader.data)
+        free(p->curGOPHeader.data);
+      p->curGOPHeader.data = pPtr;
+      p->curGOPHeader.size = p->curGOPHeader.len + numbytes;
+    }
+
+    memcpy(p->curGOPHeader.data + p->curGOPHeader.len, ptr, numbytes);
+    if (p->curGOPHeader.len == 0)
+      p->curGOPPos = p->byteCount;
+    p->curGOPHeader.len += numbytes;
+    return 0;
+}
+
+uint32_t vau_parser_confirm(struct vau_parser *p, uint32_t numbytes)
+{
+  uint8_t *ptr = p->picBuffer;
+  int32_t leftnumbytes = numbytes;
+
+  if(!ptr || !numbytes)
+    return 0;
+
+  if (p->bPicStartFlag)
+  {
+    if (!p->bPicGotHdrFlag)
+    {
+      int32_t i = 0;
+
+      while((i < leftnumbytes-3) &&
+            (BS_INT32(*(uint32_t*)&(ptr[i])) != 0x00000100))
+        i++;
+
+      if (i > 0)
+      {
+        if (save_header_bytes(p, ptr, i))
+          return 0;
+
+        // set ptr to point to the picture header
+        ptr += i;
+        leftnumbytes -= i;
+        i = 0;
+      }
+
+      while((i + 3 < leftnumbytes) &&
+            (((BS_INT32(*(uint32_t*)&(ptr[i])) & 0xFFFFFF00) != 0x00000100) ||
+             (ptr[i + 3] < 0x01) || (ptr[i + 3] > 0xAF)))
+        i++;
+
+      if(i > 0)
+      {
+        // found the picture headers, save them to the curPICHeader
+        if (i + 3 == leftnumbytes)
+          i = leftnumbytes;    // no slice header was found so just use to the end of the buffer
+
+        if(i > p->curPICHeader.size)
+        {
+          if(p->curPICHeader.size)
+            free(p->curPICHeader.data);
+          p->curPICHeader.data = (uint8_t*)malloc(i);
+          p->curPICHeader.size = i;
+        }
+
+        memcpy(p->curPICHeader.data, ptr, i);
+        p->curPICHeader.len = i;
+        p->curPICPos = p->byteCount;
+      }
+
+      p->bPicGotHdrFlag = 1;
+    }
+  }
+  else
+  {
+    if (save_header_bytes(p, ptr, numbytes))
+      return 0;
+  }
+
+  p->byteCount += numbytes;
+
+  return p->main_bs->confirm (p->main_bs, numbytes);
+}
+
+
+void vau_parser_auxinfo(struct vau_parser *p, uint32_t info_ID, void *info_ptr)
+{
+  switch(info_ID)
+  {
+    case ID_PICTURE_START_CODE:
+      {
+        struct pic_start_info *pph = (struct pic_start_info*)info_ptr;
+
+        p->curRFFFlag = pph->repeat_first_field;
+        p->bPicStartFlag = 1;
+      }
+      break;
+
+    case ID_SEQ_START_CODE:
+      if(!p->clocks_per_frame)
+      {
+        struct seq_start_info *psh = (struct seq_start_info*)info_ptr;
+
+        if((psh->pulldown_flag == PULLDOWN_32) ||
+           (psh->pulldown_flag == PULLDOWN_23))
+          p->clocks_per_frame = (int64_t)picture_rates[FRAMERATE29];
+        else
+          p->clocks_per_frame = (int64_t)picture_rates[psh->frame_rate_code];
+        p->clocks_per_field = p->clocks_per_frame / 2;
+      }
+      p->bPicStartFlag = 0;
+      p->bPicGotHdrFlag = 0;
+      break;
+
+    case ID_GOP_START_CODE:
+      p->bPicStartFlag = 0;
+      p->bPicGotHdrFlag = 0;
+      break;
+  }
+}
+
+
+int32_t vau_parser_unit_done(struct vau_parser *p, const struct v_au_struct *pau)
+{
+  return ((pau->flags & SEQHDR_FLAG) || (pau->flags & GOPHDR_FLAG)) && (p->aunit.firstPTS >= 0);
+}
+
+
+void vau_parser_add_au(struct vau_parser *p, const struct v_au_struct *pau)
+{
+  int32_t i;
+
+  if((pau->flags & SEQHDR_FLAG) || (pau->flags & GOPHDR_FLAG))
+  {
+    // clear out all the existing picture present flags
+    for(i = 0; i < MAXN; i++)
+      p->aunit.frames[i].present = 0;
+
+    p->aunit.unitType = pau->flags;
+    p->aunit.gopPosition = p->curGOPPos;
+    p->aunit.gopSize = 0;
+    p->aunit.firstPTS = -1;
+
+    byte_arena_reset(&p->aunit.headers);
+    copy_header(&p->aunit.headers, &p->aunit.headerData, p->curGOPHeader.data, p->curGOPHeader.len);
+    p->curGOPHeader.len = 0;
+  }
+
+  if ((p->curPICHeader.data != NULL) && (p->curPICHeader.len > 6))
+  {
+    // get the temp ref of the current picture
+    i = ((p->curPICHeader.data[4] << 8) | p->curPICHeader.data[5]) >> 6;
+    if(i < MAXN)
+    {
+      // we got a valid picture
+      p->aunit.frames[i].present = 1;
+      if((p->aunit.firstPTS < 0) ||
+         (pau->PTS < p->aunit.firstPTS))
+        p->aunit.firstPTS = pau->PTS;
+
+      if(pau->PTS > p->aunit.lastPTS)
+      {
+        p->aunit.lastPTS = pau->PTS;
+        p->aunit.rffFlag = p->curRFFFlag;
+      }
+
+      p->aunit.frames[i].relPosition = p->curPICPos - p->aunit.gopPosition;
+
+      copy_header(&p->aunit.headers, &p->aunit.frames[i].headerData, p->curPICHeader.data, p->curPICHeader.len);
+
+      p->aunit.gopSize += pau->length;
+    }
+  }
+  p->bPicStartFlag = 0;
+  p->bPicGotHdrFlag = 0;
+}
+
+
+int64_t vau_parser_finish_unit(struct vau_parser *p)
+{
+  int64_t gop_duration = p->aunit.lastPTS - p->aunit.firstPTS + p->clocks_per_frame;
+
+  if(p->aunit.rffFlag)
+    gop_duration += p->clocks_per_field;
+
+  p->duration += gop_duration;
+  return gop_duration;
+}
@@ -0,0 +1,104 @@
+/* ----------------------------------------------------------------------------
+ * File: vau_parser.h
+ *
+ * Desc: video access unit parser shared by the VXML and the binary index writers
+ *
+ * Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef VAU_PARSER_H
+#define VAU_PARSER_H
+
+#include "bufstrm.h"
+#include "auxinfo.h"
+#include "mcdefs.h"
+#include "byte_arena.h"
+
+// header bytes copied to the arena of the access unit
+struct vau_header_copy
+{
+  int32_t offset;
+  int32_t len;
+};
+
+struct vau_picture
+{
+  int32_t                present;
+  struct vau_header_copy headerData;
+  int64_t                relPosition;
+};
+
+// a GOP, or a sequence header with its GOP, with the pictures indexed by temp ref
+struct vau_unit
+{
+  int32_t                unitType;
+  int64_t                gopPosition;
+  int64_t                firstPTS;       // -1 until a picture is added
+  int64_t                lastPTS;
+  int32_t                gopSize;
+  int32_t                rffFlag;
+  struct vau_header_copy headerData;
+  struct vau_picture     frames[MAXN];
+  struct byte_arena      headers;        // GOP and picture headers, reset for every access unit
+};
+
+struct vau_buffer
+{
+  int32_t  len;
+  int32_t  size;
+  uint8_t *data;
+};
+
+// Follows the data written through the index bufstream and the auxinfo of the encoder, and
+// collects the headers, positions and PTS of the pictures of the current access unit.
+struct vau_parser
+{
+  bufstream_tt      *main_bs;        // bufstream the video is passed to
+  uint8_t           *picBuffer;      // pointer to the buffer the picture is written to
+  int64_t            byteCount;      // current byte count
+  int64_t            duration;       // of the finished access units
+  struct vau_buffer  curGOPHeader;
+  struct vau_buffer  curPICHeader;
+  int64_t            curGOPPos;
+  int64_t            curPICPos;
+  int64_t            clocks_per_frame;
+  int64_t            clocks_per_field;
+  int32_t            curRFFFlag;
+  uint8_t            bPicStartFlag;
+  uint8_t            bPicGotHdrFlag;
+  struct vau_unit    aunit;
+};
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void     vau_parser_init(struct vau_parser *p, bufstream_tt *main_bs);
+void     vau_parser_free(struct vau_parser *p);
+
+// request and confirm of the index bufstream, the headers are taken from the confirmed data
+uint8_t *vau_parser_request(struct vau_parser *p, uint32_t numbytes);
+uint32_t vau_parser_confirm(struct vau_parser *p, uint32_t numbytes);
+
+// ID_PICTURE_START_CODE, ID_SEQ_START_CODE and ID_GOP_START_CODE, other IDs are ignored
+void     vau_parser_auxinfo(struct vau_parser *p, uint32_t info_ID, void *info_ptr);
+
+// VIDEO_AU_CODE, a sequence or GOP header starts a new access unit. The writer has to
+// write the finished one before, if it returns 1.
+int32_t  vau_parser_unit_done(struct vau_parser *p, const struct v_au_struct *pau);
+void     vau_parser_add_au(struct vau_parser *p, const struct v_au_struct *pau);
+
+// duration of the finished access unit in 27 MHz clocks, also added to the stream duration
+int64_t  vau_parser_finish_unit(struct vau_parser *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VAU_PARSER_H */
@@ -0,0 +1,216 @@
+/* ----------------------------------------------------------------------------
+ * File: xml_writer.c
+ *
+ * Desc: buffered text output for the XML index writers
+ *
+ * Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "xml_writer.h"
+
+static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const char digit_pairs[] =
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+static const char spaces[] = "                                ";
+
+
+int32_t xml_writer_init(struct xml_writer *w, bufstream_tt *bs)
+{
+  int32_t i;
+
+  w->bs = bs;
+  w->idx = 0;
+  w->size = XML_WRITER_BUFFER;
+  w->bfr = (uint8_t*)malloc(w->size);
+  if(!w->bfr)
+    return BS_ERROR;
+
+  for(i = 0; i < 4096; i++)
+  {
+    w->b64_pairs[i][0] = b64[i >> 6];
+    w->b64_pairs[i][1] = b64[i & 0x3F];
+  }
+
+  return BS_OK;
+}
+
+
+void xml_writer_flush(struct xml_writer *w)
+{
+  if(w->idx)
+  {
+    w->bs->copybytes(w->bs, w->bfr, w->idx);
+    w->idx = 0;
+  }
+}
+
+
+void xml_writer_free(struct xml_writer *w)
+{
+  if(w->bfr)
+    free(w->bfr);
+  w->bfr = NULL;
+  w->idx = 0;
+  w->size = 0;
+}
+
+
+void xml_writer_write(struct xml_writer *w, const char *str, uint32_t len)
+{
+  if(w->idx + len > w->size)
+  {
+    xml_writer_flush(w);
+    if(len > w->size)
+    {
+      w->bs->copybytes(w->bs, (uint8_t*)str, len);
+      return;
+    }
+  }
+
+  memcpy(w->bfr + w->idx, str, len);
+  w->idx += len;
+}
+
+
+void xml_writer_indent(struct xml_writer *w, int32_t indent)
+{
+  while(indent > 0)
+  {
+    int32_t n = indent < (int32_t)sizeof(spaces) - 1 ? indent : (int32_t)sizeof(spaces) - 1;
+
+    xml_writer_write(w, spaces, n);
+    indent -= n;
+  }
+}
+
+
+// two digits per step from the end, same output as "%lld"
+void xml_writer_int64(struct xml_writer *w, int64_t value)
+{
+  char str[24];
+  char *pos = str + sizeof(str);
+  uint64_t data = value < 0 ? (uint64_t)0 - (uint64_t)value : (uint64_t)value;
+
+  while(data >= 100)
+  {
+    uint32_t i = (uint32_t)(data % 100) * 2;
+
+    data /= 100;
+    pos -= 2;
+    pos[0] = digit_pairs[i];
+    pos[1] = digit_pairs[i + 1];
+  }
+
+  if(data >= 10)
+  {
+    pos -= 2;
+    pos[0] = digit_pairs[data * 2];
+    pos[1] = digit_pairs[data * 2 + 1];
+  }
+  else
+  {
+    *--pos = '0' + (char)data;
+  }
+
+  if(value < 0)
+    *--pos = '-';
+
+  xml_writer_write(w, pos, (uint32_t)(str + sizeof(str) - pos));
+}
+
+
+// 3 bytes are 2 lookups of 12 bits each, the encoded text goes straight into the buffer
+void xml_writer_base64(struct xml_writer *w, const uint8_t *ptr, uint32_t len)
+{
+  while(len >= 3)
+  {
+    uint32_t room = (w->size - w->idx) / 4;
+    uint32_t blocks = len / 3;
+    uint8_t *out;
+
+    if(!room)
+    {
+      xml_writer_flush(w);
+      room = w->size / 4;
+    }
+    if(blocks > room)
+      blocks = room;
+
+    out = w->bfr + w->idx;
+    w->idx += blocks * 4;
+    len -= blocks * 3;
+
+    while(blocks--)
+    {
+      uint32_t v = ((uint32_t)ptr[0] << 16) | ((uint32_t)ptr[1] << 8) | ptr[2];
+
+      memcpy(out, w->b64_pairs[v >> 12], 2);
+      memcpy(out + 2, w->b64_pairs[v & 0xFFF], 2);
+      ptr += 3;
+      out += 4;
+    }
+  }
+
+  if(len)
+  {
+    char out[4];
+
+    out[0] = b64[ptr[0] >> 2];
+    if(len == 1)
+    {
+      out[1] = b64[(ptr[0] & 0x03) << 4];
+      out[2] = '=';
+    }
+    else
+    {
+      out[1] = b64[((ptr[0] & 0x03) << 4) | (ptr[1] >> 4)];
+      out[2] = b64[(ptr[1] & 0x0F) << 2];
+    }
+    out[3] = '=';
+    xml_writer_write(w, out, 4);
+  }
+}
+
+
+void xml_writer_hex(struct xml_writer *w, const uint8_t *ptr, uint32_t len)
+{
+  static const char hexChars[] = "0123456789ABCDEF";
+
+  while(len)
+  {
+    uint32_t n = (w->size - w->idx) / 2;
+    uint8_t *out;
+
+    if(!n)
+    {
+      xml_writer_flush(w);
+      n = w->size / 2;
+    }
+    if(n > len)
+      n = len;
+
+    out = w->bfr + w->idx;
+    w->idx += n * 2;
+    len -= n;
+
+    while(n--)
+    {
+      *out++ = hexChars[*ptr >> 4];
+      *out++ = hexChars[*ptr & 0x0F];
+      ptr++;
+    }
+  }
+}
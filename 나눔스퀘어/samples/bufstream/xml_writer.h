@@ -0,0 +1,55 @@
+/* ----------------------------------------------------------------------------
+ * File: xml_writer.h
+ *
+ * Desc: buffered text output for the XML index writers
+ *
+ * Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef XML_WRITER_H
+#define XML_WRITER_H
+
+#include "bufstrm.h"
+
+// output is collected and passed to the bufstream in blocks of this size
+#define XML_WRITER_BUFFER (64 * 1024)
+
+// formats straight into one large buffer, numbers and base64 without sprintf
+// and temporary strings. The buffer is passed on when it is full and in xml_writer_flush().
+struct xml_writer
+{
+  bufstream_tt *bs;
+  uint8_t      *bfr;
+  uint32_t      idx;
+  uint32_t      size;
+  char          b64_pairs[4096][2];  // two base64 characters for every 12 bits
+};
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int32_t xml_writer_init(struct xml_writer *w, bufstream_tt *bs);
+void    xml_writer_flush(struct xml_writer *w);
+void    xml_writer_free(struct xml_writer *w);
+
+void    xml_writer_write(struct xml_writer *w, const char *str, uint32_t len);
+void    xml_writer_int64(struct xml_writer *w, int64_t value);
+void    xml_writer_base64(struct xml_writer *w, const uint8_t *ptr, uint32_t len);
+void    xml_writer_hex(struct xml_writer *w, const uint8_t *ptr, uint32_t len);
+void    xml_writer_indent(struct xml_writer *w, int32_t indent);
+
+// string literals only
+#define xml_writer_str(w, s) xml_writer_write((w), (s), (uint32_t)(sizeof(s) - 1))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XML_WRITER_H */
@@ -0,0 +1,266 @@
+/********************************************************************
+ file name:  growing_file_watch.cpp
+ purpose:    Waiting for a growing file to grow
+
+ Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+*********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#include "growing_file_watch.h"
+
+struct growing_file_watch
+{
+#if defined(_WIN32) || defined(_WIN64)
+    char *path;
+#else
+    int fd;
+#endif
+    int inotify;            // -1 if the size is polled
+    int64_t size;           // size returned by the last growing_file_wait
+    bool closed;            // IN_CLOSE_WRITE seen and no IN_MODIFY since
+
+    int64_t modified_us;    // modification time of the last growth, 0 once consumed
+    int64_t latency_sum_us;
+    int64_t latency_max_us;
+    uint32_t latency_count;
+};
+
+static int64_t monotonic_ms()
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return (int64_t)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+// wall clock, the modification time of the file is given in it
+static int64_t realtime_us()
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return (int64_t)time(NULL) * 1000000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static void sleep_ms(int32_t ms)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+static int32_t file_status(growing_file_watch_t *watch, int64_t *size, int64_t *modified_us)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    struct _stat64 st;
+    if (_stat64(watch->path, &st))
+        return 1;
+    *modified_us = (int64_t)st.st_mtime * 1000000;
+#else
+    struct stat st;
+    if (fstat(watch->fd, &st))
+        return 1;
+#if defined(__APPLE__)
+    *modified_us = (int64_t)st.st_mtimespec.tv_sec * 1000000 + st.st_mtimespec.tv_nsec / 1000;
+#else
+    *modified_us = (int64_t)st.st_mtim.tv_sec * 1000000 + st.st_mtim.tv_nsec / 1000;
+#endif
+#endif
+    *size = (int64_t)st.st_size;
+    return 0;
+}
+
+// sleep until the file changes, false if the events can not be read
+static bool wait_events(growing_file_watch_t *watch, int32_t timeout_ms)
+{
+#if defined(__linux__)
+    struct pollfd pfd;
+    pfd.fd = watch->inotify;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret <= 0)
+        return ret == 0;
+
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(watch->inotify, buffer, sizeof(buffer))) > 0)
+    {
+        // the events are handled in order, a write after IN_CLOSE_WRITE reopens the file
+        for (char *ptr = buffer; ptr < buffer + len; ptr += sizeof(struct inotify_event) + ((struct inotify_event*)ptr)->len)
+        {
+            const struct inotify_event *event = (const struct inotify_event*)ptr;
+            if (event->mask & IN_MODIFY)
+                watch->closed = false;
+            if (event->mask & IN_CLOSE_WRITE)
+                watch->closed = true;
+        }
+    }
+    return true;
+#else
+    if (watch){};  // remove compile warning
+    sleep_ms(timeout_ms);
+    return true;
+#endif
+}
+
+growing_file_watch_t *growing_file_watch_open(const char *path)
+{
+    growing_file_watch_t *watch = (growing_file_watch_t*)malloc(sizeof(growing_file_watch_t));
+    if (!watch)
+        return NULL;
+
+    memset(watch, 0, sizeof(growing_file_watch_t));
+    watch->inotify = -1;
+
+#if defined(_WIN32) || defined(_WIN64)
+    watch->path = _strdup(path);
+    if (!watch->path)
+    {
+        free(watch);
+        return NULL;
+    }
+#else
+    watch->fd = open(path, O_RDONLY);
+    if (watch->fd < 0)
+    {
+        free(watch);
+        return NULL;
+    }
+#endif
+
+    int64_t modified_us;
+    if (file_status(watch, &watch->size, &modified_us))
+    {
+        growing_file_watch_close(watch);
+        return NULL;
+    }
+
+#if defined(__linux__)
+    watch->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->inotify >= 0 && inotify_add_watch(watch->inotify, path, IN_MODIFY | IN_CLOSE_WRITE) < 0)
+    {
+        close(watch->inotify);
+        watch->inotify = -1;
+    }
+
+    if (watch->inotify < 0)
+        printf("  inotify is not available, polling the file size every %d ms\n", GROWING_FILE_POLL_MS);
+#endif
+
+    return watch;
+}
+
+int32_t growing_file_wait(growing_file_watch_t *watch, int32_t timeout_ms, int64_t *size)
+{
+    const int64_t deadline = monotonic_ms() + timeout_ms;
+
+    while (true)
+    {
+        int64_t current, modified_us;
+
+        // check first, the file may have grown before the call
+        if (file_status(watch, &current, &modified_us))
+            return GROWING_FILE_ERROR;
+
+        if (size)
+            *size = current;
+
+        if (current > watch->size)
+        {
+            watch->size = current;
+            watch->modified_us = modified_us;
+            return GROWING_FILE_GREW;
+        }
+
+        if (watch->closed)
+            return GROWING_FILE_CLOSED;
+
+        const int64_t remaining = deadline - monotonic_ms();
+        if (remaining <= 0)
+            return GROWING_FILE_TIMEOUT;
+
+        if (watch->inotify >= 0)
+        {
+            if (!wait_events(watch, (int32_t)remaining))
+                return GROWING_FILE_ERROR;
+        }
+        else
+        {
+            sleep_ms(remaining < GROWING_FILE_POLL_MS ? (int32_t)remaining : GROWING_FILE_POLL_MS);
+        }
+    }
+}
+
+void growing_file_consumed(growing_file_watch_t *watch)
+{
+    if (!watch->modified_us)
+        return;
+
+    int64_t latency_us = realtime_us() - watch->modified_us;
+    if (latency_us < 0)
+        latency_us = 0;
+
+    watch->latency_sum_us += latency_us;
+    if (latency_us > watch->latency_max_us)
+        watch->latency_max_us = latency_us;
+    watch->latency_count++;
+    watch->modified_us = 0;
+}
+
+void growing_file_watch_report(growing_file_watch_t *watch)
+{
+    if (!watch->latency_count)
+        return;
+
+    printf("  Append to demux latency over %u updates (%s): average %.2f ms, max %.2f ms\n", watch->latency_count,
+           watch->inotify >= 0 ? "inotify" : "polling",
+           (double)watch->latency_sum_us / watch->latency_count / 1000.0, (double)watch->latency_max_us / 1000.0);
+}
+
+void growing_file_watch_close(growing_file_watch_t *watch)
+{
+    if (!watch)
+        return;
+
+#if defined(_WIN32) || defined(_WIN64)
+    free(watch->path);
+#else
+    if (watch->inotify >= 0)
+        close(watch->inotify);
+    close(watch->fd);
+#endif
+
+    free(watch);
+}
@@ -0,0 +1,81 @@
+/********************************************************************
+ @file: growing_file_watch.h
+ @brief Waiting for a growing file to grow
+
+ @verbatim
+ Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+ @verbatim
+*********************************************************************/
+
+#ifndef GROWING_FILE_WATCH_H_INCLUDED
+#define GROWING_FILE_WATCH_H_INCLUDED
+
+#include "mctypes.h"
+
+/**
+ * @name growing_file_wait results
+ * @{
+ **/
+#define GROWING_FILE_ERROR      -1  /**<@brief The file can not be checked any more */
+#define GROWING_FILE_GREW        0  /**<@brief The file is larger than at the last call */
+#define GROWING_FILE_CLOSED      1  /**<@brief The writer closed the file and it did not grow since */
+#define GROWING_FILE_TIMEOUT     2  /**<@brief The file did not grow within the timeout */
+/**@}*/
+
+/**
+ * @brief Interval of the size checks if inotify is not available
+ */
+#define GROWING_FILE_POLL_MS    20
+
+typedef struct growing_file_watch growing_file_watch_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Starts watching a file. On Linux the watcher sleeps on inotify
+ *        (IN_MODIFY, IN_CLOSE_WRITE), elsewhere or if inotify fails the size is polled.
+ * @param[in] path                 - Path of the file, it must exist
+ * @return     Watcher instance or NULL if the file can not be opened
+ */
+growing_file_watch_t *growing_file_watch_open(const char *path);
+
+/**
+ * @brief Blocks until the file is larger than at the last call, the writer closed it
+ *        or the timeout elapsed. Returns at once if the file already grew.
+ * @param[in] watch                - Watcher instance
+ * @param[in] timeout_ms           - Maximum time to wait in milliseconds
+ * @param[out] size                - Current size of the file, may be NULL
+ * @return     One of the GROWING_FILE_* results
+ */
+int32_t growing_file_wait(growing_file_watch_t *watch, int32_t timeout_ms, int64_t *size);
+
+/**
+ * @brief Call once the demuxer delivered data after a GROWING_FILE_GREW, measures
+ *        the time from the modification of the file until then
+ * @param[in] watch                - Watcher instance
+ */
+void growing_file_consumed(growing_file_watch_t *watch);
+
+/**
+ * @brief Prints the append to demux latency measured by growing_file_consumed
+ * @param[in] watch                - Watcher instance
+ */
+void growing_file_watch_report(growing_file_watch_t *watch);
+
+/**
+ * @brief Stops watching and frees the watcher
+ * @param[in] watch                - Watcher instance
+ */
+void growing_file_watch_close(growing_file_watch_t *watch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //GROWING_FILE_WATCH_H_INCLUDED
@@ -16,21 +16,175 @@
  **/
 
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <functional>
 #include <stdexcept>
-#if !defined(_WIN32)
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #include "ext_io_api.h"
 
-void ExtIOAPIFeeder::closeFile(long id)
+namespace {
+
+// read-only mapping of a whole file
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& file_name)
+    {
+#if defined(_WIN32)
+        m_file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER size = {};
+        if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size) || size.QuadPart <= 0) {
+            return;
+        }
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_mapping) {
+            return;
+        }
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        m_size = m_data ? size.QuadPart : 0;
+#else
+        const int fd = open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat stat_data = {};
+        if (!fstat(fd, &stat_data) && stat_data.st_size > 0) {
+            void* data = mmap(nullptr, static_cast<size_t>(stat_data.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                madvise(data, static_cast<size_t>(stat_data.st_size), MADV_SEQUENTIAL);
+                m_data = static_cast<const uint8_t*>(data);
+                m_size = stat_data.st_size;
+            }
+        }
+        close(fd);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#if defined(_WIN32)
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping) {
+            CloseHandle(m_mapping);
+        }
+        if (m_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_file);
+        }
+#else
+        if (m_data) {
+            munmap(const_cast<uint8_t*>(m_data), static_cast<size_t>(m_size));
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return m_data; }
+    int64_t size() const { return m_size; }
+
+private:
+    const uint8_t* m_data{nullptr};
+    int64_t m_size{0};
+#if defined(_WIN32)
+    HANDLE m_file{INVALID_HANDLE_VALUE};
+    HANDLE m_mapping{nullptr};
+#endif
+};
+
+// the derived index is cached next to the input file, the header identifies the input file version
+struct index_cache_header_t
+{
+    char magic[8];
+    uint32_t entry_size;
+    int32_t stream_type;
+    int64_t file_size;
+    int64_t file_time;
+    int64_t total_frames;
+};
+
+const char index_cache_magic[8] = {'M', 'C', 'X', 'I', 'D', 'X', '0', '1'};
+
+#if defined(_WIN32)
+bool openNative(const char* filename, void*& handle)
+{
+    handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return handle != INVALID_HANDLE_VALUE;
+}
+
+bool openNative(const wchar_t* filename, void*& handle)
 {
-    if (m_files[id].is_open()) {
-        m_files[id].close();
+    handle = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return handle != INVALID_HANDLE_VALUE;
+}
+
+void closeNative(void* handle)
+{
+    CloseHandle(handle);
+}
+
+// positional read, the handle has no seek state shared between the streams
+int32_t readNative(void* handle, uint8_t* buffer, int32_t size, int64_t position)
+{
+    int32_t done = 0;
+    while (done < size) {
+        OVERLAPPED overlapped = {};
+        const uint64_t pos = static_cast<uint64_t>(position) + done;
+        overlapped.Offset = static_cast<DWORD>(pos);
+        overlapped.OffsetHigh = static_cast<DWORD>(pos >> 32);
+        DWORD count = 0;
+        if (!ReadFile(handle, buffer + done, static_cast<DWORD>(size - done), &count, &overlapped) || !count) {
+            break;
+        }
+        done += static_cast<int32_t>(count);
     }
+    return done;
+}
+#else
+bool openNative(const char* filename, int& handle)
+{
+    handle = open(filename, O_RDONLY);
+    return handle >= 0;
 }
 
+void closeNative(int handle)
+{
+    close(handle);
+}
+
+// positional read, the descriptor has no seek state shared between the streams
+int32_t readNative(int handle, uint8_t* buffer, int32_t size, int64_t position)
+{
+    int32_t done = 0;
+    while (done < size) {
+        const ssize_t count = pread(handle, buffer + done, static_cast<size_t>(size - done), static_cast<off_t>(position + done));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        done += static_cast<int32_t>(count);
+    }
+    return done;
+}
+#endif
+
+} // namespace
+
 ExtIOAPIFeeder::ExtIOAPIFeeder(const callbacks_t& callbacks, const std::string& file_name)
   : m_callbacks(callbacks)
   , m_file_name(file_name)
@@ -57,6 +211,30 @@ int32_t ExtIOAPIFeeder::externalFrameGetFrameInfo(void* data, int64_t storage_fr
 
 int32_t ExtIOAPIFeeder::makeIndex()
 {
+#if defined(_WIN32)
+    struct _stati64 stat_data = {};
+    _stati64(m_file_name.c_str(), &stat_data);
+#else
+    struct stat stat_data = {};
+    stat(m_file_name.c_str(), &stat_data);
+#endif
+
+    if (stat_data.st_size <= 0) {
+        m_callbacks.err_printf(m_callbacks.context, "Unable to get the size of the input file\n");
+        return 1;
+    }
+
+    m_file_size = stat_data.st_size;
+    const int64_t file_time = static_cast<int64_t>(stat_data.st_mtime);
+
+    m_index_file_name = m_file_name + ".idx";
+    const std::string cache_file_name = m_file_name + ".idx.cache";
+
+    // an index derived before for the same input file is loaded without parsing it again
+    if (loadIndexCache(cache_file_name, file_time)) {
+        return 0;
+    }
+
     std::unique_ptr<mpegInInfo, decltype(&mpegInFree)> pInfo{mpegInCreate(&m_callbacks, nullptr), mpegInFree};
     if (!pInfo) {
         m_callbacks.err_printf(m_callbacks.context, "Unable to create an mfimport instance\n");
@@ -84,121 +262,121 @@ int32_t ExtIOAPIFeeder::makeIndex()
     m_stream_type = pInfo->video_streams[0].stream_type;
     m_total_frames = pInfo->totalFrames;
 
-    m_index_file_name = m_file_name + ".idx";
-
     if (mpegInSaveIdx(pInfo.get(), nullptr, const_cast<char*>(m_index_file_name.c_str()))) {
         m_callbacks.err_printf(m_callbacks.context, "Unable to save index file\n");
         return 1;
     }
 
-#if defined(_WIN32)
-    struct _stati64 stat_data = {};
-    _stati64(m_file_name.c_str(), &stat_data);
-#else
-    struct stat stat_data = {};
-    stat(m_file_name.c_str(), &stat_data);
-#endif
-
-    if (stat_data.st_size <= 0) {
-        m_callbacks.err_printf(m_callbacks.context, "Unable to get the size of the input file\n");
-        return 1;
-    }
+    {
+        MappedFile idx_file(m_index_file_name);
+        if (!idx_file.data()) {
+            m_callbacks.err_printf(m_callbacks.context, "Unable to open index file\n");
+            return 1;
+        }
 
-    m_file_size = stat_data.st_size;
+        if (idx_file.size() < static_cast<int64_t>(sizeof(video_stream_info) + m_total_frames * sizeof(video_au_info))) {
+            m_callbacks.err_printf(m_callbacks.context, "Unable to read index entry from index file\n");
+            return 1;
+        }
 
-    std::ifstream idx_file;
-    idx_file.open(m_index_file_name, std::ofstream::binary);
-    if (!idx_file.is_open() || !idx_file.good()) {
-        m_callbacks.err_printf(m_callbacks.context, "Unable to open index file\n");
-        return 1;
+        if (convertIndex(idx_file.data() + sizeof(video_stream_info))) {
+            return 1;
+        }
     }
 
-    if (!idx_file.seekg(sizeof(video_stream_info))) {
-        m_callbacks.err_printf(m_callbacks.context, "Unable to seek to start of index in index file\n");
-        return 1;
-    }
+    saveIndexCache(cache_file_name, file_time);
+    return 0;
+}
+
+// converts the video_au_info entries of an index file into m_index
+int32_t ExtIOAPIFeeder::convertIndex(const uint8_t* entries)
+{
+    /*
+    StorageFrame: 0 PresentationFrame: 2 TemporalOffset: 1 Flags: 0xc0 (I)
+    KeyFrame Offset: 0 StorageFrame: 1 PresentationFrame: 0 TemporalOffset: 1
+    Flags: 0x33 (B) KeyFrame Offset: 1 StorageFrame: 2 PresentationFrame: 1
+    TemporalOffset: -2 Flags: 0x33 (B) KeyFrame Offset: 2 StorageFrame: 3
+    PresentationFrame: 5 TemporalOffset: 1 Flags: 0x22 (P) KeyFrame Offset: 3
+
+    The main idea is that the array of entries represents the STORAGE frames-the
+    Nth entry represents the Nth storage frame. But using the temporal offset
+    field, the Nth entry of the same array tells you which storage frame is used
+    for the Nth presentation frame.  That is, the storage frame used for the Nth
+    presentation frame is N + TemporalOffset[N].
+
+    In the example above:
+    Which storage frame is used for presentation 0?  0 + temporal offset 1 = 1,
+    which is a B frame. Which storage frame is used for presentation 1?  1 +
+    temporal offset 1 = 2, which is a B frame. Which storage frame is used for
+    presentation 2?  2 + temporal offset -2 = 0, which is an I frame. Which
+    storage frame is used for presentation 3?  3 + temporal offset 1 = 4, which
+    is going to be a B frame in the next entry (not shown).
+
+    Notice that presentation for this stream starts with two B frames that have
+    flag bit 5 set, meaning they contain forward predictions from a previous
+    frame that is not in the stream, so these first two frames cannot be
+    decoded.  Often the first two B frames will be marked 0x10; bit 5 is clear,
+    and bit 4 is set meaning that the frames contain only backward predictions
+    from a future frame, namely the I frame at the start of the stream, so these
+    frames can be decoded.  Also note that the keyframe offsets are positive
+    numbers (that's of course not a big deal if you want negative values).
+
+    So finding a storage frame is easy: it's just entry N; and finding the
+    storage frame for a presentation frame is easy: it's just N +
+    TemporalOffset[N].  But answering the question "When is the Nth storage
+    frame presented?" is a bit more complicated. The table goes immediately from
+    presentation to storage using the temporal offset, but given a storage frame
+    there's no direct way to determine which presentation frame it is.  What we
+    do to find the presentation frame for the Nth storage frame is iterate from
+    say N-6  to N+60 and see which entry + temporal offset is N.  So for
+    example, what is the presentation frame for storage frame 0?  Check entry 0
+    -> that's 0 +1 =1.  The storage frame referenced is 1, not 0 so not the one
+    we're looking for.  Check entry 1 -> that's 1 +1 =2.  The storage frame
+    referenced is 2, not 0 so not the one we're looking for.  Check entry 2 ->
+    that's 2 - 2 =0.  The storage frame referenced is 0 which is the one we're
+    looking for.  So the presentation time for storage frame 0 is 2.
+    */
 
     m_index.resize(m_total_frames);
 
+    // mfimport writes the entries in coding order, then the derived fields are computed in the same
+    // pass, otherwise the table is sorted and derived afterwards
+    bool sorted = true;
+    int64_t last_ref_idx = -1;
+
     for (int64_t idx = 0; idx < m_total_frames; ++idx) {
-        video_au_info au{};
-        if (!idx_file.read(reinterpret_cast<char*>(&au), sizeof(au))) {
-            m_callbacks.err_printf(m_callbacks.context, "Unable to read index entry from index file\n");
-            m_index.clear();
-            return 1;
-        }
-        /*
-        StorageFrame: 0 PresentationFrame: 2 TemporalOffset: 1 Flags: 0xc0 (I)
-        KeyFrame Offset: 0 StorageFrame: 1 PresentationFrame: 0 TemporalOffset: 1
-        Flags: 0x33 (B) KeyFrame Offset: 1 StorageFrame: 2 PresentationFrame: 1
-        TemporalOffset: -2 Flags: 0x33 (B) KeyFrame Offset: 2 StorageFrame: 3
-        PresentationFrame: 5 TemporalOffset: 1 Flags: 0x22 (P) KeyFrame Offset: 3
-
-        The main idea is that the array of entries represents the STORAGE frames-the
-        Nth entry represents the Nth storage frame. But using the temporal offset
-        field, the Nth entry of the same array tells you which storage frame is used
-        for the Nth presentation frame.  That is, the storage frame used for the Nth
-        presentation frame is N + TemporalOffset[N].
-
-        In the example above:
-        Which storage frame is used for presentation 0?  0 + temporal offset 1 = 1,
-        which is a B frame. Which storage frame is used for presentation 1?  1 +
-        temporal offset 1 = 2, which is a B frame. Which storage frame is used for
-        presentation 2?  2 + temporal offset -2 = 0, which is an I frame. Which
-        storage frame is used for presentation 3?  3 + temporal offset 1 = 4, which
-        is going to be a B frame in the next entry (not shown).
-
-        Notice that presentation for this stream starts with two B frames that have
-        flag bit 5 set, meaning they contain forward predictions from a previous
-        frame that is not in the stream, so these first two frames cannot be
-        decoded.  Often the first two B frames will be marked 0x10; bit 5 is clear,
-        and bit 4 is set meaning that the frames contain only backward predictions
-        from a future frame, namely the I frame at the start of the stream, so these
-        frames can be decoded.  Also note that the keyframe offsets are positive
-        numbers (that's of course not a big deal if you want negative values).
-
-        So finding a storage frame is easy: it's just entry N; and finding the
-        storage frame for a presentation frame is easy: it's just N +
-        TemporalOffset[N].  But answering the question "When is the Nth storage
-        frame presented?" is a bit more complicated. The table goes immediately from
-        presentation to storage using the temporal offset, but given a storage frame
-        there's no direct way to determine which presentation frame it is.  What we
-        do to find the presentation frame for the Nth storage frame is iterate from
-        say N-6  to N+60 and see which entry + temporal offset is N.  So for
-        example, what is the presentation frame for storage frame 0?  Check entry 0
-        -> that's 0 +1 =1.  The storage frame referenced is 1, not 0 so not the one
-        we're looking for.  Check entry 1 -> that's 1 +1 =2.  The storage frame
-        referenced is 2, not 0 so not the one we're looking for.  Check entry 2 ->
-        that's 2 - 2 =0.  The storage frame referenced is 0 which is the one we're
-        looking for.  So the presentation time for storage frame 0 is 2.
-        */
-
-        m_index[idx].file_pos = au.filePos;
-        m_index[idx].frame_type = au.frame_type;
-        m_index[idx].coding_order = au.coding_order;
-        m_index[idx].display_order = au.display_order;
-
-        // flags field
-        // Bit 7: Random Access
-        // Bit 6: Sequence Header
-        // Bit 5: Forward prediction flag
-        // Bit 4: Backward prediction flag
-        // 00: I frame (no prediction)
-        // 10: P frame (forward prediction from previous frame)
-        // 01: B frame (backward prediction from future frame)
-        // 11: B frame (forward and backward prediction)
-        // Bits 0-3: reserved for use in SMPTE Essence
-        // mapping specifications.
+        // the entries in the mapping are not aligned
+        video_au_info au;
+        memcpy(&au, entries + idx * sizeof(video_au_info), sizeof(au));
+
+        index_entry_t& entry = m_index[idx];
+        entry.file_pos = au.filePos;
+        entry.frame_type = au.frame_type;
+        entry.coding_order = au.coding_order;
+        entry.display_order = au.display_order;
+        entry.temporal_offset = static_cast<int8_t>(au.display_order - au.coding_order);
+
+    // flags field
+    // Bit 7: Random Access
+    // Bit 6: Sequence Header
+    // Bit 5: Forward prediction flag
+    // Bit 4: Backward prediction flag
+    // 00: I frame (no prediction)
+    // 10: P frame (forward prediction from previous frame)
+    // 01: B frame (backward prediction from future frame)
+    // 11: B frame (forward and backward prediction)
+    // Bits 0-3: reserved for use in SMPTE Essence
+    // mapping specifications.
 
         switch (au.frame_type) {
             case I_TYPE:
-                m_index[idx].flags = 0x80; // Random Access = 1
+                entry.flags = 0x80; // Random Access = 1
                 break;
             case P_TYPE:
-                m_index[idx].flags = 0x20;
+                entry.flags = 0x20;
                 break;
             case B_TYPE:
-                m_index[idx].flags = 0x30;
+                entry.flags = 0x30;
                 break;
             default:
                 m_callbacks.err_printf(m_callbacks.context, "Invalid frame type %d in index\n", au.frame_type);
@@ -206,13 +384,36 @@ int32_t ExtIOAPIFeeder::makeIndex()
                 return 1;
         }
 
-        m_index[idx].temporal_offset = static_cast<int8_t>(au.display_order - au.coding_order);
-        m_index[idx].key_frame_offset = 0;
+        if (idx > 0) {
+            index_entry_t& prev = m_index[idx - 1];
+            sorted = sorted && prev.coding_order <= entry.coding_order;
+            prev.frame_size = static_cast<int32_t>(entry.file_pos - prev.file_pos);
+        }
+
+        // compute key_frame_offset value
+        if (entry.frame_type == I_TYPE) {
+            entry.key_frame_offset = 0;
+            last_ref_idx = idx;
+        }
+        else {
+            entry.key_frame_offset = last_ref_idx >= 0 ? static_cast<int8_t>(last_ref_idx - idx) : 0;
+        }
     }
 
-    auto less_index_entry = [&](const index_entry_t& a, const index_entry_t& b) { return a.coding_order < b.coding_order; };
-    std::sort(m_index.begin(), m_index.end(), less_index_entry);
+    if (!sorted) {
+        auto less_index_entry = [&](const index_entry_t& a, const index_entry_t& b) { return a.coding_order < b.coding_order; };
+        std::sort(m_index.begin(), m_index.end(), less_index_entry);
+        deriveIndex();
+    }
+    else if (m_total_frames > 0) {
+        m_index[m_total_frames - 1].frame_size = static_cast<int32_t>(m_file_size - m_index[m_total_frames - 1].file_pos);
+    }
+    return 0;
+}
 
+// computes key_frame_offset and frame_size of an index sorted in coding order
+void ExtIOAPIFeeder::deriveIndex()
+{
     int64_t last_ref_idx = -1;
     // compute frame_size values
     for (int64_t idx = 0; idx < m_total_frames; idx++) {
@@ -237,15 +438,70 @@ int32_t ExtIOAPIFeeder::makeIndex()
             m_index[idx].frame_size = static_cast<int32_t>(m_index[idx + 1].file_pos - m_index[idx].file_pos);
         }
     }
-    return 0;
 }
 
-std::shared_ptr<ExtIOAPIFeeder> ExtIOAPIFeeder::createFeeder(
-    const callbacks_t& callbacks, mpegInInfo* mfi, const std::string& filename, ExternalIoAPIMode ext_io_api_mode)
+bool ExtIOAPIFeeder::loadIndexCache(const std::string& cache_file_name, int64_t file_time)
+{
+    std::ifstream cache_file;
+    cache_file.open(cache_file_name, std::ifstream::binary);
+    if (!cache_file.is_open() || !cache_file.good()) {
+        return false;
+    }
+
+    index_cache_header_t header{};
+    if (!cache_file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+
+    // the cache belongs to this version of the input file
+    if (memcmp(header.magic, index_cache_magic, sizeof(header.magic)) || header.entry_size != sizeof(index_entry_t) ||
+        header.file_size != m_file_size || header.file_time != file_time || header.total_frames <= 0) {
+        return false;
+    }
+
+    m_index.resize(header.total_frames);
+    if (!cache_file.read(reinterpret_cast<char*>(m_index.data()), header.total_frames * sizeof(index_entry_t))) {
+        m_index.clear();
+        return false;
+    }
+
+    m_total_frames = header.total_frames;
+    m_stream_type = static_cast<mcmediatypes>(header.stream_type);
+    return true;
+}
+
+void ExtIOAPIFeeder::saveIndexCache(const std::string& cache_file_name, int64_t file_time)
+{
+    index_cache_header_t header{};
+    memcpy(header.magic, index_cache_magic, sizeof(header.magic));
+    header.entry_size = sizeof(index_entry_t);
+    header.stream_type = static_cast<int32_t>(m_stream_type);
+    header.file_size = m_file_size;
+    header.file_time = file_time;
+    header.total_frames = m_total_frames;
+
+    std::ofstream cache_file;
+    cache_file.open(cache_file_name, std::ofstream::binary | std::ofstream::trunc);
+    if (!cache_file.is_open() ||
+        !cache_file.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+        !cache_file.write(reinterpret_cast<const char*>(m_index.data()), m_total_frames * sizeof(index_entry_t))) {
+        // not fatal, the index is derived again next time
+        cache_file.close();
+        std::remove(cache_file_name.c_str());
+        m_callbacks.err_printf(m_callbacks.context, "Unable to write index cache file\n");
+    }
+}
+
+std::shared_ptr<ExtIOAPIFeeder> ExtIOAPIFeeder::createFeeder(const callbacks_t& callbacks,
+                                                             mpegInInfo* mfi,
+                                                             const std::string& filename,
+                                                             ExternalIoAPIMode ext_io_api_mode,
+                                                             int64_t frame_cache_size,
+                                                             int32_t prefetch_frames)
 {
     std::shared_ptr<ExtIOAPIFeeder> feeder;
     if (ext_io_api_mode == NewExtIoAPI) {
-        feeder = std::make_shared<NewExtIOAPIFeeder>(callbacks, const_cast<char*>(filename.c_str()));
+        feeder = std::make_shared<NewExtIOAPIFeeder>(callbacks, const_cast<char*>(filename.c_str()), frame_cache_size, prefetch_frames);
         mfi->appData = feeder.get();
         mfi->use_external_frame_io = 1;
         mfi->extFrameOpen = &(NewExtIOAPIFeeder::externalFrameOpen);
@@ -272,6 +528,7 @@ std::shared_ptr<ExtIOAPIFeeder> ExtIOAPIFeeder::createFeeder(
         }
 
         auto old_feeder = std::dynamic_pointer_cast<OldExtIOAPIFeeder>(feeder);
+        old_feeder->makeSeekTable();
         mfi->file_length = old_feeder->m_scale;
         mfi->external_io_stream_duration = old_feeder->m_total_frames;
     }
@@ -283,8 +540,12 @@ std::shared_ptr<ExtIOAPIFeeder> ExtIOAPIFeeder::createFeeder(
     return feeder;
 }
 
-NewExtIOAPIFeeder::NewExtIOAPIFeeder(const callbacks_t& callbacks, const std::string& file_name)
+NewExtIOAPIFeeder::NewExtIOAPIFeeder(const callbacks_t& callbacks,
+                                     const std::string& file_name,
+                                     int64_t frame_cache_size,
+                                     int32_t prefetch_frames)
   : ExtIOAPIFeeder(callbacks, file_name)
+  , m_frame_cache(frame_cache_size, prefetch_frames)
 {
     m_file_name = file_name;
     openFile(const_cast<char*>(file_name.c_str()));
@@ -294,7 +555,7 @@ long NewExtIOAPIFeeder::openFile(const char* filename)
 {
 
     m_file_name = filename;
-    if (ExtIOAPIFeeder::openFile(m_file_name.c_str(), m_id)) {
+    if (!m_frame_cache.open(m_file_name)) {
         return -1;
     }
     return 0;
@@ -307,6 +568,8 @@ int32_t NewExtIOAPIFeeder::externalFrameOpen(void* data, externalFrameStreamInfo
         return 1;
     }
 
+    instance->m_frame_cache.setIndex(instance->m_index.data(), instance->m_total_frames);
+
     stream_info->frameCount = instance->m_total_frames;
     stream_info->streamType = instance->m_stream_type;
 
@@ -316,7 +579,19 @@ int32_t NewExtIOAPIFeeder::externalFrameOpen(void* data, externalFrameStreamInfo
 void NewExtIOAPIFeeder::externalFrameClose(void* data)
 {
     auto instance = reinterpret_cast<NewExtIOAPIFeeder*>(data);
+    instance->m_frame_cache.setIndex(nullptr, 0);
     instance->m_index.clear();
+
+    if (instance->m_callbacks.inf_printf) {
+        const FrameCache::Statistics stats = instance->m_frame_cache.statistics();
+        instance->m_callbacks.inf_printf(instance->m_callbacks.context,
+                                         "Frame cache: %lld hits, %lld waits for prefetch, %lld reads, %lld prefetched, %lld evicted\n",
+                                         static_cast<long long>(stats.hits),
+                                         static_cast<long long>(stats.waits),
+                                         static_cast<long long>(stats.misses),
+                                         static_cast<long long>(stats.prefetched),
+                                         static_cast<long long>(stats.evicted));
+    }
 }
 
 uint8_t* NewExtIOAPIFeeder::externalFrameRead(void* data, int64_t storage_frame, int32_t& frame_size)
@@ -326,60 +601,129 @@ uint8_t* NewExtIOAPIFeeder::externalFrameRead(void* data, int64_t storage_frame,
         return nullptr;
     }
 
-    index_entry_t& pIdxEntry = instance->m_index[storage_frame];
-    instance->m_frame_buffer.resize(pIdxEntry.frame_size);
-    instance->m_files[m_id].seekg(pIdxEntry.file_pos);
-    if (instance->m_files[m_id].tellg() != pIdxEntry.file_pos) {
-        instance->m_callbacks.err_printf(instance->m_callbacks.context, "Unable to seek to frame %lld in input file\n", storage_frame);
-        return nullptr;
-    }
-
-    instance->m_files[m_id].read(reinterpret_cast<char*>(instance->m_frame_buffer.data()), pIdxEntry.frame_size);
-    if (instance->m_files[m_id].gcount() != pIdxEntry.frame_size) {
+    // the frame stays in the cache until the next call, mfimport uses it in place
+    uint8_t* frame = instance->m_frame_cache.read(storage_frame, frame_size);
+    if (!frame) {
         instance->m_callbacks.err_printf(instance->m_callbacks.context, "Unable to read frame %lld from input file\n", storage_frame);
         return nullptr;
     }
-
-    frame_size = pIdxEntry.frame_size;
-    return instance->m_frame_buffer.data();
+    return frame;
 }
 
 OldExtIOAPIFeeder::OldExtIOAPIFeeder(const callbacks_t& callbacks, const std::string& file_name, int64_t scale)
   : ExtIOAPIFeeder(callbacks, file_name)
   , m_scale{scale}
+  , m_slots{new FileSlot[max_file_count]}
+{
+}
+
+OldExtIOAPIFeeder::~OldExtIOAPIFeeder()
 {
+    for (auto& file : m_shared_files) {
+        closeNative(file.handle);
+    }
 }
 
-long OldExtIOAPIFeeder::getNextId()
+void OldExtIOAPIFeeder::makeSeekTable()
 {
-    auto found = std::find_if(m_files.begin() + 1, m_files.end(), [](std::ifstream& file) { return !file.is_open(); });
-    return found == m_files.end() ? -1 : static_cast<long>(std::distance(m_files.begin(), found));
+    m_frame_pos.resize(m_index.size());
+    for (size_t idx = 0; idx < m_index.size(); idx++) {
+        m_frame_pos[idx] = m_index[idx].file_pos;
+    }
+    m_frame_scale = m_total_frames > 0 ? std::max<int64_t>(m_scale / m_total_frames, 1) : 1;
+}
+
+template <typename T>
+OldExtIOAPIFeeder::SharedFile* OldExtIOAPIFeeder::acquireFile(const T* filename)
+{
+    // the name is compared as bytes, the first one tells char and wchar_t names apart
+    const std::basic_string<T> name(filename);
+    std::string key(1, static_cast<char>(sizeof(T)));
+    key.append(reinterpret_cast<const char*>(name.data()), name.size() * sizeof(T));
+
+    std::lock_guard<std::mutex> lock(m_mtx_files);
+    for (auto& file : m_shared_files) {
+        if (file.key == key) {
+            file.refs++;
+            return &file;
+        }
+    }
+
+    native_file_t handle;
+    if (!openNative(filename, handle)) {
+        return nullptr;
+    }
+    m_shared_files.push_back(SharedFile{key, handle, 1});
+    return &m_shared_files.back();
+}
+
+template OldExtIOAPIFeeder::SharedFile* OldExtIOAPIFeeder::acquireFile<char>(const char*);
+#if defined(_WIN32)
+template OldExtIOAPIFeeder::SharedFile* OldExtIOAPIFeeder::acquireFile<wchar_t>(const wchar_t*);
+#endif
+
+void OldExtIOAPIFeeder::releaseFile(SharedFile* file)
+{
+    std::lock_guard<std::mutex> lock(m_mtx_files);
+    if (--file->refs) {
+        return;
+    }
+    closeNative(file->handle);
+    m_shared_files.remove_if([file](const SharedFile& item) { return &item == file; });
+}
+
+long OldExtIOAPIFeeder::allocateId(SharedFile* file)
+{
+    // id 0 is not used, the search starts behind the last id handed out, usually the first slot is free
+    const uint32_t start = m_next_id.fetch_add(1, std::memory_order_relaxed);
+    for (long i = 0; i < max_file_count - 1; i++) {
+        const long id = 1 + static_cast<long>((start + i) % (max_file_count - 1));
+        FileSlot& slot = m_slots[id];
+        bool expected = false;
+        if (!slot.in_use.load(std::memory_order_relaxed) &&
+            slot.in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            slot.file = file;
+            slot.position = 0;
+            return id;
+        }
+    }
+    return -1;
+}
+
+OldExtIOAPIFeeder::FileSlot* OldExtIOAPIFeeder::getSlot(long id)
+{
+    if (id < 1 || id >= max_file_count || !m_slots[id].in_use.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return &m_slots[id];
 }
 
 int32_t OldExtIOAPIFeeder::externalIoSeek(void* app_data, long id, int64_t position)
 {
     auto instance = reinterpret_cast<OldExtIOAPIFeeder*>(app_data);
-    int64_t frame_idx = position / (instance->m_scale / instance->m_total_frames);
-
-    instance->m_files[id].seekg(instance->m_index[frame_idx].file_pos);
-    if (instance->m_files[id].tellg() != instance->m_index[frame_idx].file_pos) {
+    FileSlot* slot = instance->getSlot(id);
+    if (!slot || position < 0) {
         return 1;
     }
+
+    // positions behind the last frame read nothing
+    const int64_t frame_idx = position / instance->m_frame_scale;
+    slot->position = frame_idx < static_cast<int64_t>(instance->m_frame_pos.size()) ? instance->m_frame_pos[frame_idx] : instance->m_file_size;
     return 0;
 }
 
 int32_t OldExtIOAPIFeeder::externalIoRead(void* app_data, long id, uint8_t* buffer, int32_t buffer_size)
 {
     auto instance = reinterpret_cast<OldExtIOAPIFeeder*>(app_data);
-    instance->m_files[id].read(reinterpret_cast<char*>(buffer), buffer_size);
-
-    // Read less than requested
-    if (instance->m_files[id].fail() && instance->m_files[id].eof()) {
-        auto reset_fail_state = instance->m_files[id].rdstate() & (~std::ifstream::failbit);
-        instance->m_files[id].clear(reset_fail_state);
+    FileSlot* slot = instance->getSlot(id);
+    if (!slot || buffer_size <= 0) {
+        return 0;
     }
 
-    return static_cast<int32_t>(instance->m_files[id].gcount());
+    // Read less than requested at the end of the file
+    const int32_t count = readNative(slot->file->handle, buffer, buffer_size, slot->position);
+    slot->position += count;
+    return count;
 }
 
 void OldExtIOAPIFeeder::externalIoClose(void* app_data, long id)
@@ -390,6 +734,11 @@ void OldExtIOAPIFeeder::externalIoClose(void* app_data, long id)
 
 void OldExtIOAPIFeeder::closeFile(long id)
 {
-    std::lock_guard<std::mutex> lock(m_mtx_files);
-    ExtIOAPIFeeder::closeFile(id);
+    FileSlot* slot = getSlot(id);
+    if (!slot) {
+        return;
+    }
+    releaseFile(slot->file);
+    slot->file = nullptr;
+    slot->in_use.store(false, std::memory_order_release);
 }
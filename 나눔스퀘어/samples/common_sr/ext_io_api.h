@@ -22,12 +22,14 @@
 #include <vector>
 #include <memory>
 #include <string>
-#include <fstream>
 #include <mutex>
-#include <array>
+#include <atomic>
+#include <list>
 
 #include <mfimport.h>
 
+#include "frame_cache.h"
+
 // local index structure
 struct index_entry_t
 {
@@ -57,8 +59,13 @@ public:
 
     static int32_t externalFrameGetFrameInfo(void* data, int64_t storage_frame, externalFrameInfo* frame_info);
     int32_t makeIndex();
-    static std::shared_ptr<ExtIOAPIFeeder> createFeeder(
-        const callbacks_t& callbacks, mpegInInfo* mfi, const std::string& filename, ExternalIoAPIMode ext_io_api_mode);
+    // frame_cache_size and prefetch_frames configure the frame cache of the new external IO API
+    static std::shared_ptr<ExtIOAPIFeeder> createFeeder(const callbacks_t& callbacks,
+                                                        mpegInInfo* mfi,
+                                                        const std::string& filename,
+                                                        ExternalIoAPIMode ext_io_api_mode,
+                                                        int64_t frame_cache_size = FrameCache::DEFAULT_BUDGET,
+                                                        int32_t prefetch_frames = FrameCache::DEFAULT_PREFETCH_FRAMES);
 
     int64_t m_total_frames{0};
     std::vector<index_entry_t> m_index;
@@ -70,24 +77,14 @@ protected:
     ExtIOAPIFeeder(const callbacks_t& callbacks, const std::string& file_name);
     virtual ~ExtIOAPIFeeder() = default;
 
-    template <typename T>
-    long openFile(const T* filename, long id)
-    {
-        m_files[id].open(filename, std::ifstream::binary);
-        if (!m_files[id].is_open() || !m_files[id].good()) {
-            return -1;
-        }
-        return 0;
-    };
-
-    virtual void closeFile(long file_id);
+    int32_t convertIndex(const uint8_t* entries);
+    void deriveIndex();
+    // the derived index is kept in <file name>.idx.cache, reopening the file only reads it back
+    bool loadIndexCache(const std::string& cache_file_name, int64_t file_time);
+    void saveIndexCache(const std::string& cache_file_name, int64_t file_time);
 
     std::string m_file_name;
     callbacks_t m_callbacks;
-
-    // Some STL container having a dynamic size should have been used instead of "std::array".
-    // But this is not possible due to incomplete C++11 support in GCC 4.8 which we still support.
-    std::array<std::ifstream, 1024> m_files;
 };
 
 class NewExtIOAPIFeeder : public ExtIOAPIFeeder
@@ -95,7 +92,10 @@ class NewExtIOAPIFeeder : public ExtIOAPIFeeder
 public:
     NewExtIOAPIFeeder() = delete;
 
-    NewExtIOAPIFeeder(const callbacks_t& callbacks, const std::string& file_name);
+    NewExtIOAPIFeeder(const callbacks_t& callbacks,
+                      const std::string& file_name,
+                      int64_t frame_cache_size = FrameCache::DEFAULT_BUDGET,
+                      int32_t prefetch_frames = FrameCache::DEFAULT_PREFETCH_FRAMES);
     ~NewExtIOAPIFeeder() override = default;
 
     static int32_t externalFrameOpen(void* data, externalFrameStreamInfo* stream_info);
@@ -103,10 +103,10 @@ public:
     static void externalFrameClose(void* data);
 
 private:
-    static constexpr long m_id = 0;
     long openFile(const char* filename);
 
-    std::vector<uint8_t> m_frame_buffer;
+    // frames are read with positional reads, cached and prefetched in coding order
+    FrameCache m_frame_cache;
 };
 
 class OldExtIOAPIFeeder : public ExtIOAPIFeeder
@@ -115,7 +115,7 @@ public:
     OldExtIOAPIFeeder() = delete;
 
     OldExtIOAPIFeeder(const callbacks_t& callbacks, const std::string& file_name, int64_t scale = DEFAULT_SCALE);
-    ~OldExtIOAPIFeeder() override = default;
+    ~OldExtIOAPIFeeder() override;
 
     template <typename T>
     static long externalIoOpen(void* app_data, T* filename)
@@ -130,25 +130,65 @@ public:
     const int64_t m_scale;
     static constexpr int64_t DEFAULT_SCALE{0x3fffffffffffffff};
 
+    // prepares the seek lookup, called once the index is made
+    void makeSeekTable();
+
 private:
+#if defined(_WIN32)
+    typedef void* native_file_t;
+#else
+    typedef int native_file_t;
+#endif
+
+    // every stream opened on the same file shares one handle, reads are positional
+    struct SharedFile
+    {
+        std::string key;
+        native_file_t handle;
+        int32_t refs;
+    };
+
+    // the position is only used by the stream owning the id
+    struct FileSlot
+    {
+        std::atomic<bool> in_use{false};
+        SharedFile* file{nullptr};
+        int64_t position{0};
+    };
+
     static constexpr long max_file_count{1024};
-    std::mutex m_mtx_files;
-    long getNextId();
-    void closeFile(long id) override;
 
     template <typename T>
     long openFile(const T* filename)
     {
-        std::lock_guard<std::mutex> lock(m_mtx_files);
-        long id = getNextId();
-        if (id == -1) {
+        SharedFile* file = acquireFile(filename);
+        if (!file) {
             return -1;
         }
-        if (ExtIOAPIFeeder::openFile(filename, id)) {
-            return -1;
+        long id = allocateId(file);
+        if (id == -1) {
+            releaseFile(file);
         }
         return id;
     }
+
+    template <typename T>
+    SharedFile* acquireFile(const T* filename);
+    void releaseFile(SharedFile* file);
+    long allocateId(SharedFile* file);
+    FileSlot* getSlot(long id);
+    void closeFile(long id);
+
+    // taken to open and close files only, seeking and reading do not lock
+    std::mutex m_mtx_files;
+    std::list<SharedFile> m_shared_files;
+
+    std::unique_ptr<FileSlot[]> m_slots;
+    std::atomic<uint32_t> m_next_id{0};
+
+    // file position of every storage frame and the position units per frame
+    std::vector<int64_t> m_frame_pos;
+    int64_t m_frame_scale{1};
 };
 
 #endif
@@ -0,0 +1,312 @@
+/**
+ @file  frame_cache.cpp
+ @brief Cached and prefetching frame reader for the external frame IO API
+
+ @verbatim
+ File: frame_cache.cpp
+
+ Desc: Cached and prefetching frame reader for the external frame IO API
+
+ Copyright (c) 2020 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+ @endverbatim
+ **/
+
+#include <algorithm>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "ext_io_api.h"
+#include "frame_cache.h"
+
+// keep a few buffers of evicted frames, frames of a stream have similar sizes
+static constexpr size_t max_spare_buffers{8};
+
+FrameCache::FrameCache(int64_t budget, int32_t prefetch_frames)
+  : m_budget{budget}
+  , m_prefetch_frames{prefetch_frames}
+{
+}
+
+FrameCache::~FrameCache()
+{
+    close();
+}
+
+bool FrameCache::open(const std::string& file_name)
+{
+    close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    m_file = file;
+#else
+    m_file = ::open(file_name.c_str(), O_RDONLY);
+    if (m_file < 0) {
+        return false;
+    }
+#endif
+
+    m_stop = false;
+    if (m_prefetch_frames > 0) {
+        m_worker = std::thread(&FrameCache::prefetchThread, this);
+    }
+    return true;
+}
+
+void FrameCache::close()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        clear(lock);
+        m_index = nullptr;
+        m_frame_count = 0;
+        m_stop = true;
+        m_cv_prefetch.notify_one();
+    }
+
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+
+#if defined(_WIN32)
+    if (m_file) {
+        CloseHandle(m_file);
+        m_file = nullptr;
+    }
+#else
+    if (m_file >= 0) {
+        ::close(m_file);
+        m_file = -1;
+    }
+#endif
+}
+
+void FrameCache::setIndex(const index_entry_t* index, int64_t frame_count)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    clear(lock);
+    m_index = index;
+    m_frame_count = index ? frame_count : 0;
+}
+
+FrameCache::Statistics FrameCache::statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+// drops all frames, waits for the reads in progress
+void FrameCache::clear(std::unique_lock<std::mutex>& lock)
+{
+    m_prefetch_next = m_prefetch_end = 0;
+    m_cv_loaded.wait(lock, [this] { return m_loading == 0; });
+
+    m_lru.clear();
+    m_entries.clear();
+    m_spare.clear();
+    m_cached_bytes = 0;
+    m_pinned = -1;
+    m_last_read = -1;
+}
+
+bool FrameCache::readFrame(std::vector<uint8_t>& data, int64_t file_pos)
+{
+    size_t done = 0;
+    while (done < data.size()) {
+#if defined(_WIN32)
+        OVERLAPPED overlapped = {};
+        const uint64_t pos = static_cast<uint64_t>(file_pos) + done;
+        overlapped.Offset = static_cast<DWORD>(pos);
+        overlapped.OffsetHigh = static_cast<DWORD>(pos >> 32);
+        DWORD count = 0;
+        if (!ReadFile(m_file, data.data() + done, static_cast<DWORD>(data.size() - done), &count, &overlapped) || !count) {
+            return false;
+        }
+#else
+        ssize_t count = ::pread(m_file, data.data() + done, data.size() - done, static_cast<off_t>(file_pos + done));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+#endif
+        done += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+FrameCache::EntryList::iterator FrameCache::insertEntry(int64_t frame)
+{
+    const int32_t size = m_index[frame].frame_size;
+
+    Entry entry{frame, {}, false, false};
+    if (!m_spare.empty()) {
+        entry.data.swap(m_spare.back());
+        m_spare.pop_back();
+    }
+    entry.data.resize(size);
+
+    m_lru.push_front(std::move(entry));
+    m_entries[frame] = m_lru.begin();
+    m_cached_bytes += size;
+    m_loading++;
+    return m_lru.begin();
+}
+
+void FrameCache::removeEntry(EntryList::iterator it)
+{
+    m_cached_bytes -= static_cast<int64_t>(it->data.size());
+    if (m_spare.size() < max_spare_buffers) {
+        m_spare.push_back(std::vector<uint8_t>());
+        m_spare.back().swap(it->data);
+    }
+    m_entries.erase(it->frame);
+    m_lru.erase(it);
+}
+
+// makes room for needed bytes, the pinned frame and frames being read are kept, the worker also keeps
+// the frames it prefetched for the current position. Returns false if the budget cannot be kept.
+bool FrameCache::evict(int64_t needed, bool keep_prefetched)
+{
+    auto it = m_lru.end();
+    while (m_cached_bytes + needed > m_budget && it != m_lru.begin()) {
+        --it;
+        if (!it->ready || it->frame == m_pinned) {
+            continue;
+        }
+        if (keep_prefetched && it->frame > m_pinned && it->frame < m_prefetch_end) {
+            continue;
+        }
+
+        auto victim = it++;
+        removeEntry(victim);
+        m_stats.evicted++;
+    }
+    return m_cached_bytes + needed <= m_budget;
+}
+
+uint8_t* FrameCache::read(int64_t storage_frame, int32_t& frame_size)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_index || storage_frame < 0 || storage_frame >= m_frame_count) {
+        return nullptr;
+    }
+
+    // the frame returned by the previous call is released, the requested one must not be evicted
+    m_pinned = storage_frame;
+
+    EntryList::iterator it;
+    auto found = m_entries.find(storage_frame);
+    if (found != m_entries.end()) {
+        it = found->second;
+        if (it->ready) {
+            m_stats.hits++;
+        }
+        else {
+            m_stats.waits++;
+            m_cv_loaded.wait(lock, [it] { return it->ready; });
+        }
+
+        if (it->failed) {
+            // the worker could not read it, try again below
+            removeEntry(it);
+            found = m_entries.end();
+        }
+    }
+
+    if (found == m_entries.end()) {
+        m_stats.misses++;
+        evict(m_index[storage_frame].frame_size, false);
+        it = insertEntry(storage_frame);
+        const int64_t file_pos = m_index[storage_frame].file_pos;
+
+        lock.unlock();
+        const bool ok = readFrame(it->data, file_pos);
+        lock.lock();
+
+        it->ready = true;
+        m_loading--;
+        m_cv_loaded.notify_all();
+
+        if (!ok) {
+            removeEntry(it);
+            m_pinned = -1;
+            return nullptr;
+        }
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it);
+
+    // read ahead in coding order once the frames are read sequentially, at most half of the budget,
+    // a single jump (random access, first frame of a GOP after a seek) does not start it
+    if (storage_frame == m_last_read + 1) {
+        int64_t end = storage_frame + 1;
+        int64_t bytes = 0;
+        while (end < m_frame_count && end <= storage_frame + m_prefetch_frames) {
+            bytes += m_index[end].frame_size;
+            if (bytes > m_budget / 2) {
+                break;
+            }
+            end++;
+        }
+        m_prefetch_next = storage_frame + 1;
+        m_prefetch_end = end;
+        m_cv_prefetch.notify_one();
+    }
+    else {
+        m_prefetch_next = m_prefetch_end = 0;
+    }
+    m_last_read = storage_frame;
+
+    frame_size = static_cast<int32_t>(it->data.size());
+    return it->data.data();
+}
+
+void FrameCache::prefetchThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv_prefetch.wait(lock, [this] { return m_stop || m_prefetch_next < m_prefetch_end; });
+        if (m_stop) {
+            break;
+        }
+
+        const int64_t frame = m_prefetch_next++;
+        if (m_entries.count(frame)) {
+            continue;
+        }
+
+        if (!evict(m_index[frame].frame_size, true)) {
+            // the cache is full of frames still to be used
+            m_prefetch_next = m_prefetch_end;
+            continue;
+        }
+
+        auto it = insertEntry(frame);
+        const int64_t file_pos = m_index[frame].file_pos;
+
+        lock.unlock();
+        const bool ok = readFrame(it->data, file_pos);
+        lock.lock();
+
+        // a failed frame is read again and reported by the reader
+        it->ready = true;
+        it->failed = !ok;
+        m_loading--;
+        m_stats.prefetched++;
+        m_cv_loaded.notify_all();
+    }
+}
@@ -0,0 +1,121 @@
+/**
+ @file  frame_cache.h
+ @brief Cached and prefetching frame reader for the external frame IO API
+
+ @verbatim
+ File: frame_cache.h
+
+ Desc: Cached and prefetching frame reader for the external frame IO API
+
+ Copyright (c) 2020 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+ @endverbatim
+ **/
+
+#ifndef UUID_3E0C5A71_9D4B_4F2E_A8C6_51B7E2D940F3
+#define UUID_3E0C5A71_9D4B_4F2E_A8C6_51B7E2D940F3
+
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+struct index_entry_t;
+
+// Reads storage frames with positional reads on a raw file handle and keeps the recently used
+// ones in an LRU cache, so GOP re-reads while seeking do not touch the file again. While frames
+// are read sequentially a worker thread reads the following frames in coding order into the cache.
+//
+// The returned pointer stays valid until the next read call, the frame is pinned in the cache
+// until then, mfimport works on it directly without another copy.
+class FrameCache
+{
+public:
+    static constexpr int64_t DEFAULT_BUDGET{64 * 1024 * 1024};
+    static constexpr int32_t DEFAULT_PREFETCH_FRAMES{16};
+
+    struct Statistics
+    {
+        int64_t hits{0};       // frame was cached
+        int64_t waits{0};      // frame was being prefetched, the reader waited for it
+        int64_t misses{0};     // frame was read by the reader itself
+        int64_t prefetched{0}; // frames read by the worker
+        int64_t evicted{0};
+    };
+
+    // budget is the memory used for cached frames in bytes, prefetch_frames is the maximum
+    // number of frames read ahead, 0 disables the worker
+    explicit FrameCache(int64_t budget = DEFAULT_BUDGET, int32_t prefetch_frames = DEFAULT_PREFETCH_FRAMES);
+    ~FrameCache();
+
+    FrameCache(const FrameCache&) = delete;
+    FrameCache& operator=(const FrameCache&) = delete;
+
+    bool open(const std::string& file_name);
+    void close();
+
+    // the index is sorted in coding order and must stay unchanged until it is reset with nullptr
+    void setIndex(const index_entry_t* index, int64_t frame_count);
+
+    // returns nullptr if the frame is not in the index or cannot be read
+    uint8_t* read(int64_t storage_frame, int32_t& frame_size);
+
+    Statistics statistics() const;
+
+private:
+    struct Entry
+    {
+        int64_t frame;
+        std::vector<uint8_t> data;
+        bool ready;
+        bool failed;
+    };
+    typedef std::list<Entry> EntryList;
+
+    bool readFrame(std::vector<uint8_t>& data, int64_t file_pos);
+    EntryList::iterator insertEntry(int64_t frame);
+    void removeEntry(EntryList::iterator it);
+    bool evict(int64_t needed, bool keep_prefetched);
+    void clear(std::unique_lock<std::mutex>& lock);
+    void prefetchThread();
+
+    int64_t m_budget;
+    int32_t m_prefetch_frames;
+
+#if defined(_WIN32)
+    void* m_file{nullptr};
+#else
+    int m_file{-1};
+#endif
+
+    const index_entry_t* m_index{nullptr};
+    int64_t m_frame_count{0};
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv_prefetch; // wakes the worker
+    std::condition_variable m_cv_loaded;   // a frame was read
+
+    EntryList m_lru; // most recently used first
+    std::unordered_map<int64_t, EntryList::iterator> m_entries;
+    std::vector<std::vector<uint8_t>> m_spare; // buffers of evicted frames, reused for new ones
+    int64_t m_cached_bytes{0};
+    int32_t m_loading{0};
+    int64_t m_pinned{-1};
+    int64_t m_last_read{-1};
+
+    int64_t m_prefetch_next{0};
+    int64_t m_prefetch_end{0};
+    bool m_stop{false};
+    std::thread m_worker;
+
+    Statistics m_stats;
+};
+
+#endif
@@ -0,0 +1,164 @@
+/********************************************************************
+ File name: aac_batch_decode.cpp
+ Purpose: decoding of many AAC files on a pool of worker threads
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+#include "aac_batch_decode.h"
+
+static bool read_file_list(const char * list_file, std::vector<std::string> & files)
+{
+    FILE * fp = fopen(list_file, "r");
+    if (!fp)
+        return false;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), fp))
+    {
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' ' || line[len - 1] == '\t'))
+            line[--len] = 0;
+
+        if (len > 0 && line[0] != '#')
+            files.push_back(line);
+    }
+
+    fclose(fp);
+    return true;
+}
+
+// out_dir/<file name without extension>.wav, a number is appended if the name is taken
+static std::string output_name(const std::string & in_file, const char * out_dir, std::map<std::string, int32_t> & used)
+{
+    size_t pos = in_file.find_last_of("/\\");
+    std::string name = in_file.substr(pos == std::string::npos ? 0 : pos + 1);
+    pos = name.find_last_of('.');
+    if (pos != std::string::npos && pos > 0)
+        name.resize(pos);
+
+    int32_t count = used[name]++;
+    if (count > 0)
+        name += "_" + std::to_string(count);
+
+    std::string path(out_dir);
+    if (!path.empty() && path[path.size() - 1] != '/' && path[path.size() - 1] != '\\')
+        path += '/';
+    return path + name + ".wav";
+}
+
+static double audio_seconds(const aac_decode_stats_t & stats)
+{
+    return stats.sampling_rate > 0 ? (double)stats.samples / stats.sampling_rate : 0.0;
+}
+
+int32_t aac_batch_decode(const aac_decode_settings_t & settings, const char * list_file, const char * out_dir, int32_t num_threads)
+{
+    std::vector<std::string> files;
+    if (!read_file_list(list_file, files))
+    {
+        printf("Error opening the file list %s.\n", list_file);
+        return 1;
+    }
+    if (files.empty())
+    {
+        printf("The file list %s is empty.\n", list_file);
+        return 1;
+    }
+
+    std::vector<std::string> outputs(files.size());
+    std::map<std::string, int32_t> used;
+    for (size_t i = 0; i < files.size(); i++)
+        outputs[i] = output_name(files[i], out_dir, used);
+
+    if (num_threads <= 0)
+        num_threads = (std::max)((int32_t)std::thread::hardware_concurrency(), 1);
+    num_threads = (std::min)(num_threads, (int32_t)files.size());
+
+    printf("Decoding %u files on %d threads\n", (uint32_t)files.size(), num_threads);
+
+    std::vector<aac_decode_stats_t> results(files.size());
+    std::atomic<size_t> next(0);
+    std::atomic<uint32_t> done(0);
+    std::mutex print_mutex;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const double cpu_start = process_cpu_seconds();
+
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            const size_t i = next++;
+            if (i >= files.size())
+                break;
+
+            aac_decode_stats_t & stats = results[i];
+            aac_decode_file(settings, files[i].c_str(), outputs[i].c_str(), false, stats);
+
+            std::lock_guard<std::mutex> lock(print_mutex);
+            const uint32_t n = ++done;
+            if (stats.error)
+            {
+                printf("[%u/%u] %s: %s\n", n, (uint32_t)files.size(), files[i].c_str(), stats.error);
+            }
+            else
+            {
+                const double seconds = audio_seconds(stats);
+                printf("[%u/%u] %s: %lld frames, %.2f s audio, %.0f frames/s, %.1fx realtime, cpu %.3f s\n",
+                    n, (uint32_t)files.size(), files[i].c_str(), (long long)stats.frames, seconds,
+                    stats.wall_seconds > 0 ? stats.frames / stats.wall_seconds : 0.0,
+                    stats.wall_seconds > 0 ? seconds / stats.wall_seconds : 0.0, stats.cpu_seconds);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int32_t t = 0; t < num_threads; t++)
+        threads.push_back(std::thread(worker));
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double cpu = process_cpu_seconds() - cpu_start;
+
+    uint32_t failed = 0;
+    int64_t frames = 0;
+    double seconds = 0.0;
+    double decode_cpu = 0.0;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (results[i].error)
+        {
+            failed++;
+            continue;
+        }
+        frames += results[i].frames;
+        seconds += audio_seconds(results[i]);
+        decode_cpu += results[i].cpu_seconds;
+    }
+
+    printf("\nBatch: %u files, %u failed, %lld frames, %.2f s audio in %.2f s\n",
+        (uint32_t)files.size(), failed, (long long)frames, seconds, wall);
+    printf("       %.0f frames/s, %.1fx realtime, cpu %.2f s (decoding %.2f s), %.0f%% of %d threads\n",
+        wall > 0 ? frames / wall : 0.0, wall > 0 ? seconds / wall : 0.0, cpu, decode_cpu,
+        wall > 0 ? 100.0 * cpu / (wall * num_threads) : 0.0, num_threads);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,25 @@
+/********************************************************************
+ File name: aac_batch_decode.h
+ Purpose: decoding of many AAC files on a pool of worker threads
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#ifndef AAC_BATCH_DECODE_H_INCLUDED
+#define AAC_BATCH_DECODE_H_INCLUDED
+
+#include "aac_decode.h"
+
+// Decodes the files named in list_file, one path per line, empty lines and lines starting
+// with '#' are skipped. The workers take the next file from the list when they are done with
+// one, every file gets its own decoder instance. The PCM goes to out_dir/<name>.wav.
+// num_threads <= 0 uses one worker per CPU. Prints a line per file and the totals,
+// returns 0 if every file was decoded.
+int32_t aac_batch_decode(const aac_decode_settings_t & settings, const char * list_file, const char * out_dir, int32_t num_threads);
+
+#endif // AAC_BATCH_DECODE_H_INCLUDED
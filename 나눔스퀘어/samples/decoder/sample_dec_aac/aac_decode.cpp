@@ -0,0 +1,273 @@
+/********************************************************************
+ File name: aac_decode.cpp
+ Purpose: AAC decoder instance and file decode loop of the AAC decoder sample
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+#include "mcdefs.h"
+#include "sample_common_args.h"
+#include "sample_common_misc.h"
+#include "aac_decode.h"
+#include "pcm_output.h"
+
+static const int MAX_CHAN = 8;
+static const int OUTPUT_BUFF_SIZE = MAX_CHAN * 2048 * 3;
+
+// seconds between two progress lines
+static const double PROGRESS_INTERVAL = 0.25;
+
+AacDecoder::AacDecoder()
+    : _dec(NULL)
+    , _produced(0)
+    , _sample_bytes(2)
+{
+    _out.resize(OUTPUT_BUFF_SIZE);
+}
+
+AacDecoder::~AacDecoder()
+{
+    Close();
+}
+
+const char * AacDecoder::Open(const aac_decode_settings_t & settings, const uint8_t * head, int32_t head_size)
+{
+    Close();
+
+    init_callbacks(_callbacks);
+    _dec = createDecoderAAC(&_callbacks, 0, 0);
+    if (!_dec)
+        return "open_AACin_Audio_stream_ex() failed";
+
+    aac_decoder_config dec_config;
+    // fill config up with -1, this value is used to mark non-change parameters
+    memset(&dec_config, AAD_PARAM_DONT_CHANGE, sizeof(dec_config));
+
+    if (settings.num_channels != ITEM_NOT_INIT)
+        dec_config.num_channels = settings.num_channels;
+
+    if (settings.sample_rate != ITEM_NOT_INIT)
+        dec_config.sampling_rate = settings.sample_rate;
+
+    dec_config.bitstream_format = settings.bitstream_format;
+    // the other formats are converted from 24 bit
+    _sample_bytes = settings.pcm_format == PCM_FORMAT_S16 ? 2 : 3;
+    dec_config.output_format    = _sample_bytes == 2 ? AAD_DSF_16LE : AAD_DSF_24LE;
+    dec_config.decode_he        = 1;
+    if (settings.priming != ITEM_NOT_INIT)
+        dec_config.priming_dur = settings.priming;
+
+    if( settings.encoder_type == AAD_ENCODER_DEFAULT ||
+        settings.encoder_type == AAD_ENCODER_MC      ||
+        settings.encoder_type == AAD_ENCODER_FHG)
+    {
+        dec_config.encoder_type = settings.encoder_type;
+    }
+
+    if (settings.playback > 0)
+        dec_config.playback_dur = settings.playback;
+
+    if (settings.lp_sbr >= 0)
+        dec_config.disable_low_power_sbr = !settings.lp_sbr;
+
+    const char * error = NULL;
+    int ret = 0;
+    if (dec_config.bitstream_format != AAD_BSF_RAW)
+    {
+        _dec->auxinfo(_dec, 0, PARSE_AUD_HDR, NULL, 0);
+        ret = _dec->copybytes(_dec, const_cast<uint8_t*>(head), head_size);
+
+        if (ret == 0 && (settings.num_channels <= 0 || settings.sample_rate <= 0))
+            error = "Header is not found. The file can't be decoded.";
+        else if (ret < 0)
+            error = "Header parsing failed.";
+    }
+    else if (settings.num_channels <= 0 || settings.sample_rate <= 0)
+    {
+        error = "Sample rate (-s) and number of channels (-ch) shall be defined for the RAW AAC file.";
+    }
+
+    if (!error && _dec->auxinfo(_dec, 0, INIT_FRAME_PARSER, &dec_config, sizeof(dec_config)))
+        error = "Init failed";
+
+    if (error)
+        Close();
+    _produced = 0;
+    return error;
+}
+
+void AacDecoder::Close()
+{
+    if (_dec)
+        close_bufstream(_dec, 0);
+}
+
+int32_t AacDecoder::Decode(const uint8_t * data, int32_t size, const aac_frame_sink_t & sink)
+{
+    aud_bfr_tt dst_bfr;
+    int32_t bytes_decoded = 0;
+
+    // a call that returned PCM is repeated without new data until the decoder has nothing left
+    while (bytes_decoded < size || _produced > 0)
+    {
+        dst_bfr.bfr = &_out[0];
+        dst_bfr.bfr_size = OUTPUT_BUFF_SIZE;
+        _dec->auxinfo(_dec, 0, PARSE_FRAMES, &dst_bfr, sizeof(dst_bfr));
+
+        int frame_size = _dec->copybytes(_dec, const_cast<uint8_t*>(data) + bytes_decoded, size - bytes_decoded);
+        int state = _dec->auxinfo(_dec, 0, GET_PARSE_STATE, 0, 0);
+        bytes_decoded += frame_size;
+        _produced = dst_bfr.bfr_size;
+
+        if (dst_bfr.bfr_size > 0 && (state & PARSE_DONE_FLAG))
+        {
+            aac_decoded_frame_info * frame_info;
+            _dec->auxinfo(_dec, 0, GET_PIC_PARAMSP, &frame_info, sizeof(*frame_info));
+
+            int32_t ret = sink(*frame_info, dst_bfr.bfr, dst_bfr.bfr_size);
+            if (ret)
+                return ret;
+        }
+    }
+    return 0;
+}
+
+int32_t aac_decode_file(const aac_decode_settings_t & settings, const char * in_file, const char * out_file, bool print_progress, aac_decode_stats_t & stats)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const double cpu_start = thread_cpu_seconds();
+
+    memset(&stats, 0, sizeof(stats));
+
+    FILE * fp_in  = fopen(in_file, "rb");
+    if (!fp_in)
+    {
+        stats.error = "Error opening input file.";
+        return 1;
+    }
+
+    PcmOutput output;
+    stats.error = output.Open(out_file, settings.pcm_format, settings.planar);
+    if (stats.error)
+    {
+        fclose(fp_in);
+        return 1;
+    }
+
+    std::vector<uint8_t> in_buf(INPUT_BUFF_SIZE);
+    int bytes_read = (int)fread(&in_buf[0], 1, INPUT_BUFF_SIZE, fp_in);
+
+    AacDecoder decoder;
+    stats.error = decoder.Open(settings, &in_buf[0], bytes_read);
+    if (stats.error)
+    {
+        fclose(fp_in);
+        output.Close();
+        return 1;
+    }
+
+    const int32_t sample_bytes = decoder.SampleBytes();
+    aac_decoded_frame_info last_info;
+    std::chrono::steady_clock::time_point last_progress = start;
+
+    aac_frame_sink_t sink = [&](const aac_decoded_frame_info & frame_info, const uint8_t * pcm, int32_t size) -> int32_t
+    {
+        stats.frames++;
+        stats.sampling_rate = frame_info.sampling_rate;
+        stats.num_channels = frame_info.num_channels;
+        stats.samples += size / (sample_bytes * (std::max)(frame_info.num_channels, 1));
+        stats.pcm_bytes += size;
+        last_info = frame_info;
+
+        if (print_progress)
+        {
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (std::chrono::duration<double>(now - last_progress).count() >= PROGRESS_INTERVAL)
+            {
+                printf("\r[frame %05d] %dHz %dCh HE=%d", (int)stats.frames - 1, frame_info.sampling_rate, frame_info.num_channels, frame_info.he);
+                fflush(stdout);
+                last_progress = now;
+            }
+        }
+
+        stats.error = output.Write(pcm, size, sample_bytes, frame_info.sampling_rate, frame_info.num_channels);
+        return stats.error ? 1 : 0;
+    };
+
+    while (bytes_read > 0 && !stats.error)
+    {
+        decoder.Decode(&in_buf[0], bytes_read, sink);
+        bytes_read = (int)fread(&in_buf[0], 1, INPUT_BUFF_SIZE, fp_in);
+    }
+
+    decoder.Close();
+    fclose(fp_in);
+
+    const char * error = output.Close();
+    if (!stats.error)
+        stats.error = error;
+
+    if (print_progress && stats.frames > 0)
+        printf("\r[frame %05d] %dHz %dCh HE=%d\n", (int)stats.frames - 1, last_info.sampling_rate, last_info.num_channels, last_info.he);
+
+    stats.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.cpu_seconds = thread_cpu_seconds() - cpu_start;
+    return stats.error ? 1 : 0;
+}
+
+double thread_cpu_seconds()
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0.0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 1e-7;
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return 0.0;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+double process_cpu_seconds()
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0.0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 1e-7;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return 0.0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
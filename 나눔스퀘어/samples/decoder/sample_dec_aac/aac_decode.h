@@ -0,0 +1,92 @@
+/********************************************************************
+ File name: aac_decode.h
+ Purpose: AAC decoder instance and file decode loop of the AAC decoder sample
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#ifndef AAC_DECODE_H_INCLUDED
+#define AAC_DECODE_H_INCLUDED
+
+#include <stdio.h>
+#include <vector>
+#include <functional>
+
+#include "mctypes.h"
+#include "bufstrm.h"
+#include "mccallbacks.h"
+#include "dec_aac.h"
+#include "pcm_convert.h"
+
+#define INPUT_BUFF_SIZE         (2048*10)
+
+// decoder settings from the command line, ITEM_NOT_INIT or -1 keeps the decoder default
+typedef struct aac_decode_settings_s
+{
+    int32_t sample_rate;
+    int32_t num_channels;
+    int32_t bitstream_format;
+    int32_t priming;
+    int32_t encoder_type;
+    int64_t playback;
+    int32_t lp_sbr;
+    pcm_format_t pcm_format;    // output sample format, the decoder delivers 24 bit for all but 16 bit
+    bool planar;                // one file per channel
+} aac_decode_settings_t;
+
+typedef struct aac_decode_stats_s
+{
+    int64_t frames;
+    int64_t samples;            // per channel
+    int64_t pcm_bytes;
+    int32_t sampling_rate;
+    int32_t num_channels;
+    double  wall_seconds;
+    double  cpu_seconds;        // of the decoding thread
+    const char * error;         // NULL if the file was decoded
+} aac_decode_stats_t;
+
+// PCM of one decoded frame, a non-zero return stops decoding
+typedef std::function<int32_t(const aac_decoded_frame_info & info, const uint8_t * pcm, int32_t size)> aac_frame_sink_t;
+
+// One decoder instance. The PCM buffer belongs to the instance, the pointer passed to the sink is
+// valid until the sink returns.
+class AacDecoder
+{
+public:
+    AacDecoder();
+    virtual ~AacDecoder();
+
+    // creates and initializes the decoder, the header is searched in the first bytes of the stream
+    // (they are not consumed) unless the stream is raw. Returns 0 or an error message.
+    const char * Open(const aac_decode_settings_t & settings, const uint8_t * head, int32_t head_size);
+    void Close();
+
+    // decodes all of data, the decoder keeps incomplete frames for the next call.
+    // Returns 0, or the value of the sink if it stopped decoding.
+    int32_t Decode(const uint8_t * data, int32_t size, const aac_frame_sink_t & sink);
+
+    // bytes of a sample in the PCM passed to the sink, 2 or 3
+    int32_t SampleBytes() const { return _sample_bytes; }
+
+private:
+    callbacks_t _callbacks;
+    bufstream_tt * _dec;
+    std::vector<uint8_t> _out;
+    int32_t _produced;
+    int32_t _sample_bytes;
+};
+
+// decodes in_file to out_file, WAV if its extension is .wav, raw PCM otherwise,
+// with print_progress the frame count is updated a few times per second
+int32_t aac_decode_file(const aac_decode_settings_t & settings, const char * in_file, const char * out_file, bool print_progress, aac_decode_stats_t & stats);
+
+double thread_cpu_seconds();
+double process_cpu_seconds();
+
+#endif // AAC_DECODE_H_INCLUDED
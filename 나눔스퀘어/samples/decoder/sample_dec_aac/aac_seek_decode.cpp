@@ -0,0 +1,288 @@
+/********************************************************************
+ File name: aac_seek_decode.cpp
+ Purpose: sample accurate decoding of a range of an ADTS stream
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "sample_common_misc.h"
+#include "adts_index.h"
+#include "pcm_output.h"
+#include "aac_seek_decode.h"
+
+// file bytes read and fed to the decoder at a time
+#define SEEK_READ_SIZE          (1024*1024)
+
+// Feeds the bytes [from, to) of the file to a new decoder, which finds the stream header in the first of them.
+static const char * decode_bytes(const aac_decode_settings_t & settings, FILE * fp, uint64_t from, uint64_t to,
+    const aac_frame_sink_t & sink, uint64_t & bytes_read)
+{
+    if (!AdtsIndex::SeekTo(fp, from))
+        return "Error seeking in the input file.";
+
+    AacDecoder decoder;
+    std::vector<uint8_t> buf(SEEK_READ_SIZE);
+    bool opened = false;
+
+    while (from < to)
+    {
+        const size_t n = fread(&buf[0], 1, (size_t)(std::min)(to - from, (uint64_t)buf.size()), fp);
+        if (n == 0)
+            break;
+        from += n;
+        bytes_read += n;
+
+        if (!opened)
+        {
+            const char * error = decoder.Open(settings, &buf[0], (int32_t)(std::min)(n, (size_t)INPUT_BUFF_SIZE));
+            if (error)
+                return error;
+            opened = true;
+        }
+
+        if (decoder.Decode(&buf[0], (int32_t)n, sink))
+            break;
+    }
+
+    return opened ? NULL : "Error reading input file.";
+}
+
+// Output samples of a raw data block, twice ADTS_BLOCK_SAMPLES with SBR, found by decoding the first frame.
+static const char * probe_block_samples(const aac_decode_settings_t & settings, FILE * fp, const AdtsIndex & index, uint64_t stream_size,
+    int32_t sample_bytes, int64_t & block_samples, uint64_t & bytes_read)
+{
+    const uint64_t first_blocks = ((index.Size() > 1 ? index[1].sample : index.Samples()) - index[0].sample) / ADTS_BLOCK_SAMPLES;
+
+    block_samples = 0;
+    aac_frame_sink_t sink = [&](const aac_decoded_frame_info & info, const uint8_t *, int32_t size) -> int32_t
+    {
+        block_samples = size / (sample_bytes * (std::max)(info.num_channels, 1)) / (int64_t)first_blocks;
+        return 1;
+    };
+
+    // the decoder may need the header of the second frame to finish the first one
+    const uint64_t to = index.Size() > 2 ? index[2].offset : stream_size;
+    const char * error = decode_bytes(settings, fp, index[0].offset, to, sink, bytes_read);
+    if (!error && block_samples <= 0)
+        error = "The first frame could not be decoded.";
+    return error;
+}
+
+// receives the PCM of the range, at most one decoded frame at a time, returns 0 or an error message
+typedef std::function<const char *(const aac_decoded_frame_info & info, const uint8_t * pcm, int32_t size)> range_sink_t;
+
+// Decodes the bytes [from, to) starting at frame from_frame of the index and passes the samples [start, end) on.
+// The decoder delivers the samples of the frames fed to it in order, the ones outside the range are dropped.
+static const char * decode_range(const aac_decode_settings_t & settings, FILE * fp, const AdtsIndex & index, size_t from_frame, uint64_t to,
+    int64_t block_samples, int32_t sample_bytes, int64_t start, int64_t end, const range_sink_t & keep, int64_t & written, uint64_t & bytes_read)
+{
+    const char * error = NULL;
+    int64_t pos = (int64_t)(index[from_frame].sample / ADTS_BLOCK_SAMPLES) * block_samples;
+    written = 0;
+
+    aac_frame_sink_t sink = [&](const aac_decoded_frame_info & info, const uint8_t * pcm, int32_t size) -> int32_t
+    {
+        const int32_t frame_bytes = sample_bytes * (std::max)(info.num_channels, 1);
+        const int64_t n = size / frame_bytes;
+        const int64_t keep_from = (std::max)(pos, start);
+        const int64_t keep_to = (std::min)(pos + n, end);
+
+        if (keep_from < keep_to)
+        {
+            error = keep(info, pcm + (keep_from - pos) * frame_bytes, (int32_t)((keep_to - keep_from) * frame_bytes));
+            written += keep_to - keep_from;
+        }
+
+        pos += n;
+        return error || pos >= end ? 1 : 0;
+    };
+
+    const char * decode_error = decode_bytes(settings, fp, index[from_frame].offset, to, sink, bytes_read);
+    return error ? error : decode_error;
+}
+
+// the reference: one decoder from the start of the stream, the PCM of the range has to be the same
+static bool verify_range(const aac_decode_settings_t & settings, FILE * fp, const AdtsIndex & index, uint64_t stream_size,
+    int64_t block_samples, int32_t sample_bytes, int64_t start, int64_t end, const uint8_t digest[16], int64_t written)
+{
+    const std::chrono::steady_clock::time_point verify_start = std::chrono::steady_clock::now();
+
+    context_md5_t ctx;
+    MD5Init(&ctx);
+    range_sink_t keep = [&](const aac_decoded_frame_info &, const uint8_t * pcm, int32_t size) -> const char *
+    {
+        MD5Update(&ctx, pcm, size);
+        return NULL;
+    };
+
+    int64_t sequential_written = 0;
+    uint64_t bytes_read = 0;
+    const char * error = decode_range(settings, fp, index, 0, stream_size, block_samples, sample_bytes, start, end, keep, sequential_written, bytes_read);
+    if (error)
+    {
+        printf("Sequential decode: %s\n", error);
+        return false;
+    }
+
+    uint8_t sequential_digest[16];
+    MD5Final(sequential_digest, &ctx, 0);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - verify_start).count();
+    if (sequential_written != written || memcmp(sequential_digest, digest, sizeof(sequential_digest)))
+    {
+        printf("Bit-exact check failed, %lld samples sequential, %lld samples seeking, a longer -preroll may help\n",
+            (long long)sequential_written, (long long)written);
+        return false;
+    }
+    printf("Bit-exact check passed, the range matches the sequential decode, read %llu bytes in %.3f s\n",
+        (unsigned long long)bytes_read, seconds);
+    return true;
+}
+
+int32_t aac_seek_decode(const aac_decode_settings_t & settings, const char * in_file, const char * out_file,
+    const char * index_file, int64_t start, int64_t duration, int32_t preroll, bool verify)
+{
+    if (settings.bitstream_format != -1 && settings.bitstream_format != AAD_BSF_ADTS)
+    {
+        printf("Seeking needs an ADTS stream.\n");
+        return 1;
+    }
+    if (settings.playback > 0 || settings.priming > 0)
+    {
+        printf("The playback duration (-playback) and the priming cut (-priming) can not be used with -seek.\n");
+        return 1;
+    }
+
+    FILE * fp = fopen(in_file, "rb");
+    if (!fp)
+    {
+        printf("Error opening input file.\n");
+        return 1;
+    }
+
+    const std::chrono::steady_clock::time_point index_start = std::chrono::steady_clock::now();
+    const uint64_t stream_size = AdtsIndex::StreamSize(fp);
+    const int64_t stream_time = AdtsIndex::StreamTime(in_file);
+
+    AdtsIndex index;
+    if (index_file && index.Load(index_file, stream_size, stream_time))
+    {
+        printf("Loaded the index of %u frames from %s\n", (uint32_t)index.Size(), index_file);
+    }
+    else
+    {
+        if (!index.Build(fp) || index.Size() == 0)
+        {
+            printf("No ADTS frames found, seeking needs an ADTS stream.\n");
+            fclose(fp);
+            return 1;
+        }
+        printf("Indexed %u frames in %.2f ms\n", (uint32_t)index.Size(),
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - index_start).count());
+
+        if (index_file && !index.Save(index_file, stream_size, stream_time))
+            printf("Warning: failed to write the index file %s\n", index_file);
+    }
+
+    // positions count from the first sample of the stream, so the decoder must not cut priming samples
+    aac_decode_settings_t seek_settings = settings;
+    seek_settings.priming = 0;
+    seek_settings.encoder_type = -1;
+
+    const std::chrono::steady_clock::time_point decode_start = std::chrono::steady_clock::now();
+    const int32_t sample_bytes = settings.pcm_format == PCM_FORMAT_S16 ? 2 : 3;
+    uint64_t bytes_read = 0;
+
+    int64_t block_samples = 0;
+    const char * error = probe_block_samples(seek_settings, fp, index, stream_size, sample_bytes, block_samples, bytes_read);
+    if (error)
+    {
+        printf("%s\n", error);
+        fclose(fp);
+        return 1;
+    }
+
+    const int64_t total = (int64_t)(index.Samples() / ADTS_BLOCK_SAMPLES) * block_samples;
+    start = (std::max)(start, (int64_t)0);
+    if (start >= total)
+    {
+        printf("The start sample %lld is behind the end of the stream, %lld samples.\n", (long long)start, (long long)total);
+        fclose(fp);
+        return 1;
+    }
+    const int64_t end = duration > 0 ? (std::min)(start + duration, total) : total;
+
+    // output positions to index positions
+    const size_t first = index.FindSample((uint64_t)(start / block_samples) * ADTS_BLOCK_SAMPLES);
+    const size_t last = index.FindSample((uint64_t)((end - 1) / block_samples) * ADTS_BLOCK_SAMPLES);
+    const size_t from_frame = first > (size_t)(std::max)(preroll, 0) ? first - preroll : 0;
+
+    // like the probe one frame more, the decoder may need the header of the next frame to finish the last one,
+    // the sink stops the decoding at the end of the range
+    const uint64_t to = last + 2 < index.Size() ? index[last + 2].offset : stream_size;
+
+    PcmOutput output;
+    error = output.Open(out_file, settings.pcm_format, settings.planar);
+    if (error)
+    {
+        printf("%s\n", error);
+        fclose(fp);
+        return 1;
+    }
+
+    context_md5_t ctx;
+    MD5Init(&ctx);
+    range_sink_t keep = [&](const aac_decoded_frame_info & info, const uint8_t * pcm, int32_t size) -> const char *
+    {
+        if (verify)
+            MD5Update(&ctx, pcm, size);
+        return output.Write(pcm, size, sample_bytes, info.sampling_rate, info.num_channels);
+    };
+
+    int64_t written = 0;
+    error = decode_range(seek_settings, fp, index, from_frame, to, block_samples, sample_bytes, start, end, keep, written, bytes_read);
+
+    const char * close_error = output.Close();
+    if (!error)
+        error = close_error;
+    if (error)
+    {
+        printf("%s\n", error);
+        fclose(fp);
+        return 1;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - decode_start).count();
+    printf("Decoded samples %lld to %lld from frames %u to %u, %u frames pre-roll\n",
+        (long long)start, (long long)end, (uint32_t)first, (uint32_t)last, (uint32_t)(first - from_frame));
+    printf("Read %llu of %llu bytes in %.3f s\n", (unsigned long long)bytes_read, (unsigned long long)stream_size, seconds);
+
+    int32_t ret = 0;
+    if (written < end - start)
+    {
+        printf("Only %lld of %lld samples were decoded.\n", (long long)written, (long long)(end - start));
+        ret = 1;
+    }
+
+    if (verify)
+    {
+        uint8_t digest[16];
+        MD5Final(digest, &ctx, 0);
+        if (!verify_range(seek_settings, fp, index, stream_size, block_samples, sample_bytes, start, end, digest, written))
+            ret = 1;
+    }
+
+    fclose(fp);
+    return ret;
+}
@@ -0,0 +1,29 @@
+/********************************************************************
+ File name: aac_seek_decode.h
+ Purpose: sample accurate decoding of a range of an ADTS stream
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#ifndef AAC_SEEK_DECODE_H_INCLUDED
+#define AAC_SEEK_DECODE_H_INCLUDED
+
+#include "aac_decode.h"
+
+// Decodes the samples [start, start + duration) per channel of an ADTS file, to the end if duration
+// is <= 0. Positions count output samples, with SBR twice the samples of the AAC frames, from the first
+// sample of the stream without a priming cut. The frames of the range are found in a frame index,
+// which is loaded from index_file if that was written for this file, otherwise built and saved there
+// (index_file may be NULL). Decoding starts preroll frames in front of the frame of start, the PCM
+// of the pre-roll and of the first frame up to start is dropped, as is the PCM behind the range.
+// Only the frames of the range, the pre-roll and the frame behind the range are read. With verify the
+// range is also decoded sequentially from the start of the stream and the PCM compared. Returns 0 on success.
+int32_t aac_seek_decode(const aac_decode_settings_t & settings, const char * in_file, const char * out_file,
+    const char * index_file, int64_t start, int64_t duration, int32_t preroll, bool verify);
+
+#endif // AAC_SEEK_DECODE_H_INCLUDED
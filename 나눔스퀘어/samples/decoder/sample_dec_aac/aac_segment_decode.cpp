@@ -0,0 +1,367 @@
+/********************************************************************
+ File name: aac_segment_decode.cpp
+ Purpose: decoding of one ADTS stream in segments on parallel decoder instances
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+#include "sample_common_misc.h"
+#include "adts_frames.h"
+#include "aac_segment_decode.h"
+#include "pcm_output.h"
+
+// the decoder is fed in blocks of this size
+#define SEGMENT_FEED_SIZE       (1024*1024)
+
+struct Segment
+{
+    int64_t preroll_start;      // byte offsets in the file
+    int64_t start;
+    int64_t end;
+
+    std::vector<uint8_t> pcm;
+    int32_t sampling_rate;
+    int32_t num_channels;
+    const char * error;
+    bool done;
+
+    uint8_t digest[16];         // of the PCM, for the comparison with the sequential decode
+    uint64_t pcm_size;
+};
+
+static bool read_whole_file(const char * file_name, std::vector<uint8_t> & data)
+{
+    FILE * fp = fopen(file_name, "rb");
+    if (!fp)
+        return false;
+
+    size_t size = 0;
+    while (true)
+    {
+        data.resize(size + SEGMENT_FEED_SIZE);
+        size_t n = fread(&data[size], 1, SEGMENT_FEED_SIZE, fp);
+        size += n;
+        if (n < SEGMENT_FEED_SIZE)
+            break;
+    }
+    data.resize(size);
+
+    fclose(fp);
+    return true;
+}
+
+// feeds data[from, to) to the decoder in blocks
+static void feed(AacDecoder & decoder, const std::vector<uint8_t> & data, int64_t from, int64_t to, const aac_frame_sink_t & sink)
+{
+    while (from < to)
+    {
+        const int32_t n = (int32_t)(std::min)(to - from, (int64_t)SEGMENT_FEED_SIZE);
+        decoder.Decode(&data[(size_t)from], n, sink);
+        from += n;
+    }
+}
+
+static const char * open_decoder(AacDecoder & decoder, const aac_decode_settings_t & settings, const std::vector<uint8_t> & data, int64_t from, int64_t to)
+{
+    const int32_t head_size = (int32_t)(std::min)(to - from, (int64_t)INPUT_BUFF_SIZE);
+    return decoder.Open(settings, head_size > 0 ? &data[(size_t)from] : NULL, head_size);
+}
+
+static void decode_segment(const aac_decode_settings_t & settings, const std::vector<uint8_t> & data, Segment & seg)
+{
+    AacDecoder decoder;
+    seg.error = open_decoder(decoder, settings, data, seg.preroll_start, seg.end);
+    if (seg.error)
+        return;
+
+    bool keep = false;
+    aac_frame_sink_t sink = [&](const aac_decoded_frame_info & info, const uint8_t * pcm, int32_t size) -> int32_t
+    {
+        if (keep)
+        {
+            if (seg.pcm.empty())
+            {
+                seg.sampling_rate = info.sampling_rate;
+                seg.num_channels = info.num_channels;
+            }
+            seg.pcm.insert(seg.pcm.end(), pcm, pcm + size);
+        }
+        return 0;
+    };
+
+    feed(decoder, data, seg.preroll_start, seg.start, sink);
+    keep = true;
+    feed(decoder, data, seg.start, seg.end, sink);
+}
+
+static void md5_of(const uint8_t * data, size_t size, uint8_t digest[16])
+{
+    context_md5_t ctx;
+    MD5Init(&ctx);
+    MD5Update(&ctx, data, size);
+    MD5Final(digest, &ctx, 0);
+}
+
+// the reference: one decoder over the whole file, fed up to the same segment boundaries
+static bool verify_segments(const aac_decode_settings_t & settings, const std::vector<uint8_t> & data, const std::vector<Segment> & segs, double & seconds)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    AacDecoder decoder;
+    const char * error = open_decoder(decoder, settings, data, 0, (int64_t)data.size());
+    if (error)
+    {
+        printf("Sequential decode: %s\n", error);
+        return false;
+    }
+
+    context_md5_t ctx;
+    uint64_t size = 0;
+    aac_frame_sink_t sink = [&](const aac_decoded_frame_info &, const uint8_t * pcm, int32_t n) -> int32_t
+    {
+        MD5Update(&ctx, pcm, n);
+        size += n;
+        return 0;
+    };
+
+    uint32_t mismatches = 0;
+    for (size_t k = 0; k < segs.size(); k++)
+    {
+        uint8_t digest[16];
+        MD5Init(&ctx);
+        size = 0;
+        feed(decoder, data, segs[k].start, segs[k].end, sink);
+        MD5Final(digest, &ctx, 0);
+
+        if (size != segs[k].pcm_size || memcmp(digest, segs[k].digest, sizeof(digest)))
+        {
+            if (mismatches++ < 10)
+                printf("Segment %u differs: %llu bytes sequential, %llu bytes segmented\n",
+                    (uint32_t)k, (unsigned long long)size, (unsigned long long)segs[k].pcm_size);
+        }
+    }
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (mismatches)
+        printf("Bit-exact check failed, %u of %u segments differ, a longer -preroll may help\n", mismatches, (uint32_t)segs.size());
+    else
+        printf("Bit-exact check passed, all %u segments match the sequential decode\n", (uint32_t)segs.size());
+    return mismatches == 0;
+}
+
+int32_t aac_segment_decode(const aac_decode_settings_t & settings, const char * in_file, const char * out_file,
+    int32_t segments, int32_t preroll, int32_t num_threads, bool verify)
+{
+    if (settings.bitstream_format != -1 && settings.bitstream_format != AAD_BSF_ADTS)
+    {
+        printf("Segmented decoding needs an ADTS stream.\n");
+        return 1;
+    }
+    if (settings.playback > 0)
+    {
+        printf("The playback duration (-playback) can not be used with segmented decoding.\n");
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    if (!read_whole_file(in_file, data))
+    {
+        printf("Error opening input file.\n");
+        return 1;
+    }
+
+    std::vector<int64_t> offsets;
+    const int64_t total_frames = (int64_t)adts_scan_frames(data.empty() ? NULL : &data[0], (int64_t)data.size(), offsets);
+    if (total_frames == 0)
+    {
+        printf("No ADTS frames found, segmented decoding needs an ADTS stream.\n");
+        return 1;
+    }
+
+    PcmOutput output;
+    const char * error = output.Open(out_file, settings.pcm_format, settings.planar);
+    if (error)
+    {
+        printf("%s\n", error);
+        return 1;
+    }
+
+    // no more than AAC_SEGMENT_MAX_FRAMES frames per segment, the PCM of a segment is held until it is written
+    const int64_t min_segments = (total_frames + AAC_SEGMENT_MAX_FRAMES - 1) / AAC_SEGMENT_MAX_FRAMES;
+    if (segments < min_segments)
+        printf("Using %lld segments of at most %d frames instead of %d\n", (long long)min_segments, AAC_SEGMENT_MAX_FRAMES, segments);
+    segments = (int32_t)(std::min)((std::max)((int64_t)(std::max)(segments, 1), min_segments), total_frames);
+    if (num_threads <= 0)
+        num_threads = (std::max)((int32_t)std::thread::hardware_concurrency(), 1);
+    num_threads = (std::min)(num_threads, segments);
+    preroll = (std::max)(preroll, 0);
+
+    // the first segment takes anything in front of the first frame, the last one anything after the last frame
+    const int32_t sample_bytes = settings.pcm_format == PCM_FORMAT_S16 ? 2 : 3;
+    std::vector<Segment> segs(segments);
+    for (int32_t k = 0; k < segments; k++)
+    {
+        Segment & seg = segs[k];
+        const int64_t first = total_frames * k / segments;
+        const int64_t last = total_frames * (k + 1) / segments;
+
+        seg.start = k ? offsets[(size_t)first] : 0;
+        seg.end = k + 1 < segments ? offsets[(size_t)last] : (int64_t)data.size();
+        seg.preroll_start = first - preroll > 0 ? offsets[(size_t)(first - preroll)] : 0;
+        seg.sampling_rate = 0;
+        seg.num_channels = 0;
+        seg.error = NULL;
+        seg.done = false;
+        seg.pcm_size = 0;
+    }
+
+    // the decoder must not cut priming samples from a segment in the middle of the stream
+    aac_decode_settings_t later_settings = settings;
+    later_settings.priming = 0;
+    later_settings.encoder_type = -1;
+
+    printf("Decoding %lld frames in %d segments on %d threads, %d frames pre-roll\n",
+        (long long)total_frames, segments, num_threads, preroll);
+
+    std::atomic<int32_t> next(0);
+    std::mutex mutex;
+    std::condition_variable segment_done;
+    std::condition_variable segment_written;
+    int32_t written = 0;            // segments the writer is done with
+    bool stop = false;
+    const int32_t ahead = AAC_SEGMENTS_AHEAD * num_threads;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const double cpu_start = process_cpu_seconds();
+
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            const int32_t k = next++;
+            if (k >= segments)
+                break;
+
+            // the decoded segments wait for the writer in memory, do not get too far ahead of it
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                segment_written.wait(lock, [&] { return stop || k - written < ahead; });
+                if (stop)
+                    break;
+            }
+
+            decode_segment(k ? later_settings : settings, data, segs[k]);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            segs[k].done = true;
+            segment_done.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int32_t t = 0; t < num_threads; t++)
+        threads.push_back(std::thread(worker));
+
+    // write the segments in order, the PCM is released once it is written
+    int32_t ret = 0;
+    uint64_t samples = 0;
+    int32_t sampling_rate = 0;
+    for (int32_t k = 0; k < segments; k++)
+    {
+        Segment & seg = segs[k];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            segment_done.wait(lock, [&] { return seg.done; });
+        }
+
+        if (seg.error)
+        {
+            printf("Segment %d: %s\n", k, seg.error);
+            ret = 1;
+            break;
+        }
+
+        if (!seg.pcm.empty())
+        {
+            if (sampling_rate == 0)
+                sampling_rate = seg.sampling_rate;
+
+            // in pieces of whole sample frames
+            const size_t piece = (size_t)sample_bytes * (std::max)(seg.num_channels, 1) * 1024 * 1024;
+            for (size_t pos = 0; pos < seg.pcm.size() && !error; pos += piece)
+                error = output.Write(&seg.pcm[pos], (int32_t)(std::min)(piece, seg.pcm.size() - pos), sample_bytes, seg.sampling_rate, seg.num_channels);
+            if (error)
+            {
+                printf("%s\n", error);
+                ret = 1;
+                break;
+            }
+
+            samples += seg.pcm.size() / (sample_bytes * (std::max)(seg.num_channels, 1));
+        }
+
+        seg.pcm_size = seg.pcm.size();
+        if (verify)
+            md5_of(seg.pcm.empty() ? NULL : &seg.pcm[0], seg.pcm.size(), seg.digest);
+        std::vector<uint8_t>().swap(seg.pcm);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        written = k + 1;
+        segment_written.notify_all();
+    }
+
+    if (ret)
+    {
+        // the workers waiting for the writer stop, the others finish their segment
+        std::lock_guard<std::mutex> lock(mutex);
+        next = segments;
+        stop = true;
+        segment_written.notify_all();
+    }
+
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double cpu = process_cpu_seconds() - cpu_start;
+
+    error = output.Close();
+    if (error && !ret)
+    {
+        printf("%s\n", error);
+        ret = 1;
+    }
+
+    if (ret)
+        return ret;
+
+    const double audio = sampling_rate > 0 ? (double)samples / sampling_rate : 0.0;
+    printf("Segmented: %.2f s audio in %.2f s, %.0f frames/s, %.1fx realtime, cpu %.2f s\n",
+        audio, wall, wall > 0 ? total_frames / wall : 0.0, wall > 0 ? audio / wall : 0.0, cpu);
+
+    if (verify)
+    {
+        double sequential = 0.0;
+        if (!verify_segments(settings, data, segs, sequential))
+            ret = 1;
+        printf("Sequential: %.2f s, %.1fx realtime, speedup %.2fx\n",
+            sequential, sequential > 0 ? audio / sequential : 0.0, wall > 0 ? sequential / wall : 0.0);
+    }
+
+    return ret;
+}
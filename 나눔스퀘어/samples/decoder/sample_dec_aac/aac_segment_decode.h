@@ -0,0 +1,38 @@
+/********************************************************************
+ File name: aac_segment_decode.h
+ Purpose: decoding of one ADTS stream in segments on parallel decoder instances
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#ifndef AAC_SEGMENT_DECODE_H_INCLUDED
+#define AAC_SEGMENT_DECODE_H_INCLUDED
+
+#include "aac_decode.h"
+
+// frames decoded and dropped in front of a segment by default
+#define AAC_SEGMENT_PREROLL     8
+
+// longer segments are split further, so that the decoded PCM waiting to be written stays small
+#define AAC_SEGMENT_MAX_FRAMES  2048
+
+// decoded segments that may wait for the writer, per thread
+#define AAC_SEGMENTS_AHEAD      2
+
+// Splits an ADTS file at frame boundaries into segments and decodes them on num_threads workers
+// (<= 0 is one per CPU), each segment on its own decoder instance. Every segment but the first
+// starts preroll frames early, the PCM the decoder returns while it is fed those frames is dropped.
+// That is the same PCM a sequential decode returns for the segment once the decoder state has
+// settled, so the stitched output matches the sequential one. The segments are written in order
+// as soon as they are complete, and a worker does not start a segment more than
+// AAC_SEGMENTS_AHEAD * num_threads segments ahead of the writer. With verify the file is also decoded sequentially and the PCM
+// of every segment is compared. Returns 0 on success, 1 on errors or a mismatch.
+int32_t aac_segment_decode(const aac_decode_settings_t & settings, const char * in_file, const char * out_file,
+    int32_t segments, int32_t preroll, int32_t num_threads, bool verify);
+
+#endif // AAC_SEGMENT_DECODE_H_INCLUDED
@@ -0,0 +1,71 @@
+/********************************************************************
+ File name: adts_frames.cpp
+ Purpose: ADTS frame header parsing and frame scanning
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#include <string.h>
+
+#include "adts_frames.h"
+
+bool adts_parse_header(const uint8_t * p, int64_t avail, adts_header_t & hdr)
+{
+    if (avail < ADTS_HEADER_SIZE)
+        return false;
+
+    // syncword 0xFFF, layer 0
+    if (p[0] != 0xFF || (p[1] & 0xF6) != 0xF0)
+        return false;
+
+    hdr.protection_absent = p[1] & 0x01;
+    hdr.sampling_index = (p[2] >> 2) & 0x0F;
+    hdr.channel_config = ((p[2] & 0x01) << 2) | (p[3] >> 6);
+    hdr.frame_length = ((p[3] & 0x03) << 11) | (p[4] << 3) | (p[5] >> 5);
+    hdr.raw_blocks = (p[6] & 0x03) + 1;
+
+    if (hdr.sampling_index > 12)
+        return false;
+
+    return hdr.frame_length >= (hdr.protection_absent ? ADTS_HEADER_SIZE : ADTS_HEADER_SIZE + 2);
+}
+
+size_t adts_scan_frames(const uint8_t * data, int64_t size, std::vector<int64_t> & offsets)
+{
+    adts_header_t hdr, next;
+    int64_t pos = 0;
+    int64_t chained = -1;   // end of the last frame
+
+    offsets.clear();
+    while (pos + ADTS_HEADER_SIZE <= size)
+    {
+        if (adts_parse_header(data + pos, size - pos, hdr))
+        {
+            const int64_t end = pos + hdr.frame_length;
+            if (end <= size && (size - end < ADTS_HEADER_SIZE || adts_parse_header(data + end, size - end, next)))
+            {
+                offsets.push_back(pos);
+                chained = pos = end;
+                continue;
+            }
+            // the last frame may be cut
+            if (end > size && pos == chained)
+            {
+                offsets.push_back(pos);
+                break;
+            }
+        }
+
+        // resync at the next 0xFF
+        const uint8_t * p = (const uint8_t*)memchr(data + pos + 1, 0xFF, (size_t)(size - pos - 1));
+        if (!p)
+            break;
+        pos = p - data;
+    }
+    return offsets.size();
+}
@@ -0,0 +1,40 @@
+/********************************************************************
+ File name: adts_frames.h
+ Purpose: ADTS frame header parsing and frame scanning
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#ifndef ADTS_FRAMES_H_INCLUDED
+#define ADTS_FRAMES_H_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+
+#include "mctypes.h"
+
+#define ADTS_HEADER_SIZE    7
+
+typedef struct adts_header_s
+{
+    int32_t frame_length;       // including the header
+    int32_t sampling_index;
+    int32_t channel_config;
+    int32_t raw_blocks;         // raw data blocks in the frame, 1024 samples each
+    int32_t protection_absent;
+} adts_header_t;
+
+// parses the fixed and variable header at p, false if it is not a valid ADTS header
+bool adts_parse_header(const uint8_t * p, int64_t avail, adts_header_t & hdr);
+
+// Offsets of the ADTS frames in data. The scan jumps from header to header by the frame length,
+// a header only counts if the next one follows it (or less than a header is left). After damage the
+// scan continues at the next sync word that passes this check. Returns the number of frames.
+size_t adts_scan_frames(const uint8_t * data, int64_t size, std::vector<int64_t> & offsets);
+
+#endif // ADTS_FRAMES_H_INCLUDED
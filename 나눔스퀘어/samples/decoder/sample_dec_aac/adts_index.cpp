@@ -0,0 +1,234 @@
+/********************************************************************
+ File name: adts_index.cpp
+ Purpose: frame index of an ADTS file used for seeking, with an optional sidecar file
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "adts_frames.h"
+#include "adts_index.h"
+
+// file bytes read at a time while indexing
+#define INDEX_READ_SIZE         (1024*1024)
+
+// a frame is only accepted with the header behind it, so a frame and a header have to be in the window
+#define INDEX_LOOKAHEAD         (8191 + ADTS_HEADER_SIZE)
+
+static const char ADTS_INDEX_MAGIC[8] = { 'A', 'D', 'T', 'S', 'I', 'D', 'X', ' ' };
+
+// layout of the sidecar file: the header, then the frames
+typedef struct adts_index_header_s
+{
+    char magic[8];
+    uint32_t version;
+    int32_t sampling_index;
+    int32_t channel_config;
+    uint32_t reserved;
+    uint64_t frames;
+    uint64_t samples;
+    uint64_t stream_size;       // a sidecar of another stream is not used
+    int64_t stream_time;        // nor one of a stream rewritten with the same size
+} adts_index_header_t;
+
+AdtsIndex::AdtsIndex()
+    : _samples(0)
+    , _sampling_index(-1)
+    , _channel_config(-1)
+{
+}
+
+uint64_t AdtsIndex::StreamSize(FILE * fp)
+{
+#if defined(_WIN32)
+    const int64_t position = _ftelli64(fp);
+    _fseeki64(fp, 0, SEEK_END);
+    const int64_t size = _ftelli64(fp);
+    _fseeki64(fp, position, SEEK_SET);
+#else
+    const off_t position = ftello(fp);
+    fseeko(fp, 0, SEEK_END);
+    const off_t size = ftello(fp);
+    fseeko(fp, position, SEEK_SET);
+#endif
+    return size < 0 ? 0 : (uint64_t)size;
+}
+
+int64_t AdtsIndex::StreamTime(const char * file_name)
+{
+#if defined(_WIN32)
+    struct _stati64 stat_data = {};
+    if (_stati64(file_name, &stat_data))
+        return 0;
+#else
+    struct stat stat_data = {};
+    if (stat(file_name, &stat_data))
+        return 0;
+#endif
+    return (int64_t)stat_data.st_mtime;
+}
+
+bool AdtsIndex::SeekTo(FILE * fp, uint64_t offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(fp, (int64_t)offset, SEEK_SET) == 0;
+#else
+    return fseeko(fp, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+bool AdtsIndex::Build(FILE * fp)
+{
+    _frames.clear();
+    _samples = 0;
+    _sampling_index = -1;
+    _channel_config = -1;
+
+    const int64_t size = (int64_t)StreamSize(fp);
+    if (!SeekTo(fp, 0))
+        return false;
+
+    // window of the file starting at base, refilled when a frame and the next header do not fit any more
+    std::vector<uint8_t> window(INDEX_READ_SIZE + INDEX_LOOKAHEAD);
+    int64_t base = 0;
+    int64_t avail = 0;
+
+    adts_header_t hdr, next;
+    int64_t pos = 0;
+    int64_t chained = -1;   // end of the last frame
+
+    while (pos + ADTS_HEADER_SIZE <= size)
+    {
+        if (pos + INDEX_LOOKAHEAD > base + avail && base + avail < size)
+        {
+            const int64_t keep = (std::max)(base + avail - pos, (int64_t)0);
+            if (keep > 0)
+                memmove(&window[0], &window[(size_t)(pos - base)], (size_t)keep);
+            else if (!SeekTo(fp, (uint64_t)pos))
+                return false;
+            base = pos;
+            avail = keep + (int64_t)fread(&window[(size_t)keep], 1, window.size() - (size_t)keep, fp);
+            if (avail < ADTS_HEADER_SIZE)
+                break;
+        }
+
+        // the window holds everything up to end + ADTS_HEADER_SIZE, or up to the end of the file
+        const uint8_t * p = &window[(size_t)(pos - base)];
+        const int64_t left = base + avail - pos;
+        if (adts_parse_header(p, left, hdr))
+        {
+            const int64_t end = pos + hdr.frame_length;
+            if (end <= size && (size - end < ADTS_HEADER_SIZE || adts_parse_header(p + hdr.frame_length, left - hdr.frame_length, next)))
+            {
+                if (_frames.empty())
+                {
+                    _sampling_index = hdr.sampling_index;
+                    _channel_config = hdr.channel_config;
+                }
+                adts_index_entry_t entry = { (uint64_t)pos, _samples };
+                _frames.push_back(entry);
+                _samples += hdr.raw_blocks * ADTS_BLOCK_SAMPLES;
+                chained = pos = end;
+                continue;
+            }
+            // the last frame may be cut
+            if (end > size && pos == chained)
+            {
+                adts_index_entry_t entry = { (uint64_t)pos, _samples };
+                _frames.push_back(entry);
+                _samples += hdr.raw_blocks * ADTS_BLOCK_SAMPLES;
+                break;
+            }
+        }
+
+        // resync at the next 0xFF, a window without one is skipped as a whole
+        const uint8_t * sync = left > 1 ? (const uint8_t*)memchr(p + 1, 0xFF, (size_t)(left - 1)) : NULL;
+        pos = sync ? base + (sync - &window[0]) : base + avail;
+    }
+
+    return !ferror(fp);
+}
+
+bool AdtsIndex::Load(const char * file_name, uint64_t stream_size, int64_t stream_time)
+{
+    FILE * fp = fopen(file_name, "rb");
+    if (!fp)
+        return false;
+
+    adts_index_header_t header;
+    bool valid = fread(&header, sizeof(header), 1, fp) == 1 && !memcmp(header.magic, ADTS_INDEX_MAGIC, sizeof(header.magic)) &&
+        header.version == ADTS_INDEX_VERSION && header.stream_size == stream_size && header.stream_time == stream_time && header.frames > 0 &&
+        header.frames <= stream_size / ADTS_HEADER_SIZE;
+
+    if (valid)
+    {
+        _frames.resize((size_t)header.frames);
+        valid = fread(&_frames[0], sizeof(adts_index_entry_t), _frames.size(), fp) == _frames.size();
+    }
+
+    fclose(fp);
+
+    // the sample positions have to grow and the offsets to stay in the stream
+    for (size_t i = 0; valid && i < _frames.size(); i++)
+    {
+        valid = _frames[i].offset < stream_size && _frames[i].sample < header.samples &&
+            (i == 0 || (_frames[i].offset > _frames[i - 1].offset && _frames[i].sample > _frames[i - 1].sample));
+    }
+
+    if (!valid)
+    {
+        _frames.clear();
+        _samples = 0;
+        return false;
+    }
+
+    _samples = header.samples;
+    _sampling_index = header.sampling_index;
+    _channel_config = header.channel_config;
+    return true;
+}
+
+bool AdtsIndex::Save(const char * file_name, uint64_t stream_size, int64_t stream_time) const
+{
+    if (_frames.empty())
+        return false;
+
+    FILE * fp = fopen(file_name, "wb");
+    if (!fp)
+        return false;
+
+    adts_index_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ADTS_INDEX_MAGIC, sizeof(header.magic));
+    header.version = ADTS_INDEX_VERSION;
+    header.sampling_index = _sampling_index;
+    header.channel_config = _channel_config;
+    header.frames = _frames.size();
+    header.samples = _samples;
+    header.stream_size = stream_size;
+    header.stream_time = stream_time;
+
+    const bool valid = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+        fwrite(&_frames[0], sizeof(adts_index_entry_t), _frames.size(), fp) == _frames.size();
+
+    return fclose(fp) == 0 && valid;
+}
+
+size_t AdtsIndex::FindSample(uint64_t sample) const
+{
+    if (_frames.empty() || sample >= _samples)
+        return ADTS_INDEX_NOT_FOUND;
+
+    // the last frame that starts at or before the sample
+    std::vector<adts_index_entry_t>::const_iterator it = std::upper_bound(_frames.begin(), _frames.end(), sample,
+        [](uint64_t value, const adts_index_entry_t & entry) { return value < entry.sample; });
+    return (size_t)(it - _frames.begin()) - 1;
+}
@@ -0,0 +1,69 @@
+/********************************************************************
+ File name: adts_index.h
+ Purpose: frame index of an ADTS file used for seeking, with an optional sidecar file
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#ifndef ADTS_INDEX_H_INCLUDED
+#define ADTS_INDEX_H_INCLUDED
+
+#include <stdio.h>
+#include <vector>
+
+#include "mctypes.h"
+
+#define ADTS_INDEX_VERSION      2
+#define ADTS_INDEX_NOT_FOUND    ((size_t)-1)
+
+// 1024 samples per raw data block
+#define ADTS_BLOCK_SAMPLES      1024
+
+typedef struct adts_index_entry_s
+{
+    uint64_t offset;            // of the frame header in the file
+    uint64_t sample;            // first sample of the frame per channel, ADTS_BLOCK_SAMPLES per raw data block
+} adts_index_entry_t;
+
+// Offsets and sample positions of all frames of an ADTS file. It is built by a scan that only
+// follows the frame headers, or loaded from a sidecar file written by a previous run.
+class AdtsIndex
+{
+public:
+    AdtsIndex();
+
+    // the scan accepts the same frames as adts_scan_frames()
+    bool Build(FILE * fp);
+    // a sidecar is only loaded for the stream size and modification time it was saved with
+    bool Load(const char * file_name, uint64_t stream_size, int64_t stream_time);
+    bool Save(const char * file_name, uint64_t stream_size, int64_t stream_time) const;
+
+    size_t Size() const { return _frames.size(); }
+    const adts_index_entry_t & operator[](size_t frame) const { return _frames[frame]; }
+
+    // samples per channel in all frames
+    uint64_t Samples() const { return _samples; }
+    int32_t SamplingIndex() const { return _sampling_index; }
+    int32_t ChannelConfig() const { return _channel_config; }
+
+    // the frame that holds the sample, ADTS_INDEX_NOT_FOUND past the end
+    size_t FindSample(uint64_t sample) const;
+
+    static uint64_t StreamSize(FILE * fp);
+    // modification time of the file, 0 if it is not known
+    static int64_t StreamTime(const char * file_name);
+    static bool SeekTo(FILE * fp, uint64_t offset);
+
+private:
+    std::vector<adts_index_entry_t> _frames;
+    uint64_t _samples;
+    int32_t _sampling_index;    // of the first frame
+    int32_t _channel_config;
+};
+
+#endif // ADTS_INDEX_H_INCLUDED
@@ -0,0 +1,318 @@
+/********************************************************************
+ File name: pcm_convert.cpp
+ Purpose: PCM sample format conversion and deinterleaving for the AAC decoder sample
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PCM_SSE2
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PCM_TARGET(x)
+#else
+#include <cpuid.h>
+#define PCM_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+#include "pcm_convert.h"
+
+#if defined _MSC_VER
+#define strcmp_lower_case _stricmp
+#else
+#include <strings.h>
+#define strcmp_lower_case strcasecmp
+#endif
+
+int32_t pcm_format_bytes(pcm_format_t format)
+{
+    switch (format)
+    {
+    case PCM_FORMAT_S16: return 2;
+    case PCM_FORMAT_S24: return 3;
+    default:             return 4;
+    }
+}
+
+int32_t pcm_format_from_string(const char * name)
+{
+    if (strcmp_lower_case(name, "s16") == 0) return PCM_FORMAT_S16;
+    if (strcmp_lower_case(name, "s24") == 0) return PCM_FORMAT_S24;
+    if (strcmp_lower_case(name, "s32") == 0) return PCM_FORMAT_S32;
+    if (strcmp_lower_case(name, "f32") == 0) return PCM_FORMAT_F32;
+
+    return -1;
+}
+
+// the scalar versions also do the tails of the vector loops
+
+static void unpack_s16_c(const uint8_t * src, int32_t * dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        dst[i] = (int32_t)((uint32_t)(src[2 * i] | (src[2 * i + 1] << 8)) << 16);
+}
+
+static void unpack_s24_c(const uint8_t * src, int32_t * dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        dst[i] = (int32_t)((uint32_t)(src[3 * i] | (src[3 * i + 1] << 8) | (src[3 * i + 2] << 16)) << 8);
+}
+
+static void pack_s16_c(const int32_t * src, uint8_t * dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        dst[2 * i] = (uint8_t)(src[i] >> 16);
+        dst[2 * i + 1] = (uint8_t)(src[i] >> 24);
+    }
+}
+
+static void pack_s24_c(const int32_t * src, uint8_t * dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        dst[3 * i] = (uint8_t)(src[i] >> 8);
+        dst[3 * i + 1] = (uint8_t)(src[i] >> 16);
+        dst[3 * i + 2] = (uint8_t)(src[i] >> 24);
+    }
+}
+
+static void pack_f32_c(const int32_t * src, uint8_t * dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const float f = (float)src[i] * (1.0f / 2147483648.0f);
+        memcpy(dst + 4 * i, &f, sizeof(f));
+    }
+}
+
+static void deinterleave_c(const int32_t * src, int32_t num_channels, size_t frames, int32_t * dst)
+{
+    for (int32_t c = 0; c < num_channels; c++)
+    {
+        const int32_t * s = src + c;
+        int32_t * d = dst + c * frames;
+        for (size_t i = 0; i < frames; i++, s += num_channels)
+            d[i] = *s;
+    }
+}
+
+#if defined(PCM_SSE2)
+
+static bool has_ssse3()
+{
+    static int32_t ssse3 = -1;
+    if (ssse3 < 0)
+    {
+#if defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 1);
+        ssse3 = (regs[2] >> 9) & 1;
+#else
+        unsigned int eax, ebx, ecx, edx;
+        ssse3 = __get_cpuid(1, &eax, &ebx, &ecx, &edx) ? (ecx >> 9) & 1 : 0;
+#endif
+    }
+    return ssse3 != 0;
+}
+
+static void unpack_s16_sse2(const uint8_t * src, int32_t * dst, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // a zero low half puts the sample in the upper 16 bits
+        const __m128i v = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(zero, v));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(zero, v));
+    }
+    unpack_s16_c(src + 2 * i, dst + i, count - i);
+}
+
+static void pack_s16_sse2(const int32_t * src, uint8_t * dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i a = _mm_srai_epi32(_mm_loadu_si128((const __m128i*)(src + i)), 16);
+        const __m128i b = _mm_srai_epi32(_mm_loadu_si128((const __m128i*)(src + i + 4)), 16);
+        _mm_storeu_si128((__m128i*)(dst + 2 * i), _mm_packs_epi32(a, b));
+    }
+    pack_s16_c(src + i, dst + 2 * i, count - i);
+}
+
+static void pack_f32_sse2(const int32_t * src, uint8_t * dst, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 f = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(src + i)));
+        _mm_storeu_ps((float*)(dst + 4 * i), _mm_mul_ps(f, scale));
+    }
+    pack_f32_c(src + i, dst + 4 * i, count - i);
+}
+
+// 16 bytes are loaded and stored for 4 samples (12 bytes), the loops stop while 2 more samples follow
+PCM_TARGET("ssse3")
+static void unpack_s24_ssse3(const uint8_t * src, int32_t * dst, size_t count)
+{
+    const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    size_t i = 0;
+    for (; i + 6 <= count; i += 4)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(src + 3 * i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(v, shuffle));
+    }
+    unpack_s24_c(src + 3 * i, dst + i, count - i);
+}
+
+PCM_TARGET("ssse3")
+static void pack_s24_ssse3(const int32_t * src, uint8_t * dst, size_t count)
+{
+    const __m128i shuffle = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 6 <= count; i += 4)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + 3 * i), _mm_shuffle_epi8(v, shuffle));
+    }
+    pack_s24_c(src + i, dst + 3 * i, count - i);
+}
+
+static void deinterleave_stereo_sse2(const int32_t * src, size_t frames, int32_t * dst)
+{
+    int32_t * left = dst;
+    int32_t * right = dst + frames;
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4)
+    {
+        // L0 R0 L1 R1 -> L0 L1 R0 R1
+        const __m128i a = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(src + 2 * i)), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m128i b = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(src + 2 * i + 4)), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i*)(left + i), _mm_unpacklo_epi64(a, b));
+        _mm_storeu_si128((__m128i*)(right + i), _mm_unpackhi_epi64(a, b));
+    }
+    for (; i < frames; i++)
+    {
+        left[i] = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+
+// 4 frames at a time, each group of 4 channels is a 4x4 transpose. The last group overlaps the one before
+// if the channels are not a multiple of 4, those channels are simply stored twice.
+static void deinterleave_sse2(const int32_t * src, int32_t num_channels, size_t frames, int32_t * dst)
+{
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4)
+    {
+        const int32_t * s = src + i * num_channels;
+        for (int32_t g = 0; g < num_channels; g += 4)
+        {
+            const int32_t c = (std::min)(g, num_channels - 4);
+            const __m128i r0 = _mm_loadu_si128((const __m128i*)(s + c));
+            const __m128i r1 = _mm_loadu_si128((const __m128i*)(s + num_channels + c));
+            const __m128i r2 = _mm_loadu_si128((const __m128i*)(s + 2 * num_channels + c));
+            const __m128i r3 = _mm_loadu_si128((const __m128i*)(s + 3 * num_channels + c));
+
+            const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+            const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+            const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+            const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+            int32_t * d = dst + c * frames + i;
+            _mm_storeu_si128((__m128i*)d, _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128((__m128i*)(d + frames), _mm_unpackhi_epi64(t0, t1));
+            _mm_storeu_si128((__m128i*)(d + 2 * frames), _mm_unpacklo_epi64(t2, t3));
+            _mm_storeu_si128((__m128i*)(d + 3 * frames), _mm_unpackhi_epi64(t2, t3));
+        }
+    }
+    for (; i < frames; i++)
+    {
+        for (int32_t c = 0; c < num_channels; c++)
+            dst[c * frames + i] = src[i * num_channels + c];
+    }
+}
+
+#endif // PCM_SSE2
+
+void pcm_unpack(const uint8_t * src, int32_t src_bytes, int32_t * dst, size_t count)
+{
+#if defined(PCM_SSE2)
+    if (src_bytes == 2)
+        unpack_s16_sse2(src, dst, count);
+    else if (has_ssse3())
+        unpack_s24_ssse3(src, dst, count);
+    else
+        unpack_s24_c(src, dst, count);
+#else
+    if (src_bytes == 2)
+        unpack_s16_c(src, dst, count);
+    else
+        unpack_s24_c(src, dst, count);
+#endif
+}
+
+void pcm_pack(const int32_t * src, pcm_format_t format, uint8_t * dst, size_t count)
+{
+    switch (format)
+    {
+    case PCM_FORMAT_S16:
+#if defined(PCM_SSE2)
+        pack_s16_sse2(src, dst, count);
+#else
+        pack_s16_c(src, dst, count);
+#endif
+        break;
+    case PCM_FORMAT_S24:
+#if defined(PCM_SSE2)
+        if (has_ssse3())
+        {
+            pack_s24_ssse3(src, dst, count);
+            break;
+        }
+#endif
+        pack_s24_c(src, dst, count);
+        break;
+    case PCM_FORMAT_S32:
+        memcpy(dst, src, count * sizeof(int32_t));
+        break;
+    case PCM_FORMAT_F32:
+#if defined(PCM_SSE2)
+        pack_f32_sse2(src, dst, count);
+#else
+        pack_f32_c(src, dst, count);
+#endif
+        break;
+    }
+}
+
+void pcm_deinterleave(const int32_t * src, int32_t num_channels, size_t frames, int32_t * dst)
+{
+#if defined(PCM_SSE2)
+    if (num_channels == 2)
+    {
+        deinterleave_stereo_sse2(src, frames, dst);
+        return;
+    }
+    if (num_channels >= 4)
+    {
+        deinterleave_sse2(src, num_channels, frames, dst);
+        return;
+    }
+#endif
+    deinterleave_c(src, num_channels, frames, dst);
+}
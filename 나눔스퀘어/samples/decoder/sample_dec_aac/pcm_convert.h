@@ -0,0 +1,47 @@
+/********************************************************************
+ File name: pcm_convert.h
+ Purpose: PCM sample format conversion and deinterleaving for the AAC decoder sample
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#ifndef PCM_CONVERT_H_INCLUDED
+#define PCM_CONVERT_H_INCLUDED
+
+#include <stddef.h>
+
+#include "mctypes.h"
+
+// output sample formats, all little-endian
+typedef enum pcm_format_e
+{
+    PCM_FORMAT_S16 = 0,
+    PCM_FORMAT_S24,
+    PCM_FORMAT_S32,
+    PCM_FORMAT_F32
+} pcm_format_t;
+
+// bytes of one sample
+int32_t pcm_format_bytes(pcm_format_t format);
+
+// "s16", "s24", "s32" or "f32", -1 for anything else
+int32_t pcm_format_from_string(const char * name);
+
+// Samples in between are held as int32 with the sample in the upper bits, a 16 bit sample x is x << 16
+// and a 24 bit sample x << 8. The conversion to the output formats is then exact, float is x / 2^31.
+
+// count samples of src_bytes (2 or 3) each to int32
+void pcm_unpack(const uint8_t * src, int32_t src_bytes, int32_t * dst, size_t count);
+
+// count int32 samples to the output format, 16 and 24 bit keep the upper bits
+void pcm_pack(const int32_t * src, pcm_format_t format, uint8_t * dst, size_t count);
+
+// frames of interleaved samples to num_channels planes of frames samples, plane c starts at dst + c * frames
+void pcm_deinterleave(const int32_t * src, int32_t num_channels, size_t frames, int32_t * dst);
+
+#endif // PCM_CONVERT_H_INCLUDED
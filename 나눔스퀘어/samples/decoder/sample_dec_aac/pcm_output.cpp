@@ -0,0 +1,404 @@
+/********************************************************************
+ File name: pcm_output.cpp
+ Purpose: PCM and WAV output of the AAC decoder sample with a write-behind thread
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#include <string.h>
+#include <algorithm>
+
+#include "pcm_output.h"
+
+// samples converted at a time, a multiple of up to 8 channels
+#define PCM_BLOCK_SAMPLES           (2048*8)
+
+// the buffers of planar writers are split among the channels, but not below this
+#define PCM_WRITER_MIN_BUFFER_SIZE  (256*1024)
+
+#define WAVE_FORMAT_PCM             1
+#define WAVE_FORMAT_IEEE_FLOAT      3
+#define WAVE_FORMAT_EXTENSIBLE      0xFFFE
+
+// speaker positions of the default PCM channel order of the decoder, by number of channels
+static const uint32_t wav_channel_masks[9] =
+{
+    0,
+    0x4,        // C
+    0x3,        // L R
+    0x7,        // L R C
+    0x107,      // L R C Cs
+    0x37,       // L R C Ls Rs
+    0x3F,       // L R C LFE Ls Rs
+    0x13F,      // L R C LFE Ls Rs Cs
+    0x63F       // L R C LFE Ls Rs Lsd Rsd
+};
+
+// speaker position of channel c of num_channels, 0 if there is no default layout
+static uint32_t wav_channel_mask(int32_t num_channels, int32_t c)
+{
+    if (num_channels <= 0 || num_channels > 8)
+        return 0;
+
+    uint32_t mask = wav_channel_masks[num_channels];
+    if (c < 0)
+        return mask;
+
+    for (int32_t i = 0; i < c; i++)
+        mask &= mask - 1;
+    return mask & (0 - mask);
+}
+
+static uint8_t * put_le16(uint8_t * p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t * put_le32(uint8_t * p, uint32_t v)
+{
+    p = put_le16(p, v & 0xFFFF);
+    return put_le16(p, v >> 16);
+}
+
+static uint8_t * put_tag(uint8_t * p, const char * tag)
+{
+    memcpy(p, tag, 4);
+    return p + 4;
+}
+
+// Writes the WAV header at the start of the file. Float, more than 16 bits and more than two
+// channels use WAVE_FORMAT_EXTENSIBLE with the channel mask, float adds the fact chunk.
+static bool write_wav_header(FILE * fp, const wav_hdr_param & hdr, pcm_format_t format, uint32_t channel_mask)
+{
+    static const uint8_t subformat_guid[14] =
+    {
+        0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+    };
+
+    const bool is_float = format == PCM_FORMAT_F32;
+    const bool extensible = is_float || hdr.bits_per_sample > 16 || hdr.num_channels > 2;
+    const uint32_t fmt_size = extensible ? 40 : 16;
+    const uint32_t fact_size = is_float ? 12 : 0;
+    const uint32_t data_size = (uint32_t)hdr.data_size;
+
+    uint8_t buf[80];
+    uint8_t * p = buf;
+    p = put_tag(p, "RIFF");
+    p = put_le32(p, 4 + 8 + fmt_size + fact_size + 8 + data_size);
+    p = put_tag(p, "WAVE");
+
+    p = put_tag(p, "fmt ");
+    p = put_le32(p, fmt_size);
+    p = put_le16(p, extensible ? WAVE_FORMAT_EXTENSIBLE : WAVE_FORMAT_PCM);
+    p = put_le16(p, hdr.num_channels);
+    p = put_le32(p, hdr.sample_rate);
+    p = put_le32(p, hdr.bytes_per_sec);
+    p = put_le16(p, hdr.block_align);
+    p = put_le16(p, hdr.bits_per_sample);
+    if (extensible)
+    {
+        p = put_le16(p, 22);
+        p = put_le16(p, hdr.bits_per_sample);
+        p = put_le32(p, channel_mask);
+        p = put_le16(p, is_float ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM);
+        memcpy(p, subformat_guid, sizeof(subformat_guid));
+        p += sizeof(subformat_guid);
+    }
+
+    if (is_float)
+    {
+        p = put_tag(p, "fact");
+        p = put_le32(p, 4);
+        p = put_le32(p, hdr.block_align ? data_size / hdr.block_align : 0);
+    }
+
+    p = put_tag(p, "data");
+    p = put_le32(p, data_size);
+
+    const size_t size = p - buf;
+    return fseek(fp, 0, SEEK_SET) == 0 && fwrite(buf, 1, size, fp) == size;
+}
+
+PcmWriter::PcmWriter()
+    : _fp(NULL)
+    , _cur(0)
+    , _fill(0)
+    , _pending(-1)
+    , _pending_size(0)
+    , _stop(false)
+    , _error(false)
+{
+}
+
+PcmWriter::~PcmWriter()
+{
+    Finish();
+}
+
+void PcmWriter::Start(FILE * fp, size_t buffer_size)
+{
+    _fp = fp;
+    _buf[0].resize(buffer_size);
+    _buf[1].resize(buffer_size);
+    _cur = 0;
+    _fill = 0;
+    _pending = -1;
+    _stop = false;
+    _error = false;
+    _thread = std::thread(&PcmWriter::Run, this);
+}
+
+uint8_t * PcmWriter::Reserve(size_t size)
+{
+    if (_fill + size > _buf[_cur].size())
+        Submit();
+    return &_buf[_cur][_fill];
+}
+
+void PcmWriter::Commit(size_t size)
+{
+    _fill += size;
+}
+
+void PcmWriter::Write(const uint8_t * data, size_t size)
+{
+    while (size > 0)
+    {
+        const size_t n = (std::min)(size, _buf[_cur].size());
+        memcpy(Reserve(n), data, n);
+        Commit(n);
+        data += n;
+        size -= n;
+    }
+}
+
+// hands the filled buffer to the thread and continues with the other one once that is written
+void PcmWriter::Submit()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cond.wait(lock, [&] { return _pending < 0; });
+    if (_fill > 0)
+    {
+        _pending = _cur;
+        _pending_size = _fill;
+        _cur ^= 1;
+        _fill = 0;
+        _cond.notify_all();
+    }
+}
+
+void PcmWriter::Run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _cond.wait(lock, [&] { return _pending >= 0 || _stop; });
+        if (_pending < 0)
+            break;
+
+        const int32_t k = _pending;
+        const size_t size = _pending_size;
+        lock.unlock();
+        const bool ok = fwrite(&_buf[k][0], 1, size, _fp) == size;
+        lock.lock();
+
+        if (!ok)
+            _error = true;
+        _pending = -1;
+        _cond.notify_all();
+    }
+}
+
+bool PcmWriter::Finish()
+{
+    if (!_thread.joinable())
+        return !_error;
+
+    Submit();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        _cond.notify_all();
+    }
+    _thread.join();
+    std::vector<uint8_t>().swap(_buf[0]);
+    std::vector<uint8_t>().swap(_buf[1]);
+    return !_error;
+}
+
+PcmOutput::PcmOutput()
+    : _format(PCM_FORMAT_S16)
+    , _planar(false)
+    , _wav(false)
+    , _num_channels(0)
+{
+}
+
+PcmOutput::~PcmOutput()
+{
+    Close();
+}
+
+const char * PcmOutput::Open(const char * out_file, pcm_format_t format, bool planar)
+{
+    Close();
+
+    _name = out_file;
+    _format = format;
+    _planar = planar;
+    _num_channels = 0;
+
+    const char *s;
+    _wav = ((s = strstr(out_file, ".wav")) ||
+        (s = strstr(out_file, ".WAV"))) && strlen(s) == 4;
+
+    // the channel files are created with the first PCM, the single file right away to fail early
+    if (!planar)
+    {
+        std::unique_ptr<File> file(new File);
+        file->name = out_file;
+        file->fp = fopen(out_file, "wb");
+        if (!file->fp)
+            return "Error opening output file.";
+        memset(&file->wav_hdr, 0, sizeof(file->wav_hdr));
+        file->channel_mask = 0;
+        _files.push_back(std::move(file));
+    }
+    return NULL;
+}
+
+const char * PcmOutput::OpenFiles(int32_t sampling_rate, int32_t num_channels)
+{
+    if (_planar)
+    {
+        size_t pos = _name.find_last_of('.');
+        if (pos == std::string::npos || _name.find_first_of("/\\", pos) != std::string::npos)
+            pos = _name.size();
+
+        for (int32_t c = 0; c < num_channels; c++)
+        {
+            std::unique_ptr<File> file(new File);
+            file->name = _name.substr(0, pos) + "_ch" + std::to_string(c) + _name.substr(pos);
+            file->fp = fopen(file->name.c_str(), "wb");
+            if (!file->fp)
+                return "Error opening output file.";
+            memset(&file->wav_hdr, 0, sizeof(file->wav_hdr));
+            file->channel_mask = 0;
+            _files.push_back(std::move(file));
+        }
+    }
+
+    const int32_t bytes = pcm_format_bytes(_format);
+    const int32_t file_channels = _planar ? 1 : num_channels;
+    const size_t buffer_size = (std::max)((size_t)PCM_WRITER_BUFFER_SIZE / _files.size(), (size_t)PCM_WRITER_MIN_BUFFER_SIZE);
+
+    for (size_t k = 0; k < _files.size(); k++)
+    {
+        File & file = *_files[k];
+        if (_wav)
+        {
+            file.wav_hdr.bits_per_sample = (uint16_t)(bytes * 8);
+            file.wav_hdr.sample_rate = sampling_rate;
+            file.wav_hdr.num_channels = (uint16_t)file_channels;
+            file.wav_hdr.block_align = (uint16_t)(bytes * file_channels);
+            file.wav_hdr.bytes_per_sec = sampling_rate * file.wav_hdr.block_align;
+            file.wav_hdr.data_size = 0;
+            file.channel_mask = wav_channel_mask(num_channels, _planar ? (int32_t)k : -1);
+            if (!write_wav_header(file.fp, file.wav_hdr, _format, file.channel_mask))
+                return "Error writing output file.";
+        }
+        file.writer.Start(file.fp, buffer_size);
+    }
+
+    _num_channels = num_channels;
+    return NULL;
+}
+
+const char * PcmOutput::Write(const uint8_t * pcm, int32_t size, int32_t src_bytes, int32_t sampling_rate, int32_t num_channels)
+{
+    if (num_channels <= 0 || size <= 0)
+        return NULL;
+
+    if (_num_channels == 0)
+    {
+        const char * error = OpenFiles(sampling_rate, num_channels);
+        if (error)
+            return error;
+    }
+    else if (_planar && num_channels != _num_channels)
+    {
+        return "The number of channels changed, planar output needs the same channels throughout.";
+    }
+
+    const int32_t bytes = pcm_format_bytes(_format);
+    const size_t frames = size / (src_bytes * num_channels);
+    if (!_planar)
+    {
+        File & file = *_files[0];
+        const size_t count = frames * num_channels;
+        file.wav_hdr.data_size += (int32_t)(count * bytes);
+
+        // the decoder already delivers the output format
+        if (bytes == src_bytes)
+        {
+            file.writer.Write(pcm, count * bytes);
+            return NULL;
+        }
+
+        _block.resize(PCM_BLOCK_SAMPLES);
+        for (size_t i = 0; i < count; i += PCM_BLOCK_SAMPLES)
+        {
+            const size_t n = (std::min)(count - i, (size_t)PCM_BLOCK_SAMPLES);
+            pcm_unpack(pcm + i * src_bytes, src_bytes, &_block[0], n);
+            pcm_pack(&_block[0], _format, file.writer.Reserve(n * bytes), n);
+            file.writer.Commit(n * bytes);
+        }
+        return NULL;
+    }
+
+    const size_t block_frames = PCM_BLOCK_SAMPLES / num_channels;
+    _block.resize(block_frames * num_channels);
+    _planes.resize(block_frames * num_channels);
+    for (size_t i = 0; i < frames; i += block_frames)
+    {
+        const size_t n = (std::min)(frames - i, block_frames);
+        pcm_unpack(pcm + i * src_bytes * num_channels, src_bytes, &_block[0], n * num_channels);
+        pcm_deinterleave(&_block[0], num_channels, n, &_planes[0]);
+
+        for (int32_t c = 0; c < num_channels; c++)
+        {
+            File & file = *_files[c];
+            pcm_pack(&_planes[c * n], _format, file.writer.Reserve(n * bytes), n);
+            file.writer.Commit(n * bytes);
+            file.wav_hdr.data_size += (int32_t)(n * bytes);
+        }
+    }
+    return NULL;
+}
+
+const char * PcmOutput::Close()
+{
+    const char * error = NULL;
+    for (size_t k = 0; k < _files.size(); k++)
+    {
+        File & file = *_files[k];
+        if (!file.fp)
+            continue;
+
+        if (!file.writer.Finish())
+            error = "Error writing output file.";
+        else if (_wav && !write_wav_header(file.fp, file.wav_hdr, _format, file.channel_mask))
+            error = "Error writing output file.";
+        fclose(file.fp);
+    }
+    _files.clear();
+    _num_channels = 0;
+    return error;
+}
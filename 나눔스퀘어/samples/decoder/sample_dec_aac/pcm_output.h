@@ -0,0 +1,108 @@
+/********************************************************************
+ File name: pcm_output.h
+ Purpose: PCM and WAV output of the AAC decoder sample with a write-behind thread
+
+ Copyright (c) 2015 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.  Unauthorized
+ reproduction or distribution of any portion is prohibited by law.
+
+*********************************************************************/
+
+#ifndef PCM_OUTPUT_H_INCLUDED
+#define PCM_OUTPUT_H_INCLUDED
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "sample_common_misc.h"
+#include "pcm_convert.h"
+
+// size of each of the two buffers of a writer
+#define PCM_WRITER_BUFFER_SIZE      (4*1024*1024)
+
+// Writes a file on its own thread. The caller fills one buffer while the other one is written,
+// it only waits if the disk falls behind by a whole buffer.
+class PcmWriter
+{
+public:
+    PcmWriter();
+    virtual ~PcmWriter();
+
+    // the writer takes over fp until Finish(), nothing is written before that from other threads
+    void Start(FILE * fp, size_t buffer_size);
+
+    // space for size bytes (at most buffer_size) to be filled and then committed
+    uint8_t * Reserve(size_t size);
+    void Commit(size_t size);
+
+    void Write(const uint8_t * data, size_t size);
+
+    // writes the rest and stops the thread, false if a write failed
+    bool Finish();
+
+private:
+    void Submit();
+    void Run();
+
+    FILE * _fp;
+    std::vector<uint8_t> _buf[2];
+    int32_t _cur;               // buffer being filled
+    size_t _fill;
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    int32_t _pending;           // buffer being written, -1 if none
+    size_t _pending_size;
+    bool _stop;
+    bool _error;
+};
+
+// Converts decoded PCM to the output format and writes it, as WAV if the file name ends with .wav,
+// as raw PCM otherwise. Planar output goes to one mono file per channel, <name>_ch<n><extension>.
+class PcmOutput
+{
+public:
+    PcmOutput();
+    virtual ~PcmOutput();
+
+    // Returns 0 or an error message.
+    const char * Open(const char * out_file, pcm_format_t format, bool planar);
+
+    // pcm holds interleaved samples of src_bytes (2 or 3) each, the first call writes the WAV header
+    const char * Write(const uint8_t * pcm, int32_t size, int32_t src_bytes, int32_t sampling_rate, int32_t num_channels);
+
+    // writes the rest and the final WAV header
+    const char * Close();
+
+private:
+    struct File
+    {
+        std::string name;
+        FILE * fp;
+        wav_hdr_param wav_hdr;
+        uint32_t channel_mask;  // speaker position(s) of the WAV header
+        PcmWriter writer;
+    };
+
+    const char * OpenFiles(int32_t sampling_rate, int32_t num_channels);
+
+    std::vector<std::unique_ptr<File> > _files;
+    std::string _name;
+    pcm_format_t _format;
+    bool _planar;
+    bool _wav;
+    int32_t _num_channels;      // 0 until the first Write()
+
+    std::vector<int32_t> _block;
+    std::vector<int32_t> _planes;
+};
+
+#endif // PCM_OUTPUT_H_INCLUDED
@@ -14,16 +14,21 @@
 #include "sample_common_args.h"
 #include "sample_common_misc.h"
 #include "dec_aac.h"
-
-#define INPUT_BUFF_SIZE         (2048*10)
+#include "aac_decode.h"
+#include "aac_batch_decode.h"
+#include "aac_segment_decode.h"
+#include "aac_seek_decode.h"
 
 int get_bitstream_format_from_string(const char * stream_format);
 
 int main(int argc, char * argv[])
 {
-    char * in_file;
+    char * in_file = NULL;
     char * out_file;
     char * stream_format = NULL;
+    char * batch = NULL;
+    char * format = NULL;
+    char * index_file = NULL;
 
     int32_t sample_rate = -1;
     int32_t num_channels = -1;
@@ -31,14 +36,27 @@ int main(int argc, char * argv[])
     int32_t encoder_type = -1;
     int64_t playback = -1;
     int32_t lp_sbr = -1;
-
-	wav_hdr_param wav_hdr = {0};
-	int wav_flag = 0;
+    int32_t num_threads = 0;
+    int32_t segments = 0;
+    int32_t preroll = -1;
+    int32_t verify = 0;
+    int32_t planar = 0;
+    int64_t seek = -1;
+    int64_t duration = -1;
 
     constexpr int32_t ID_LP_SBR = IDC_CUSTOM_START_ID + 1;
+    constexpr int32_t ID_BATCH = IDC_CUSTOM_START_ID + 2;
+    constexpr int32_t ID_SEGMENTS = IDC_CUSTOM_START_ID + 3;
+    constexpr int32_t ID_PREROLL = IDC_CUSTOM_START_ID + 4;
+    constexpr int32_t ID_VERIFY = IDC_CUSTOM_START_ID + 5;
+    constexpr int32_t ID_FORMAT = IDC_CUSTOM_START_ID + 6;
+    constexpr int32_t ID_PLANAR = IDC_CUSTOM_START_ID + 7;
+    constexpr int32_t ID_SEEK = IDC_CUSTOM_START_ID + 8;
+    constexpr int32_t ID_DURATION = IDC_CUSTOM_START_ID + 9;
+    constexpr int32_t ID_INDEX = IDC_CUSTOM_START_ID + 10;
 
     const std::vector<arg_item_t> params = {
-        {IDS_INPUT_FILE, 1, &in_file},        //
+        {IDS_INPUT_FILE, 0, &in_file},        //
         {IDS_OUTPUT_FILE, 1, &out_file},      //
         {ID_A_SAMPLERATE, 0, &sample_rate},   //
         {ID_A_CHANNELS, 0, &num_channels},    //
@@ -46,191 +64,92 @@ int main(int argc, char * argv[])
         {ID_A_PRIMING_CUT, 0, &priming},      //
         {ID_A_ENCODER_IDX, 0, &encoder_type}, //
         {ID_A_PLAYBACK_DUR, 0, &playback},    //
-        {ID_LP_SBR, 0, &lp_sbr}               //
+        {ID_LP_SBR, 0, &lp_sbr},              //
+        {ID_BATCH, 0, &batch},                //
+        {IDI_NUM_THREADS, 0, &num_threads},   //
+        {ID_SEGMENTS, 0, &segments},          //
+        {ID_PREROLL, 0, &preroll},            //
+        {ID_VERIFY, 0, &verify},              //
+        {ID_FORMAT, 0, &format},              //
+        {ID_PLANAR, 0, &planar},              //
+        {ID_SEEK, 0, &seek},                  //
+        {ID_DURATION, 0, &duration},          //
+        {ID_INDEX, 0, &index_file}            //
     };
 
-    const std::vector<arg_item_desc_t> custom_params{arg_item_desc_t{ID_LP_SBR, {"lp_sbr", ""}, ItemTypeInt, 0, "Enable (1) or disable (0) the Low Power SBR"}};
-
-    if (parse_program_options(argc, argv, params, custom_params) < 0) {
+    const std::vector<arg_item_desc_t> custom_params{
+        arg_item_desc_t{ID_LP_SBR, {"lp_sbr", ""}, ItemTypeInt, 0, "Enable (1) or disable (0) the Low Power SBR"},
+        arg_item_desc_t{ID_BATCH, {"batch", ""}, ItemTypeString, 0, "Decode the files listed in a file"},
+        arg_item_desc_t{ID_SEGMENTS, {"segments", ""}, ItemTypeInt, 0, "Decode an ADTS file in segments in parallel"},
+        arg_item_desc_t{ID_PREROLL, {"preroll", ""}, ItemTypeInt, 0, "Frames decoded in front of a segment"},
+        arg_item_desc_t{ID_VERIFY, {"verify", ""}, ItemTypeInt, 0, "Compare the segmented or seeking with a sequential decode"},
+        arg_item_desc_t{ID_FORMAT, {"format", ""}, ItemTypeString, 0, "Output sample format: s16, s24, s32 or f32"},
+        arg_item_desc_t{ID_PLANAR, {"planar", ""}, ItemTypeInt, 0, "Write one file per channel"},
+        arg_item_desc_t{ID_SEEK, {"seek", ""}, ItemTypeInt64, 0, "First sample to decode"},
+        arg_item_desc_t{ID_DURATION, {"duration", ""}, ItemTypeInt64, 0, "Number of samples to decode"},
+        arg_item_desc_t{ID_INDEX, {"index", ""}, ItemTypeString, 0, "Frame index sidecar file used for seeking"}};
+
+    // the input is mandatory unless the files come from a list
+    if (parse_program_options(argc, argv, params, custom_params) < 0 || (!in_file && !batch)) {
         printf("\n==== MainConcept AAC decoder sample ====\n"
                "Usage:\nsample_dec_aac.exe -i audio.aac -o audio.pcm -s 48000 -ch 2 [-ADTS | -ADIF | -RAW | -LOAS | -LATM] [-priming n ...] [-encoder_idx idx] "
-               "[-playback n] [-lp_sbr n]\n\n"
+               "[-playback n] [-lp_sbr n] [-format s16 | s24 | s32 | f32] [-planar 1]\n"
+               "sample_dec_aac.exe -batch list.txt -o out_dir [-nth n] [decoder options]\n"
+               "sample_dec_aac.exe -i audio.aac -o audio.wav -segments n [-preroll n] [-verify 1] [-nth n] [decoder options]\n"
+               "sample_dec_aac.exe -i audio.aac -o audio.wav -seek n [-duration n] [-index audio.idx] [-preroll n] [-verify 1] [decoder options]\n\n"
                "Options:\n"
                "-s\tsample rate\n"
                "-ch\tnumber of channels\n"
                "-priming\tpriming duration in PTS\n"
                "-encoder_idx\tencoder index (0 - MC, 1 - Fraunhofer)\n"
-               "-lp_sbr\tenable (1) or disable (0) the Low Power SBR. Enabled by default.\n");
+               "-lp_sbr\tenable (1) or disable (0) the Low Power SBR. Enabled by default.\n"
+               "-batch\tdecode the files listed in a text file, one per line, to out_dir/<name>.wav\n"
+               "-nth\tnumber of decoding threads with -batch and -segments, one per CPU by default\n"
+               "-segments\tsplit an ADTS file into at least n segments and decode them in parallel\n"
+               "-preroll\tframes decoded and dropped in front of every segment or the seek position, 8 by default\n"
+               "-verify\talso decode sequentially and check that the segmented or seeking output is bit-exact (1)\n"
+               "-format\toutput samples: s16 (default), s24, s32 (integer) or f32 (float)\n"
+               "-planar\twrite each channel to its own file, <name>_ch<n>.<extension> (1)\n"
+               "-seek\tfirst sample per channel to decode from an ADTS file, counted without a priming cut\n"
+               "-duration\tnumber of samples per channel to decode, to the end by default\n"
+               "-index\tframe index file, read if it matches the input, written otherwise\n");
         return 0;
     }
 
-    FILE * fp_in  = fopen(in_file, "rb");
-    if (!fp_in)
+    aac_decode_settings_t settings;
+    settings.sample_rate = sample_rate;
+    settings.num_channels = num_channels;
+    settings.bitstream_format = (stream_format != NULL) ? get_bitstream_format_from_string(stream_format + 1) : -1; // skip leading '-' for stream_format
+    settings.priming = priming;
+    settings.encoder_type = encoder_type;
+    settings.playback = playback;
+    settings.lp_sbr = lp_sbr;
+    settings.planar = planar > 0;
+
+    const int32_t pcm_format = format ? pcm_format_from_string(format) : PCM_FORMAT_S16;
+    if (pcm_format < 0)
     {
-        printf("Error opening input file.\n");
+        printf("Unknown output format %s, use s16, s24, s32 or f32.\n", format);
         return 1;
     }
+    settings.pcm_format = (pcm_format_t)pcm_format;
 
-    FILE * fp_out = fopen(out_file, "wb");
-    if (!fp_out)
-    {
-		fclose(fp_in);
-        printf("Error opening output file.\n");
-        return 1;        
-    }
+    if (batch)
+        return aac_batch_decode(settings, batch, out_file, num_threads);
 
-	char *s;
-	if (((s = strstr(out_file, ".wav")) || 
-		(s = strstr(out_file, ".WAV"))) && strlen(s) == 4)
-	{
-		wav_flag = 1;
-	}
+    if (segments > 0)
+        return aac_segment_decode(settings, in_file, out_file, segments, preroll >= 0 ? preroll : AAC_SEGMENT_PREROLL, num_threads, verify > 0);
 
-    const int MAX_CHAN = 8;
-    const int OUTPUT_BUFF_SIZE = MAX_CHAN * 2048 * sizeof(short);
+    if (seek >= 0 || duration > 0)
+        return aac_seek_decode(settings, in_file, out_file, index_file, seek >= 0 ? seek : 0, duration, preroll >= 0 ? preroll : AAC_SEGMENT_PREROLL, verify > 0);
 
-    unsigned char * mem_area = new unsigned char[INPUT_BUFF_SIZE + OUTPUT_BUFF_SIZE];
-
-    unsigned char * in_buf = mem_area;
-    unsigned char * out_buf = mem_area + INPUT_BUFF_SIZE;
-
-    aud_bfr_tt dst_bfr;
-    callbacks_t callbacks;
-    init_callbacks(callbacks);
-    bufstream_tt * pdec = createDecoderAAC(&callbacks, 0, 0);
-
-    if (!pdec)
+    aac_decode_stats_t stats;
+    if (aac_decode_file(settings, in_file, out_file, true, stats))
     {
-		fclose(fp_in);
-		fclose(fp_out);
-        printf("open_AACin_Audio_stream_ex() failed\n");
+        printf("%s\n", stats.error);
         return 1;
     }
 
-    aac_decoder_config dec_config;
-    // fill config up with -1, this value is used to mark non-change parameters
-    memset(&dec_config, AAD_PARAM_DONT_CHANGE, sizeof(dec_config));
-
-	if (num_channels != ITEM_NOT_INIT)
-		dec_config.num_channels = num_channels;
-
-	if (sample_rate != ITEM_NOT_INIT)
-		dec_config.sampling_rate = sample_rate;
-    
-    dec_config.bitstream_format = (stream_format != NULL) ? get_bitstream_format_from_string(stream_format + 1) : -1; // skip leading '-' for stream_format
-    dec_config.output_format    = AAD_DSF_16LE;
-    dec_config.decode_he        = 1;
-    if (priming != ITEM_NOT_INIT)
-        dec_config.priming_dur = priming;
-
-    if( encoder_type == AAD_ENCODER_DEFAULT ||
-        encoder_type == AAD_ENCODER_MC      ||
-        encoder_type == AAD_ENCODER_FHG)
-    {
-        dec_config.encoder_type = encoder_type;
-    }
-
-    if (playback > 0)
-        dec_config.playback_dur = playback;
-
-    if (lp_sbr >= 0)
-        dec_config.disable_low_power_sbr = !lp_sbr;
-
-    dst_bfr.bfr = 0;
-    dst_bfr.bfr_size = 0;
-    int bytes_read = 0;
-    int bytes_decoded = 0;
-    int frames_decoded = 0;
-    int ret = 0;
-    if (dec_config.bitstream_format != AAD_BSF_RAW)
-    {
-        pdec->auxinfo(pdec, 0, PARSE_AUD_HDR, NULL, 0);
-        bytes_read = (int)fread(in_buf, 1, INPUT_BUFF_SIZE, fp_in);    
-        ret = pdec->copybytes(pdec, in_buf, bytes_read);
-
-        if (ret == 0 && (num_channels <= 0 || sample_rate <= 0))
-        {
-            printf("Header is not found. The file can't be decoded.\n");
-            ret = -1;
-        }
-    }
-    else if (num_channels <= 0 || sample_rate <= 0)
-    {
-        printf("Sample rate (-s) and number of channels (-ch) shall be defined for the RAW AAC file.\n");
-        ret = -1;
-    }
-
-    if (ret >= 0 && (ret = pdec->auxinfo(pdec, 0, INIT_FRAME_PARSER, &dec_config, sizeof(dec_config))))
-    {
-        printf("Init failed\n");
-    }
-
-    if (ret < 0)
-    {
-        close_bufstream(pdec, 0);
-        fclose(fp_in);
-        fclose(fp_out);
-        return 1;
-    }
-
-    while (1)
-    {
-        if (bytes_decoded >= bytes_read && dst_bfr.bfr_size <= 0)
-        {
-            bytes_read = (int)fread(in_buf, 1, INPUT_BUFF_SIZE, fp_in);    
-            bytes_decoded = 0;
-
-            if (bytes_read == 0)	//EOF
-                break;
-        }
-
-        dst_bfr.bfr = out_buf;
-        dst_bfr.bfr_size = OUTPUT_BUFF_SIZE;
-        pdec->auxinfo(pdec, 0, PARSE_FRAMES, &dst_bfr, sizeof(dst_bfr));
-
-        int frame_size = pdec->copybytes(pdec, in_buf + bytes_decoded, bytes_read - bytes_decoded);
-        int state = pdec->auxinfo(pdec, 0, GET_PARSE_STATE, 0, 0);
-        bytes_decoded += frame_size;
-
-        if (dst_bfr.bfr_size > 0 && (state & PARSE_DONE_FLAG))
-        {
-            aac_decoded_frame_info * frame_info;
-            pdec->auxinfo(pdec, 0, GET_PIC_PARAMSP, &frame_info, sizeof(*frame_info));
-            if (wav_flag && frames_decoded == 0)
-            {
-                wav_hdr.bits_per_sample = 16;
-                wav_hdr.sample_rate = frame_info->sampling_rate;
-                wav_hdr.num_channels = frame_info->num_channels;
-                wav_hdr.block_align = (16 >> 3) * frame_info->num_channels;
-                wav_hdr.bytes_per_sec = frame_info->sampling_rate * wav_hdr.block_align;
-                wav_hdr.data_size = 0;
-                wav_header_write(fp_out, &wav_hdr);
-            }
-            printf("\r[frame %05d] %dHz %dCh HE=%d", frames_decoded++, frame_info->sampling_rate, frame_info->num_channels, frame_info->he);
-
-		    if (wav_flag)
-			    wav_data_write(fp_out, &wav_hdr, dst_bfr.bfr, dst_bfr.bfr_size);
-		    else
-		    // Write provided pcm samples out to file
-                fwrite(dst_bfr.bfr, dst_bfr.bfr_size, 1, fp_out);
-        }
-    }
-
-	if (wav_flag)
-		wav_header_write(fp_out, &wav_hdr);
-
-	if (pdec)
-		close_bufstream(pdec, 0);
-
-    if (fp_in)
-        fclose(fp_in);
-
-    if (fp_out)
-        fclose(fp_out);
-
-    if(mem_area)
-        delete [] mem_area;
-
     return 0;
 }
 
@@ -0,0 +1,78 @@
+/**
+@brief throughput regression benchmark for the HEVC decoder
+
+ Decodes a corpus of elementary streams several times after warmup runs and records the frame rate, CPU time,
+ peak resident memory of the run and the percentiles of the time between output pictures. Results can be stored as JSON
+ and compared against a previous result file; the process exits with code 2 if the throughput of any stream
+ dropped significantly (bootstrap confidence interval) by more than the threshold.
+
+@verbatim
+Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+This software is protected by copyright law and international treaties.  Unauthorized
+reproduction or distribution of any portion is prohibited by law.
+@endverbatim
+**/
+
+#include <stdio.h>
+#include "benchmark/application.h"
+#include "benchmark/report.h"
+#include "benchmark/resources.h"
+
+// Main entry point
+int main(int argc, char* argv[])
+{
+    Application application(argc, argv);
+    if (!application.initialized()) {
+        application.usage();
+        return VERDICT_ERROR;
+    }
+
+    std::vector<StreamResult> results(application.streams.size());
+    bool failed = false;
+
+    for (size_t i = 0; i < application.streams.size(); ++i) {
+        StreamResult& result = results[i];
+        result.name = application.streams[i];
+
+        Runner runner(application.settings);
+        if (!runner.load(result.name.c_str())) {
+            fprintf(stderr, "Failed to read %s\n", result.name.c_str());
+            failed = true;
+            continue;
+        }
+
+        result.bytes = runner.size();
+        result.valid = true;
+
+        for (int32_t run = -application.warmup; result.valid && run < application.repeat; ++run) {
+            Run measurement;
+            const bool warmup = run < 0;
+            printf("%s %d/%d: %s\r", warmup ? "Warmup" : "Run", (warmup ? run + application.warmup : run) + 1,
+                warmup ? application.warmup : application.repeat, result.name.c_str());
+            fflush(stdout);
+
+            result.valid = runner.run(measurement, warmup ? nullptr : &result.frame_ms);
+            if (!warmup)
+                result.runs.push_back(measurement);
+        }
+
+        if (!result.valid) {
+            fprintf(stderr, "\nFailed to decode %s\n", result.name.c_str());
+            failed = true;
+        }
+    }
+
+    // The high-water mark of the process only grows, so it is a figure of the whole run and not of a stream
+    Report report(application, results, ProcessUsage::peakRssKilobytes());
+    report.print();
+
+    if (application.result && !report.write(application.result)) {
+        fprintf(stderr, "Failed to write %s\n", application.result);
+        failed = true;
+    }
+
+    const Verdict verdict = application.baseline ? report.compare(application.baseline) : VERDICT_PASS;
+    return verdict != VERDICT_PASS ? verdict : (failed ? VERDICT_ERROR : VERDICT_PASS);
+}
@@ -0,0 +1,134 @@
+#ifndef UUID_C07B5E19_84D2_4A3F_9B60_1E8F2D7A5C43
+#define UUID_C07B5E19_84D2_4A3F_9B60_1E8F2D7A5C43
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "runner.h"
+#include "sample_common_args.h"
+
+#define ARG_CORPUS (IDC_CUSTOM_START_ID + 1)
+#define ARG_REPEAT (IDC_CUSTOM_START_ID + 2)
+#define ARG_WARMUP (IDC_CUSTOM_START_ID + 3)
+#define ARG_THREADS (IDC_CUSTOM_START_ID + 4)
+#define ARG_MULTIPROCESSING (IDC_CUSTOM_START_ID + 5)
+#define ARG_PREVIEW (IDC_CUSTOM_START_ID + 6)
+#define ARG_RESULT (IDC_CUSTOM_START_ID + 7)
+#define ARG_BASELINE (IDC_CUSTOM_START_ID + 8)
+#define ARG_THRESHOLD (IDC_CUSTOM_START_ID + 9)
+#define ARG_CONFIDENCE (IDC_CUSTOM_START_ID + 10)
+#define ARG_RESAMPLES (IDC_CUSTOM_START_ID + 11)
+#define ARG_LABEL (IDC_CUSTOM_START_ID + 12)
+#define ARG_COUNT 12
+
+#define MAX_CORPUS_LINE 1024 // The maximum length of a stream path in a corpus file
+
+// Benchmark application settings
+class Application
+{
+public:
+    Application(int argc, char* argv[])
+    {
+        executable = argv[0];
+
+        int offset = 1;
+        while (offset < argc && strcmp(argv[offset++], "--"))
+            ;
+
+        parse_args(offset - !!(argc - offset) - 1, argv + 1, ARG_COUNT, ARGUMENTS, DESCRIPTIONS, ARG_COUNT);
+
+        if (repeat == ITEM_NOT_INIT || repeat < 1)
+            repeat = 5;
+        if (warmup == ITEM_NOT_INIT || warmup < 0)
+            warmup = 1;
+        if (settings.threads == ITEM_NOT_INIT)
+            settings.threads = 0;
+        if (settings.smp == ITEM_NOT_INIT)
+            settings.smp = HEVCVD_SMP_AUTO;
+        if (settings.preview == ITEM_NOT_INIT)
+            settings.preview = HEVCVD_PREVIEW_OFF;
+        if (threshold == ITEM_NOT_INIT || threshold < 0.)
+            threshold = 3.;
+        if (confidence == ITEM_NOT_INIT || confidence <= 0. || confidence >= 100.)
+            confidence = 95.;
+        if (resamples == ITEM_NOT_INIT || resamples < 100)
+            resamples = 2000;
+
+        // Streams listed in the corpus file go first, then the ones given after "--"
+        if (corpus && !readCorpus(corpus))
+            fprintf(stderr, "Failed to read the corpus file %s\n", corpus);
+
+        for (int i = offset; i < argc; ++i)
+            streams.push_back(argv[i]);
+    }
+
+    bool initialized() const noexcept { return !streams.empty(); }
+
+    void usage() const noexcept
+    {
+        fprintf(stderr, "\nUSAGE:\n%s [options] [-- <stream1> [<stream2> ...]]\n", executable);
+        fprintf(stderr, "\nOPTIONS:\n");
+        print_help(ARGUMENTS, ARG_COUNT, DESCRIPTIONS, ARG_COUNT);
+    }
+
+    std::vector<std::string> streams{};
+    Settings settings{};
+
+    char* executable = nullptr;
+    char* corpus = nullptr;
+    char* result = nullptr;
+    char* baseline = nullptr;
+    char* label = nullptr;
+
+    int32_t repeat = 5;
+    int32_t warmup = 1;
+    int32_t resamples = 2000;
+    double threshold = 3.;
+    double confidence = 95.;
+
+private:
+    // One stream path per line, empty lines and lines starting with '#' are ignored
+    bool readCorpus(const char* filename)
+    {
+        FILE* file = fopen(filename, "rt");
+        if (!file)
+            return false;
+
+        char line[MAX_CORPUS_LINE];
+        while (fgets(line, sizeof(line), file)) {
+            size_t length = strcspn(line, "\r\n");
+            while (length && (line[length - 1] == ' ' || line[length - 1] == '\t'))
+                --length;
+            line[length] = '\0';
+
+            const char* path = line + strspn(line, " \t");
+            if (*path && *path != '#')
+                streams.push_back(path);
+        }
+
+        fclose(file);
+        return true;
+    }
+
+    arg_item_t ARGUMENTS[ARG_COUNT] = { { ARG_CORPUS, 0, &corpus }, { ARG_REPEAT, 0, &repeat }, { ARG_WARMUP, 0, &warmup }, { ARG_THREADS, 0, &settings.threads },
+        { ARG_MULTIPROCESSING, 0, &settings.smp }, { ARG_PREVIEW, 0, &settings.preview }, { ARG_RESULT, 0, &result }, { ARG_BASELINE, 0, &baseline },
+        { ARG_THRESHOLD, 0, &threshold }, { ARG_CONFIDENCE, 0, &confidence }, { ARG_RESAMPLES, 0, &resamples }, { ARG_LABEL, 0, &label } };
+
+    // clang-format off
+    arg_item_desc_t DESCRIPTIONS[ARG_COUNT] = {
+        { ARG_CORPUS, { "corpus", "" }, ItemTypeString, 0,                              "Text file listing the streams to decode, one path per line.       |  Streams can also be given after \"--\"" },
+        { ARG_REPEAT, { "repeat", "" }, ItemTypeInt, 5,                                 "The number of measured decodes of each stream.                     |  By default each stream is decoded 5 times" },
+        { ARG_WARMUP, { "warmup", "" }, ItemTypeInt, 1,                                 "The number of decodes of each stream preceding the measurements.   |  By default a single warmup decode is done" },
+        { ARG_THREADS, { "threads", "" }, ItemTypeInt, 0,                               "The number of worker threads.                                      |  By default the number of threads is set to the number of CPU cores" },
+        { ARG_MULTIPROCESSING, { "smp", "" }, ItemTypeInt, HEVCVD_SMP_AUTO,             "Choose ST {0}, overlapped MT {1}, or concurrent MT {2} decoding.   |  By default the decoder chooses the mode" },
+        { ARG_PREVIEW, { "previewmode", "pm" }, ItemTypeInt, HEVCVD_PREVIEW_OFF,        "Preview mode {0..4}, see hevcdec.cfg.                              |  By default the standard decoding {0} is used" },
+        { ARG_RESULT, { "json", "" }, ItemTypeString, 0,                                "Write the results to the JSON file.                                |  By default the results are only printed" },
+        { ARG_BASELINE, { "baseline", "" }, ItemTypeString, 0,                          "Compare the results against the JSON file of a previous run.       |  By default no comparison is done" },
+        { ARG_THRESHOLD, { "threshold", "" }, ItemTypeDouble, 0,                        "Throughput loss in percent tolerated before reporting regression.  |  By default 3%" },
+        { ARG_CONFIDENCE, { "confidence", "" }, ItemTypeDouble, 0,                      "Confidence level in percent of the bootstrap intervals.            |  By default 95%" },
+        { ARG_RESAMPLES, { "resamples", "" }, ItemTypeInt, 2000,                        "The number of bootstrap resamples.                                 |  By default 2000" },
+        { ARG_LABEL, { "label", "" }, ItemTypeString, 0,                                "Free text stored with the results, e.g. the SDK drop.              |  Empty by default" } };
+    // clang-format on
+};
+#endif
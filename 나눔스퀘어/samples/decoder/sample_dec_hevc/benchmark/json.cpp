@@ -0,0 +1,253 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "json.h"
+
+namespace json
+{
+const Value& Value::null() noexcept
+{
+    static const Value NONE_VALUE;
+    return NONE_VALUE;
+}
+
+const Value& Value::operator[](const char* key) const noexcept
+{
+    for (size_t i = 0; i < keys.size(); ++i)
+        if (keys[i] == key)
+            return items[i];
+
+    return null();
+}
+
+std::vector<double> Value::numbers() const
+{
+    std::vector<double> result;
+    for (const Value& item : items)
+        if (item.type == NUMBER)
+            result.push_back(item.number);
+
+    return result;
+}
+
+// Recursive descent parser over a NUL-terminated buffer
+class Parser
+{
+public:
+    explicit Parser(const char* text) noexcept : m_cursor(text) {}
+
+    bool parse(Value& value)
+    {
+        if (!parseValue(value))
+            return false;
+
+        skip();
+        return *m_cursor == '\0';
+    }
+
+private:
+    void skip() noexcept
+    {
+        while (isspace(static_cast<unsigned char>(*m_cursor)))
+            ++m_cursor;
+    }
+
+    bool expect(const char* literal) noexcept
+    {
+        const size_t length = strlen(literal);
+        if (strncmp(m_cursor, literal, length))
+            return false;
+
+        m_cursor += length;
+        return true;
+    }
+
+    bool parseString(std::string& text)
+    {
+        if (*m_cursor++ != '"')
+            return false;
+
+        while (*m_cursor && *m_cursor != '"') {
+            if (*m_cursor == '\\') {
+                switch (*++m_cursor) {
+                    case 'n':
+                        text += '\n';
+                        break;
+                    case 't':
+                        text += '\t';
+                        break;
+                    case 'r':
+                        text += '\r';
+                        break;
+                    case '\0':
+                        return false;
+                    default:
+                        text += *m_cursor; // '"', '\\' and '/'; \u escapes are never written by the benchmark
+                        break;
+                }
+                ++m_cursor;
+            }
+            else {
+                text += *m_cursor++;
+            }
+        }
+
+        return *m_cursor++ == '"';
+    }
+
+    bool parseValue(Value& value)
+    {
+        skip();
+        switch (*m_cursor) {
+            case '{':
+                value.type = Value::OBJECT;
+                ++m_cursor;
+                skip();
+                if (*m_cursor == '}')
+                    return ++m_cursor, true;
+
+                do {
+                    skip();
+                    value.keys.emplace_back();
+                    value.items.emplace_back();
+                    if (!parseString(value.keys.back()))
+                        return false;
+
+                    skip();
+                    if (*m_cursor++ != ':' || !parseValue(value.items.back()))
+                        return false;
+
+                    skip();
+                } while (*m_cursor == ',' && ++m_cursor);
+
+                return *m_cursor++ == '}';
+
+            case '[':
+                value.type = Value::ARRAY;
+                ++m_cursor;
+                skip();
+                if (*m_cursor == ']')
+                    return ++m_cursor, true;
+
+                do {
+                    value.items.emplace_back();
+                    if (!parseValue(value.items.back()))
+                        return false;
+
+                    skip();
+                } while (*m_cursor == ',' && ++m_cursor);
+
+                return *m_cursor++ == ']';
+
+            case '"':
+                value.type = Value::STRING;
+                return parseString(value.string);
+
+            case 't':
+                value.type = Value::BOOLEAN;
+                value.number = 1.;
+                return expect("true");
+
+            case 'f':
+                value.type = Value::BOOLEAN;
+                return expect("false");
+
+            case 'n':
+                return expect("null");
+
+            default: {
+                char* end = nullptr;
+                value.type = Value::NUMBER;
+                value.number = strtod(m_cursor, &end);
+                if (end == m_cursor)
+                    return false;
+
+                m_cursor = end;
+                return true;
+            }
+        }
+    }
+
+    const char* m_cursor;
+};
+
+bool load(const char* filename, Value& value)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+        return false;
+
+    std::string text;
+    char buffer[64 * 1024];
+    for (size_t size; (size = fread(buffer, 1, sizeof(buffer), file)) != 0;)
+        text.append(buffer, size);
+
+    fclose(file);
+    return Parser(text.c_str()).parse(value);
+}
+
+void Writer::prefix(const char* key) noexcept
+{
+    fprintf(m_file, "%s\n%*s", m_first.back() ? "" : ",", static_cast<int>(2 * (m_first.size() - 1)), "");
+    m_first.back() = false;
+
+    if (key)
+        fprintf(m_file, "\"%s\": ", key);
+}
+
+void Writer::open(const char* key, char bracket) noexcept
+{
+    if (m_first.size() > 1 || !m_first.back())
+        prefix(key);
+
+    fputc(bracket, m_file);
+    m_first.push_back(true);
+}
+
+void Writer::close(char bracket) noexcept
+{
+    const bool empty = m_first.back();
+    m_first.pop_back();
+
+    if (!empty)
+        fprintf(m_file, "\n%*s", static_cast<int>(2 * (m_first.size() - 1)), "");
+
+    fputc(bracket, m_file);
+    if (m_first.size() == 1)
+        fputc('\n', m_file);
+}
+
+void Writer::value(const char* key, const char* text) noexcept
+{
+    prefix(key);
+    fputc('"', m_file);
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\')
+            fputc('\\', m_file);
+        fputc(*text, m_file);
+    }
+    fputc('"', m_file);
+}
+
+void Writer::value(const char* key, double number) noexcept
+{
+    prefix(key);
+    fprintf(m_file, "%.6g", number);
+}
+
+void Writer::value(const char* key, uint64_t number) noexcept
+{
+    prefix(key);
+    fprintf(m_file, "%" PRIu64, number);
+}
+
+void Writer::value(const char* key, const std::vector<double>& numbers) noexcept
+{
+    prefix(key);
+    fputc('[', m_file);
+    for (size_t i = 0; i < numbers.size(); ++i)
+        fprintf(m_file, "%s%.6g", i ? ", " : "", numbers[i]);
+    fputc(']', m_file);
+}
+} // namespace json
@@ -0,0 +1,69 @@
+#ifndef UUID_E51C7A3D_92F0_4B6A_8E47_0DA6C3B1F284
+#define UUID_E51C7A3D_92F0_4B6A_8E47_0DA6C3B1F284
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal JSON support for the benchmark result files. Only what the result format needs is implemented
+namespace json
+{
+// Parsed JSON value
+struct Value
+{
+    enum Type
+    {
+        NONE,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    const Value& operator[](const char* key) const noexcept;
+    const Value& at(size_t index) const noexcept { return index < items.size() ? items[index] : null(); }
+
+    size_t size() const noexcept { return items.size(); }
+    std::vector<double> numbers() const;
+
+    static const Value& null() noexcept;
+
+    Type type = NONE;
+    double number = 0.;
+    std::string string;
+    std::vector<Value> items;             // ARRAY elements or OBJECT values
+    std::vector<std::string> keys;        // OBJECT keys, parallel to `items`
+};
+
+// Parse a whole file, returns false on a syntax error
+bool load(const char* filename, Value& value);
+
+// Streaming writer producing indented JSON
+class Writer
+{
+public:
+    explicit Writer(FILE* file) noexcept : m_file(file) {}
+
+    void beginObject(const char* key = nullptr) noexcept { open(key, '{'); }
+    void endObject() noexcept { close('}'); }
+    void beginArray(const char* key = nullptr) noexcept { open(key, '['); }
+    void endArray() noexcept { close(']'); }
+
+    void value(const char* key, const char* text) noexcept;
+    void value(const char* key, double number) noexcept;
+    void value(const char* key, uint64_t number) noexcept;
+    void value(const char* key, const std::vector<double>& numbers) noexcept;
+
+private:
+    void open(const char* key, char bracket) noexcept;
+    void close(char bracket) noexcept;
+    void prefix(const char* key) noexcept;
+
+    FILE* m_file;
+    std::vector<bool> m_first{ true }; // No element emitted yet at the given nesting level
+};
+} // namespace json
+#endif
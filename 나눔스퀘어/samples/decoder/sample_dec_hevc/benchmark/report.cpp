@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include "report.h"
+#include "json.h"
+#include "statistics.h"
+
+#define SEPARATOR "------------------------------------------------------------------------------------------------------------------\n"
+
+// Per-run series of a stream result
+static std::vector<double> series(const StreamResult& result, double (*metric)(const Run&))
+{
+    std::vector<double> values;
+    for (const Run& run : result.runs)
+        values.push_back(metric(run));
+
+    return values;
+}
+
+static double fpsOf(const Run& run) { return run.fps(); }
+static double cpuOf(const Run& run) { return run.cpu_ms; }
+static double wallOf(const Run& run) { return run.wall_ms; }
+
+static const char* streamName(const std::string& path)
+{
+    const size_t slash = path.find_last_of("/\\");
+    return path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+void Report::print() const noexcept
+{
+    statistics::Bootstrap bootstrap(m_application.resamples, m_application.confidence);
+
+    printf("\n%s%-32s %6s %9s %19s %9s %8s %8s %8s\n%s", SEPARATOR, "STREAM", "FRAMES", "FPS", "FPS CI", "CPU, ms", "P50, ms", "P90, ms", "P99, ms",
+        SEPARATOR);
+
+    for (const StreamResult& result : m_results) {
+        if (!result.valid) {
+            printf("%-32.32s FAILED\n", streamName(result.name));
+            continue;
+        }
+
+        std::vector<double> frame_ms(result.frame_ms);
+        std::sort(frame_ms.begin(), frame_ms.end());
+
+        const std::vector<double> fps = series(result, fpsOf);
+        const Interval interval = bootstrap.mean(fps);
+        printf("%-32.32s %6u %9.2f [%8.2f;%8.2f] %9.1f %8.2f %8.2f %8.2f\n", streamName(result.name), result.runs.front().frames,
+            statistics::mean(fps), interval.low, interval.high, statistics::mean(series(result, cpuOf)), statistics::percentile(frame_ms, 50.),
+            statistics::percentile(frame_ms, 90.), statistics::percentile(frame_ms, 99.));
+    }
+
+    printf("%sPeak RSS of the run: %" PRIu64 " KB\n", SEPARATOR, m_peak_rss_kb);
+}
+
+bool Report::write(const char* filename) const noexcept
+{
+    FILE* file = fopen(filename, "wt");
+    if (!file)
+        return false;
+
+    char timestamp[32] = "";
+    const time_t now = time(nullptr);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    statistics::Bootstrap bootstrap(m_application.resamples, m_application.confidence);
+    json::Writer writer(file);
+
+    writer.beginObject();
+    writer.value("format", "sample_dec_hevc_benchmark");
+    writer.value("version", static_cast<uint64_t>(RESULT_FORMAT_VERSION));
+    writer.value("label", m_application.label ? m_application.label : "");
+    writer.value("timestamp", timestamp);
+    writer.value("peak_rss_kb", m_peak_rss_kb);
+
+    writer.beginObject("settings");
+    writer.value("repeat", static_cast<uint64_t>(m_application.repeat));
+    writer.value("warmup", static_cast<uint64_t>(m_application.warmup));
+    writer.value("threads", static_cast<double>(m_application.settings.threads));
+    writer.value("smp", static_cast<double>(m_application.settings.smp));
+    writer.value("preview", static_cast<double>(m_application.settings.preview));
+    writer.value("confidence", m_application.confidence);
+    writer.endObject();
+
+    writer.beginArray("streams");
+    for (const StreamResult& result : m_results) {
+        if (!result.valid)
+            continue;
+
+        std::vector<double> frame_ms(result.frame_ms);
+        std::sort(frame_ms.begin(), frame_ms.end());
+
+        const std::vector<double> fps = series(result, fpsOf);
+        const Interval interval = bootstrap.mean(fps);
+
+        writer.beginObject();
+        writer.value("name", streamName(result.name));
+        writer.value("bytes", result.bytes);
+        writer.value("frames", static_cast<uint64_t>(result.runs.front().frames));
+        writer.value("fps", fps);
+        writer.value("wall_ms", series(result, wallOf));
+        writer.value("cpu_ms", series(result, cpuOf));
+        writer.value("fps_mean", statistics::mean(fps));
+        writer.value("fps_ci", std::vector<double>{ interval.low, interval.high });
+        writer.beginObject("frame_ms");
+        writer.value("p50", statistics::percentile(frame_ms, 50.));
+        writer.value("p90", statistics::percentile(frame_ms, 90.));
+        writer.value("p99", statistics::percentile(frame_ms, 99.));
+        writer.value("max", frame_ms.empty() ? 0. : frame_ms.back());
+        writer.endObject();
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+
+    return fclose(file) == 0;
+}
+
+Verdict Report::compare(const char* filename) const noexcept
+{
+    json::Value baseline;
+    if (!json::load(filename, baseline) || baseline["format"].string != "sample_dec_hevc_benchmark") {
+        fprintf(stderr, "Failed to read the baseline %s\n", filename);
+        return VERDICT_ERROR;
+    }
+
+    if (baseline["version"].number != RESULT_FORMAT_VERSION) {
+        fprintf(stderr, "The baseline format version %d is not supported, expected %d\n", static_cast<int>(baseline["version"].number),
+            RESULT_FORMAT_VERSION);
+        return VERDICT_ERROR;
+    }
+
+    statistics::Bootstrap bootstrap(m_application.resamples, m_application.confidence);
+    Verdict verdict = VERDICT_PASS;
+
+    printf("\nBASELINE %s (%s)\n%s%-32s %9s %9s %8s %19s  %s\n%s", filename, baseline["label"].string.c_str(), SEPARATOR, "STREAM", "BASE FPS", "FPS",
+        "CHANGE", "CHANGE CI", "VERDICT", SEPARATOR);
+
+    const json::Value& streams = baseline["streams"];
+    for (const StreamResult& result : m_results) {
+        if (!result.valid)
+            continue;
+
+        const json::Value* reference = nullptr;
+        for (size_t i = 0; i < streams.size() && !reference; ++i)
+            if (streams.at(i)["name"].string == streamName(result.name))
+                reference = &streams.at(i);
+
+        if (!reference) {
+            printf("%-32.32s %9s %9.2f %8s %19s  NEW\n", streamName(result.name), "-", statistics::mean(series(result, fpsOf)), "-", "-");
+            continue;
+        }
+
+        const std::vector<double> base = (*reference)["fps"].numbers();
+        const std::vector<double> current = series(result, fpsOf);
+        const double change = statistics::mean(base) > 0. ? statistics::mean(current) / statistics::mean(base) - 1. : 0.;
+        const Interval interval = bootstrap.change(base, current);
+
+        // Regression only when the whole interval is below zero and the estimate exceeds the tolerance, so noise alone never fails the check
+        const char* status = "OK";
+        if (interval.high < 0. && -change * 100. > m_application.threshold) {
+            status = "REGRESSION";
+            verdict = VERDICT_REGRESSION;
+        }
+        else if (interval.low > 0.) {
+            status = "FASTER";
+        }
+        else if (interval.high < 0.) {
+            status = "SLOWER (within threshold)";
+        }
+
+        printf("%-32.32s %9.2f %9.2f %+7.2f%% [%+7.2f%%;%+7.2f%%]  %s\n", streamName(result.name), statistics::mean(base), statistics::mean(current),
+            change * 100., interval.low * 100., interval.high * 100., status);
+    }
+
+    printf("%s", SEPARATOR);
+    return verdict;
+}
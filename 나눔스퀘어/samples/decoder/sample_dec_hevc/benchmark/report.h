@@ -0,0 +1,35 @@
+#ifndef UUID_4F2A8C61_D73E_4B09_A1C5_6E90B3D72F18
+#define UUID_4F2A8C61_D73E_4B09_A1C5_6E90B3D72F18
+
+#include <vector>
+#include "application.h"
+#include "runner.h"
+
+// Version of the result file layout. Bump it whenever fields change their meaning
+#define RESULT_FORMAT_VERSION 2
+
+// Comparison verdicts, used as the process exit code
+enum Verdict
+{
+    VERDICT_PASS = 0,
+    VERDICT_ERROR = 1,
+    VERDICT_REGRESSION = 2
+};
+
+// Summary, storage, and baseline comparison of the benchmark results
+class Report
+{
+public:
+    Report(const Application& application, const std::vector<StreamResult>& results, uint64_t peak_rss_kb) noexcept
+        : m_application(application), m_results(results), m_peak_rss_kb(peak_rss_kb) {}
+
+    void print() const noexcept;
+    bool write(const char* filename) const noexcept;
+    Verdict compare(const char* filename) const noexcept;
+
+private:
+    const Application& m_application;
+    const std::vector<StreamResult>& m_results;
+    const uint64_t m_peak_rss_kb; // Of the whole process, all streams share it
+};
+#endif
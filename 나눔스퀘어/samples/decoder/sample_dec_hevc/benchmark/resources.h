@@ -0,0 +1,58 @@
+#ifndef UUID_3B0F4C52_6E1A_4C8E_9D1B_2F7A40C5E913
+#define UUID_3B0F4C52_6E1A_4C8E_9D1B_2F7A40C5E913
+
+#include <inttypes.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+// Resources consumed by the current process, including all decoder worker threads
+struct ProcessUsage
+{
+    // User plus kernel CPU time in milliseconds
+    static double cpuMilliseconds() noexcept
+    {
+#if defined(_WIN32)
+        FILETIME creation, exit, kernel, user;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+            return 0.;
+
+        const uint64_t kernel_ticks = (uint64_t(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+        const uint64_t user_ticks = (uint64_t(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+        return (kernel_ticks + user_ticks) / 10000.; // 100 ns units
+#else
+        struct rusage usage = {};
+        if (getrusage(RUSAGE_SELF, &usage))
+            return 0.;
+
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000. + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.;
+#endif
+    }
+
+    // Peak resident set size in kilobytes
+    static uint64_t peakRssKilobytes() noexcept
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters = {};
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return 0;
+
+        return counters.PeakWorkingSetSize / 1024;
+#else
+        struct rusage usage = {};
+        if (getrusage(RUSAGE_SELF, &usage))
+            return 0;
+#if defined(__APPLE__)
+        return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+        return usage.ru_maxrss; // kilobytes on Linux
+#endif
+#endif
+    }
+};
+#endif
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <algorithm>
+#include <limits>
+#include "runner.h"
+#include "resources.h"
+#include "misc.h"
+
+bool Runner::load(const char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+        return false;
+
+    m_data.clear();
+    uint8_t buffer[DEFAULT_FEED_SIZE];
+    for (size_t size; (size = fread(buffer, 1, sizeof(buffer), file)) != 0;)
+        m_data.insert(m_data.end(), buffer, buffer + size);
+
+    fclose(file);
+    return !m_data.empty();
+}
+
+bool Runner::configure(bufstream_tt* decoder) const noexcept
+{
+    return decoder->auxinfo(decoder, 0, PARSE_INIT, nullptr, 0) == BS_OK &&
+        decoder->auxinfo(decoder, INTERN_REORDERING_FLAG, PARSE_OPTIONS, nullptr, 0) == BS_OK &&
+        decoder->auxinfo(decoder, m_settings.preview, SET_PREVIEW_MODE, nullptr, 0) == BS_OK &&
+        decoder->auxinfo(decoder, SKIP_NONE, PARSE_FRAMES, nullptr, 0) == BS_OK &&
+        decoder->auxinfo(decoder, m_settings.threads, SET_CPU_NUM, nullptr, 0) == BS_OK &&
+        decoder->auxinfo(decoder, m_settings.smp, SET_SMP_MODE, nullptr, 0) == BS_OK;
+}
+
+bool Runner::run(Run& run, std::vector<double>* frame_ms) noexcept
+{
+    callbacks_t callbacks{};
+    callbacks.context.p = this;
+
+    callbacks_decoder_hevc_t hevc_callbacks{};
+    hevc_callbacks.pic_output_callback = pictureOutputCallback;
+
+    stream_params_t parameters{};
+    parameters.nodeset = (std::numeric_limits<uint64_t>::max)();
+
+    m_frame_ms = frame_ms;
+    m_frames = 0;
+
+    // Decoder creation and configuration are part of every run, like in a real playback session
+    const double cpu_start = ProcessUsage::cpuMilliseconds();
+    const uint64_t wall_start = m_last_output = time_get_count();
+
+    bufstream_tt* decoder = createDecoderHEVC(&callbacks, &hevc_callbacks, &parameters);
+    if (!decoder)
+        return false;
+
+    bool valid = configure(decoder);
+    for (size_t offset = 0; valid && offset < m_data.size();) {
+        const uint32_t chunk = static_cast<uint32_t>(std::min<size_t>(DEFAULT_FEED_SIZE, m_data.size() - offset));
+        offset += decoder->copybytes(decoder, &m_data[offset], chunk);
+        valid = !(decoder->auxinfo(decoder, 0, CLEAN_PARSE_STATE, nullptr, 0) & INTERNAL_ERROR);
+    }
+
+    while (valid && decoder->copybytes(decoder, nullptr, 0))
+        valid = !(decoder->auxinfo(decoder, 0, CLEAN_PARSE_STATE, nullptr, 0) & INTERNAL_ERROR);
+
+    close_bufstream(decoder, 0);
+
+    run.wall_ms = (time_get_count() - wall_start) * 1000. / time_get_freq();
+    run.cpu_ms = ProcessUsage::cpuMilliseconds() - cpu_start;
+    run.frames = m_frames;
+    return valid && m_frames > 0;
+}
+
+// Called in display order, records the time elapsed since the previous output picture
+void Runner::pictureOutputCallback(context_t context, const hevc_picture_t* picture)
+{
+    Runner* runner = reinterpret_cast<Runner*>(context.p);
+    if (!picture || picture->skipped)
+        return;
+
+    const uint64_t now = time_get_count();
+    if (runner->m_frame_ms)
+        runner->m_frame_ms->push_back((now - runner->m_last_output) * 1000. / time_get_freq());
+
+    runner->m_last_output = now;
+    ++runner->m_frames;
+}
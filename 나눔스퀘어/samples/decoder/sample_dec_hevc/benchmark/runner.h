@@ -0,0 +1,62 @@
+#ifndef UUID_6A94D0E2_1F3B_47C8_B5E9_C27D8A4F1B36
+#define UUID_6A94D0E2_1F3B_47C8_B5E9_C27D8A4F1B36
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include "dec_hevc.h"
+
+#define DEFAULT_FEED_SIZE (64 * 1024) // Same chunk size as the file reader of sample_dec_hevc
+
+// Decoder settings shared by all runs
+struct Settings
+{
+    int32_t threads = 0;
+    int32_t smp = HEVCVD_SMP_AUTO;
+    int32_t preview = HEVCVD_PREVIEW_OFF;
+};
+
+// Measurements of a single decode of a stream
+struct Run
+{
+    double wall_ms = 0.;
+    double cpu_ms = 0.;
+    uint32_t frames = 0;
+
+    double fps() const noexcept { return wall_ms > 0. ? frames * 1000. / wall_ms : 0.; }
+};
+
+// Measurements of all repetitions of a corpus stream
+struct StreamResult
+{
+    std::string name;
+    uint64_t bytes = 0;
+    std::vector<Run> runs;
+    std::vector<double> frame_ms; // Time between successive output pictures, collected over all measured runs
+    bool valid = false;
+};
+
+// Decodes a stream held in memory, so that disk I/O does not take part in the measurement
+class Runner
+{
+public:
+    explicit Runner(const Settings& settings) noexcept : m_settings(settings) {}
+
+    bool load(const char* filename);
+    bool run(Run& run, std::vector<double>* frame_ms) noexcept;
+
+    uint64_t size() const noexcept { return m_data.size(); }
+
+private:
+    static void pictureOutputCallback(context_t context, const hevc_picture_t* picture);
+
+    bool configure(bufstream_tt* decoder) const noexcept;
+
+    const Settings m_settings;
+    std::vector<uint8_t> m_data;
+
+    std::vector<double>* m_frame_ms = nullptr;
+    uint64_t m_last_output = 0;
+    uint32_t m_frames = 0;
+};
+#endif
@@ -0,0 +1,90 @@
+#ifndef UUID_8D2E61A7_0C4B_4F5E_A6D3_94B1E7C2F058
+#define UUID_8D2E61A7_0C4B_4F5E_A6D3_94B1E7C2F058
+
+#include <inttypes.h>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Confidence interval of a statistic
+struct Interval
+{
+    double low;
+    double high;
+};
+
+namespace statistics
+{
+inline double mean(const std::vector<double>& samples) noexcept
+{
+    return samples.empty() ? 0. : std::accumulate(samples.begin(), samples.end(), 0.) / samples.size();
+}
+
+// Percentile with linear interpolation between the closest ranks, `samples` must be sorted
+inline double percentile(const std::vector<double>& samples, double rank) noexcept
+{
+    if (samples.empty())
+        return 0.;
+
+    const double position = rank / 100. * (samples.size() - 1);
+    const size_t lower = static_cast<size_t>(position);
+    const size_t upper = std::min(lower + 1, samples.size() - 1);
+    return samples[lower] + (samples[upper] - samples[lower]) * (position - lower);
+}
+
+// Percentile bootstrap. The seed is fixed so that the same inputs always produce the same interval
+class Bootstrap
+{
+public:
+    Bootstrap(uint32_t resamples, double confidence) noexcept : m_resamples(resamples ? resamples : 1), m_confidence(confidence), m_engine(0x5eed) {}
+
+    // Interval of the mean of `samples`
+    Interval mean(const std::vector<double>& samples) noexcept
+    {
+        std::vector<double> means(m_resamples);
+        for (double& value : means)
+            value = resample(samples);
+
+        return interval(means);
+    }
+
+    // Interval of the relative change of the mean, `current` against `baseline`, e.g. -0.05 is 5% lower
+    Interval change(const std::vector<double>& baseline, const std::vector<double>& current) noexcept
+    {
+        std::vector<double> changes(m_resamples);
+        for (double& value : changes) {
+            const double base = resample(baseline);
+            value = base > 0. ? resample(current) / base - 1. : 0.;
+        }
+
+        return interval(changes);
+    }
+
+private:
+    double resample(const std::vector<double>& samples) noexcept
+    {
+        if (samples.empty())
+            return 0.;
+
+        std::uniform_int_distribution<size_t> pick(0, samples.size() - 1);
+        double sum = 0.;
+        for (size_t i = 0; i < samples.size(); ++i)
+            sum += samples[pick(m_engine)];
+
+        return sum / samples.size();
+    }
+
+    Interval interval(std::vector<double>& values) const noexcept
+    {
+        std::sort(values.begin(), values.end());
+        const double tail = (100. - m_confidence) / 2.;
+        return { percentile(values, tail), percentile(values, 100. - tail) };
+    }
+
+    const uint32_t m_resamples;
+    const double m_confidence;
+    std::mt19937_64 m_engine;
+};
+} // namespace statistics
+#endif
@@ -35,7 +35,12 @@ public:
         hw_adapter(ITEM_NOT_INIT),
         hw_acc_name(NULL),
         cc_pix_range(RANGE_FULL_TO_FULL),
-        transfer_characteristics(ITEM_NOT_INIT)
+        transfer_characteristics(ITEM_NOT_INIT),
+        seek_frame(ITEM_NOT_INIT),
+        seek_poc(ITEM_NOT_INIT),
+        seek_index_file_name(NULL),
+        segments(ITEM_NOT_INIT),
+        trick_play(ITEM_NOT_INIT)
     {
         const std::map<std::string, hevc_decoding_toolset_t>& toolsets = enumerateDecodingToolsets();
 
@@ -65,6 +70,11 @@ public:
         m_params.push_back(ArgItem(IDN_LOCAL_PIXEL_RANGE, 0, &cc_pix_range));
         m_params.push_back(ArgItem(IDN_LOCAL_DEINTERLACING_MODE, 0, &deinterlacing_mode));
         m_params.push_back(ArgItem(IDN_LOCAL_TRANSFER_CHARACTERISTICS, 0, &transfer_characteristics));
+        m_params.push_back(ArgItem(IDN_LOCAL_SEEK_FRAME, 0, &seek_frame));
+        m_params.push_back(ArgItem(IDN_LOCAL_SEEK_POC, 0, &seek_poc));
+        m_params.push_back(ArgItem(IDS_LOCAL_SEEK_INDEX, 0, &seek_index_file_name));
+        m_params.push_back(ArgItem(IDN_LOCAL_SEGMENTS, 0, &segments));
+        m_params.push_back(ArgItem(IDN_LOCAL_TRICK_PLAY, 0, &trick_play));
 
         m_custom_params.push_back(ArgItemDescription(IDN_V_FOURCC, "<fourcc>", "cs", ItemTypeInt, 0,
             "output frames using specified colorspace, default is native colorspace of stream (for example I420 for 8-bit 4:2:0 stream (when SW decoding is "
@@ -100,6 +110,17 @@ public:
         m_custom_params.push_back(ArgItemDescription(IDN_LOCAL_DEINTERLACING_MODE, "deinterlacing_mode", "dm", ItemTypeInt, ITEM_NOT_INIT,
             "select deinterlacing mode for interlaced video, default value is 0, possible values: 0 - output by fields, 1 - interfield interpolation, 2 - top "
             "field stretching, 3 - bottom field stretching, 4 - weave"));
+        m_custom_params.push_back(ArgItemDescription(IDN_LOCAL_SEEK_FRAME, "seek_frame", "sf", ItemTypeInt, ITEM_NOT_INIT,
+            "start the output with the given frame number (display order), decoding starts at the nearest preceding IRAP picture"));
+        m_custom_params.push_back(ArgItemDescription(IDN_LOCAL_SEEK_POC, "seek_poc", "", ItemTypeInt, ITEM_NOT_INIT,
+            "start the output with the first picture that has the given POC, see seek_frame"));
+        m_custom_params.push_back(ArgItemDescription(IDS_LOCAL_SEEK_INDEX, "seek_index", "", ItemTypeString, ITEM_NOT_INIT,
+            "access unit index file used for seeking, it is created by a parse-only pass if missing or outdated"));
+        m_custom_params.push_back(ArgItemDescription(IDN_LOCAL_SEGMENTS, "segments", "", ItemTypeInt, ITEM_NOT_INIT,
+            "decode closed GOP segments of the stream on the given number of decoder instances in parallel, the output stays in display order"));
+        m_custom_params.push_back(ArgItemDescription(IDN_LOCAL_TRICK_PLAY, "trick_play", "", ItemTypeInt, ITEM_NOT_INIT,
+            "play back at the given rate (for example 2, 4 or 8), temporal sub-layers not shown at this rate are not decoded and the preview mode is "
+            "raised while decoding falls behind"));
     }
 
     // initialize with command line args
@@ -130,6 +151,11 @@ public:
     int32_t cc_pix_range;
     int32_t deinterlacing_mode;
     int32_t transfer_characteristics;
+    int32_t seek_frame;
+    int32_t seek_poc;
+    char* seek_index_file_name;
+    int32_t segments;
+    int32_t trick_play;
 
 protected:
     std::vector<arg_item_t> m_params;
@@ -19,6 +19,7 @@ bool Decoder::initialize(BufstreamCreator bufstream_creator)
     // initialize stream parameters
     stream_params_t stream_params = { 0 };
     stream_params.nodeset = helper.nodeset;
+    stream_params.threadpool = helper.threadpool;
 
     initCallbacks();
 
@@ -52,13 +52,22 @@ protected:
     virtual bool handleErrors(const uint32_t state);
     virtual bool processFrame(const uint32_t state);
 
+    // Called when a picture is selected from the DPB for display and before its internally queued for display
+    // Pictures are received in display order.
+    static void pictureOutputCallback(context_t context, const hevc_picture_t* hevc_pic);
+    // Called as each NALU is parsed from the stream
+    static void naluCallback(context_t context, const hevc_picture_t* hevc_pic, const hevc_nalu_t* nalu);
+
+    // Prepare m_frame for GET_PIC according to the requested colorspace and size
+    void initializeFrame();
+
     bufstream_tt* m_decoder;
     callbacks_t m_callbacks;
     callbacks_decoder_hevc_t m_decoder_callback;
+    frame_tt m_frame;
+    frame_colorspace_info_tt m_cs_info;
 
 private:
-    // Called as each NALU is parsed from the stream
-    static void naluCallback(context_t context, const hevc_picture_t* hevc_pic, const hevc_nalu_t* nalu);
     // Called as each sps is parsed from the stream
     static void spsCallback(context_t context, const hevc_picture_t* hevc_pic, const hevc_seq_par_set_t* sps);
     // Called as each pps is parsed from the stream
@@ -71,9 +80,6 @@ private:
     static void pictureParsedCallback(context_t context, const hevc_picture_t* hevc_pic);
     // Called when a picture is decoded. Pictures are received in decode order.
     static void pictureDecodedCallback(context_t context, const hevc_picture_t* hevc_pic);
-    // Called when a picture is selected from the DPB for display and before its internally queued for display
-    // Pictures are received in display order.
-    static void pictureOutputCallback(context_t context, const hevc_picture_t* hevc_pic);
     // Called when a picture is skipped. Pictures can be skipped because a flag like SKIP_B is active.
     static void pictureSkippedCallback(context_t context, const hevc_picture_t* hevc_pic);
     // Called when a stream or decode error occurs
@@ -83,7 +89,6 @@ private:
 
     bool getFrame();
     bool getHwFrame();
-    void initializeFrame();
     void getFrameSize(uint32_t& width, uint32_t& height);
 
     bool getFrameMd5(hevc_sei_messages_t* sei_messages, uint8_t plane_count, uint8_t* plane_md5[3]);
@@ -91,8 +96,6 @@ private:
     void initializeDictionary();
 
     uint8_t* m_buffer;
-    frame_tt m_frame;
-    frame_colorspace_info_tt m_cs_info;
     uint32_t m_buffer_size;
 };
 
@@ -101,6 +101,14 @@ bool Helper::initialize(CommandLine const& command_line, Configuration const& co
 
     license_file_name = command_line.license_file_name;
 
+    seek_frame = command_line.seek_frame;
+    seek_poc = command_line.seek_poc;
+    seek_index_file_name = command_line.seek_index_file_name;
+    if (seek_frame != ITEM_NOT_INIT && seek_poc != ITEM_NOT_INIT) {
+        fprintf(log, "Options seek_frame and seek_poc can not be set together.\n");
+        return false;
+    }
+
     skip_mode = config.skip_mode;
     cc_pix_range = command_line.cc_pix_range != ITEM_NOT_INIT ? command_line.cc_pix_range : config.cc_pix_range;
     max_temporal_layer = config.max_temporal_layer;
@@ -109,6 +117,19 @@ bool Helper::initialize(CommandLine const& command_line, Configuration const& co
     deinterlacing_mode =
         static_cast<hevc_deinterlacing_mode_t>(command_line.deinterlacing_mode != ITEM_NOT_INIT ? command_line.deinterlacing_mode : config.deinterlacing_mode);
 
+    // Segments are decoded independently, so only whole pictures reach the output and per picture SEI checks are not available
+    segments = command_line.segments != ITEM_NOT_INIT && command_line.segments > 0 ? command_line.segments : 0;
+    if (segments && (seeking() || use_callbacks || parse_frames || md5_frame)) {
+        fprintf(log, "Option segments can not be combined with seeking, parse_frames, md5_frame or the callback api.\n");
+        return false;
+    }
+
+    trick_play = command_line.trick_play != ITEM_NOT_INIT ? command_line.trick_play : 0;
+    if (trick_play < 0 || (trick_play && (seeking() || segments))) {
+        fprintf(log, "Option trick_play needs a positive rate and can not be combined with seeking or segments.\n");
+        return false;
+    }
+
     // initialize the MD5 sum if necessary
     if (md5)
         MD5Init(&m_ctx_md5);
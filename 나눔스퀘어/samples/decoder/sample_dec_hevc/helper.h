@@ -28,6 +28,8 @@ public:
         output_file(NULL),
         log(stderr),
         license_file_name(NULL),
+        seek_index_file_name(NULL),
+        threadpool(NULL),
         dec_start(0),
         dec_stop(0),
         frame_start(0),
@@ -43,6 +45,10 @@ public:
         raw_hardware_output(false),
         frame_required(false),
         convert_frame(false),
+        seek_frame(ITEM_NOT_INIT),
+        seek_poc(ITEM_NOT_INIT),
+        segments(0),
+        trick_play(0),
         m_frame_md5_exist(false)
     {
     }
@@ -80,10 +86,15 @@ public:
     void printSeiInfo(hevc_sei_messages_t const* sei);
     void printError(const char* const msg);
 
+    bool seeking() const { return seek_frame != ITEM_NOT_INIT || seek_poc != ITEM_NOT_INIT; }
+    const char* inputFileName() const { return m_input_file_name; }
+
     FILE* input_file;
     FILE* output_file;
     FILE* log;
     char* license_file_name;
+    char* seek_index_file_name; // Sidecar file with the access unit index
+    mcr_thread_pool_t threadpool; // External threadpool shared by the decoder instances, NULL for the internal one
 
     uint64_t dec_start;        // Time we start decoding the HEVC file
     uint64_t dec_stop;         // Time we stop decoding the HEVC file
@@ -123,6 +134,10 @@ public:
     bool raw_hardware_output;
     bool frame_required;
     bool convert_frame;
+    int32_t seek_frame; // Frame number in display order the output starts with
+    int32_t seek_poc;   // POC of the picture the output starts with
+    int32_t segments;   // Decoder instances decoding closed GOP segments in parallel, 0 for serial decoding
+    int32_t trick_play; // Playback rate as a multiple of the frame rate, 0 if trick play is off
     uint32_t md5_digest[4];
 
 private:
@@ -29,6 +29,11 @@
 #define IDN_LOCAL_PIXEL_RANGE (IDC_CUSTOM_START_ID + 8)
 #define IDN_LOCAL_DEINTERLACING_MODE (IDC_CUSTOM_START_ID + 9)
 #define IDN_LOCAL_TRANSFER_CHARACTERISTICS (IDC_CUSTOM_START_ID + 10)
+#define IDN_LOCAL_SEEK_FRAME (IDC_CUSTOM_START_ID + 11)
+#define IDN_LOCAL_SEEK_POC (IDC_CUSTOM_START_ID + 12)
+#define IDS_LOCAL_SEEK_INDEX (IDC_CUSTOM_START_ID + 13)
+#define IDN_LOCAL_SEGMENTS (IDC_CUSTOM_START_ID + 14)
+#define IDN_LOCAL_TRICK_PLAY (IDC_CUSTOM_START_ID + 15)
 
 const std::map<std::string, hevc_decoding_toolset_t>& enumerateDecodingToolsets();
 
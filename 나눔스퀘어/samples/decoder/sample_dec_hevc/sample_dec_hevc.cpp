@@ -10,7 +10,43 @@
 *********************************************************************/
 
 #include "unicode_tools.h"
-#include "decoder.h"
+#include "seeker.h"
+#include "segment_decoder.h"
+#include "trick_play.h"
+
+// Load the access unit index from the sidecar file or build it with a parse-only pass over the input
+static bool prepareSeekIndex(Helper& helper, SeekIndex& index)
+{
+    const uint64_t stream_size = SeekIndex::streamSize(helper.input_file);
+    const int64_t stream_time = SeekIndex::streamTime(helper.input_file);
+    if (helper.seek_index_file_name && index.load(helper.seek_index_file_name, stream_size, stream_time))
+        return true;
+
+    const uint64_t start = time_get_count();
+    if (!index.build(helper.input_file)) {
+        fprintf(helper.log, "Error: failed to index the input stream\n");
+        return false;
+    }
+
+    fprintf(helper.log, "Indexed %u access units in %.2f ms\n", static_cast<uint32_t>(index.size()), (time_get_count() - start) * 1000.0 / time_get_freq());
+
+    if (helper.seek_index_file_name && !index.save(helper.seek_index_file_name, stream_size, stream_time))
+        fprintf(helper.log, "Warning: failed to write the index file %s\n", helper.seek_index_file_name);
+
+    return true;
+}
+
+// Print the summaries once decoding is done
+static int finish(Helper& helper, int result)
+{
+    helper.finish();
+    helper.printStreamSummary();
+    helper.printSummary();
+
+    fprintf(helper.log, "\n");
+
+    return result;
+}
 
 int main(int argc, char* argv[])
 {
@@ -37,7 +73,34 @@ int main(int argc, char* argv[])
     if (!helper.initialize(command_line, config))
         return 1;
 
-    Decoder decoder(helper);
+    SeekIndex index;
+    if ((helper.seeking() || helper.segments) && !prepareSeekIndex(helper, index))
+        return 1;
+
+    if (helper.segments) {
+        ParallelDecoder decoder(helper, index);
+        if (!decoder.initialize(createDecoderHEVC))
+            return 1;
+
+        helper.start();
+        return finish(helper, decoder.run());
+    }
+
+    if (helper.trick_play) {
+        TrickPlayer decoder(helper);
+        if (!decoder.initialize(createDecoderHEVC))
+            return 1;
+
+        helper.start();
+        int result = decoder.loop();
+        if (!result)
+            result = decoder.flush();
+
+        decoder.report();
+        return finish(helper, result);
+    }
+
+    Seeker decoder(helper, index);
     if (!decoder.initialize(createDecoderHEVC))
         return 1;
 
@@ -48,6 +111,15 @@ int main(int argc, char* argv[])
 
     helper.start();
 
+    if (helper.seeking()) {
+        const size_t target = helper.seek_frame != ITEM_NOT_INIT ? index.findFrame(helper.seek_frame) : index.findPoc(helper.seek_poc);
+        if (target == SEEK_INDEX_NOT_FOUND || !decoder.seek(target)) {
+            fprintf(helper.log, "Error: failed to seek to %s %d\n", helper.seek_frame != ITEM_NOT_INIT ? "frame" : "POC",
+                helper.seek_frame != ITEM_NOT_INIT ? helper.seek_frame : helper.seek_poc);
+            return 1;
+        }
+    }
+
     /////////////////////////////////////////////////////
     // Call the main decode loop to process the HEVC file
     /////////////////////////////////////////////////////
@@ -55,11 +127,5 @@ int main(int argc, char* argv[])
     if (!result)
         result = decoder.flush();
 
-    helper.finish();
-    helper.printStreamSummary();
-    helper.printSummary();
-
-    fprintf(helper.log, "\n");
-
-    return result;
+    return finish(helper, result);
 }
@@ -0,0 +1,353 @@
+/*****************************************************************************
+ File name: seek_index.cpp
+ Purpose: access unit index of an HEVC elementary stream used for random access
+
+ Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.
+ Unauthorized reproduction or distribution of any portion is prohibited by law.
+******************************************************************************/
+
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <unordered_map>
+#include "seek_index.h"
+
+/* How many HEVC file bytes to read at a time while indexing */
+#define INDEX_READ_BUFFER_SIZE (64 * 1024)
+
+static const char SEEK_INDEX_MAGIC[8] = { 'H', 'E', 'V', 'C', 'S', 'I', 'D', 'X' };
+
+// Layout of the sidecar file: header, access units, parameter sets
+struct SeekIndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t units;
+    uint32_t parameter_sets;
+    uint32_t time_scale;
+    uint32_t num_units_in_tick;
+    uint32_t reserved;
+    uint64_t stream_size; // Used to detect a sidecar left over from another stream
+    int64_t stream_time;  // or from an edited stream of the same size
+};
+
+// State of the parse-only pass
+struct IndexBuilder
+{
+    std::vector<AccessUnitEntry>& units;
+    std::vector<hevc_nalu_t> nalus;
+    std::unordered_map<uint64_t, size_t> decode_order; // AU offset to decode order
+    uint32_t output_order;
+    uint32_t time_scale;
+    uint32_t num_units_in_tick;
+};
+
+// Called in decode order as each picture is parsed
+static void index_pic_callback(context_t context, const hevc_picture_t* picture)
+{
+    IndexBuilder* builder = reinterpret_cast<IndexBuilder*>(context.p);
+
+    AccessUnitEntry unit = {};
+    unit.offset = picture->access_unit_info.offset;
+    unit.size = picture->access_unit_info.size;
+    unit.poc = picture->poc;
+    unit.output_order = UINT32_MAX;
+
+    builder->decode_order[unit.offset] = builder->units.size();
+    builder->units.push_back(unit);
+
+    const hevc_seq_par_set_t* sps = picture->sps;
+    if (!builder->num_units_in_tick && sps && sps->vui_parameters_present_flag && sps->vui.timing_info_present && sps->vui.num_units_in_tick) {
+        builder->time_scale = sps->vui.time_scale;
+        builder->num_units_in_tick = sps->vui.num_units_in_tick;
+    }
+}
+
+// Called in display order, skipped pictures still keep their place
+static void index_pic_output_callback(context_t context, const hevc_picture_t* picture)
+{
+    IndexBuilder* builder = reinterpret_cast<IndexBuilder*>(context.p);
+
+    std::unordered_map<uint64_t, size_t>::const_iterator i = builder->decode_order.find(picture->access_unit_info.offset);
+    if (i != builder->decode_order.end())
+        builder->units[i->second].output_order = builder->output_order++;
+}
+
+static void index_nalu_callback(context_t context, const hevc_picture_t*, const hevc_nalu_t* nalu)
+{
+    IndexBuilder* builder = reinterpret_cast<IndexBuilder*>(context.p);
+    builder->nalus.push_back(*nalu);
+}
+
+bool SeekIndex::build(FILE* stream)
+{
+    m_units.clear();
+    m_parameter_sets.clear();
+    m_display.clear();
+
+    IndexBuilder builder = { m_units, {}, {}, 0, 0, 0 };
+
+    callbacks_t callbacks{};
+    callbacks.context.p = &builder;
+
+    callbacks_decoder_hevc_t hevc_callbacks{};
+    hevc_callbacks.pic_callback = index_pic_callback;
+    hevc_callbacks.pic_output_callback = index_pic_output_callback;
+    hevc_callbacks.nalu_callback = index_nalu_callback;
+
+    bufstream_tt* decoder = createDecoderHEVC(&callbacks, &hevc_callbacks, 0);
+    if (!decoder)
+        return false;
+
+    // Parse only, nothing has to be reconstructed to learn the structure of the stream
+    if (decoder->auxinfo(decoder, INTERN_REORDERING_FLAG, PARSE_OPTIONS, 0, 0) != BS_OK || decoder->auxinfo(decoder, SKIP_IPB, PARSE_FRAMES, 0, 0) != BS_OK) {
+        close_bufstream(decoder, 0);
+        return false;
+    }
+
+    uint8_t buffer[INDEX_READ_BUFFER_SIZE];
+    size_t bytes_available;
+    while (0 != (bytes_available = fread(buffer, 1, INDEX_READ_BUFFER_SIZE, stream))) {
+        uint32_t consumed = 0;
+        do {
+            consumed += decoder->copybytes(decoder, buffer + consumed, (uint32_t)(bytes_available - consumed));
+        } while (bytes_available - consumed);
+    }
+
+    while (decoder->copybytes(decoder, 0, 0))
+        ;
+
+    close_bufstream(decoder, 0);
+    fseek(stream, 0, SEEK_SET);
+
+    // NAL units arrive in stream order as do the pictures, so both lists are merged in a single pass
+    std::vector<bool> typed(m_units.size(), false);
+    size_t unit = 0;
+    for (const hevc_nalu_t& nalu : builder.nalus) {
+        if (nalu.nal_unit_type >= NALU_TYPE_VPS && nalu.nal_unit_type <= NALU_TYPE_PPS) {
+            ParameterSetEntry parameter_set = {};
+            parameter_set.offset = nalu.offset;
+            parameter_set.size = nalu.size;
+            parameter_set.nal_unit_type = nalu.nal_unit_type;
+            m_parameter_sets.push_back(parameter_set);
+            continue;
+        }
+
+        if (nalu.nal_unit_type >= NALU_TYPE_VPS)
+            continue;
+
+        while (unit < m_units.size() && nalu.offset >= m_units[unit].offset + m_units[unit].size)
+            ++unit;
+
+        // The first slice segment defines the type of the picture
+        if (unit < m_units.size() && nalu.offset >= m_units[unit].offset && !typed[unit]) {
+            m_units[unit].nal_unit_type = nalu.nal_unit_type;
+            m_units[unit].temporal_id = nalu.temporal_layer_id;
+            typed[unit] = true;
+        }
+    }
+
+    m_time_scale = builder.time_scale;
+    m_num_units_in_tick = builder.num_units_in_tick;
+
+    updateDisplayOrder();
+    return !m_units.empty();
+}
+
+bool SeekIndex::load(const char* filename, uint64_t stream_size, int64_t stream_time)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+        return false;
+
+    SeekIndexHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 && !memcmp(header.magic, SEEK_INDEX_MAGIC, sizeof(header.magic)) &&
+        header.version == SEEK_INDEX_VERSION && header.stream_size == stream_size && header.stream_time == stream_time && header.units;
+
+    if (valid) {
+        m_time_scale = header.time_scale;
+        m_num_units_in_tick = header.num_units_in_tick;
+        m_units.resize(header.units);
+        m_parameter_sets.resize(header.parameter_sets);
+        valid = fread(&m_units[0], sizeof(AccessUnitEntry), m_units.size(), file) == m_units.size() &&
+            (m_parameter_sets.empty() || fread(&m_parameter_sets[0], sizeof(ParameterSetEntry), m_parameter_sets.size(), file) == m_parameter_sets.size());
+    }
+
+    fclose(file);
+
+    if (!valid) {
+        m_units.clear();
+        m_parameter_sets.clear();
+        return false;
+    }
+
+    updateDisplayOrder();
+    return true;
+}
+
+bool SeekIndex::save(const char* filename, uint64_t stream_size, int64_t stream_time) const
+{
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+        return false;
+
+    SeekIndexHeader header = {};
+    memcpy(header.magic, SEEK_INDEX_MAGIC, sizeof(header.magic));
+    header.version = SEEK_INDEX_VERSION;
+    header.units = static_cast<uint32_t>(m_units.size());
+    header.parameter_sets = static_cast<uint32_t>(m_parameter_sets.size());
+    header.time_scale = m_time_scale;
+    header.num_units_in_tick = m_num_units_in_tick;
+    header.stream_size = stream_size;
+    header.stream_time = stream_time;
+
+    bool valid = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(&m_units[0], sizeof(AccessUnitEntry), m_units.size(), file) == m_units.size() &&
+        (m_parameter_sets.empty() || fwrite(&m_parameter_sets[0], sizeof(ParameterSetEntry), m_parameter_sets.size(), file) == m_parameter_sets.size());
+
+    return fclose(file) == 0 && valid;
+}
+
+void SeekIndex::updateDisplayOrder()
+{
+    uint32_t pictures = 0;
+    for (const AccessUnitEntry& entry : m_units)
+        if (entry.output_order != UINT32_MAX)
+            pictures = (std::max)(pictures, entry.output_order + 1);
+
+    m_display.assign(pictures, UINT32_MAX);
+    for (size_t i = 0; i < m_units.size(); ++i)
+        if (m_units[i].output_order != UINT32_MAX)
+            m_display[m_units[i].output_order] = static_cast<uint32_t>(i);
+}
+
+size_t SeekIndex::findFrame(uint32_t frame) const
+{
+    return frame < m_display.size() && m_display[frame] != UINT32_MAX ? m_display[frame] : SEEK_INDEX_NOT_FOUND;
+}
+
+size_t SeekIndex::findPoc(int32_t poc) const
+{
+    for (uint32_t decode_order : m_display)
+        if (decode_order != UINT32_MAX && m_units[decode_order].poc == poc)
+            return decode_order;
+
+    return SEEK_INDEX_NOT_FOUND;
+}
+
+size_t SeekIndex::randomAccessPoint(size_t target) const
+{
+    if (target >= m_units.size())
+        return SEEK_INDEX_NOT_FOUND;
+
+    size_t start = target;
+    while (start > 0 && !isIrap(m_units[start].nal_unit_type))
+        --start;
+
+    // RASL pictures reference pictures preceding their CRA picture in decode order, so the decoder drops them when it starts at that CRA.
+    // Step back to the previous IRAP picture to reconstruct them.
+    if (isRasl(m_units[target].nal_unit_type) && isCra(m_units[start].nal_unit_type) && start > 0) {
+        size_t previous = start - 1;
+        while (previous > 0 && !isIrap(m_units[previous].nal_unit_type))
+            --previous;
+
+        if (isIrap(m_units[previous].nal_unit_type))
+            start = previous;
+    }
+
+    return start;
+}
+
+uint32_t SeekIndex::outputsBefore(size_t start, size_t target) const
+{
+    if (start > target || target >= m_units.size())
+        return 0;
+
+    const uint32_t output_order = m_units[target].output_order;
+    uint32_t outputs = 0;
+    bool associated = true; // Still in the pictures associated with the IRAP picture decoding starts from
+    bool next_irap = false;
+
+    for (size_t i = start; i < m_units.size(); ++i) {
+        const uint8_t nal_unit_type = m_units[i].nal_unit_type;
+
+        // Pictures past the next IRAP picture following the target and its leading pictures follow the target in output order
+        if (i > start && isIrap(nal_unit_type)) {
+            associated = false;
+            if (i > target) {
+                if (next_irap)
+                    break;
+                next_irap = true;
+            }
+        }
+        else if (next_irap && !isLeading(nal_unit_type)) {
+            break;
+        }
+
+        // The decoder drops the RASL pictures of the IRAP picture it starts from
+        if (associated && isRasl(nal_unit_type))
+            continue;
+
+        if (m_units[i].output_order != UINT32_MAX && m_units[i].output_order < output_order)
+            ++outputs;
+    }
+
+    return outputs;
+}
+
+std::vector<ParameterSetEntry> SeekIndex::parameterSets(size_t decode_order) const
+{
+    std::vector<ParameterSetEntry> parameter_sets;
+    const AccessUnitEntry& unit = m_units[decode_order];
+
+    // Find the last SPS preceding or inside the access unit
+    size_t sps = m_parameter_sets.size();
+    for (size_t i = 0; i < m_parameter_sets.size() && m_parameter_sets[i].offset < unit.offset + unit.size; ++i)
+        if (m_parameter_sets[i].nal_unit_type == NALU_TYPE_SPS)
+            sps = i;
+
+    if (sps == m_parameter_sets.size() || m_parameter_sets[sps].offset >= unit.offset)
+        return parameter_sets;
+
+    // Take the whole group of adjacent parameter sets around that SPS (usually VPS, SPS, PPS) and any later PPS updates
+    size_t first = sps;
+    while (first > 0 && m_parameter_sets[first - 1].offset + m_parameter_sets[first - 1].size == m_parameter_sets[first].offset)
+        --first;
+
+    for (size_t i = first; i < m_parameter_sets.size() && m_parameter_sets[i].offset < unit.offset; ++i)
+        parameter_sets.push_back(m_parameter_sets[i]);
+
+    return parameter_sets;
+}
+
+uint64_t SeekIndex::streamSize(FILE* stream)
+{
+#if defined(_WIN32)
+    const int64_t position = _ftelli64(stream);
+    _fseeki64(stream, 0, SEEK_END);
+    const int64_t size = _ftelli64(stream);
+    _fseeki64(stream, position, SEEK_SET);
+#else
+    const off_t position = ftello(stream);
+    fseeko(stream, 0, SEEK_END);
+    const off_t size = ftello(stream);
+    fseeko(stream, position, SEEK_SET);
+#endif
+    return size < 0 ? 0 : static_cast<uint64_t>(size);
+}
+
+int64_t SeekIndex::streamTime(FILE* stream)
+{
+#if defined(_WIN32)
+    struct _stati64 stat_data = {};
+    if (_fstati64(_fileno(stream), &stat_data))
+        return 0;
+#else
+    struct stat stat_data = {};
+    if (fstat(fileno(stream), &stat_data))
+        return 0;
+#endif
+    return static_cast<int64_t>(stat_data.st_mtime);
+}
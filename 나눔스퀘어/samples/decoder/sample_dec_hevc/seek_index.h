@@ -0,0 +1,90 @@
+/*****************************************************************************
+ File name: seek_index.h
+ Purpose: access unit index of an HEVC elementary stream used for random access
+
+ Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.
+ Unauthorized reproduction or distribution of any portion is prohibited by law.
+******************************************************************************/
+
+#ifndef UUID_8E3D61B4_2A7C_4F95_B1D8_C46A09E5F372
+#define UUID_8E3D61B4_2A7C_4F95_B1D8_C46A09E5F372
+
+#include <stdio.h>
+#include <vector>
+#include "dec_hevc.h"
+
+#define SEEK_INDEX_VERSION 3
+#define SEEK_INDEX_NOT_FOUND (static_cast<size_t>(-1))
+
+// One access unit of the stream, the index in the table is the decode order
+struct AccessUnitEntry
+{
+    uint64_t offset;       // Byte offset of the first NAL unit of the AU in the stream
+    uint64_t size;         // Size of the AU in bytes
+    int32_t poc;           // Picture order count, restarts at each IDR and BLA picture
+    uint32_t output_order; // Position of the picture in display order over the whole stream
+    uint8_t nal_unit_type; // Type of the first VCL NAL unit of the AU
+    uint8_t temporal_id;   // Temporal sub-layer of the AU
+    uint8_t reserved[6];
+};
+
+// VPS, SPS or PPS NAL unit
+struct ParameterSetEntry
+{
+    uint64_t offset;
+    uint64_t size;
+    uint8_t nal_unit_type;
+    uint8_t reserved[7];
+};
+
+inline bool isIrap(const uint8_t nal_unit_type) { return nal_unit_type >= NALU_TYPE_SLICE_BLA && nal_unit_type <= NALU_TYPE_RESERVED_23; }
+inline bool isRasl(const uint8_t nal_unit_type) { return nal_unit_type == NALU_TYPE_SLICE_RASL_N || nal_unit_type == NALU_TYPE_SLICE_RASL_R; }
+inline bool isLeading(const uint8_t nal_unit_type) { return nal_unit_type >= NALU_TYPE_SLICE_RADL_N && nal_unit_type <= NALU_TYPE_SLICE_RASL_R; }
+inline bool isCra(const uint8_t nal_unit_type) { return nal_unit_type == NALU_TYPE_SLICE_CRA; }
+
+/* Index of all access units of an HEVC elementary stream.
+   It is either built by a parse-only pass over the stream or loaded from a sidecar file written by a previous run. */
+class SeekIndex
+{
+public:
+    bool build(FILE* stream);
+    // A sidecar is only used for the stream size and modification time it was saved with
+    bool load(const char* filename, uint64_t stream_size, int64_t stream_time);
+    bool save(const char* filename, uint64_t stream_size, int64_t stream_time) const;
+
+    size_t size() const { return m_units.size(); }
+    const AccessUnitEntry& operator[](size_t decode_order) const { return m_units[decode_order]; }
+
+    // Decode order of the picture displayed as the given frame number
+    size_t findFrame(uint32_t frame) const;
+    // Decode order of the first picture in display order with the given POC
+    size_t findPoc(int32_t poc) const;
+    // Decode order of the IRAP picture decoding has to start from to reconstruct the target picture
+    size_t randomAccessPoint(size_t target) const;
+    // Pictures the decoder outputs before the target when it starts at the given IRAP picture.
+    // POC values can not be compared instead, decoding from a CRA picture restarts the POC MSB there.
+    uint32_t outputsBefore(size_t start, size_t target) const;
+    // Parameter sets that have to be fed before the access unit if it does not carry its own ones
+    std::vector<ParameterSetEntry> parameterSets(size_t decode_order) const;
+
+    // Pictures per second signalled in the VUI of the SPS, zero if the stream carries no timing
+    double frameRate() const { return m_num_units_in_tick ? static_cast<double>(m_time_scale) / m_num_units_in_tick : 0.0; }
+
+    static uint64_t streamSize(FILE* stream);
+    // Modification time of the file, zero if it is not known
+    static int64_t streamTime(FILE* stream);
+
+private:
+    void updateDisplayOrder();
+
+    std::vector<AccessUnitEntry> m_units;
+    std::vector<ParameterSetEntry> m_parameter_sets;
+    std::vector<uint32_t> m_display; // Decode order of the pictures in display order
+    uint32_t m_time_scale = 0;
+    uint32_t m_num_units_in_tick = 0;
+};
+
+#endif
@@ -0,0 +1,151 @@
+/*****************************************************************************
+ File name: seeker.cpp
+ Purpose: random access on top of the sample decoder
+
+ Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.
+ Unauthorized reproduction or distribution of any portion is prohibited by law.
+******************************************************************************/
+
+#include "seeker.h"
+
+static bool seekFile(FILE* file, uint64_t offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+bool Seeker::seek(size_t target)
+{
+    if (target >= m_index.size())
+        return false;
+
+    const uint64_t started = time_get_count();
+
+    // Pictures still held by the decoder belong to the previous position
+    m_drain = true;
+    const int drained = flush();
+    m_drain = false;
+
+    if (drained || !setDecoderParam(0, PARSE_INIT))
+        return false;
+
+    const size_t start = m_index.randomAccessPoint(target);
+
+    // A RASL picture associated with the first CRA picture of the stream or with a BLA picture is never output, show its IRAP picture instead
+    if (isRasl(m_index[target].nal_unit_type)) {
+        size_t i = start + 1;
+        while (i <= target && !isIrap(m_index[i].nal_unit_type))
+            ++i;
+
+        if (i > target) {
+            fprintf(helper.log, "Warning: picture %u can not be reconstructed, seeking to the IRAP picture %u instead\n", m_index[target].output_order,
+                m_index[start].output_order);
+            target = start;
+        }
+    }
+
+    // Streams that carry the parameter sets only at the beginning need them repeated in front of the IRAP picture
+    const std::vector<ParameterSetEntry> parameter_sets = m_index.parameterSets(start);
+    for (const ParameterSetEntry& parameter_set : parameter_sets)
+        if (!feed(parameter_set.offset, parameter_set.size))
+            return false;
+
+    if (!seekFile(helper.input_file, m_index[start].offset))
+        return false;
+
+    m_statistics = SeekStatistics();
+    m_statistics.random_access_point = start;
+    m_statistics.target = target;
+    m_statistics.decoded = static_cast<uint32_t>(target - start + 1);
+    m_statistics.started = started;
+
+    m_skip = m_index.outputsBefore(start, target);
+    m_hidden = 0;
+    m_suppress = true;
+
+    return true;
+}
+
+bool Seeker::feed(uint64_t offset, uint64_t size)
+{
+    std::vector<uint8_t> buffer(static_cast<size_t>(size));
+    if (buffer.empty() || !seekFile(helper.input_file, offset) || fread(&buffer[0], 1, buffer.size(), helper.input_file) != buffer.size())
+        return false;
+
+    uint32_t consumed = 0;
+    while (consumed < buffer.size()) {
+        consumed += m_decoder->copybytes(m_decoder, &buffer[consumed], static_cast<uint32_t>(buffer.size() - consumed));
+        if (!handleErrors(m_decoder->auxinfo(m_decoder, 0, CLEAN_PARSE_STATE, NULL, 0)))
+            return false;
+    }
+
+    return true;
+}
+
+// Returns true if the picture has to be shown
+bool Seeker::show()
+{
+    if (!m_suppress)
+        return true;
+
+    if (m_statistics.discarded < m_skip) {
+        m_statistics.discarded++;
+        return false;
+    }
+
+    m_suppress = false;
+    m_statistics.completed = true;
+    m_statistics.milliseconds = (time_get_count() - m_statistics.started) * 1000.0 / time_get_freq();
+
+    fprintf(helper.log, "Seek to frame %u (POC %d): started at frame %u, %u access units decoded, %u pictures discarded, %.2f ms\n",
+        m_index[m_statistics.target].output_order, m_index[m_statistics.target].poc, m_index[m_statistics.random_access_point].output_order, m_statistics.decoded,
+        m_statistics.discarded, m_statistics.milliseconds);
+
+    return true;
+}
+
+bool Seeker::processFrame(const uint32_t state)
+{
+    if (m_drain)
+        return true;
+
+    // The output callback counted the picture before and decided if it is shown
+    if (m_hidden && (state & PIC_DECODED_FLAG)) {
+        m_hidden--;
+        return true;
+    }
+
+    if (m_suppress)
+        return true;
+
+    return Decoder::processFrame(state);
+}
+
+void Seeker::seekPictureOutputCallback(context_t context, const hevc_picture_t* hevc_pic)
+{
+    Seeker* seeker = static_cast<Seeker*>(reinterpret_cast<Decoder*>(context.p));
+
+    if (!seeker || !hevc_pic || seeker->m_drain)
+        return;
+
+    // Skipped pictures, such as the RASL pictures of the random access point, are not counted
+    if (!hevc_pic->skipped && !seeker->show()) {
+        if (!seeker->helper.use_callbacks)
+            seeker->m_hidden++;
+        return;
+    }
+
+    Decoder::pictureOutputCallback(context, hevc_pic);
+}
+
+void Seeker::initCallbacks()
+{
+    Decoder::initCallbacks();
+    m_decoder_callback.pic_output_callback = Seeker::seekPictureOutputCallback;
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+ File name: seeker.h
+ Purpose: random access on top of the sample decoder
+
+ Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.
+ Unauthorized reproduction or distribution of any portion is prohibited by law.
+******************************************************************************/
+
+#ifndef UUID_2C9F47A0_6B1E_4D83_95F2_7A0E8C3D1B64
+#define UUID_2C9F47A0_6B1E_4D83_95F2_7A0E8C3D1B64
+
+#include "decoder.h"
+#include "seek_index.h"
+
+// Cost of the last seek
+struct SeekStatistics
+{
+    size_t random_access_point; // Decode order of the IRAP picture decoding started from
+    size_t target;              // Decode order of the target picture
+    uint32_t decoded;           // Access units fed from the IRAP picture up to the target
+    uint32_t discarded;         // Pictures output before the target and not shown
+    uint64_t started;           // Time the seek was requested
+    double milliseconds;        // Time from the request to the output of the target picture
+    bool completed;
+};
+
+/* Decoder that can start decoding at any picture of the stream.
+   Decoding starts at the nearest IRAP picture preceding the target and the pictures output before the target are counted and suppressed. */
+class Seeker : public Decoder
+{
+public:
+    Seeker(Helper& helper, const SeekIndex& index) : Decoder(helper), m_index(index), m_statistics(), m_skip(0), m_hidden(0), m_suppress(false), m_drain(false) {}
+
+    // Positions the input file, the following loop() call starts the output with the target picture
+    bool seek(size_t target);
+
+    const SeekStatistics& statistics() const { return m_statistics; }
+
+protected:
+    virtual void initCallbacks();
+    virtual bool processFrame(const uint32_t state);
+
+private:
+    // Called in display order, counts and drops the pictures preceding the seek target
+    static void seekPictureOutputCallback(context_t context, const hevc_picture_t* hevc_pic);
+
+    bool feed(uint64_t offset, uint64_t size);
+    // Only called from the output callback, so that every output picture is counted once
+    bool show();
+
+    const SeekIndex& m_index;
+    SeekStatistics m_statistics;
+    uint32_t m_skip;   // Pictures output before the target since the random access point
+    uint32_t m_hidden; // Pictures the output callback dropped that processFrame() still has to drop without the output callbacks
+    bool m_suppress;
+    bool m_drain;
+};
+
+#endif
@@ -0,0 +1,329 @@
+/*****************************************************************************
+ File name: segment_decoder.cpp
+ Purpose: parallel decoding of closed GOP segments on top of the sample decoder
+
+ Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.
+ Unauthorized reproduction or distribution of any portion is prohibited by law.
+******************************************************************************/
+
+#include <algorithm>
+#include <thread>
+#include "segment_decoder.h"
+#include "unicode_tools.h"
+
+static bool seekFile(FILE* file, uint64_t offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+bool ReorderBuffer::push(uint32_t output_order, SegmentPicture& picture)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [&] { return m_aborted || output_order == m_next || m_pictures.size() < m_capacity; });
+    if (m_aborted)
+        return false;
+
+    std::swap(m_pictures[output_order], picture);
+    m_condition.notify_all();
+    return true;
+}
+
+bool ReorderBuffer::pop(SegmentPicture& picture)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [&] { return m_aborted || m_pictures.count(m_next); });
+    if (m_aborted)
+        return false;
+
+    std::map<uint32_t, SegmentPicture>::iterator it = m_pictures.find(m_next);
+    std::swap(it->second, picture);
+    m_pictures.erase(it);
+    m_next++;
+    m_condition.notify_all();
+    return true;
+}
+
+void ReorderBuffer::abort()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_aborted = true;
+    m_condition.notify_all();
+}
+
+bool SegmentDecoder::open()
+{
+    m_file = UnicodeTools::openFile(helper.inputFileName(), true);
+    return m_file != NULL;
+}
+
+bool SegmentDecoder::decode(const Segment& segment, uint64_t stream_size)
+{
+    m_segment = &segment;
+    m_pictures = 0;
+
+    if (!setDecoderParam(0, PARSE_INIT))
+        return false;
+
+    const std::vector<ParameterSetEntry> parameter_sets = m_index.parameterSets(segment.first);
+    for (const ParameterSetEntry& parameter_set : parameter_sets)
+        if (!feed(parameter_set.offset, parameter_set.size))
+            return false;
+
+    // Everything up to the next segment is fed, including the non-VCL NAL units trailing the last access unit
+    const uint64_t start = m_index[segment.first].offset;
+    const uint64_t end = segment.last < m_index.size() ? m_index[segment.last].offset : stream_size;
+    if (!feed(start, end - start) || flush())
+        return false;
+
+    if (m_pictures != segment.pictures) {
+        fprintf(helper.log, "Error: segment starting at frame %u output %u pictures, %u expected\n", segment.first_output, m_pictures, segment.pictures);
+        return false;
+    }
+
+    return true;
+}
+
+bool SegmentDecoder::feed(uint64_t offset, uint64_t size)
+{
+    if (!seekFile(m_file, offset))
+        return false;
+
+    m_input.resize(READ_BUFFER_SIZE);
+    while (size) {
+        const uint32_t bytes_available = static_cast<uint32_t>((std::min)(size, static_cast<uint64_t>(READ_BUFFER_SIZE)));
+        if (fread(&m_input[0], 1, bytes_available, m_file) != bytes_available)
+            return false;
+
+        size -= bytes_available;
+
+        uint32_t consumed = 0;
+        do {
+            consumed += m_decoder->copybytes(m_decoder, &m_input[consumed], bytes_available - consumed);
+
+            uint32_t state = m_decoder->auxinfo(m_decoder, 0, CLEAN_PARSE_STATE, NULL, 0);
+
+            if (!handleErrors(state))
+                return false;
+
+            if (state & (PIC_DECODED_FLAG | PIC_VALID_FLAG | PIC_FULL_FLAG)) {
+                if (!processFrame(state))
+                    return false;
+            }
+        } while (bytes_available - consumed);
+    }
+
+    return true;
+}
+
+void SegmentDecoder::initCallbacks()
+{
+    Decoder::initCallbacks();
+
+    // Decoder::naluCallback() stores the NAL unit type in the helper shared by all instances, which are running on different threads
+    m_decoder_callback.nalu_callback = NULL;
+}
+
+bool SegmentDecoder::processFrame(const uint32_t state)
+{
+    if (!(state & PIC_DECODED_FLAG))
+        return true;
+
+    if (m_pictures >= m_segment->pictures) {
+        fprintf(helper.log, "Error: segment starting at frame %u outputs more pictures than indexed\n", m_segment->first_output);
+        return false;
+    }
+
+    // Same as Decoder::getFrame() but without touching the helper, which belongs to the output thread
+    initializeFrame();
+    m_picture.planes = 0;
+    if (helper.frame_required) {
+        if (BS_OK != m_decoder->auxinfo(m_decoder, 0, GET_PIC, &m_frame, sizeof(frame_tt)))
+            return false;
+
+        if (!helper.convert_frame)
+            get_frame_colorspace_info(&m_cs_info, m_frame.width, m_frame.height, m_frame.four_cc, 0);
+
+        size_t size = 0;
+        for (uint8_t i = 0; i < m_cs_info.planes; i++)
+            size += size_t(m_cs_info.stride[i]) * m_cs_info.plane_height[i];
+
+        m_picture.data.resize(size);
+
+        // Pack the rows, the reorder buffer keeps only the visible part of the picture
+        uint8_t* destination = m_picture.data.data();
+        for (uint8_t i = 0; i < m_cs_info.planes; i++) {
+            const uint8_t* source = m_frame.plane[i];
+            for (uint32_t row = 0; row < m_cs_info.plane_height[i]; row++, source += m_frame.stride[i], destination += m_cs_info.stride[i])
+                memcpy(destination, source, m_cs_info.stride[i]);
+
+            m_picture.width[i] = m_cs_info.stride[i];
+            m_picture.height[i] = m_cs_info.plane_height[i];
+        }
+        m_picture.planes = m_cs_info.planes;
+    }
+
+    m_picture.frame_width = m_frame.width;
+    m_picture.frame_height = m_frame.height;
+
+    return m_output.push(m_segment->first_output + m_pictures++, m_picture);
+}
+
+ParallelDecoder::~ParallelDecoder()
+{
+    // The decoder instances have to be closed before the threadpool they run on
+    m_decoders.clear();
+
+    if (m_threadpool)
+        threadpoolDestroy(m_threadpool, NULL);
+}
+
+bool ParallelDecoder::initialize(Decoder::BufstreamCreator bufstream_creator)
+{
+    planSegments();
+
+    if (threadpoolCreate(NULL, TP_TYPE_AUTO, NULL, &m_threadpool) != MCR_ERROR_OK) {
+        fprintf(helper.log, "\nError: Can`t create the threadpool\n");
+        return false;
+    }
+
+    helper.threadpool = m_threadpool;
+
+    const size_t count = (std::min)(m_segments.size(), static_cast<size_t>(helper.segments));
+    m_output.reset(new ReorderBuffer(count * PICTURES_PER_DECODER));
+
+    for (size_t i = 0; i < count; i++) {
+        m_decoders.emplace_back(new SegmentDecoder(helper, m_index, *m_output));
+        if (!m_decoders.back()->initialize(bufstream_creator))
+            return false;
+
+        if (!m_decoders.back()->open()) {
+            fprintf(helper.log, "\nError: Can`t open the input file\n");
+            return false;
+        }
+    }
+
+    fprintf(helper.log, "Decoding %u segments on %u decoder instances\n", static_cast<uint32_t>(m_segments.size()), static_cast<uint32_t>(count));
+    return true;
+}
+
+void ParallelDecoder::planSegments()
+{
+    // A CRA picture closes the GOP only if no RASL picture refers to the pictures preceding it
+    std::vector<bool> closed(m_index.size(), false);
+    bool rasl = false;
+    for (size_t i = m_index.size(); i-- > 0;) {
+        const uint8_t nal_unit_type = m_index[i].nal_unit_type;
+        if (isRasl(nal_unit_type))
+            rasl = true;
+        else if (isIrap(nal_unit_type)) {
+            closed[i] = nal_unit_type < NALU_TYPE_SLICE_CRA || (isCra(nal_unit_type) && !rasl);
+            rasl = false;
+        }
+    }
+
+    // A segment boundary also needs all pictures preceding it in decode order to precede it in display order
+    std::vector<size_t> boundaries(1, 0);
+    std::vector<uint32_t> outputs(1, 0);
+    uint32_t pictures = 0;
+    int64_t highest = -1;
+    for (size_t i = 0; i < m_index.size(); i++) {
+        if (i && closed[i] && highest + 1 == pictures) {
+            boundaries.push_back(i);
+            outputs.push_back(pictures);
+        }
+
+        if (m_index[i].output_order != UINT32_MAX) {
+            pictures++;
+            highest = (std::max)(highest, static_cast<int64_t>(m_index[i].output_order));
+        }
+    }
+
+    boundaries.push_back(m_index.size());
+    outputs.push_back(pictures);
+
+    // Join short GOPs so that each decoder instance gets a few segments of similar length
+    const size_t target = m_index.size() / (static_cast<size_t>(helper.segments) * SEGMENTS_PER_DECODER) + 1;
+    m_segments.clear();
+    for (size_t i = 0; i + 1 < boundaries.size();) {
+        size_t j = i + 1;
+        while (j + 1 < boundaries.size() && boundaries[j] - boundaries[i] < target)
+            j++;
+
+        Segment segment = { boundaries[i], boundaries[j], outputs[i], outputs[j] - outputs[i] };
+        m_segments.push_back(segment);
+        i = j;
+    }
+}
+
+int ParallelDecoder::run()
+{
+    m_next = 0;
+    m_failed = false;
+
+    uint32_t pictures = 0;
+    for (const Segment& segment : m_segments)
+        pictures += segment.pictures;
+
+    const uint64_t stream_size = SeekIndex::streamSize(helper.input_file);
+
+    std::vector<std::thread> threads;
+    for (std::unique_ptr<SegmentDecoder>& decoder : m_decoders)
+        threads.emplace_back(&ParallelDecoder::work, this, std::ref(*decoder), stream_size);
+
+    SegmentPicture picture;
+    for (uint32_t i = 0; i < pictures && m_output->pop(picture); i++) {
+        helper.pictures_decoded++;
+
+        if (!helper.width && !helper.height) {
+            helper.width = picture.frame_width;
+            helper.height = picture.frame_height;
+        }
+
+        if (picture.planes) {
+            const uint8_t* planes[4] = {};
+            int32_t strides[4] = {};
+            const uint8_t* plane = picture.data.data();
+            for (uint8_t j = 0; j < picture.planes; j++) {
+                planes[j] = plane;
+                strides[j] = picture.width[j];
+                plane += size_t(picture.width[j]) * picture.height[j];
+            }
+
+            // Update the MD5
+            if (helper.md5)
+                helper.updateMD5(planes, picture.width, picture.height, strides, picture.planes);
+
+            // Write out the yuv frame
+            if (helper.output_file)
+                helper.outputFrame(planes, picture.width, picture.height, strides, picture.planes);
+        }
+
+        // Update progress
+        if (helper.progress == 1)
+            helper.updateProgress();
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    return m_failed || helper.pictures_decoded != pictures ? 1 : 0;
+}
+
+void ParallelDecoder::work(SegmentDecoder& decoder, uint64_t stream_size) noexcept
+{
+    for (size_t i = m_next++; i < m_segments.size() && !m_failed; i = m_next++) {
+        if (!decoder.decode(m_segments[i], stream_size)) {
+            fprintf(helper.log, "Error: failed to decode the segment starting at frame %u\n", m_segments[i].first_output);
+            m_failed = true;
+            // Release the output thread and the decoders waiting for room in the reorder buffer
+            m_output->abort();
+        }
+    }
+}
@@ -0,0 +1,132 @@
+/*****************************************************************************
+ File name: segment_decoder.h
+ Purpose: parallel decoding of closed GOP segments on top of the sample decoder
+
+ Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.
+ Unauthorized reproduction or distribution of any portion is prohibited by law.
+******************************************************************************/
+
+#ifndef UUID_5A93C7E2_14D8_4B6F_A0E3_9D2B71F48C06
+#define UUID_5A93C7E2_14D8_4B6F_A0E3_9D2B71F48C06
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "decoder.h"
+#include "seek_index.h"
+
+#define SEGMENTS_PER_DECODER 4    // Segments scheduled per decoder instance to balance uneven GOP sizes
+#define PICTURES_PER_DECODER 2    // Pictures buffered per decoder instance before the output catches up
+
+// Range of access units that can be decoded without any picture preceding it in decode order
+struct Segment
+{
+    size_t first;          // Decode order of the first access unit, an IRAP picture except for the start of the stream
+    size_t last;           // Decode order following the last access unit
+    uint32_t first_output; // Display order of the first picture output by the segment
+    uint32_t pictures;     // Pictures output by the segment
+};
+
+// Decoded picture waiting for its turn in display order
+struct SegmentPicture
+{
+    std::vector<uint8_t> data; // Planes packed one after another without padding
+    int32_t width[4];          // Row size of the planes in bytes
+    uint32_t height[4];
+    uint32_t frame_width;
+    uint32_t frame_height;
+    uint8_t planes; // Zero if the picture content is not required
+};
+
+/* Re-serializes the pictures of all segments in display order.
+   The buffer is bounded, but the picture the output waits for is always accepted so a full buffer can not stall the decoders. */
+class ReorderBuffer
+{
+public:
+    explicit ReorderBuffer(size_t capacity) : m_capacity(capacity), m_next(0), m_aborted(false) {}
+
+    // Blocks while the buffer is full, false once aborted
+    bool push(uint32_t output_order, SegmentPicture& picture);
+    // Blocks until the next picture in display order is available, false once aborted
+    bool pop(SegmentPicture& picture);
+    void abort();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::map<uint32_t, SegmentPicture> m_pictures;
+    size_t m_capacity;
+    uint32_t m_next;
+    bool m_aborted;
+};
+
+/* Decoder instance of the pool. Every segment is decoded from a clean parser state:
+   the parameter sets and the access units of the segment are fed and the decoder is flushed. */
+class SegmentDecoder : public Decoder
+{
+public:
+    SegmentDecoder(Helper& helper, const SeekIndex& index, ReorderBuffer& output)
+        : Decoder(helper), m_index(index), m_output(output), m_file(NULL), m_segment(NULL), m_pictures(0)
+    {
+    }
+
+    ~SegmentDecoder()
+    {
+        if (m_file)
+            fclose(m_file);
+    }
+
+    // Opens the own handle of the input file
+    bool open();
+    bool decode(const Segment& segment, uint64_t stream_size);
+
+protected:
+    virtual void initCallbacks();
+    virtual bool processFrame(const uint32_t state);
+
+private:
+    bool feed(uint64_t offset, uint64_t size);
+
+    const SeekIndex& m_index;
+    ReorderBuffer& m_output;
+    FILE* m_file;
+    const Segment* m_segment;
+    uint32_t m_pictures; // Pictures of the current segment passed to the reorder buffer
+    SegmentPicture m_picture;
+    std::vector<uint8_t> m_input;
+};
+
+/* Decodes a closed GOP stream on several decoder instances sharing one threadpool.
+   The output, MD5 sum and progress are handled on the calling thread in display order, so they match the serial decode. */
+class ParallelDecoder
+{
+public:
+    ParallelDecoder(Helper& helper, const SeekIndex& index) : helper(helper), m_index(index), m_threadpool(NULL) {}
+    ~ParallelDecoder();
+
+    bool initialize(Decoder::BufstreamCreator bufstream_creator);
+    // Decodes the whole stream, returns zero on success like Decoder::loop()
+    int run();
+
+    Helper& helper;
+
+private:
+    void planSegments();
+    void work(SegmentDecoder& decoder, uint64_t stream_size) noexcept;
+
+    const SeekIndex& m_index;
+    std::vector<Segment> m_segments;
+    std::vector<std::unique_ptr<SegmentDecoder>> m_decoders;
+    std::unique_ptr<ReorderBuffer> m_output;
+    mcr_thread_pool_t m_threadpool;
+    std::atomic<size_t> m_next;
+    std::atomic<bool> m_failed;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef UUID_61D0E8A3_5F47_4B2C_8E19_3AB7C5D02E96
+#define UUID_61D0E8A3_5F47_4B2C_8E19_3AB7C5D02E96
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include "sample_common_args.h"
+
+#define ARG_INTERVAL (IDC_CUSTOM_START_ID + 1)
+#define ARG_FRAME_RATE (IDC_CUSTOM_START_ID + 2)
+#define ARG_WIDTH (IDC_CUSTOM_START_ID + 3)
+#define ARG_COLUMNS (IDC_CUSTOM_START_ID + 4)
+#define ARG_OUTPUT (IDC_CUSTOM_START_ID + 5)
+#define ARG_WORKERS (IDC_CUSTOM_START_ID + 6)
+#define ARG_THREADS (IDC_CUSTOM_START_ID + 7)
+#define ARG_INDEX (IDC_CUSTOM_START_ID + 8)
+#define ARG_COUNT 8
+
+#define MIN_THUMBNAIL_WIDTH 32
+
+// Thumbnail extraction settings
+class Application
+{
+public:
+    Application(int argc, char* argv[])
+    {
+        executable = argv[0];
+
+        int offset = 1;
+        while (offset < argc && strcmp(argv[offset++], "--"))
+            ;
+
+        parse_args(offset - !!(argc - offset) - 1, argv + 1, ARG_COUNT, ARGUMENTS, DESCRIPTIONS, ARG_COUNT);
+
+        if (interval == ITEM_NOT_INIT || interval <= 0.)
+            interval = 10.;
+        if (frame_rate == ITEM_NOT_INIT || frame_rate <= 0.)
+            frame_rate = 0.;
+        if (width == ITEM_NOT_INIT || width < MIN_THUMBNAIL_WIDTH)
+            width = 320;
+        if (columns == ITEM_NOT_INIT || columns < 0)
+            columns = 0;
+        if (workers == ITEM_NOT_INIT || workers < 1)
+            workers = (std::max)(1u, std::thread::hardware_concurrency());
+        if (threads == ITEM_NOT_INIT || threads < 0)
+            threads = 1;
+        if (!output)
+            output = const_cast<char*>(columns ? "thumbnails.ppm" : "thumbnail");
+
+        if (offset < argc)
+            stream = argv[offset];
+    }
+
+    bool initialized() const noexcept { return stream != nullptr; }
+
+    void usage() const noexcept
+    {
+        fprintf(stderr, "\nUSAGE:\n%s [options] -- <stream>\n", executable);
+        fprintf(stderr, "\nOPTIONS:\n");
+        print_help(ARGUMENTS, ARG_COUNT, DESCRIPTIONS, ARG_COUNT);
+    }
+
+    char* executable = nullptr;
+    char* stream = nullptr;
+    char* output = nullptr;
+    char* index = nullptr;
+
+    double interval = 10.;
+    double frame_rate = 0.;
+    int32_t width = 320;
+    int32_t columns = 0;
+    int32_t workers = 1;
+    int32_t threads = 1;
+
+private:
+    arg_item_t ARGUMENTS[ARG_COUNT] = { { ARG_INTERVAL, 0, &interval }, { ARG_FRAME_RATE, 0, &frame_rate }, { ARG_WIDTH, 0, &width },
+        { ARG_COLUMNS, 0, &columns }, { ARG_OUTPUT, 0, &output }, { ARG_WORKERS, 0, &workers }, { ARG_THREADS, 0, &threads }, { ARG_INDEX, 0, &index } };
+
+    // clang-format off
+    arg_item_desc_t DESCRIPTIONS[ARG_COUNT] = {
+        { ARG_INTERVAL, { "interval", "" }, ItemTypeDouble, 0,                "Seconds between two thumbnails, the next IRAP picture is taken.  |  By default 10 seconds" },
+        { ARG_FRAME_RATE, { "fps", "" }, ItemTypeDouble, 0,                   "Frame rate of the stream.                                         |  By default taken from the VUI, 25 if missing" },
+        { ARG_WIDTH, { "width", "w" }, ItemTypeInt, 320,                      "Width of a thumbnail, the height keeps the aspect ratio.         |  By default 320" },
+        { ARG_COLUMNS, { "columns", "" }, ItemTypeInt, 0,                     "Compose a contact sheet with the given number of columns.        |  By default numbered images are written" },
+        { ARG_OUTPUT, { "o", "" }, ItemTypeString, 0,                         "Contact sheet file or prefix of the numbered images (PPM).        |  By default thumbnails.ppm or thumbnail_NNNNN.ppm" },
+        { ARG_WORKERS, { "workers", "" }, ItemTypeInt, 0,                     "The number of decoder instances decoding IRAP pictures in parallel. |  By default the number of CPU cores" },
+        { ARG_THREADS, { "threads", "" }, ItemTypeInt, 1,                     "The number of worker threads of each decoder instance.           |  By default 1" },
+        { ARG_INDEX, { "index", "" }, ItemTypeString, 0,                      "Access unit index file, created if missing or outdated.          |  By default the stream is indexed on every run" } };
+    // clang-format on
+};
+#endif
@@ -0,0 +1,199 @@
+#include <limits>
+#include <memory>
+#include <thread>
+#include "extractor.h"
+#include "mcfourcc.h"
+#include "mccolorspace.h"
+
+static bool seekFile(FILE* file, uint64_t offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+bool Worker::open()
+{
+    m_file = fopen(m_application.stream, "rb");
+    if (!m_file)
+        return false;
+
+    callbacks_t callbacks{};
+    callbacks_decoder_hevc_t hevc_callbacks{};
+    stream_params_t parameters{};
+    parameters.nodeset = (std::numeric_limits<uint64_t>::max)();
+
+    m_decoder = createDecoderHEVC(&callbacks, &hevc_callbacks, &parameters);
+    if (!m_decoder)
+        return false;
+
+    // Only intra pictures are fed, skipping P and B pictures guards against leading pictures sneaking into an access unit
+    return m_decoder->auxinfo(m_decoder, 0, PARSE_INIT, nullptr, 0) == BS_OK &&
+        m_decoder->auxinfo(m_decoder, INTERN_REORDERING_FLAG, PARSE_OPTIONS, nullptr, 0) == BS_OK &&
+        m_decoder->auxinfo(m_decoder, SKIP_PB, PARSE_FRAMES, nullptr, 0) == BS_OK &&
+        m_decoder->auxinfo(m_decoder, m_application.threads, SET_CPU_NUM, nullptr, 0) == BS_OK;
+}
+
+void Worker::close() noexcept
+{
+    if (m_decoder) {
+        close_bufstream(m_decoder, 0);
+        m_decoder = nullptr;
+    }
+
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+bool Worker::decode(Thumbnail& thumbnail)
+{
+    thumbnail.valid = false;
+
+    if (m_decoder->auxinfo(m_decoder, 0, PARSE_INIT, nullptr, 0) != BS_OK)
+        return false;
+
+    const std::vector<ParameterSetEntry> parameter_sets = m_index.parameterSets(thumbnail.unit);
+    for (const ParameterSetEntry& parameter_set : parameter_sets)
+        if (!feed(parameter_set.offset, parameter_set.size, thumbnail))
+            return false;
+
+    if (!feed(m_index[thumbnail.unit].offset, m_index[thumbnail.unit].size, thumbnail))
+        return false;
+
+    // The end of the access unit is only known once the stream ends
+    uint32_t bytes_left = 0;
+    do {
+        bytes_left = m_decoder->copybytes(m_decoder, nullptr, 0);
+        if (!checkState(thumbnail))
+            return false;
+    } while (bytes_left);
+
+    return thumbnail.valid;
+}
+
+bool Worker::feed(uint64_t offset, uint64_t size, Thumbnail& thumbnail)
+{
+    m_input.resize(static_cast<size_t>(size));
+    if (m_input.empty() || !seekFile(m_file, offset) || fread(&m_input[0], 1, m_input.size(), m_file) != m_input.size())
+        return false;
+
+    uint32_t consumed = 0;
+    while (consumed < m_input.size()) {
+        consumed += m_decoder->copybytes(m_decoder, &m_input[consumed], static_cast<uint32_t>(m_input.size() - consumed));
+        if (!checkState(thumbnail))
+            return false;
+    }
+
+    return true;
+}
+
+bool Worker::checkState(Thumbnail& thumbnail)
+{
+    const uint32_t state = m_decoder->auxinfo(m_decoder, 0, CLEAN_PARSE_STATE, nullptr, 0);
+    if (state & INTERNAL_ERROR)
+        return false;
+
+    return !(state & PIC_DECODED_FLAG) || thumbnail.valid || capture(thumbnail);
+}
+
+bool Worker::capture(Thumbnail& thumbnail)
+{
+    SEQ_ParamsEx* sequence = nullptr;
+    if (m_decoder->auxinfo(m_decoder, 0, GET_SEQ_PARAMSPEX, &sequence, sizeof(SEQ_ParamsEx)) != BS_OK || !sequence->horizontal_size ||
+        !sequence->vertical_size)
+        return false;
+
+    const uint32_t width = sequence->horizontal_size;
+    const uint32_t height = sequence->vertical_size;
+
+    // Let the decoder convert any bit depth and chroma format to 8-bit 4:2:0
+    frame_colorspace_info_tt picture_info;
+    frame_tt frame{};
+    if (get_frame_colorspace_info(&picture_info, width, height, FOURCC_I420, 0))
+        return false;
+
+    m_picture.resize(picture_info.frame_size);
+    fill_frame_from_colorspace_info(&picture_info, &m_picture[0], &frame);
+    if (m_decoder->auxinfo(m_decoder, 0, GET_PIC, &frame, sizeof(frame_tt)) != BS_OK)
+        return false;
+
+    thumbnail.width = (std::min)(width, static_cast<uint32_t>(m_application.width)) & ~1u;
+    thumbnail.height = (std::max)(2u, static_cast<uint32_t>(uint64_t(height) * thumbnail.width / width + 1) & ~1u);
+
+    frame_colorspace_info_tt scaled_info;
+    if (get_frame_colorspace_info(&scaled_info, thumbnail.width, thumbnail.height, FOURCC_I420, 0))
+        return false;
+
+    m_scaled.resize(scaled_info.frame_size);
+
+    Plane scaled[3];
+    for (uint32_t i = 0; i < 3; ++i) {
+        const Plane source = { m_picture.data() + picture_info.plane_offset[i], picture_info.stride[i], picture_info.plane_width[i], picture_info.plane_height[i] };
+        m_scaler.scale(source, &m_scaled[scaled_info.plane_offset[i]], scaled_info.stride[i], scaled_info.plane_width[i], scaled_info.plane_height[i]);
+        scaled[i] = { m_scaled.data() + scaled_info.plane_offset[i], scaled_info.stride[i], scaled_info.plane_width[i], scaled_info.plane_height[i] };
+    }
+
+    thumbnail.rgb.resize(size_t(thumbnail.width) * thumbnail.height * 3);
+    convertI420ToRgb(scaled, width >= 1280 || height >= 720, &thumbnail.rgb[0], thumbnail.width * 3);
+    thumbnail.valid = true;
+    return true;
+}
+
+std::vector<size_t> Extractor::selectKeyframes(double frame_rate) const
+{
+    std::vector<size_t> keyframes;
+    double next = 0.;
+
+    // IRAP pictures are output in their decode order, so this walks through them in display order as well
+    for (size_t i = 0; i < m_index.size(); ++i) {
+        if (!isIrap(m_index[i].nal_unit_type) || m_index[i].output_order == UINT32_MAX)
+            continue;
+
+        const double seconds = m_index[i].output_order / frame_rate;
+        if (seconds >= next) {
+            keyframes.push_back(i);
+            next = (static_cast<uint64_t>(seconds / m_application.interval) + 1) * m_application.interval;
+        }
+    }
+
+    return keyframes;
+}
+
+bool Extractor::run(std::vector<Thumbnail>& thumbnails)
+{
+    m_next = 0;
+    m_failed = false;
+
+    const size_t count = (std::min)(thumbnails.size(), static_cast<size_t>(m_application.workers));
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (size_t i = 0; i < count; ++i) {
+        workers.emplace_back(new Worker(m_application, m_index));
+        if (!workers.back()->open()) {
+            fprintf(stderr, "Failed to create decoder instance\n");
+            return false;
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (std::unique_ptr<Worker>& worker : workers)
+        threads.emplace_back(&Extractor::work, this, std::ref(*worker), std::ref(thumbnails));
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    return !m_failed;
+}
+
+void Extractor::work(Worker& worker, std::vector<Thumbnail>& thumbnails) noexcept
+{
+    for (size_t i = m_next++; i < thumbnails.size(); i = m_next++) {
+        if (!worker.decode(thumbnails[i])) {
+            fprintf(stderr, "Failed to decode the IRAP picture of frame %u\n", m_index[thumbnails[i].unit].output_order);
+            m_failed = true;
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef UUID_D4A7193E_B80C_4F6D_9E25_71C3A8F04B5D
+#define UUID_D4A7193E_B80C_4F6D_9E25_71C3A8F04B5D
+
+#include <atomic>
+#include <vector>
+#include "application.h"
+#include "scaler.h"
+#include "seek_index.h"
+
+// Downscaled picture, packed RGB
+struct Thumbnail
+{
+    size_t unit = 0;    // Decode order of the IRAP access unit
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> rgb{};
+    bool valid = false;
+};
+
+/* Decoder instance of the pool. IRAP access units are independent, so each one is decoded on its own:
+   the parser is reset, the parameter sets and the access unit are fed, and the decoder is flushed. */
+class Worker
+{
+public:
+    Worker(const Application& application, const SeekIndex& index) noexcept : m_application(application), m_index(index) {}
+    ~Worker() noexcept { close(); }
+
+    bool open();
+    void close() noexcept;
+    bool decode(Thumbnail& thumbnail);
+
+private:
+    bool feed(uint64_t offset, uint64_t size, Thumbnail& thumbnail);
+    bool checkState(Thumbnail& thumbnail);
+    bool capture(Thumbnail& thumbnail);
+
+    const Application& m_application;
+    const SeekIndex& m_index;
+    FILE* m_file{};
+    bufstream_tt* m_decoder{};
+    std::vector<uint8_t> m_input{};
+    std::vector<uint8_t> m_picture{}; // Full size I420 picture
+    std::vector<uint8_t> m_scaled{};  // Thumbnail size I420 picture
+    Scaler m_scaler{};
+};
+
+// Distributes the IRAP access units over a pool of decoder instances
+class Extractor
+{
+public:
+    Extractor(const Application& application, const SeekIndex& index) noexcept : m_application(application), m_index(index) {}
+
+    // Decode order of the first IRAP access unit of each interval
+    std::vector<size_t> selectKeyframes(double frame_rate) const;
+
+    bool run(std::vector<Thumbnail>& thumbnails);
+
+private:
+    void work(Worker& worker, std::vector<Thumbnail>& thumbnails) noexcept;
+
+    const Application& m_application;
+    const SeekIndex& m_index;
+    std::atomic<size_t> m_next{};
+    std::atomic<bool> m_failed{};
+};
+#endif
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "image.h"
+
+bool writePpm(const char* filename, const uint8_t* rgb, uint32_t width, uint32_t height)
+{
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+        return false;
+
+    const size_t size = size_t(width) * height * 3;
+    const bool valid = fprintf(file, "P6\n%u %u\n255\n", width, height) > 0 && fwrite(rgb, 1, size, file) == size;
+    return fclose(file) == 0 && valid;
+}
+
+bool writeImages(const char* prefix, const std::vector<Thumbnail>& thumbnails, const SeekIndex& index)
+{
+    char filename[1024];
+    for (const Thumbnail& thumbnail : thumbnails) {
+        if (!thumbnail.valid)
+            continue;
+
+        snprintf(filename, sizeof(filename), "%s_%05u.ppm", prefix, index[thumbnail.unit].output_order);
+        if (!writePpm(filename, &thumbnail.rgb[0], thumbnail.width, thumbnail.height)) {
+            fprintf(stderr, "Failed to write %s\n", filename);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool writeContactSheet(const char* filename, const std::vector<Thumbnail>& thumbnails, uint32_t columns)
+{
+    uint32_t tile_width = 0;
+    uint32_t tile_height = 0;
+    uint32_t count = 0;
+    for (const Thumbnail& thumbnail : thumbnails) {
+        if (!thumbnail.valid)
+            continue;
+
+        tile_width = (std::max)(tile_width, thumbnail.width);
+        tile_height = (std::max)(tile_height, thumbnail.height);
+        ++count;
+    }
+
+    if (!count)
+        return false;
+
+    columns = (std::min)(columns, count);
+    const uint32_t rows = (count + columns - 1) / columns;
+    const uint32_t width = columns * (tile_width + CONTACT_SHEET_MARGIN) + CONTACT_SHEET_MARGIN;
+    const uint32_t height = rows * (tile_height + CONTACT_SHEET_MARGIN) + CONTACT_SHEET_MARGIN;
+    const size_t stride = size_t(width) * 3;
+
+    std::vector<uint8_t> sheet(stride * height, 0);
+
+    uint32_t tile = 0;
+    for (const Thumbnail& thumbnail : thumbnails) {
+        if (!thumbnail.valid)
+            continue;
+
+        const uint32_t x = CONTACT_SHEET_MARGIN + (tile % columns) * (tile_width + CONTACT_SHEET_MARGIN);
+        const uint32_t y = CONTACT_SHEET_MARGIN + (tile / columns) * (tile_height + CONTACT_SHEET_MARGIN);
+        for (uint32_t row = 0; row < thumbnail.height; ++row)
+            memcpy(&sheet[(y + row) * stride + x * 3], &thumbnail.rgb[size_t(row) * thumbnail.width * 3], size_t(thumbnail.width) * 3);
+
+        ++tile;
+    }
+
+    return writePpm(filename, &sheet[0], width, height);
+}
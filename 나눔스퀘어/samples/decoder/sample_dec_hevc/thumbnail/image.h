@@ -0,0 +1,18 @@
+#ifndef UUID_0B6E2F95_C3A1_47D8_8F5E_A29D41C7E30B
+#define UUID_0B6E2F95_C3A1_47D8_8F5E_A29D41C7E30B
+
+#include <vector>
+#include "extractor.h"
+
+#define CONTACT_SHEET_MARGIN 4 // Pixels between the thumbnails of a contact sheet
+
+// Writes packed RGB as binary PPM
+bool writePpm(const char* filename, const uint8_t* rgb, uint32_t width, uint32_t height);
+
+// Writes the thumbnails as <prefix>_<frame>.ppm
+bool writeImages(const char* prefix, const std::vector<Thumbnail>& thumbnails, const SeekIndex& index);
+
+// Composes the thumbnails row by row into a single image
+bool writeContactSheet(const char* filename, const std::vector<Thumbnail>& thumbnails, uint32_t columns);
+
+#endif
@@ -0,0 +1,86 @@
+#include <string.h>
+#include <algorithm>
+#include "scaler.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCALER_SSE2
+#endif
+
+// Adds one source row to the column sums
+static void accumulate(const uint8_t* row, uint32_t* sums, uint32_t width)
+{
+    uint32_t x = 0;
+#ifdef SCALER_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= width; x += 16) {
+        const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        const __m128i low = _mm_unpacklo_epi8(samples, zero);
+        const __m128i high = _mm_unpackhi_epi8(samples, zero);
+
+        __m128i* sum = reinterpret_cast<__m128i*>(sums + x);
+        _mm_storeu_si128(sum + 0, _mm_add_epi32(_mm_loadu_si128(sum + 0), _mm_unpacklo_epi16(low, zero)));
+        _mm_storeu_si128(sum + 1, _mm_add_epi32(_mm_loadu_si128(sum + 1), _mm_unpackhi_epi16(low, zero)));
+        _mm_storeu_si128(sum + 2, _mm_add_epi32(_mm_loadu_si128(sum + 2), _mm_unpacklo_epi16(high, zero)));
+        _mm_storeu_si128(sum + 3, _mm_add_epi32(_mm_loadu_si128(sum + 3), _mm_unpackhi_epi16(high, zero)));
+    }
+#endif
+    for (; x < width; ++x)
+        sums[x] += row[x];
+}
+
+void Scaler::scale(const Plane& source, uint8_t* destination, int32_t destination_stride, uint32_t width, uint32_t height)
+{
+    m_sums.resize(source.width);
+
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint32_t y0 = static_cast<uint32_t>(uint64_t(y) * source.height / height);
+        const uint32_t y1 = (std::max)(y0 + 1, static_cast<uint32_t>(uint64_t(y + 1) * source.height / height));
+
+        memset(&m_sums[0], 0, m_sums.size() * sizeof(uint32_t));
+        for (uint32_t row = y0; row < y1; ++row)
+            accumulate(source.data + static_cast<intptr_t>(row) * source.stride, &m_sums[0], source.width);
+
+        uint8_t* output = destination + static_cast<intptr_t>(y) * destination_stride;
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t x0 = static_cast<uint32_t>(uint64_t(x) * source.width / width);
+            const uint32_t x1 = (std::max)(x0 + 1, static_cast<uint32_t>(uint64_t(x + 1) * source.width / width));
+
+            uint64_t sum = 0;
+            for (uint32_t column = x0; column < x1; ++column)
+                sum += m_sums[column];
+
+            const uint64_t count = uint64_t(x1 - x0) * (y1 - y0);
+            output[x] = static_cast<uint8_t>((sum + count / 2) / count);
+        }
+    }
+}
+
+static inline uint8_t clip(int32_t value) { return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value)); }
+
+void convertI420ToRgb(const Plane planes[3], bool bt709, uint8_t* rgb, int32_t rgb_stride)
+{
+    // Coefficients scaled by 256
+    const int32_t y_scale = 298;
+    const int32_t v_to_r = bt709 ? 459 : 409;
+    const int32_t u_to_g = bt709 ? 55 : 100;
+    const int32_t v_to_g = bt709 ? 136 : 208;
+    const int32_t u_to_b = bt709 ? 541 : 516;
+
+    for (uint32_t y = 0; y < planes[0].height; ++y) {
+        const uint8_t* luma = planes[0].data + static_cast<intptr_t>(y) * planes[0].stride;
+        const uint8_t* cb = planes[1].data + static_cast<intptr_t>(y / 2) * planes[1].stride;
+        const uint8_t* cr = planes[2].data + static_cast<intptr_t>(y / 2) * planes[2].stride;
+        uint8_t* output = rgb + static_cast<intptr_t>(y) * rgb_stride;
+
+        for (uint32_t x = 0; x < planes[0].width; ++x, output += 3) {
+            const int32_t l = (luma[x] - 16) * y_scale + 128;
+            const int32_t u = cb[x / 2] - 128;
+            const int32_t v = cr[x / 2] - 128;
+
+            output[0] = clip((l + v_to_r * v) >> 8);
+            output[1] = clip((l - u_to_g * u - v_to_g * v) >> 8);
+            output[2] = clip((l + u_to_b * u) >> 8);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef UUID_93B5F2C7_0D6A_4E81_A4C3_58E1F7B9D20A
+#define UUID_93B5F2C7_0D6A_4E81_A4C3_58E1F7B9D20A
+
+#include <vector>
+#include "mctypes.h"
+
+// 8-bit image plane
+struct Plane
+{
+    const uint8_t* data;
+    int32_t stride;
+    uint32_t width;
+    uint32_t height;
+};
+
+/* Area-averaging downscaler.
+   Each destination sample is the mean of the source samples it covers. The source rows of a destination row are summed with SSE2
+   when available, which is where almost all of the work is. */
+class Scaler
+{
+public:
+    void scale(const Plane& source, uint8_t* destination, int32_t destination_stride, uint32_t width, uint32_t height);
+
+private:
+    std::vector<uint32_t> m_sums; // Column sums of the source rows covered by one destination row
+};
+
+// Converts short range I420 planes to packed RGB using the BT.709 or BT.601 matrix
+void convertI420ToRgb(const Plane planes[3], bool bt709, uint8_t* rgb, int32_t rgb_stride);
+
+#endif
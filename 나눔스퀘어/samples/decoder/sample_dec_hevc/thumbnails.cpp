@@ -0,0 +1,91 @@
+/**
+@brief keyframe thumbnail extraction with the HEVC decoder
+
+ Selects the first IRAP picture of every interval from the access unit index and decodes these pictures on a pool
+ of decoder instances. IRAP pictures do not depend on any other picture, so each instance resets its parser and
+ decodes a single access unit at a time without touching the pictures in between. The pictures are downscaled and
+ written as numbered PPM images or as a single contact sheet.
+
+@verbatim
+Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+This software is protected by copyright law and international treaties.  Unauthorized
+reproduction or distribution of any portion is prohibited by law.
+@endverbatim
+**/
+
+#include <stdio.h>
+#include "thumbnail/application.h"
+#include "thumbnail/extractor.h"
+#include "thumbnail/image.h"
+#include "misc.h"
+
+#define DEFAULT_FRAME_RATE 25.0 // Used when neither the VUI nor the command line specify the frame rate
+
+// Main entry point
+int main(int argc, char* argv[])
+{
+    Application application(argc, argv);
+    if (!application.initialized()) {
+        application.usage();
+        return 1;
+    }
+
+    FILE* stream = fopen(application.stream, "rb");
+    if (!stream) {
+        fprintf(stderr, "Failed to open %s\n", application.stream);
+        return 1;
+    }
+
+    const uint64_t start = time_get_count();
+
+    SeekIndex index;
+    const uint64_t stream_size = SeekIndex::streamSize(stream);
+    const int64_t stream_time = SeekIndex::streamTime(stream);
+    if (!application.index || !index.load(application.index, stream_size, stream_time)) {
+        if (!index.build(stream)) {
+            fprintf(stderr, "Failed to index %s\n", application.stream);
+            fclose(stream);
+            return 1;
+        }
+
+        if (application.index && !index.save(application.index, stream_size, stream_time))
+            fprintf(stderr, "Failed to write the index file %s\n", application.index);
+    }
+
+    fclose(stream);
+
+    const uint64_t indexed = time_get_count();
+
+    double frame_rate = application.frame_rate;
+    if (frame_rate <= 0.)
+        frame_rate = index.frameRate() > 0. ? index.frameRate() : DEFAULT_FRAME_RATE;
+
+    Extractor extractor(application, index);
+    const std::vector<size_t> keyframes = extractor.selectKeyframes(frame_rate);
+    if (keyframes.empty()) {
+        fprintf(stderr, "No IRAP pictures found in %s\n", application.stream);
+        return 1;
+    }
+
+    std::vector<Thumbnail> thumbnails(keyframes.size());
+    for (size_t i = 0; i < keyframes.size(); ++i)
+        thumbnails[i].unit = keyframes[i];
+
+    const bool decoded = extractor.run(thumbnails);
+    const uint64_t extracted = time_get_count();
+
+    const bool written = application.columns ? writeContactSheet(application.output, thumbnails, application.columns)
+                                             : writeImages(application.output, thumbnails, index);
+    if (!written)
+        fprintf(stderr, "Failed to write %s\n", application.output);
+
+    const double frequency = static_cast<double>(time_get_freq());
+    printf("Access units: %u, IRAP pictures selected: %u (every %.2f s at %.3f fps), decoder instances: %d\n", static_cast<uint32_t>(index.size()),
+        static_cast<uint32_t>(keyframes.size()), application.interval, frame_rate, (std::min)(application.workers, static_cast<int32_t>(keyframes.size())));
+    printf("Indexing: %.2f ms, extraction: %.2f ms (%.2f thumbnails/s)\n", (indexed - start) * 1000. / frequency, (extracted - indexed) * 1000. / frequency,
+        keyframes.size() * frequency / (extracted - indexed));
+
+    return decoded && written ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+/*****************************************************************************
+ File name: trick_play.cpp
+ Purpose: fast forward playback on top of the sample decoder
+
+ Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.
+ Unauthorized reproduction or distribution of any portion is prohibited by law.
+******************************************************************************/
+
+#include <algorithm>
+#include "trick_play.h"
+#include "seek_index.h"
+
+void TrickPlayer::plan(const hevc_seq_par_set_t* sps)
+{
+    if (sps->vui_parameters_present_flag && sps->vui.timing_info_present && sps->vui.num_units_in_tick)
+        m_frame_rate = static_cast<double>(sps->vui.time_scale) / sps->vui.num_units_in_tick;
+
+    m_nesting = sps->temporal_id_nesting_flag != 0;
+
+    // Keep the adjustments made so far as long as the layer structure does not change
+    if (!sps->sps_max_sub_layers || sps->sps_max_sub_layers == m_sub_layers)
+        return;
+
+    m_sub_layers = sps->sps_max_sub_layers;
+
+    // Each sub-layer of a hierarchical GOP doubles the frame rate, so a rate of 2^n leaves the n highest sub-layers undisplayed
+    uint32_t dropped = 0;
+    while ((2u << dropped) <= static_cast<uint32_t>(helper.trick_play) && dropped + 1 < m_sub_layers)
+        dropped++;
+
+    m_planned.max_temporal_layer = (std::min)(helper.max_temporal_layer, m_sub_layers - 1 - dropped);
+    m_planned.preview_mode = helper.preview_mode;
+    m_pending = m_planned;
+
+    fprintf(helper.log, "Trick play %dx: decoding temporal layers 0-%u of %u at %.2f fps\n", helper.trick_play, m_planned.max_temporal_layer, m_sub_layers,
+        m_frame_rate);
+}
+
+TrickPlayLevel TrickPlayer::faster() const
+{
+    // The preview mode costs quality of every picture, so it is raised first. Dropping another sub-layer halves the display cadence.
+    TrickPlayLevel level = m_current;
+    if (level.preview_mode < HEVCVD_PREVIEW_LV4)
+        level.preview_mode++;
+    else if (level.max_temporal_layer > 0)
+        level.max_temporal_layer--;
+
+    return level;
+}
+
+TrickPlayLevel TrickPlayer::slower() const
+{
+    // Undo the steps of faster() in reverse order but never go beyond what the requested rate needs
+    TrickPlayLevel level = m_current;
+    if (level.max_temporal_layer < m_planned.max_temporal_layer)
+        level.max_temporal_layer++;
+    else if (level.preview_mode > m_planned.preview_mode)
+        level.preview_mode--;
+
+    return level;
+}
+
+void TrickPlayer::evaluate()
+{
+    const uint64_t now = time_get_count();
+    if (!m_window_start) {
+        m_window_start = now;
+        return;
+    }
+
+    const double seconds = static_cast<double>(now - m_window_start) / time_get_freq();
+    if (seconds * 1000 < TRICK_PLAY_WINDOW_MS)
+        return;
+
+    const uint32_t displayed = m_displayed.exchange(0);
+    const uint32_t content = m_content.exchange(0);
+    m_window_start = now;
+
+    m_statistics.displayed += displayed;
+    m_statistics.content += content;
+    m_statistics.seconds += seconds;
+
+    // Nothing is output while the decoder fills its DPB
+    if (!displayed)
+        return;
+
+    const double speed = content / seconds / m_frame_rate;
+    m_statistics.windows++;
+    if (speed >= helper.trick_play)
+        m_statistics.realtime++;
+
+    TrickPlayLevel level = m_current;
+    if (speed < helper.trick_play)
+        level = faster();
+    else if (speed > helper.trick_play * TRICK_PLAY_HEADROOM)
+        level = slower();
+
+    if (level != m_pending) {
+        m_pending = level;
+        fprintf(helper.log, "Trick play %dx: %.2f fps decoded, %.2f fps display cadence, switching to temporal layers 0-%u, preview mode %u\n", helper.trick_play,
+            displayed / seconds, m_frame_rate * helper.trick_play * displayed / content, level.max_temporal_layer, level.preview_mode);
+    }
+}
+
+void TrickPlayer::queue(const hevc_nalu_t* nalu)
+{
+    // A picture is decoded with one setting, so it only changes ahead of an access unit or at its first slice
+    const uint8_t nal_unit_type = nalu->nal_unit_type;
+    const bool first_slice = m_first_slice && nal_unit_type < NALU_TYPE_VPS;
+    if (nal_unit_type < NALU_TYPE_VPS)
+        m_first_slice = false;
+
+    // The queued level is set after the pictures parsed in the same copybytes() call, a sub-layer is not added behind a picture that needs it restarted
+    if (m_queued_valid && first_slice && m_queued.max_temporal_layer > m_current.max_temporal_layer && !m_nesting && !isIrap(nal_unit_type)) {
+        m_queued.max_temporal_layer = m_current.max_temporal_layer;
+        m_queued_valid = m_queued != m_current;
+    }
+
+    if (!(m_pending != m_current) || !(first_slice || (nal_unit_type >= NALU_TYPE_VPS && nal_unit_type <= NALU_TYPE_ACCESS_UNIT_DELIMITER)))
+        return;
+
+    // Pictures of a sub-layer that was not decoded may still be referenced, so a sub-layer is only added where the references restart:
+    // at an IRAP picture (leading RASL pictures aside) or anywhere if the SPS guarantees temporal nesting
+    TrickPlayLevel level = m_pending;
+    if (level.max_temporal_layer > m_current.max_temporal_layer && !m_nesting && !isIrap(nalu->nal_unit_type))
+        level.max_temporal_layer = m_current.max_temporal_layer;
+
+    if (level != m_current) {
+        m_queued = level;
+        m_queued_valid = true;
+    }
+}
+
+bool TrickPlayer::handleErrors(const uint32_t state)
+{
+    if (!Decoder::handleErrors(state))
+        return false;
+
+    // The decoder settings are not changed from its own callbacks
+    if (m_queued_valid) {
+        m_queued_valid = false;
+        if (!set(m_queued))
+            m_pending = m_current;
+    }
+
+    return true;
+}
+
+bool TrickPlayer::set(const TrickPlayLevel& level)
+{
+    if (!setDecoderParam(level.max_temporal_layer, SET_MAX_TEMPORAL_LAYER) || !setDecoderParam(level.preview_mode, SET_PREVIEW_MODE))
+        return false;
+
+    m_current = level;
+    return true;
+}
+
+void TrickPlayer::report()
+{
+    // Account for the last partial window
+    if (m_window_start)
+        m_statistics.seconds += static_cast<double>(time_get_count() - m_window_start) / time_get_freq();
+
+    m_statistics.displayed += m_displayed.exchange(0);
+    m_statistics.content += m_content.exchange(0);
+
+    if (!m_statistics.displayed || m_statistics.seconds <= 0)
+        return;
+
+    const double decoded = m_statistics.displayed / m_statistics.seconds;
+    const double cadence = m_frame_rate * helper.trick_play * m_statistics.displayed / m_statistics.content;
+
+    fprintf(helper.log, "\nTrick play %dx: %.2f fps decoded, %.2f fps display cadence, %.2fx achieved, real time in %u of %u windows\n", helper.trick_play, decoded,
+        cadence, m_statistics.content / m_statistics.seconds / m_frame_rate, m_statistics.realtime, m_statistics.windows);
+    fprintf(helper.log, "Trick play level at the end: temporal layers 0-%u of %u, preview mode %u\n", m_current.max_temporal_layer, m_sub_layers,
+        m_current.preview_mode);
+}
+
+void TrickPlayer::trickPlaySpsCallback(context_t context, const hevc_picture_t*, const hevc_seq_par_set_t* sps)
+{
+    TrickPlayer* player = static_cast<TrickPlayer*>(reinterpret_cast<Decoder*>(context.p));
+
+    if (!player || !sps)
+        return;
+
+    player->plan(sps);
+}
+
+void TrickPlayer::trickPlaySliceHeaderCallback(context_t context, const hevc_picture_t*, const hevc_slice_hdr_t* slice_hdr)
+{
+    TrickPlayer* player = static_cast<TrickPlayer*>(reinterpret_cast<Decoder*>(context.p));
+
+    if (!player || !slice_hdr)
+        return;
+
+    player->m_first_slice = slice_hdr->first_slice_in_pic_flag != 0;
+}
+
+void TrickPlayer::trickPlayNaluCallback(context_t context, const hevc_picture_t* hevc_pic, const hevc_nalu_t* nalu)
+{
+    TrickPlayer* player = static_cast<TrickPlayer*>(reinterpret_cast<Decoder*>(context.p));
+
+    if (!player || !nalu)
+        return;
+
+    Decoder::naluCallback(context, hevc_pic, nalu);
+
+    player->evaluate();
+    player->queue(nalu);
+}
+
+void TrickPlayer::trickPlayPictureOutputCallback(context_t context, const hevc_picture_t* hevc_pic)
+{
+    TrickPlayer* player = static_cast<TrickPlayer*>(reinterpret_cast<Decoder*>(context.p));
+
+    if (!player || !hevc_pic)
+        return;
+
+    if (!hevc_pic->skipped) {
+        // Pictures of the dropped sub-layers leave gaps in the POC of the output, a new CVS restarts the count
+        uint32_t content = 1;
+        if (!player->m_first_output && hevc_pic->poc > player->m_last_poc)
+            content = static_cast<uint32_t>(hevc_pic->poc - player->m_last_poc);
+
+        player->m_first_output = false;
+        player->m_last_poc = hevc_pic->poc;
+        player->m_content += content;
+        player->m_displayed++;
+    }
+
+    Decoder::pictureOutputCallback(context, hevc_pic);
+}
+
+void TrickPlayer::initCallbacks()
+{
+    Decoder::initCallbacks();
+    m_decoder_callback.sps_callback = TrickPlayer::trickPlaySpsCallback;
+    m_decoder_callback.slice_header_callback = TrickPlayer::trickPlaySliceHeaderCallback;
+    m_decoder_callback.nalu_callback = TrickPlayer::trickPlayNaluCallback;
+    m_decoder_callback.pic_output_callback = TrickPlayer::trickPlayPictureOutputCallback;
+
+    // Decoder::initialize() applies these settings
+    m_current.max_temporal_layer = helper.max_temporal_layer;
+    m_current.preview_mode = helper.preview_mode;
+    m_planned = m_current;
+    m_pending = m_current;
+    m_queued_valid = false;
+}
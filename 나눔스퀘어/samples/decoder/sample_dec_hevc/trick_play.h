@@ -0,0 +1,100 @@
+/*****************************************************************************
+ File name: trick_play.h
+ Purpose: fast forward playback on top of the sample decoder
+
+ Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+
+ MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ This software is protected by copyright law and international treaties.
+ Unauthorized reproduction or distribution of any portion is prohibited by law.
+******************************************************************************/
+
+#ifndef UUID_C71E08A4_3F52_4D9B_86A1_E04B9D2C5F37
+#define UUID_C71E08A4_3F52_4D9B_86A1_E04B9D2C5F37
+
+#include <atomic>
+#include "decoder.h"
+
+#define TRICK_PLAY_WINDOW_MS 500           // Length of the window the decoding speed is measured over
+#define TRICK_PLAY_HEADROOM 1.5            // Speed over the requested rate needed before stepping back to a better quality
+#define TRICK_PLAY_DEFAULT_FRAME_RATE 25.0 // Used if the SPS carries no timing
+
+// Decoder settings of a trick play step
+struct TrickPlayLevel
+{
+    uint32_t max_temporal_layer;
+    uint32_t preview_mode;
+
+    bool operator!=(const TrickPlayLevel& other) const { return max_temporal_layer != other.max_temporal_layer || preview_mode != other.preview_mode; }
+};
+
+// Decoding speed over the measured windows
+struct TrickPlayStatistics
+{
+    uint64_t displayed;  // Pictures output
+    uint64_t content;    // Pictures of the stream covered by the output pictures
+    double seconds;
+    uint32_t windows;
+    uint32_t realtime;   // Windows that kept up with the requested rate
+};
+
+/* Decoder that plays the stream back at a multiple of its frame rate.
+   The temporal sub-layers that would not be shown at the requested rate are not decoded at all. If the decoder still falls behind,
+   the preview mode is raised and further sub-layers are dropped, and both are restored once the decoder gets ahead again. */
+class TrickPlayer : public Decoder
+{
+public:
+    TrickPlayer(Helper& helper)
+        : Decoder(helper), m_sub_layers(0), m_nesting(false), m_frame_rate(TRICK_PLAY_DEFAULT_FRAME_RATE), m_planned(), m_current(), m_pending(),
+          m_queued(), m_queued_valid(false), m_window_start(0), m_displayed(0), m_content(0), m_last_poc(0), m_first_output(true), m_first_slice(false),
+          m_statistics()
+    {
+    }
+
+    // Prints the achieved decoding speed against the display cadence of the requested rate
+    void report();
+
+protected:
+    virtual void initCallbacks();
+    // Called after every copybytes() call, applies the level queued by the NALU callback while the decoder is not running
+    virtual bool handleErrors(const uint32_t state);
+
+private:
+    // Called as each SPS is parsed, the sub-layer count decides how many layers the rate allows to drop
+    static void trickPlaySpsCallback(context_t context, const hevc_picture_t* hevc_pic, const hevc_seq_par_set_t* sps);
+    // Called as each slice header is parsed, before the NALU callback of the slice
+    static void trickPlaySliceHeaderCallback(context_t context, const hevc_picture_t* hevc_pic, const hevc_slice_hdr_t* slice_hdr);
+    // Called as each NALU is parsed, the decoder settings are changed at access unit boundaries only
+    static void trickPlayNaluCallback(context_t context, const hevc_picture_t* hevc_pic, const hevc_nalu_t* nalu);
+    // Called in display order, measures how far the output advances through the stream
+    static void trickPlayPictureOutputCallback(context_t context, const hevc_picture_t* hevc_pic);
+
+    void plan(const hevc_seq_par_set_t* sps);
+    void evaluate();
+    void queue(const hevc_nalu_t* nalu);
+    bool set(const TrickPlayLevel& level);
+
+    TrickPlayLevel faster() const;
+    TrickPlayLevel slower() const;
+
+    uint32_t m_sub_layers;
+    bool m_nesting;
+    double m_frame_rate;
+
+    TrickPlayLevel m_planned; // Level the requested rate needs without any further degradation
+    TrickPlayLevel m_current;
+    TrickPlayLevel m_pending;
+    TrickPlayLevel m_queued;  // Level chosen at an access unit boundary, set once copybytes() returns
+    bool m_queued_valid;
+
+    uint64_t m_window_start;
+    std::atomic<uint32_t> m_displayed;
+    std::atomic<uint32_t> m_content;
+    int32_t m_last_poc;
+    bool m_first_output;
+    bool m_first_slice; // The slice NALU being parsed starts a picture
+
+    TrickPlayStatistics m_statistics;
+};
+
+#endif
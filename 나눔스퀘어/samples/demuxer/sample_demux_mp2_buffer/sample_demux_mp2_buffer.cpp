@@ -15,6 +15,14 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#if (defined(__APPLE__) || defined(__linux__))
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#else
+#include <windows.h>
+#endif
 #include <vector>
 #include <fstream>
 #include <sstream>
@@ -24,6 +32,7 @@
 #include "auxinfo.h"
 #include "buf_fifo.h"
 #include "buf_file.h"
+#include "buf_replay.h"
 #include "buf_wave.h"
 #include "sample_common_args.h"
 #include "sample_common_misc.h"
@@ -34,6 +43,9 @@
 bool USE_MP2_API = true;
 
 #define MAX_OUTPUT 32
+// the demuxer keeps at most the tail of a packet of each lent chunk,
+// so a few descriptors are enough to never wait for one
+#define IN_BUFS 4
 
 typedef struct out_bufs
 {
@@ -42,6 +54,17 @@ typedef struct out_bufs
 }out_bufs_t;
 
 
+// the input file mapped into memory, its pages are lent to the input fifo
+typedef struct input_map_s
+{
+  uint8_t *data;
+  uint64_t size;
+#if !(defined(__APPLE__) || defined(__linux__))
+  HANDLE file;
+  HANDLE mapping;
+#endif
+} input_map_t;
+
 typedef struct app_vars_s
 {
   char *in_filename;
@@ -51,6 +74,8 @@ typedef struct app_vars_s
 	int32_t parser;
 	bufstream_tt *in_bs;
 	fifo_stream_tt *in_fifo;
+	input_map_t in_map;             // New API only, not mapped for pipes or if the address space is too small
+	fifo_desc_tt in_descs[IN_BUFS]; // New API only, chunks of in_map lent to the input fifo
 	
   out_bufs_t out_bufs[MAX_OUTPUT];
 
@@ -143,10 +168,104 @@ static uint32_t stream_auxinfo(bufstream_tt *bs, uint32_t offs, uint32_t info_ID
 	return BS_OK;
 }
 
+// map the whole input file, the demuxer then parses the pages of the file
+// cache and the input is never copied. false leaves the input to be read
+static bool map_input(input_map_t *map, const char *filename)
+{
+#if (defined(__APPLE__) || defined(__linux__))
+  struct stat st;
+  void *data;
+  int fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  if ((fstat(fd, &st) < 0) || !S_ISREG(st.st_mode) || !st.st_size ||
+      ((uint64_t)(size_t)st.st_size != (uint64_t)st.st_size))
+  {
+    close(fd);
+    return false;
+  }
+
+  // the mapping stays valid after the file is closed. it is copy-on-write
+  // because the TS decryptors work in place on the input
+  data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+#if defined(__linux__)
+  madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+  map->data = (uint8_t*)data;
+  map->size = (uint64_t)st.st_size;
+#else
+  LARGE_INTEGER size;
+
+  map->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (map->file == INVALID_HANDLE_VALUE)
+    return false;
+
+  if (!GetFileSizeEx(map->file, &size) || !size.QuadPart || ((uint64_t)(SIZE_T)size.QuadPart != (uint64_t)size.QuadPart))
+  {
+    CloseHandle(map->file);
+    return false;
+  }
+
+  // copy-on-write because the TS decryptors work in place on the input
+  map->mapping = CreateFileMapping(map->file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  if (map->mapping)
+    map->data = (uint8_t*)MapViewOfFile(map->mapping, FILE_MAP_COPY, 0, 0, 0);
+  if (!map->data)
+  {
+    if (map->mapping)
+      CloseHandle(map->mapping);
+    CloseHandle(map->file);
+    return false;
+  }
+  map->size = (uint64_t)size.QuadPart;
+#endif
+  return true;
+}
+
+static void unmap_input(input_map_t *map)
+{
+  if (!map->data)
+    return;
+
+#if (defined(__APPLE__) || defined(__linux__))
+  munmap(map->data, (size_t)map->size);
+#else
+  UnmapViewOfFile(map->data);
+  CloseHandle(map->mapping);
+  CloseHandle(map->file);
+#endif
+  map->data = NULL;
+}
+
+// get a descriptor the input fifo does not hold a reference to
+static fifo_desc_tt *get_in_desc(app_vars_t *vars)
+{
+	for (int32_t i = 0; i < IN_BUFS; i++)
+	{
+		fifo_desc_tt *desc = &vars->in_descs[i];
+		if (!desc->refs)
+		{
+			desc->refs = 1;
+			return desc;
+		}
+	}
+
+	return NULL;
+}
+
 // stream detection will be limited to the chunk size
 // so it must be large enough to detect all the relevant streams
 #define CHUNK_SIZE	4*1024 * 1024
 #define FIFO_SIZE	CHUNK_SIZE * 4
+// the detection can not push more data than the input fifo holds,
+// so this is all the replay bufstream ever has to record
+#define PROBE_SIZE	FIFO_SIZE
 
 
 static void add_file_extension(char * filename, mcmediatypes_t stream_mediatype)
@@ -281,6 +400,7 @@ int main_new_api(int argc, char * argv[])
 	mp2dmux_sm_init_settings_t sm_set;
 	mp2dmux_sm_stream_settings_t sm_stream_set;
 	bufstream_tt *ibs;
+	bufstream_tt *file_bs;
 	int64_t byte_cnt, bytes_left;
 	dmux_chunk_info chunk_info;
 	int32_t i, j, ret = 1;
@@ -345,20 +465,26 @@ int main_new_api(int argc, char * argv[])
 
   pes_output_flag = (pes_output_flag == ITEM_NOT_INIT) ? 0 : 1;
 
-	// open the input file
-	vars.in_bs = open_file_buf_read(vars.in_filename, input_buffer_size + 1, NULL);
-	if (!vars.in_bs)
+	// open the input file, the replay bufstream keeps the data read during the
+	// stream detection so the input is read only once, even if it is a pipe
+	file_bs = open_file_buf_read(vars.in_filename, input_buffer_size + 1, NULL);
+	if (!file_bs)
 	{
 		printf("Unable to open the input file.\n");
 		goto clean_exit;
 	}
 
-	// get the size of the input file
-	if (vars.in_bs->auxinfo(vars.in_bs, 0, FILESIZE_INFO, (void*)&file_size, sizeof(file_size)) != BS_OK)
+	vars.in_bs = open_replay_buf_read(file_bs, PROBE_SIZE, NULL);
+	if (!vars.in_bs)
 	{
-		printf("Unable to get the size of the input file.\n");
+		close_file_buf(file_bs, 0);
+		printf("Unable to create the replay bufstream.\n");
 		goto clean_exit;
 	}
+
+	// get the size of the input file, zero if it is not known (live input)
+	if (vars.in_bs->auxinfo(vars.in_bs, 0, FILESIZE_INFO, (void*)&file_size, sizeof(file_size)) != BS_OK)
+		file_size = 0;
 	bytes_left = file_size;
 	byte_cnt = 0;
 
@@ -543,16 +669,19 @@ int main_new_api(int argc, char * argv[])
   // flush demuxer
   mp2DemuxStreamModeFlush(demuxer);
 
-  // we have to "rewind" input bufstream to make sure that all data from input file will be fetched
-  close_file_buf(vars.in_bs, 0);
-  vars.in_bs = open_file_buf_read(vars.in_filename, input_buffer_size + 1, NULL);
+  // replay the data used for the detection, then continue with the rest of the input
+  if (replay_buf_rewind(vars.in_bs) != BS_OK)
+  {
+    printf("Unable to rewind the input.\n");
+    goto clean_exit;
+  }
 
 
   bytes_left = file_size;
   byte_cnt = 0;
 
   prg_next = byte_cnt;
-	prg_mod = file_size / 100;
+	prg_mod = file_size ? file_size / 100 : CHUNK_SIZE;
   if (!prg_mod)
     prg_mod = 1;
 
@@ -562,34 +691,73 @@ int main_new_api(int argc, char * argv[])
 
 	memset(&chunk_info, 0, sizeof(dmux_chunk_info));
 
-	while ((bytes_left > 0) && (i != BS_ERROR))
+	// a regular file is mapped and lent to the fifo chunk by chunk, so the demuxer parses
+	// the file pages in place. otherwise the input is read straight into the fifo.
+	// the prefix recorded during the detection is taken from the replay bufstream first,
+	// so it is not read twice, and its buffer is released once it is consumed
+	if (file_size && map_input(&vars.in_map, vars.in_filename) && (vars.in_map.size != file_size))
+		unmap_input(&vars.in_map);
+
+	while ((!file_size || (bytes_left > 0)) && (i != BS_ERROR))
 	{
 		uint32_t bytes_avail = input_buffer_size;
 		uint8_t *ptr;
+		fifo_desc_tt *desc = NULL;
+		const bool from_map = vars.in_map.data && !vars.in_bs->usable_bytes(vars.in_bs);
 
-		if (bytes_avail > bytes_left)
+		if (file_size && (bytes_avail > bytes_left))
 			bytes_avail = (uint32_t)bytes_left;
 
-		ptr = ibs->request(ibs, bytes_avail);
-		if (!ptr)
+		if (from_map)
+			desc = get_in_desc(&vars);
+
+		if (desc)
 		{
-			bytes_avail = vars.in_bs->usable_bytes(vars.in_bs);
-			ptr = ibs->request(ibs, bytes_avail);
-			if (!ptr)
+			// the fifo takes over our reference, the descriptor is free again once the demuxer consumed the chunk
+			desc->ptr = vars.in_map.data + byte_cnt;
+			desc->numSamples = bytes_avail;
+			chunk_info.length = lend_fifo_buf(vars.in_fifo, desc);
+			if (!chunk_info.length)
 			{
-				printf("\nUnable to request %u bytes from input fifo.\n", bytes_avail);
+				printf("\nUnable to lend %u bytes to the input fifo.\n", bytes_avail);
 				goto clean_exit;
 			}
 		}
-
-		chunk_info.length = vars.in_bs->copybytes(vars.in_bs, ptr, bytes_avail);
-		if (chunk_info.length != bytes_avail)
+		else
 		{
-			printf("\nUnable to copy %u bytes from input file.\n", bytes_avail);
-			goto clean_exit;
-		}
+			ptr = ibs->request(ibs, bytes_avail);
+			if (!ptr)
+			{
+				bytes_avail = ibs->usable_bytes(ibs);
+				ptr = ibs->request(ibs, bytes_avail);
+				if (!ptr)
+				{
+					printf("\nUnable to request %u bytes from input fifo.\n", bytes_avail);
+					goto clean_exit;
+				}
+			}
 
-		ibs->confirm(ibs, chunk_info.length);
+			// all descriptors are still held, the mapped chunk is copied like a read would do
+			if (from_map)
+			{
+				memcpy(ptr, vars.in_map.data + byte_cnt, bytes_avail);
+				chunk_info.length = bytes_avail;
+			}
+			else
+			{
+				chunk_info.length = vars.in_bs->copybytes(vars.in_bs, ptr, bytes_avail);
+				if (!file_size && !chunk_info.length)
+					break;  // end of a live input
+
+				if (file_size && (chunk_info.length != bytes_avail))
+				{
+					printf("\nUnable to copy %u bytes from input file.\n", bytes_avail);
+					goto clean_exit;
+				}
+			}
+
+			ibs->confirm(ibs, chunk_info.length);
+		}
 
 		i = ibs->auxinfo(ibs, 0, DMUX_CHUNK_INFO, (uint8_t*)&chunk_info, sizeof(dmux_chunk_info));
 		if (i == BS_ERROR)
@@ -602,9 +770,12 @@ int main_new_api(int argc, char * argv[])
 		bytes_left -= chunk_info.length;
 		if (byte_cnt >= prg_next)
 		{
-			printf("\rProcessed %u%% ...", (uint32_t)((double)byte_cnt / (double)file_size * 100.0));
+			if (file_size)
+				printf("\rProcessed %u%% ...", (uint32_t)((double)byte_cnt / (double)file_size * 100.0));
+			else
+				printf("\rProcessed %u MB ...", (uint32_t)(byte_cnt >> 20));
 			prg_next += prg_mod;
-			if (prg_next > file_size)
+			if (file_size && (prg_next > file_size))
 				prg_next = file_size;
 		}
 	}
@@ -621,11 +792,14 @@ clean_exit:
 	}
 
 	if (vars.in_bs)
-		close_file_buf(vars.in_bs, 0);
+		close_replay_buf(vars.in_bs, 0);
 
   if (vars.in_fifo)
     free_fifo_buf(vars.in_fifo);
 
+  // freeing the fifo dropped its references to the lent chunks
+  unmap_input(&vars.in_map);
+
   for (int i = 0; i < MAX_OUTPUT; i++)
   {
     if (vars.out_bufs[i].out_bs)
@@ -26,6 +26,7 @@
 #include "sample_common_args.h"
 #include "sample_common_misc.h"
 #include "demux_mp2.h"
+#include "ts_prescan.h"
 
 bool USE_MP2_API = true;
 
@@ -64,6 +65,7 @@ void print_usage() {
 
     printf("\n==== MainConcept MPEG-2 Demuxer file sample ====\n"
         "Usage:\nsample_demux_mp2_file -i <filename> [-tid <id> -sid <id>] -o <filename> [-idx] [-find_stream_limit <amount in MiB>] [-old]\n"
+        "       sample_demux_mp2_file -i <filename> -prescan [-nth <n>]\n"
         " -i <filename>     input filename\n"
         " -o <filename>     output filename\n"
         " -tid <id>         title id\n"
@@ -74,6 +76,9 @@ void print_usage() {
         "                   file. If insufficient data is found, only \n"
         "                   PMT will be used for stream information.\n"
         " -old              use the demuxer's old API\n"
+        " -prescan          index a transport stream without the demuxer, the\n"
+        "                   index is written to <filename>.mcidx\n"
+        " -nth <n>          number of -prescan threads, default is one per core\n"
         "Use -tid, -sid and -o to demux a particular stream.  Otherwise just\n"
         "print information about the streams in the input file\n"
         "\n"
@@ -81,6 +86,7 @@ void print_usage() {
 }
 
 #define IDS_FIND_STREAM_LIMIT      (IDC_CUSTOM_START_ID + 1)
+#define IDN_PRESCAN                (IDC_CUSTOM_START_ID + 2)
 
 int main_new_api(int argc, char * argv[])
 {
@@ -95,6 +101,8 @@ int main_new_api(int argc, char * argv[])
     int64_t byte_cnt, prg_mod, prg_next;
     app_vars_t vars;
     int32_t find_stream_limit;
+    int32_t prescan;
+    int32_t num_threads;
     char *custom_arg(NULL);
 
     arg_item_t params[] =
@@ -103,14 +111,17 @@ int main_new_api(int argc, char * argv[])
         { IDI_C_TITLE_ID,    0,  &vars.tid},
         { IDI_C_STREAM_ID,   0,  &vars.sid},
         { IDS_OUTPUT_FILE,   0,  &vars.out_file},
+        { IDI_NUM_THREADS,   0,  &num_threads},
         { IDS_CUSTOM_ARG,    0,  &custom_arg},
         //custom args
-        { IDS_FIND_STREAM_LIMIT,        0, &find_stream_limit}
+        { IDS_FIND_STREAM_LIMIT,        0, &find_stream_limit},
+        { IDN_PRESCAN,                  0, &prescan}
     };
 
     static const arg_item_desc_t custom_args[] =
     {
         { IDS_FIND_STREAM_LIMIT, { "find_stream_limit", 0 }, ItemTypeInt, 1, "find stream limit" },
+        { IDN_PRESCAN, { "prescan", 0 }, ItemTypeNoArg, 1, "index the transport stream without the demuxer" },
     };
 
     memset(&vars, 0, sizeof(app_vars_t));
@@ -144,6 +155,13 @@ int main_new_api(int argc, char * argv[])
         }
     }
 
+    if (prescan == 1)
+    {
+        char index_file[BUFFER_SIZE + 8];
+        sprintf(index_file, "%s.mcidx", vars.in_file);
+        return ts_prescan(vars.in_file, index_file, num_threads != ITEM_NOT_INIT ? num_threads : 0) ? 1 : 0;
+    }
+
     // create a demuxer
     memset(&demuxer_set, 0, sizeof(mp2dmux_settings_t));
 
@@ -0,0 +1,733 @@
+/* ----------------------------------------------------------------------------
+ * File: ts_prescan.cpp
+ * Desc: parallel pre-scan of MPEG-2 transport streams into an mcidx index
+ *
+ * Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PRESCAN_SSE2
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#include "auxinfo.h"
+#include "bufstrm.h"
+#include "mcindextypes.h"
+#include "mcmediatypes.h"
+#include "buf_index.h"
+#include "buf_null.h"
+#include "ts_prescan.h"
+
+#define TS_SYNC_BYTE            0x47
+#define TS_PACKET_SIZE          188
+#define TS_NULL_PID             0x1FFF
+#define TS_PAT_PID              0x0000
+#define TS_MAX_PSI_SECTION      1024                // PAT and PMT sections, section_length is at most 1021
+
+#define PRESCAN_BLOCK_SIZE      (4 * 1024 * 1024)   // read size of a range scanner
+#define PRESCAN_MIN_RANGE       (64 * 1024 * 1024)  // smaller files are split in fewer ranges
+#define PRESCAN_RANGES_PER_THREAD 4                 // ranges are handed out dynamically to balance the threads
+#define PRESCAN_PROBE_SIZE      (1024 * 1024)       // data read to detect the packet size
+#define PRESCAN_PROBE_PACKETS   20                  // consecutive packets needed to detect the packet size
+#define PRESCAN_SYNC_PACKETS    5                   // consecutive packets needed to resync
+#define PRESCAN_PAT_SCAN_SIZE   (16 * 1024 * 1024)  // data searched for the first PAT before the ranges are scanned
+
+
+struct ts_format
+{
+    uint32_t stride;        // 188, 192 (M2TS time code prefix) or 204 (Reed-Solomon suffix)
+    uint32_t sync_offset;   // position of the sync byte in a packet
+};
+
+struct ts_pes_entry
+{
+    uint64_t offset;
+    uint64_t pts;
+    uint64_t dts;
+    uint32_t flags;
+    uint16_t pid;
+    uint8_t stream_id;
+};
+
+struct ts_pcr_entry
+{
+    uint64_t offset;
+    uint64_t pcr;
+    uint16_t pid;
+};
+
+struct ts_pmt_stream
+{
+    uint16_t program_number;
+    uint8_t stream_type;
+};
+
+// a PSI section assembled from the packets of a PID
+struct ts_section
+{
+    std::vector<uint8_t> data;      // empty if no section is started
+    uint8_t continuity;             // counter of the last packet, 0xFF before the first one
+};
+
+struct ts_range
+{
+    uint64_t start;
+    uint64_t end;
+
+    std::vector<ts_pes_entry> pes;
+    std::vector<ts_pcr_entry> pcr;
+    std::map<uint16_t, ts_pmt_stream> streams;
+    std::set<uint16_t> pmt_pids;    // listed in the PATs, the first ones are found before the ranges are scanned
+    std::map<uint16_t, ts_section> sections;
+    uint64_t packets;
+    uint32_t resyncs;
+    bool failed;
+};
+
+
+static FILE *open_input(const char *file_name, uint64_t offset)
+{
+    FILE *file = fopen(file_name, "rb");
+    if (!file)
+        return NULL;
+
+#if defined(_WIN32)
+    if (_fseeki64(file, offset, SEEK_SET))
+#else
+    if (fseeko(file, offset, SEEK_SET))
+#endif
+    {
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+
+// position of the first sync byte candidate, size if there is none
+static size_t find_sync_byte(const uint8_t *data, size_t size)
+{
+    size_t i = 0;
+
+#ifdef PRESCAN_SSE2
+    // compare 16 bytes at once, almost every byte is rejected here
+    const __m128i sync = _mm_set1_epi8(TS_SYNC_BYTE);
+    for (; i + 16 <= size; i += 16)
+    {
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i)), sync));
+        if (mask)
+        {
+#if defined(_MSC_VER)
+            unsigned long bit;
+            _BitScanForward(&bit, mask);
+            return i + bit;
+#else
+            return i + __builtin_ctz(mask);
+#endif
+        }
+    }
+#endif
+
+    for (; i < size; i++)
+    {
+        if (data[i] == TS_SYNC_BYTE)
+            break;
+    }
+    return i;
+}
+
+
+// number of consecutive sync bytes at the stride starting at data, up to count
+static uint32_t count_sync(const uint8_t *data, size_t size, uint32_t stride, uint32_t count)
+{
+    uint32_t n = 0;
+    while (n < count && (size_t)n * stride < size && data[(size_t)n * stride] == TS_SYNC_BYTE)
+        n++;
+    return n;
+}
+
+
+static bool detect_format(const char *file_name, ts_format &format)
+{
+    static const uint32_t strides[] = { 188, 192, 204 };
+
+    FILE *file = open_input(file_name, 0);
+    if (!file)
+        return false;
+
+    std::vector<uint8_t> data(PRESCAN_PROBE_SIZE);
+    const size_t size = fread(&data[0], 1, data.size(), file);
+    fclose(file);
+
+    for (size_t pos = find_sync_byte(&data[0], size); pos < size; pos += 1 + find_sync_byte(&data[pos + 1], size - pos - 1))
+    {
+        for (size_t i = 0; i < sizeof(strides) / sizeof(strides[0]); i++)
+        {
+            // a short file only needs to be consistent
+            const uint32_t needed = (std::min)((uint32_t)PRESCAN_PROBE_PACKETS, (uint32_t)((size - pos) / strides[i]));
+            if (needed && count_sync(&data[pos], size - pos, strides[i], needed) == needed)
+            {
+                format.stride = strides[i];
+                format.sync_offset = strides[i] == 192 && pos >= 4 ? 4 : 0;
+                return true;
+            }
+        }
+
+        if (pos + 1 >= size)
+            break;
+    }
+
+    return false;
+}
+
+
+static uint64_t read_timestamp(const uint8_t *p)
+{
+    return ((uint64_t)((p[0] >> 1) & 0x07) << 30) | ((uint64_t)p[1] << 22) | ((uint64_t)(p[2] >> 1) << 15) | ((uint64_t)p[3] << 7) | (p[4] >> 1);
+}
+
+
+static void parse_section(uint16_t pid, const uint8_t *section, size_t size, ts_range &range)
+{
+    // a section with current_next_indicator 0 only announces the next version
+    if (size < 12 || !(section[5] & 0x01))
+        return;
+
+    const size_t end = size - 4;  // CRC
+
+    if (pid == TS_PAT_PID && section[0] == 0x00)
+    {
+        for (size_t pos = 8; pos + 4 <= end; pos += 4)
+        {
+            // program 0 carries the network PID
+            const uint16_t program_number = (section[pos] << 8) | section[pos + 1];
+            if (program_number)
+                range.pmt_pids.insert(((section[pos + 2] & 0x1F) << 8) | section[pos + 3]);
+        }
+    }
+    else if (pid != TS_PAT_PID && section[0] == 0x02 && size >= 16)
+    {
+        const uint16_t program_number = (section[3] << 8) | section[4];
+        size_t pos = 12 + (((section[10] & 0x0F) << 8) | section[11]);
+
+        while (pos + 5 <= end)
+        {
+            const uint16_t stream_pid = ((section[pos + 1] & 0x1F) << 8) | section[pos + 2];
+            if (!range.streams.count(stream_pid))
+            {
+                ts_pmt_stream stream = { program_number, section[pos] };
+                range.streams[stream_pid] = stream;
+            }
+            pos += 5 + (((section[pos + 3] & 0x0F) << 8) | section[pos + 4]);
+        }
+    }
+}
+
+
+// appends up to the end of the section and parses it once it is complete, returns the bytes used
+static size_t append_section(uint16_t pid, ts_section &section, const uint8_t *data, size_t size, ts_range &range)
+{
+    const size_t before = section.data.size();
+    section.data.insert(section.data.end(), data, data + size);
+    if (section.data.size() < 3)
+        return size;
+
+    const size_t length = 3 + (((section.data[1] & 0x0F) << 8) | section.data[2]);
+    if (length > TS_MAX_PSI_SECTION)
+    {
+        section.data.clear();
+        return size;
+    }
+    if (section.data.size() < length)
+        return size;
+
+    parse_section(pid, &section.data[0], length, range);
+    section.data.clear();
+    return length - before;
+}
+
+
+// sections may span several packets and a packet may hold the end of one section and the start of others
+static void assemble_sections(uint16_t pid, uint8_t continuity, bool unit_start, const uint8_t *payload, size_t size, ts_range &range)
+{
+    std::map<uint16_t, ts_section>::iterator it = range.sections.find(pid);
+    if (it == range.sections.end())
+    {
+        it = range.sections.insert(std::make_pair(pid, ts_section())).first;
+        it->second.continuity = 0xFF;
+    }
+    ts_section &section = it->second;
+
+    // a repeated packet is skipped, a lost one drops the section
+    if (continuity == section.continuity)
+        return;
+    if (((section.continuity + 1) & 0x0F) != continuity)
+        section.data.clear();
+    section.continuity = continuity;
+
+    size_t pos = 0;
+    if (unit_start)
+    {
+        pos = 1 + payload[0];
+        if (pos > size)
+        {
+            section.data.clear();
+            return;
+        }
+        // the bytes up to the pointer end the previous section
+        if (!section.data.empty())
+            append_section(pid, section, payload + 1, pos - 1, range);
+        section.data.clear();
+    }
+
+    while (pos < size)
+    {
+        // new sections only start behind the pointer, stuffing fills the rest
+        if (section.data.empty() && (!unit_start || payload[pos] == 0xFF))
+            break;
+        pos += append_section(pid, section, payload + pos, size - pos, range);
+    }
+}
+
+
+static void parse_packet(const uint8_t *packet, uint64_t offset, ts_range &range)
+{
+    range.packets++;
+
+    // transport error indicator
+    if (packet[1] & 0x80)
+        return;
+
+    const uint16_t pid = ((packet[1] & 0x1F) << 8) | packet[2];
+    if (pid == TS_NULL_PID)
+        return;
+
+    const uint8_t adaptation_field_control = (packet[3] >> 4) & 0x03;
+    size_t pos = 4;
+    uint32_t flags = 0;
+
+    if (adaptation_field_control & 0x02)
+    {
+        const uint8_t length = packet[4];
+        if (length > TS_PACKET_SIZE - 5)
+            return;
+
+        if (length)
+        {
+            if (packet[5] & 0x40)  // random access indicator
+                flags |= MCIDX_VAU_RP_TYPE;
+
+            if ((packet[5] & 0x10) && length >= 7)
+            {
+                const uint8_t *p = packet + 6;
+                const uint64_t base = ((uint64_t)p[0] << 25) | ((uint64_t)p[1] << 17) | ((uint64_t)p[2] << 9) | ((uint64_t)p[3] << 1) | (p[4] >> 7);
+                const uint64_t extension = ((p[4] & 0x01) << 8) | p[5];
+                ts_pcr_entry entry = { offset, base * 300 + extension, pid };
+                range.pcr.push_back(entry);
+            }
+        }
+        pos = 5 + length;
+    }
+
+    if (!(adaptation_field_control & 0x01) || pos >= TS_PACKET_SIZE)
+        return;
+
+    const uint8_t *payload = packet + pos;
+    const size_t size = TS_PACKET_SIZE - pos;
+    const bool unit_start = (packet[1] & 0x40) != 0;
+
+    // the PAT and the PMTs it lists are read as sections, the other PIDs only index their PES starts
+    if (pid == TS_PAT_PID || range.pmt_pids.count(pid))
+    {
+        assemble_sections(pid, packet[3] & 0x0F, unit_start, payload, size, range);
+        return;
+    }
+
+    if (unit_start && size >= 9 && payload[0] == 0x00 && payload[1] == 0x00 && payload[2] == 0x01)
+    {
+        ts_pes_entry entry = { offset, 0, 0, flags, pid, payload[3] };
+
+        // streams without the optional PES header lack the '10' marker bits
+        if ((payload[6] & 0xC0) == 0x80)
+        {
+            const uint8_t pts_dts_flags = payload[7] >> 6;
+            if ((pts_dts_flags & 0x02) && size >= 14)
+            {
+                entry.pts = read_timestamp(payload + 9);
+                entry.flags |= MCIDX_AU_TIMESTAMP_IS_VALID;
+            }
+            if (pts_dts_flags == 0x03 && size >= 19)
+            {
+                entry.dts = read_timestamp(payload + 14);
+                entry.flags |= MCIDX_AU_GEN_TIMESTAMP_IS_VALID;
+            }
+        }
+        range.pes.push_back(entry);
+    }
+}
+
+
+// scans the packets whose sync byte lies in the range, the last one may end past it,
+// until_pat stops at the first PAT
+static void scan_range(const char *file_name, const ts_format &format, ts_range &range, bool until_pat)
+{
+    FILE *file = open_input(file_name, range.start);
+    if (!file)
+    {
+        range.failed = true;
+        return;
+    }
+
+    std::vector<uint8_t> buffer(PRESCAN_BLOCK_SIZE + format.stride * PRESCAN_SYNC_PACKETS);
+    uint64_t buffer_offset = range.start;   // file offset of buffer[0]
+    size_t filled = 0;
+    size_t pos = 0;
+    bool locked = false;
+    bool eof = false;
+
+    while (!eof)
+    {
+        // keep the incomplete packet or resync window and refill
+        filled -= pos;
+        memmove(&buffer[0], &buffer[pos], filled);
+        buffer_offset += pos;
+        pos = 0;
+
+        const size_t read = fread(&buffer[filled], 1, buffer.size() - filled, file);
+        filled += read;
+        eof = read == 0;
+
+        while (buffer_offset + pos < range.end)
+        {
+            if (!locked)
+            {
+                pos += find_sync_byte(&buffer[pos], filled - pos);
+
+                // a candidate needs a few more sync bytes at the packet stride, unless the file ends
+                const uint32_t needed = eof ? (std::max)(1u, (std::min)((uint32_t)PRESCAN_SYNC_PACKETS, (uint32_t)((filled - pos) / format.stride))) : PRESCAN_SYNC_PACKETS;
+                const uint32_t found = count_sync(&buffer[pos], filled - pos, format.stride, needed);
+                if (found < needed || pos + TS_PACKET_SIZE > filled)
+                {
+                    if (pos + (size_t)format.stride * (PRESCAN_SYNC_PACKETS - 1) + 1 > filled)
+                        break;      // not enough data to decide
+                    pos++;
+                    continue;
+                }
+                locked = true;
+            }
+
+            if (pos + TS_PACKET_SIZE > filled)
+                break;
+
+            if (buffer[pos] != TS_SYNC_BYTE)
+            {
+                locked = false;
+                range.resyncs++;
+                pos++;
+                continue;
+            }
+
+            const uint64_t sync = buffer_offset + pos;
+            parse_packet(&buffer[pos], sync >= format.sync_offset ? sync - format.sync_offset : 0, range);
+            pos += format.stride;
+
+            if (until_pat && !range.pmt_pids.empty())
+            {
+                eof = true;
+                break;
+            }
+        }
+
+        if (buffer_offset + pos >= range.end)
+            break;
+    }
+
+    fclose(file);
+}
+
+
+static mcmediatypes_t media_type(uint8_t stream_type)
+{
+    switch (stream_type)
+    {
+    case 0x01:
+    case 0x02: return mctMPEG2V;
+    case 0x03: return mctMPEG1A;
+    case 0x04: return mctMPEG2A;
+    case 0x0F: return mctAAC_ADTS;
+    case 0x10: return mctMPEG4V;
+    case 0x11: return mctAAC_LATM;
+    case 0x1B: return mctH264;
+    case 0x24: return mctHEVC;
+    case 0x81: return mctAC3;
+    case 0xEA: return mctVC1;
+    default:   return mctUnknown;
+    }
+}
+
+
+struct ts_index
+{
+    mcidx_index_header_t header;
+    std::vector<mcidx_au_entry_t> entries;
+};
+
+
+static void init_index_header(mcidx_index_header_t &header, uint16_t pid)
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.indexIdentifier, MCIDX_INDEX_HDR_ID, sizeof(header.indexIdentifier));
+    header.nVersion = MCIDX_INDEX_HDR_VERSION_0100;
+    header.nIndexType = MCIDX_INDEX_HDR_TYPE_AU_LIST;
+    header.nIndexTypeVersion = MCIDX_AU_ENTRY_VERSION_0100;
+    header.nIndexTypeSize = MCIDX_AU_ENTRY_VERSION_0100_SIZE;
+    header.nFlags = MCIDX_INDEX_HDR_PID_VALID;
+    header.nPID = pid;
+    header.nStreamType = mctUnknown;
+}
+
+
+// merge the ranges in file order, one index per PES PID and one per PCR PID
+static void merge_ranges(const std::vector<ts_range> &ranges, std::vector<ts_index> &indexes)
+{
+    std::map<uint16_t, ts_pmt_stream> streams;
+    std::map<uint16_t, size_t> pes_indexes, pcr_indexes;
+
+    for (size_t i = 0; i < ranges.size(); i++)
+        streams.insert(ranges[i].streams.begin(), ranges[i].streams.end());
+
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        const ts_range &range = ranges[i];
+
+        for (size_t j = 0; j < range.pes.size(); j++)
+        {
+            const ts_pes_entry &pes = range.pes[j];
+
+            std::map<uint16_t, size_t>::iterator it = pes_indexes.find(pes.pid);
+            if (it == pes_indexes.end())
+            {
+                it = pes_indexes.insert(std::make_pair(pes.pid, indexes.size())).first;
+                indexes.push_back(ts_index());
+
+                mcidx_index_header_t &header = indexes.back().header;
+                init_index_header(header, pes.pid);
+                header.nStreamId = pes.stream_id;
+                header.nFlags |= MCIDX_INDEX_HDR_ESID_VALID;
+
+                std::map<uint16_t, ts_pmt_stream>::const_iterator stream = streams.find(pes.pid);
+                if (stream != streams.end())
+                {
+                    header.nStreamType = media_type(stream->second.stream_type);
+                    header.nProgramNum = stream->second.program_number;
+                    header.nFlags |= MCIDX_INDEX_HDR_PROGRAM_VALID;
+                }
+            }
+
+            mcidx_au_entry_t entry;
+            memset(&entry, 0, sizeof(entry));
+            entry.nFlags = pes.flags | MCIDX_AU_TIMESTAMPS_90KHz_UNITS;
+            entry.nPackOffset = pes.offset;
+            entry.nTimestamp = pes.pts;
+            entry.nGenTimestamp = pes.dts;
+            indexes[it->second].entries.push_back(entry);
+        }
+
+        for (size_t j = 0; j < range.pcr.size(); j++)
+        {
+            const ts_pcr_entry &pcr = range.pcr[j];
+
+            std::map<uint16_t, size_t>::iterator it = pcr_indexes.find(pcr.pid);
+            if (it == pcr_indexes.end())
+            {
+                // the PCR index carries no stream id, which tells it apart from a PES index of the same PID
+                it = pcr_indexes.insert(std::make_pair(pcr.pid, indexes.size())).first;
+                indexes.push_back(ts_index());
+                init_index_header(indexes.back().header, pcr.pid);
+            }
+
+            mcidx_au_entry_t entry;
+            memset(&entry, 0, sizeof(entry));
+            entry.nFlags = MCIDX_AU_TIMESTAMP_IS_VALID | MCIDX_AU_TIMESTAMPS_27MHz_UNITS;
+            entry.nPackOffset = pcr.offset;
+            entry.nTimestamp = pcr.pcr;
+            indexes[it->second].entries.push_back(entry);
+        }
+    }
+}
+
+
+static int32_t write_index(const char *in_file, const char *index_file, std::vector<ts_index> &indexes)
+{
+    int32_t ret = 1;
+
+    if (indexes.empty() || indexes.size() > 0xFFFF)
+    {
+        printf("No indexable streams found\n");
+        return 1;
+    }
+
+    // buf_index only needs a main bufstream to pass the data through
+    bufstream_tt *null_bs = open_null_buf_write(65536, NULL);
+    if (!null_bs)
+        return 1;
+
+    bufstream_tt *idx_bs = open_bufstream_write_with_index(null_bs, in_file, index_file, 1);
+    if (!idx_bs)
+    {
+        printf("Failed to open output index file\n");
+        close_null_buf(null_bs, 0);
+        return 1;
+    }
+
+    mcidx_file_header_t file_header;
+    memset(&file_header, 0, sizeof(file_header));
+    memcpy(file_header.fileIdentifier, MCIDX_FILE_HDR_ID, sizeof(file_header.fileIdentifier));
+    file_header.nVersion = MCIDX_FILE_HDR_VERSION_0100;
+    file_header.nContainerType = mcmjtMPEG2Transport;
+    file_header.nIndexCount = (uint16_t)indexes.size();
+
+    if (idx_bs->auxinfo(idx_bs, 0, INDEX_CONTAINER_INFO, &file_header, MCIDX_FILE_HDR_VERSION_0100_SIZE) != BS_OK)
+        goto exit;
+
+    for (size_t i = 0; i < indexes.size(); i++)
+    {
+        // buf_index counts the entries itself
+        indexes[i].header.nItemCount = 0;
+        if (idx_bs->auxinfo(idx_bs, (uint32_t)i, INDEX_STREAM_INFO, &indexes[i].header, MCIDX_INDEX_HDR_VERSION_0100_SIZE) != BS_OK)
+            goto exit;
+
+        for (size_t j = 0; j < indexes[i].entries.size(); j++)
+        {
+            if (idx_bs->auxinfo(idx_bs, (uint32_t)i, INDEX_AU_INFO, &indexes[i].entries[j], MCIDX_AU_ENTRY_VERSION_0100_SIZE) != BS_OK)
+                goto exit;
+        }
+    }
+
+    ret = 0;
+
+exit:
+    if (ret)
+        printf("Failed to write the index file\n");
+
+    close_bufstream_write_with_index(idx_bs, ret);
+    close_null_buf(null_bs, 0);
+    return ret;
+}
+
+
+int32_t ts_prescan(const char *in_file, const char *index_file, int32_t num_threads)
+{
+    const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+    ts_format format;
+    if (!detect_format(in_file, format))
+    {
+        printf("No transport stream packets found in the input file\n");
+        return 1;
+    }
+
+    FILE *file = open_input(in_file, 0);
+    if (!file)
+    {
+        printf("Unable to open the input file\n");
+        return 1;
+    }
+#if defined(_WIN32)
+    _fseeki64(file, 0, SEEK_END);
+    const uint64_t file_size = _ftelli64(file);
+#else
+    fseeko(file, 0, SEEK_END);
+    const uint64_t file_size = ftello(file);
+#endif
+    fclose(file);
+
+    if (num_threads <= 0)
+        num_threads = (std::max)(1u, std::thread::hardware_concurrency());
+
+    // the PMT PIDs are taken from the first PAT, a range adds the ones of the PATs in it
+    ts_range probe;
+    probe.start = 0;
+    probe.end = (std::min)(file_size, (uint64_t)PRESCAN_PAT_SCAN_SIZE);
+    probe.packets = 0;
+    probe.resyncs = 0;
+    probe.failed = false;
+    scan_range(in_file, format, probe, true);
+
+    // the ranges are cut at arbitrary offsets, every range scanner resyncs on its own
+    const uint64_t range_count = (std::max)((uint64_t)1, (std::min)((uint64_t)num_threads * PRESCAN_RANGES_PER_THREAD, file_size / PRESCAN_MIN_RANGE));
+    std::vector<ts_range> ranges((size_t)range_count);
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        ranges[i].start = file_size * i / range_count;
+        ranges[i].end = file_size * (i + 1) / range_count;
+        ranges[i].packets = 0;
+        ranges[i].resyncs = 0;
+        ranges[i].failed = false;
+        ranges[i].pmt_pids = probe.pmt_pids;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (int32_t i = 0; i < num_threads && i < (int32_t)ranges.size(); i++)
+    {
+        threads.push_back(std::thread([&]()
+        {
+            for (size_t j = next++; j < ranges.size(); j = next++)
+                scan_range(in_file, format, ranges[j], false);
+        }));
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    uint64_t packets = 0;
+    uint32_t resyncs = 0;
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        if (ranges[i].failed)
+        {
+            printf("Unable to read the input file\n");
+            return 1;
+        }
+        packets += ranges[i].packets;
+        resyncs += ranges[i].resyncs;
+    }
+
+    const double scan_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::vector<ts_index> indexes;
+    merge_ranges(ranges, indexes);
+    ranges.clear();
+
+    if (write_index(in_file, index_file, indexes))
+        return 1;
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    printf("Pre-scanned %.1f MB of %u byte packets on %d threads in %.2f s (%.1f MB/s), index written after %.2f s\n",
+           file_size / 1048576.0, format.stride, (int32_t)threads.size(), scan_seconds,
+           scan_seconds > 0 ? file_size / 1048576.0 / scan_seconds : 0.0, seconds);
+    printf("  %llu packets, %u resyncs, %u indexes written to %s\n", (unsigned long long)packets, resyncs, (uint32_t)indexes.size(), index_file);
+
+    return 0;
+}
@@ -0,0 +1,28 @@
+/* ----------------------------------------------------------------------------
+ * File: ts_prescan.h
+ * Desc: parallel pre-scan of MPEG-2 transport streams into an mcidx index
+ *
+ * Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef TS_PRESCAN_H_INCLUDED
+#define TS_PRESCAN_H_INCLUDED
+
+#include "mctypes.h"
+
+// Scans a transport stream (188, 192 or 204 byte packets) without the demuxer. The file is
+// split into ranges which are scanned on separate threads, each one resyncs on the sync byte
+// and collects the PES starts with their PTS/DTS and the PCRs of every PID. The stream types
+// come from the PMTs on the PIDs listed in the PAT. The results are merged in file order and
+// written as an mcindextypes.h index, one index per PES PID and one per PCR PID.
+//
+// num_threads <= 0 uses one thread per CPU core
+// returns 0 if successful
+int32_t ts_prescan(const char *in_file, const char *index_file, int32_t num_threads);
+
+#endif // TS_PRESCAN_H_INCLUDED
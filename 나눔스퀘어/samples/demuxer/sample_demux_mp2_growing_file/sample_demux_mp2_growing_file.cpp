@@ -25,6 +25,7 @@
 #include "buf_file.h"
 #include "auxinfo.h"
 #include "sample_common_misc.h"
+#include "growing_file_watch.h"
 
 #if defined(_WIN32)
 
@@ -162,6 +163,10 @@ void* FileCopyThread(void * pParams)
         mc_sleep(demux_vars->copy_delay_ms);
     };
 
+    // closing lets the demuxer know that the file is complete
+    fclose(demux_vars->copy_file);
+    demux_vars->copy_file = NULL;
+
     printf ("File Copy - Thread finished\n");
 
     demux_vars->filecopy_done = true;
@@ -340,9 +345,10 @@ void* DemuxThread(void * pParams)
     int32_t wait_count = 0;
     int32_t ret = 0;
 
-    int32_t eos_wait_count = 0;
     uint8_t eos_sent = 0;
 
+    growing_file_watch_t *watch = NULL;
+
     demuxer_vars *demux_vars = (demuxer_vars*)pParams;
 
     printf("Initialize demuxer\n\n");
@@ -427,6 +433,15 @@ void* DemuxThread(void * pParams)
     }
 
     
+    // wake up as soon as the file grows instead of polling it
+    watch = growing_file_watch_open(demux_vars->growing_file_name);
+    if (!watch)
+    {
+        printf(" demuxer - Unable to watch the growing file\n");
+        demux_vars->demuxing_error = true;
+        goto exit;
+    }
+
     // seek to file begin
     mp2DemuxSeekPos(demux_vars->demuxer, demux_vars->parser, 0);
 
@@ -443,7 +458,7 @@ void* DemuxThread(void * pParams)
         }
         else if (ret > 0) // got some data
         {
-            eos_wait_count = 0;
+            growing_file_consumed(watch);
 
             //printf("  demuxer - mp2DemuxPush returned: %d\n", ret );
 
@@ -482,17 +497,31 @@ void* DemuxThread(void * pParams)
                 eos_sent = 1;
                 continue;
             }
-            else if(eos_wait_count * 100  >= EOS_MAX_WAIT)
+
+            switch (growing_file_wait(watch, EOS_MAX_WAIT, NULL))
             {
-                printf("  demuxer - No file update for %d seconds - give up\n", eos_wait_count * 100 / 1000);
+            case GROWING_FILE_GREW:
+                mp2DemuxUpdateFilesize(demux_vars->demuxer, demux_vars->parser, 0);
+                break;
+
+            case GROWING_FILE_CLOSED:
+                printf("  demuxer - sending EOS as the writer closed the file\n");
+                mp2DemuxUpdateFilesize(demux_vars->demuxer, demux_vars->parser, -1);
+                eos_sent = 1;
+                break;
+
+            case GROWING_FILE_TIMEOUT:
+                printf("  demuxer - No file update for %d seconds - give up\n", EOS_MAX_WAIT / 1000);
                 // Tell demuxer to reset growing file mode 
                 mp2DemuxUpdateFilesize(demux_vars->demuxer, demux_vars->parser, -1);
                 eos_sent = 1;
-                continue;
+                break;
+
+            default:
+                printf("  demuxer - Unable to check the growing file\n");
+                demux_vars->demuxing_error = true;
+                goto exit;
             }
-            mc_sleep(100);
-            eos_wait_count++;
-            mp2DemuxUpdateFilesize(demux_vars->demuxer, demux_vars->parser, 0);
         }
         else
         {
@@ -506,6 +535,12 @@ exit:
     printf("\n");
     printf("demuxing done\n");
 
+    if (watch)
+    {
+        growing_file_watch_report(watch);
+        growing_file_watch_close(watch);
+    }
+
     free_demuxer_data(demux_vars);
     demux_vars->demuxing_done = true;
 
@@ -674,7 +709,8 @@ int main(int argc, char *argv[])
 
 
     fclose(demux_vars.org_file);
-    fclose(demux_vars.copy_file);
+    if (demux_vars.copy_file)
+        fclose(demux_vars.copy_file);
     free(demux_vars.copy_buf);
 
     printf("\nFinished\n");
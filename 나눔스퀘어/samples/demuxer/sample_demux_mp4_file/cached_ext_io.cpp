@@ -0,0 +1,364 @@
+/* ----------------------------------------------------------------------------
+ * File: cached_ext_io.cpp
+ * Desc: external I/O for the MP4 demuxer with positional reads, a block cache and read-ahead
+ *
+ * Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "cached_ext_io.h"
+
+#define EXT_IO_LOG_BUFFER_SIZE  (1024 * 1024)
+
+CCachedExtIO::CCachedExtIO(const char* input_file_name, mp4dmux_settings& demuxer_set, const char* log_file_name, int64_t cache_size)
+    : m_clock(0)
+    , m_log_file(0)
+    , m_reads(0)
+    , m_read_bytes(0)
+    , m_cache_hits(0)
+    , m_seeks(0)
+    , m_syscalls(0)
+    , m_file_bytes(0)
+    , m_block_hits(0)
+    , m_block_misses(0)
+{
+    // the demuxer reads only the first file_size bytes, so this has to be the real size
+#if defined(_WIN32)
+    struct _stati64 stat_data = {};
+    _stati64(input_file_name, &stat_data);
+#else
+    struct stat stat_data = {};
+    stat(input_file_name, &stat_data);
+#endif
+    file_size = stat_data.st_size;
+
+    if (cache_size <= 0)
+        cache_size = EXT_IO_CACHE_SIZE;
+    m_max_blocks = (std::max)((size_t)(cache_size / EXT_IO_BLOCK_SIZE), (size_t)2);
+
+    p_app_ptr = this;
+    p_open = mp4ExternalOpenCB;
+    p_openW = 0;
+    p_seek = mp4ExternalSeekCB;
+    p_read = mp4ExternalReadCB;
+    p_close = mp4ExternalCloseCB;
+
+    demuxer_set.file_length = file_size;
+    demuxer_set.use_external_io = 1;
+    demuxer_set.p_external_io = this;
+
+    if (log_file_name) {
+        m_log_file = fopen(log_file_name, "w");
+    }
+}
+
+CCachedExtIO::~CCachedExtIO()
+{
+    // the demuxer closes its handles, these are left over from an error
+    for (size_t i = 0; i < m_files.size(); i++) {
+#if defined(_WIN32)
+        CloseHandle(m_files[i]->native);
+#else
+        close(m_files[i]->native);
+#endif
+        delete m_files[i];
+    }
+
+    if (m_log_file) {
+        setvbuf(m_log_file, NULL, _IOFBF, EXT_IO_LOG_BUFFER_SIZE);
+        for (size_t i = 0; i < m_log.size(); i++) {
+            fprintf(m_log_file, "ExtIO: pos: %lld, read: %d\n", (long long)m_log[i].position, m_log[i].size);
+        }
+        PrintStats(m_log_file);
+        fclose(m_log_file);
+    }
+}
+
+void CCachedExtIO::PrintStats(FILE* out) const
+{
+    fprintf(out, "External IO: %llu reads of %llu bytes, %llu (%.1f%%) from the cache, %llu seeks\n",
+        (unsigned long long)m_reads, (unsigned long long)m_read_bytes, (unsigned long long)m_cache_hits,
+        m_reads ? 100.0 * m_cache_hits / m_reads : 0.0, (unsigned long long)m_seeks);
+    fprintf(out, "             %llu system calls reading %llu bytes, %llu block hits, %llu block misses\n",
+        (unsigned long long)m_syscalls, (unsigned long long)m_file_bytes,
+        (unsigned long long)m_block_hits, (unsigned long long)m_block_misses);
+}
+
+int32_t CCachedExtIO::Open(char* file_name, void** pp_file_handle)
+{
+    *pp_file_handle = 0;
+
+    File* file = 0;
+    for (size_t i = 0; i < m_files.size() && !file; i++) {
+        if (m_files[i]->name == file_name)
+            file = m_files[i];
+    }
+
+    if (!file) {
+        file = new File;
+        file->name = file_name;
+        file->handles = 0;
+        memset(file->streams, 0, sizeof(file->streams));
+#if defined(_WIN32)
+        file->native = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        LARGE_INTEGER size = {};
+        if (file->native == INVALID_HANDLE_VALUE || !GetFileSizeEx(file->native, &size)) {
+            if (file->native != INVALID_HANDLE_VALUE)
+                CloseHandle(file->native);
+            delete file;
+            return 1;
+        }
+        file->size = size.QuadPart;
+#else
+        file->native = open(file_name, O_RDONLY);
+        struct stat stat_data = {};
+        if (file->native < 0 || fstat(file->native, &stat_data)) {
+            if (file->native >= 0)
+                close(file->native);
+            delete file;
+            return 1;
+        }
+        file->size = stat_data.st_size;
+#endif
+        m_files.push_back(file);
+    }
+
+    Handle* handle = new Handle;
+    handle->file = file;
+    handle->position = 0;
+    file->handles++;
+
+    *pp_file_handle = handle;
+    return 0;
+}
+
+int32_t CCachedExtIO::Seek(void* p_file_handle, int64_t position)
+{
+    Handle* handle = (Handle*)p_file_handle;
+    if (!handle || position < 0)
+        return 1;
+
+    // nothing is read here, the position is passed to the positional reads
+    handle->position = position;
+    m_seeks++;
+    return 0;
+}
+
+int32_t CCachedExtIO::Read(void* p_file_handle, uint8_t* p_buffer, int32_t buffer_size)
+{
+    Handle* handle = (Handle*)p_file_handle;
+    if (!handle)
+        return 0;
+
+    File& file = *handle->file;
+    m_reads++;
+    if (m_log_file) {
+        LogEntry entry = { handle->position, buffer_size };
+        m_log.push_back(entry);
+    }
+
+    if (buffer_size <= 0 || handle->position >= file.size)
+        return 0;
+
+    const int32_t size = (int32_t)(std::min)((int64_t)buffer_size, file.size - handle->position);
+    const Stream& stream = Track(file, handle->position, size);
+    const int64_t request_last = (handle->position + size - 1) / EXT_IO_BLOCK_SIZE;
+
+    bool hit = true;
+    int32_t done = 0;
+    while (done < size) {
+        const int64_t position = handle->position + done;
+        const int64_t index = position / EXT_IO_BLOCK_SIZE;
+
+        const Block* block = Find(file, index);
+        if (block) {
+            m_block_hits++;
+        } else {
+            hit = false;
+            m_block_misses++;
+            if (!Load(file, index, request_last, stream.read_ahead) || !(block = Find(file, index)))
+                break;
+        }
+
+        const int32_t offset = (int32_t)(position - index * EXT_IO_BLOCK_SIZE);
+        const int32_t n = (std::min)(block->size - offset, size - done);
+        if (n <= 0)
+            break;
+
+        memcpy(p_buffer + done, &block->data[offset], n);
+        done += n;
+    }
+
+    handle->position += done;
+    m_read_bytes += done;
+    if (hit && done > 0)
+        m_cache_hits++;
+    return done;
+}
+
+void CCachedExtIO::Close(void** pp_file_handle)
+{
+    Handle* handle = (Handle*)*pp_file_handle;
+    *pp_file_handle = 0;
+    if (!handle)
+        return;
+
+    File* file = handle->file;
+    delete handle;
+
+    if (--file->handles > 0)
+        return;
+
+#if defined(_WIN32)
+    CloseHandle(file->native);
+#else
+    close(file->native);
+#endif
+    m_files.erase(std::find(m_files.begin(), m_files.end(), file));
+    delete file;
+}
+
+// The stream whose last read ends close before the position, within its read-ahead, continues
+// and doubles its read-ahead. Otherwise the least recently used stream restarts at one block.
+CCachedExtIO::Stream& CCachedExtIO::Track(File& file, int64_t position, int32_t size)
+{
+    m_clock++;
+
+    Stream* stream = 0;
+    Stream* oldest = &file.streams[0];
+    for (int32_t i = 0; i < EXT_IO_STREAMS && !stream; i++) {
+        Stream& s = file.streams[i];
+        if (s.last_use && position >= s.next - EXT_IO_BLOCK_SIZE && position <= s.next + s.read_ahead)
+            stream = &s;
+        else if (s.last_use < oldest->last_use)
+            oldest = &s;
+    }
+
+    if (stream) {
+        stream->read_ahead = (std::min)(stream->read_ahead * 2, (int64_t)EXT_IO_MAX_READ_AHEAD);
+    } else {
+        stream = oldest;
+        stream->read_ahead = EXT_IO_BLOCK_SIZE;
+    }
+
+    stream->next = position + size;
+    stream->last_use = m_clock;
+    return *stream;
+}
+
+const CCachedExtIO::Block* CCachedExtIO::Find(File& file, int64_t index)
+{
+    std::unordered_map<int64_t, std::list<Block>::iterator>::iterator it = file.lookup.find(index);
+    if (it == file.lookup.end())
+        return 0;
+
+    file.blocks.splice(file.blocks.begin(), file.blocks, it->second);
+    return &*it->second;
+}
+
+// Reads the missing blocks from first up to the end of the request or the read-ahead, whatever is
+// further, with one positional read. The run stops at the first cached block.
+bool CCachedExtIO::Load(File& file, int64_t first, int64_t request_last, int64_t read_ahead)
+{
+    const int64_t max_run = (std::max)((std::min)((int64_t)m_max_blocks / 2, (int64_t)(EXT_IO_MAX_READ_AHEAD / EXT_IO_BLOCK_SIZE)), (int64_t)1);
+    const int64_t file_last = (file.size - 1) / EXT_IO_BLOCK_SIZE;
+
+    int64_t last = (std::max)(request_last, first + read_ahead / EXT_IO_BLOCK_SIZE - 1);
+    last = (std::min)((std::min)(last, file_last), first + max_run - 1);
+
+    int64_t end = first + 1;
+    while (end <= last && file.lookup.find(end) == file.lookup.end())
+        end++;
+
+    const int64_t offset = first * EXT_IO_BLOCK_SIZE;
+    const int32_t size = (int32_t)(std::min)((end - first) * EXT_IO_BLOCK_SIZE, file.size - offset);
+    if (m_staging.size() < (size_t)size)
+        m_staging.resize((size_t)(max_run * EXT_IO_BLOCK_SIZE));
+
+    const int32_t got = ReadNative(file, &m_staging[0], size, offset);
+    if (got <= 0)
+        return false;
+
+    for (int64_t index = first; (index - first) * EXT_IO_BLOCK_SIZE < got; index++) {
+        // the least recently used block is reused once the cache is full
+        if (file.lookup.size() >= m_max_blocks) {
+            file.lookup.erase(file.blocks.back().index);
+            file.blocks.splice(file.blocks.begin(), file.blocks, --file.blocks.end());
+        } else {
+            file.blocks.push_front(Block());
+            file.blocks.front().data.resize(EXT_IO_BLOCK_SIZE);
+        }
+
+        Block& block = file.blocks.front();
+        const int32_t start = (int32_t)((index - first) * EXT_IO_BLOCK_SIZE);
+        block.index = index;
+        block.size = (std::min)(got - start, (int32_t)EXT_IO_BLOCK_SIZE);
+        memcpy(&block.data[0], &m_staging[start], block.size);
+        file.lookup[index] = file.blocks.begin();
+    }
+    return true;
+}
+
+int32_t CCachedExtIO::ReadNative(File& file, uint8_t* buffer, int32_t size, int64_t position)
+{
+    int32_t done = 0;
+    while (done < size) {
+        m_syscalls++;
+#if defined(_WIN32)
+        OVERLAPPED overlapped = {};
+        const uint64_t pos = (uint64_t)position + done;
+        overlapped.Offset = (DWORD)pos;
+        overlapped.OffsetHigh = (DWORD)(pos >> 32);
+        DWORD count = 0;
+        if (!ReadFile(file.native, buffer + done, (DWORD)(size - done), &count, &overlapped) || !count)
+            break;
+#else
+        const ssize_t count = pread(file.native, buffer + done, (size_t)(size - done), (off_t)(position + done));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+#endif
+        done += (int32_t)count;
+    }
+    m_file_bytes += done;
+    return done;
+}
+
+int32_t CCachedExtIO::mp4ExternalOpenCB(void* p_app_ptr, char* p_filename, void** pp_file_handle)
+{
+    return ((CCachedExtIO*)p_app_ptr)->Open(p_filename, pp_file_handle);
+}
+
+int32_t CCachedExtIO::mp4ExternalSeekCB(void* p_app_ptr, void* p_file_handle, int64_t position)
+{
+    return ((CCachedExtIO*)p_app_ptr)->Seek(p_file_handle, position);
+}
+
+int32_t CCachedExtIO::mp4ExternalReadCB(void* p_app_ptr, void* p_file_handle, uint8_t* p_buffer, int32_t buffer_size)
+{
+    return ((CCachedExtIO*)p_app_ptr)->Read(p_file_handle, p_buffer, buffer_size);
+}
+
+void CCachedExtIO::mp4ExternalCloseCB(void* p_app_ptr, void** pp_file_handle)
+{
+    ((CCachedExtIO*)p_app_ptr)->Close(pp_file_handle);
+}
@@ -0,0 +1,121 @@
+/* ----------------------------------------------------------------------------
+ * File: cached_ext_io.h
+ * Desc: external I/O for the MP4 demuxer with positional reads, a block cache and read-ahead
+ *
+ * Copyright (c) 2019 MainConcept GmbH or its affiliates.  All rights reserved.
+ *
+ * MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+ * This software is protected by copyright law and international treaties.  Unauthorized
+ * reproduction or distribution of any portion is prohibited by law.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef CACHED_EXT_IO_H_INCLUDED
+#define CACHED_EXT_IO_H_INCLUDED
+
+#include <stdio.h>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mctypes.h"
+#include "demux_mp4.h"
+
+#define EXT_IO_BLOCK_SIZE       (64 * 1024)             // cache granularity, file reads are aligned to it
+#define EXT_IO_CACHE_SIZE       (32 * 1024 * 1024)      // default cache size of a file
+#define EXT_IO_MAX_READ_AHEAD   (4 * 1024 * 1024)       // largest read of a sequential stream
+#define EXT_IO_STREAMS          8                       // sequential streams tracked per file
+
+// Serves the demuxer reads from a cache of aligned blocks. A miss reads the run of missing blocks
+// with one positional read (pread, or ReadFile at an offset), so there is no seek state in the
+// file handle. Reads are sorted into up to EXT_IO_STREAMS sequential streams by their offset,
+// which separates the per-track cursors of an interleaved file. A stream that keeps reading
+// forward doubles its read-ahead up to EXT_IO_MAX_READ_AHEAD, so small reads of a track are
+// merged into large reads while a jump to another place starts again with a single block.
+class CCachedExtIO : public mc_external_io_t
+{
+public:
+    CCachedExtIO(const char* input_file_name, mp4dmux_settings& demuxer_set, const char* log_file_name, int64_t cache_size);
+    ~CCachedExtIO();
+
+    void PrintStats(FILE* out) const;
+
+private:
+    struct Block
+    {
+        int64_t index;
+        int32_t size;                   // less than EXT_IO_BLOCK_SIZE at the end of the file
+        std::vector<uint8_t> data;
+    };
+
+    struct Stream
+    {
+        int64_t next;                   // offset behind the last read
+        int64_t read_ahead;
+        uint64_t last_use;
+    };
+
+    // one per file name, shared by all handles of the file
+    struct File
+    {
+        std::string name;
+#if defined(_WIN32)
+        void* native;
+#else
+        int native;
+#endif
+        int64_t size;
+        int32_t handles;
+        std::list<Block> blocks;        // most recently used first
+        std::unordered_map<int64_t, std::list<Block>::iterator> lookup;
+        Stream streams[EXT_IO_STREAMS];
+    };
+
+    struct Handle
+    {
+        File* file;
+        int64_t position;
+    };
+
+    struct LogEntry
+    {
+        int64_t position;
+        int32_t size;
+    };
+
+    int32_t Open(char* file_name, void** pp_file_handle);
+    int32_t Seek(void* p_file_handle, int64_t position);
+    int32_t Read(void* p_file_handle, uint8_t* p_buffer, int32_t buffer_size);
+    void Close(void** pp_file_handle);
+
+    Stream& Track(File& file, int64_t position, int32_t size);
+    const Block* Find(File& file, int64_t index);
+    bool Load(File& file, int64_t first, int64_t request_last, int64_t read_ahead);
+    int32_t ReadNative(File& file, uint8_t* buffer, int32_t size, int64_t position);
+
+    static int32_t mp4ExternalOpenCB(void* p_app_ptr, char* p_filename, void** pp_file_handle);
+    static int32_t mp4ExternalSeekCB(void* p_app_ptr, void* p_file_handle, int64_t position);
+    static int32_t mp4ExternalReadCB(void* p_app_ptr, void* p_file_handle, uint8_t* p_buffer, int32_t buffer_size);
+    static void mp4ExternalCloseCB(void* p_app_ptr, void** pp_file_handle);
+
+    std::vector<File*> m_files;
+    size_t m_max_blocks;
+    std::vector<uint8_t> m_staging;
+    uint64_t m_clock;
+
+    FILE* m_log_file;
+    std::vector<LogEntry> m_log;        // written when the file is closed, not on every read
+
+    // counters
+    uint64_t m_reads;
+    uint64_t m_read_bytes;
+    uint64_t m_cache_hits;              // reads served without a file read
+    uint64_t m_seeks;
+    uint64_t m_syscalls;
+    uint64_t m_file_bytes;
+    uint64_t m_block_hits;
+    uint64_t m_block_misses;
+};
+
+#endif // CACHED_EXT_IO_H_INCLUDED
@@ -27,97 +27,10 @@
 #include "sample_common_args.h"
 #include "sample_common_misc.h"
 #include "demux_mp4.h"
+#include "cached_ext_io.h"
 
 #define  NMP_PLAYBACK_DMX_DETECT_CHUNK_SIZE (512 * 1024)
 
-class CExtIO : public mc_external_io_t {
-    size_t m_file_pos;
-    FILE* m_log_file;
-
-    int32_t Open(char *fileName, void **pp_file_handle) {
-        *pp_file_handle = 0;
-        FILE* fd = fopen(fileName, "rb");
-        if (fd) {
-            *pp_file_handle = fd;
-        }
-        return fd != 0 ? 0 : 1;
-    }
-    int32_t Seek(void* p_file_handle, int64_t position) {
-        FILE* fd = (FILE*)p_file_handle;
-        m_file_pos = position;
-        if (fd) {
-            return fseek(fd, (long)position, SEEK_SET) == 0 ? 0 : 1;
-        }
-        return 1;
-    }
-    int32_t Read(void *p_file_handle, uint8_t *p_buffer, int32_t buffer_size) {
-        FILE* fd = (FILE*)p_file_handle;
-        if (m_log_file) {
-            fprintf(m_log_file, "ExtIO: pos: %d, read: %d\n", (int)m_file_pos, buffer_size);
-        }
-        if (fd) {
-            int32_t bytes = (int32_t)fread(p_buffer, 1, buffer_size, fd);
-            if (bytes > 0)
-                return bytes;
-        }
-        return 0;
-    }
-    void Close(void **pp_file_handle) 
-    {
-        fclose((FILE*)*pp_file_handle);
-        *pp_file_handle = 0;
-    }
-
-
-    static int32_t mp4ExternalOpenCB(void *p_app_ptr, char *p_filename, void **pp_file_handle) {
-        return ((CExtIO*)p_app_ptr)->Open(p_filename, pp_file_handle);
-    }
-
-    static int32_t mp4ExternalSeekCB(void *p_app_ptr, void *p_file_handle, int64_t position) {
-        return ((CExtIO*)p_app_ptr)->Seek(p_file_handle, position);
-    }
-
-    static int32_t mp4ExternalReadCB(void *p_app_ptr, void *p_file_handle, uint8_t *p_buffer, int32_t buffer_size) {
-        return ((CExtIO*)p_app_ptr)->Read(p_file_handle, p_buffer, buffer_size);
-    }
-
-    static void mp4ExternalCloseCB(void *p_app_ptr, void **pp_file_handle) {
-        ((CExtIO*)p_app_ptr)->Close(pp_file_handle);
-    }
-
-public:
-    CExtIO(const char* input_file_name, mp4dmux_settings& demuxer_set, const char* log_file_name)
-        : m_log_file(0)
-        , m_file_pos(0)
-    {
-        FILE* fd = fopen(input_file_name, "rb");
-        if (fd) {
-            fseek(fd, 0, SEEK_END);
-            //WARNING: please check file_size
-            // it should be the real file size in bytes
-            // demuxer will read only first file_size bytes from the file. no more.
-            file_size = ftell(fd);
-            fclose(fd);
-        }
-
-        p_app_ptr = this;
-        p_open = mp4ExternalOpenCB;
-        p_openW = 0;
-        p_seek = mp4ExternalSeekCB;
-        p_read = mp4ExternalReadCB;
-        p_close = mp4ExternalCloseCB;
-
-
-        demuxer_set.file_length = file_size;
-        demuxer_set.use_external_io = 1;
-        demuxer_set.p_external_io = this;
-
-        if (log_file_name) {
-            m_log_file = fopen(log_file_name, "w");
-        }
-    }
-};
-
 typedef struct app_vars_s
 {
     char *in_file;
@@ -147,9 +60,10 @@ static void print_fourcc(char* str, const char* fcc)
 void print_usage()
 {
     printf("\n==== MainConcept MP4 Demuxer file sample ====\n"
-        "Usage:\nsample_demux_mp4_file.exe -i file.mp4 -sid 1 -o stream.out [-noelst] [-ext.io] [-cache.size bytes] [-ext.log file_name]\n"
+        "Usage:\nsample_demux_mp4_file.exe -i file.mp4 -sid 1 -o stream.out [-noelst] [-ext.io] [-ext.cache bytes] [-cache.size bytes] [-ext.log file_name]\n"
         "    -noelst              Specify the option to ignore edit lists from container (old MP4 demuxer behavior)\n"
-        "    -ext.io              Use external IO API\n"
+        "    -ext.io              Use external IO API, reads go through a block cache with read-ahead\n"
+        "    -ext.cache bytes     Size of the external IO block cache, 32 MB by default\n"
         "    -ext.log file_name   Log external read operation into the file_name.\n"
         "    -cache.size bytes    Specify external IO read chunk size in bytes\n"
         "    -list.meta           List all available metadata\n"
@@ -163,6 +77,7 @@ void print_usage()
 #define IDI_CACHE_SIZE        (IDC_CUSTOM_START_ID + 4)
 #define IDI_LIST_META         (IDC_CUSTOM_START_ID + 5)
 #define IDI_SAVE_META         (IDC_CUSTOM_START_ID + 6)
+#define IDI_EXTERNAL_CACHE    (IDC_CUSTOM_START_ID + 7)
 
 int main(int argc, char * argv[])
 {
@@ -176,6 +91,7 @@ int main(int argc, char * argv[])
     uint32_t uiUseExternalIO = 0;
     char* sExternalLogFile = 0;
     int32_t iCacheSize = 0;
+    int32_t iExtCacheSize = 0;
     int32_t i, ret = 1;
     int64_t byte_cnt, prg_mod, prg_next;
     int32_t iListMeta = 0;
@@ -198,6 +114,7 @@ int main(int argc, char * argv[])
         { IDI_CACHE_SIZE,          0, &iCacheSize },
         { IDI_LIST_META,           0, &iListMeta },
         { IDI_SAVE_META,           0, &iSaveMeta },
+        { IDI_EXTERNAL_CACHE,      0, &iExtCacheSize },
     };
     static const arg_item_desc_t custom_args[] =
     {
@@ -207,6 +124,7 @@ int main(int argc, char * argv[])
         { IDI_CACHE_SIZE,          { "cache.size", 0 },     ItemTypeInt,    0,  "size of demuxer read cache" },
         { IDI_LIST_META,{ "list.meta", 0 },     ItemTypeNoArg,    1,  "list all metadata" },
         { IDI_SAVE_META,{ "save.meta", 0 },     ItemTypeNoArg,    1,  "save all metadata to a xml file" },
+        { IDI_EXTERNAL_CACHE,      { "ext.cache", 0 },      ItemTypeInt,    0,  "size of the external IO block cache" },
     };
 
     uint32_t argsn = sizeof(params) / sizeof(arg_item_t);
@@ -224,9 +142,9 @@ int main(int argc, char * argv[])
 
     memset(&demuxer_set, 0, sizeof(mp4dmux_settings));
 
-    CExtIO* ext_io(0);
+    CCachedExtIO* ext_io(0);
     if (uiUseExternalIO == 1) {
-        ext_io = new CExtIO(vars.in_file, demuxer_set, sExternalLogFile);
+        ext_io = new CCachedExtIO(vars.in_file, demuxer_set, sExternalLogFile, iExtCacheSize != ITEM_NOT_INIT ? iExtCacheSize : 0);
     }
     if(iCacheSize != ITEM_NOT_INIT)
         demuxer_set.read_cache_size = iCacheSize;
@@ -592,6 +510,10 @@ int main(int argc, char * argv[])
         }
     }
     printf("\rProcessed %u%% ...", 100);
+    if (ext_io) {
+        printf("\n");
+        ext_io->PrintStats(stdout);
+    }
     ret = 0;
 
 err_exit:
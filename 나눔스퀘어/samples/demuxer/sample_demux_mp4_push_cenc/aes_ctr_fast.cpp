@@ -0,0 +1,531 @@
+/**
+@file: aes_ctr_fast.cpp
+@brief AES CTR decryptor using AES-NI / VAES
+
+@verbatim
+File: aes_ctr_fast.cpp
+Desc: AES CTR decryptor using AES-NI / VAES, same interface as decrypt_aes_ctr.h
+
+Copyright (c) 2016 MainConcept GmbH or its affiliates.  All rights reserved.
+
+MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+This software is protected by copyright law and international treaties.  Unauthorized
+reproduction or distribution of any portion is prohibited by law.
+@endverbatim
+**/
+
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include "aes_ctr_fast.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define AESCTR_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AESCTR_TARGET(x)
+#else
+#include <cpuid.h>
+#define AESCTR_TARGET(x) __attribute__((target(x)))
+#endif
+
+// _mm512_aesenc_epi128 needs GCC 8, clang 6 or Visual Studio 2019
+#if (defined(__clang__) && __clang_major__ >= 6) || (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 8) || (defined(_MSC_VER) && _MSC_VER >= 1920)
+#define AESCTR_VAES
+#endif
+#endif
+
+#define AES_BLOCK_SIZE      16
+#define AES_MAX_ROUNDS      14
+
+struct aes_ctr_fast_s;
+typedef void (*ctr_blocks_t)(aes_ctr_fast_s *ctx, uint8_t *data, size_t blocks);
+
+struct aes_ctr_fast_s
+{
+    uint8_t round_keys[AES_MAX_ROUNDS + 1][AES_BLOCK_SIZE];
+    uint32_t rounds;                        // 0 until a key is set
+
+    uint64_t counter_hi;                    // counter block as a 128 bit number
+    uint64_t counter_lo;
+
+    uint8_t key_stream[AES_BLOCK_SIZE];     // of the partially used block
+    uint32_t key_stream_pos;                // AES_BLOCK_SIZE if there is none
+
+    int32_t impl;
+    ctr_blocks_t blocks;                    // xors the key stream of whole blocks into data
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// counter
+
+static inline void next_counter(aes_ctr_fast_s *ctx, uint64_t &hi, uint64_t &lo)
+{
+    hi = ctx->counter_hi;
+    lo = ctx->counter_lo;
+    if (!++ctx->counter_lo)
+        ctx->counter_hi++;
+}
+
+static inline void store_be64(uint8_t *p, uint64_t v)
+{
+    for (int i = 7; i >= 0; i--, v >>= 8)
+        p[i] = static_cast<uint8_t>(v);
+}
+
+static inline uint64_t load_be64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// portable implementation, also used for the key expansion
+
+static const uint8_t sbox[256] =
+{
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static inline uint8_t xtime(uint8_t x)
+{
+    return static_cast<uint8_t>((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+static void expand_key(aes_ctr_fast_s *ctx, const uint8_t *key, uint32_t size)
+{
+    const uint32_t nk = size / 4;
+    const uint32_t words = 4 * (ctx->rounds + 1);
+    uint8_t *w = &ctx->round_keys[0][0];
+    uint8_t rcon = 0x01;
+
+    memcpy(w, key, size);
+
+    for (uint32_t i = nk; i < words; i++)
+    {
+        uint8_t t[4];
+        memcpy(t, w + 4 * (i - 1), 4);
+
+        if (i % nk == 0)
+        {
+            const uint8_t t0 = t[0];
+            t[0] = static_cast<uint8_t>(sbox[t[1]] ^ rcon);
+            t[1] = sbox[t[2]];
+            t[2] = sbox[t[3]];
+            t[3] = sbox[t0];
+            rcon = xtime(rcon);
+        }
+        else if (nk > 6 && i % nk == 4)
+        {
+            for (int j = 0; j < 4; j++)
+                t[j] = sbox[t[j]];
+        }
+
+        for (int j = 0; j < 4; j++)
+            w[4 * i + j] = w[4 * (i - nk) + j] ^ t[j];
+    }
+}
+
+static void encrypt_block_scalar(const aes_ctr_fast_s *ctx, uint8_t *s)
+{
+    for (int i = 0; i < AES_BLOCK_SIZE; i++)
+        s[i] ^= ctx->round_keys[0][i];
+
+    for (uint32_t round = 1; round <= ctx->rounds; round++)
+    {
+        uint8_t t[AES_BLOCK_SIZE];
+
+        // SubBytes and ShiftRows, the state is column major
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                t[4 * c + r] = sbox[s[4 * ((c + r) & 3) + r]];
+
+        if (round < ctx->rounds)
+        {
+            // MixColumns
+            for (int c = 0; c < 4; c++)
+            {
+                uint8_t *col = t + 4 * c;
+                const uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+                const uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+                col[0] = a0 ^ all ^ xtime(a0 ^ a1);
+                col[1] = a1 ^ all ^ xtime(a1 ^ a2);
+                col[2] = a2 ^ all ^ xtime(a2 ^ a3);
+                col[3] = a3 ^ all ^ xtime(a3 ^ a0);
+            }
+        }
+
+        for (int i = 0; i < AES_BLOCK_SIZE; i++)
+            s[i] = t[i] ^ ctx->round_keys[round][i];
+    }
+}
+
+static void ctr_blocks_scalar(aes_ctr_fast_s *ctx, uint8_t *data, size_t blocks)
+{
+    for (; blocks; blocks--, data += AES_BLOCK_SIZE)
+    {
+        uint8_t block[AES_BLOCK_SIZE];
+        uint64_t hi, lo;
+        next_counter(ctx, hi, lo);
+        store_be64(block, hi);
+        store_be64(block + 8, lo);
+
+        encrypt_block_scalar(ctx, block);
+
+        for (int i = 0; i < AES_BLOCK_SIZE; i++)
+            data[i] ^= block[i];
+    }
+}
+
+
+#ifdef AESCTR_X86
+//--------------------------------------------------------------------------------------------------
+// AES-NI, 8 independent blocks hide the latency of aesenc
+
+static inline uint64_t byte_swap64(uint64_t v)
+{
+#if defined(_MSC_VER)
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+AESCTR_TARGET("sse2")
+static inline __m128i counter_block(aes_ctr_fast_s *ctx)
+{
+    uint64_t hi, lo;
+    next_counter(ctx, hi, lo);
+    return _mm_set_epi64x(static_cast<int64_t>(byte_swap64(lo)), static_cast<int64_t>(byte_swap64(hi)));
+}
+
+AESCTR_TARGET("aes,ssse3")
+static void ctr_blocks_aesni(aes_ctr_fast_s *ctx, uint8_t *data, size_t blocks)
+{
+    const uint32_t rounds = ctx->rounds;
+    __m128i k[AES_MAX_ROUNDS + 1];
+    for (uint32_t i = 0; i <= rounds; i++)
+        k[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctx->round_keys[i]));
+
+    // the counter as two native 64 bit lanes (hi, lo), byte swapped into a counter block
+    const __m128i swap = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    const __m128i one = _mm_set_epi64x(1, 0);
+
+    for (; blocks >= 8; blocks -= 8, data += 8 * AES_BLOCK_SIZE)
+    {
+        __m128i b[8];
+        if (ctx->counter_lo <= UINT64_MAX - 8)
+        {
+            // no carry into the upper half within the next 8 blocks
+            __m128i c = _mm_set_epi64x(static_cast<int64_t>(ctx->counter_lo), static_cast<int64_t>(ctx->counter_hi));
+            for (int j = 0; j < 8; j++, c = _mm_add_epi64(c, one))
+                b[j] = _mm_xor_si128(_mm_shuffle_epi8(c, swap), k[0]);
+            ctx->counter_lo += 8;
+        }
+        else
+        {
+            for (int j = 0; j < 8; j++)
+                b[j] = _mm_xor_si128(counter_block(ctx), k[0]);
+        }
+
+        for (uint32_t i = 1; i < rounds; i++)
+        {
+            for (int j = 0; j < 8; j++)
+                b[j] = _mm_aesenc_si128(b[j], k[i]);
+        }
+
+        __m128i *p = reinterpret_cast<__m128i*>(data);
+        for (int j = 0; j < 8; j++)
+            _mm_storeu_si128(p + j, _mm_xor_si128(_mm_loadu_si128(p + j), _mm_aesenclast_si128(b[j], k[rounds])));
+    }
+
+    for (; blocks;blocks--, data += AES_BLOCK_SIZE)
+    {
+        __m128i b = _mm_xor_si128(counter_block(ctx), k[0]);
+        for (uint32_t i = 1; i < rounds; i++)
+            b = _mm_aesenc_si128(b, k[i]);
+
+        __m128i *p = reinterpret_cast<__m128i*>(data);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), _mm_aesenclast_si128(b, k[rounds])));
+    }
+}
+
+
+#ifdef AESCTR_VAES
+//--------------------------------------------------------------------------------------------------
+// VAES, 4 registers of 4 blocks each
+
+AESCTR_TARGET("avx512f,avx512bw,vaes,aes,ssse3")
+static void ctr_blocks_vaes(aes_ctr_fast_s *ctx, uint8_t *data, size_t blocks)
+{
+    const uint32_t rounds = ctx->rounds;
+    __m512i k[AES_MAX_ROUNDS + 1];
+    for (uint32_t i = 0; i <= rounds; i++)
+        k[i] = _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctx->round_keys[i])));
+
+    // same layout as the AES-NI path, four counters per register
+    const __m512i swap = _mm512_broadcast_i32x4(_mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7));
+    const __m512i lanes = _mm512_set_epi64(3, 0, 2, 0, 1, 0, 0, 0);
+    const __m512i four = _mm512_set_epi64(4, 0, 4, 0, 4, 0, 4, 0);
+
+    while (blocks >= 16 && ctx->counter_lo <= UINT64_MAX - 16)
+    {
+        __m512i c = _mm512_add_epi64(_mm512_broadcast_i32x4(_mm_set_epi64x(static_cast<int64_t>(ctx->counter_lo), static_cast<int64_t>(ctx->counter_hi))), lanes);
+        __m512i b0 = _mm512_xor_si512(_mm512_shuffle_epi8(c, swap), k[0]);
+        c = _mm512_add_epi64(c, four);
+        __m512i b1 = _mm512_xor_si512(_mm512_shuffle_epi8(c, swap), k[0]);
+        c = _mm512_add_epi64(c, four);
+        __m512i b2 = _mm512_xor_si512(_mm512_shuffle_epi8(c, swap), k[0]);
+        c = _mm512_add_epi64(c, four);
+        __m512i b3 = _mm512_xor_si512(_mm512_shuffle_epi8(c, swap), k[0]);
+        ctx->counter_lo += 16;
+
+        for (uint32_t i = 1; i < rounds; i++)
+        {
+            b0 = _mm512_aesenc_epi128(b0, k[i]);
+            b1 = _mm512_aesenc_epi128(b1, k[i]);
+            b2 = _mm512_aesenc_epi128(b2, k[i]);
+            b3 = _mm512_aesenc_epi128(b3, k[i]);
+        }
+
+        b0 = _mm512_aesenclast_epi128(b0, k[rounds]);
+        b1 = _mm512_aesenclast_epi128(b1, k[rounds]);
+        b2 = _mm512_aesenclast_epi128(b2, k[rounds]);
+        b3 = _mm512_aesenclast_epi128(b3, k[rounds]);
+
+        _mm512_storeu_si512(data,       _mm512_xor_si512(_mm512_loadu_si512(data), b0));
+        _mm512_storeu_si512(data + 64,  _mm512_xor_si512(_mm512_loadu_si512(data + 64), b1));
+        _mm512_storeu_si512(data + 128, _mm512_xor_si512(_mm512_loadu_si512(data + 128), b2));
+        _mm512_storeu_si512(data + 192, _mm512_xor_si512(_mm512_loadu_si512(data + 192), b3));
+
+        blocks -= 16;
+        data += 16 * AES_BLOCK_SIZE;
+    }
+
+    // the rest and a carry into the upper half of the counter go through the AES-NI path
+    if (blocks)
+        ctr_blocks_aesni(ctx, data, blocks);
+}
+#endif // AESCTR_VAES
+
+
+//--------------------------------------------------------------------------------------------------
+// CPU detection
+
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex(reinterpret_cast<int*>(regs), static_cast<int>(leaf), static_cast<int>(subleaf));
+#else
+    if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3]))
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+}
+
+static uint64_t xgetbv0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+}
+
+static bool has_aesni()
+{
+    uint32_t regs[4];
+    cpuid(1, 0, regs);
+    return (regs[2] & (1u << 25)) && (regs[2] & (1u << 9));  // AES, SSSE3
+}
+
+static bool has_vaes512()
+{
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    if (regs[0] < 7)
+        return false;
+
+    cpuid(1, 0, regs);
+    if (!(regs[2] & (1u << 25)) || !(regs[2] & (1u << 27)))  // AES, OSXSAVE
+        return false;
+
+    // the OS saves the SSE, AVX and AVX-512 (opmask, ZMM0-15 upper, ZMM16-31) state
+    if ((xgetbv0() & 0xE6) != 0xE6)
+        return false;
+
+    cpuid(7, 0, regs);
+    return (regs[1] & (1u << 16)) && (regs[1] & (1u << 30)) && (regs[2] & (1u << 9));  // AVX512F, AVX512BW, VAES
+}
+#endif // AESCTR_X86
+
+
+//--------------------------------------------------------------------------------------------------
+
+int32_t MC_EXPORT_API aesctrFastSupported(int32_t impl)
+{
+    switch (impl)
+    {
+    case AESCTR_IMPL_AUTO:
+    case AESCTR_IMPL_SCALAR:
+        return 1;
+#ifdef AESCTR_X86
+    case AESCTR_IMPL_AESNI:
+        return has_aesni() ? 1 : 0;
+#ifdef AESCTR_VAES
+    case AESCTR_IMPL_VAES:
+        return has_vaes512() ? 1 : 0;
+#endif
+#endif
+    default:
+        return 0;
+    }
+}
+
+int32_t MC_EXPORT_API aesctrFastSelect(aes_decryptor_t instance, int32_t impl)
+{
+    aes_ctr_fast_s *ctx = reinterpret_cast<aes_ctr_fast_s*>(instance);
+    if (!ctx || !aesctrFastSupported(impl))
+        return 1;
+
+    if (impl == AESCTR_IMPL_AUTO)
+    {
+        impl = AESCTR_IMPL_SCALAR;
+        if (aesctrFastSupported(AESCTR_IMPL_VAES))
+            impl = AESCTR_IMPL_VAES;
+        else if (aesctrFastSupported(AESCTR_IMPL_AESNI))
+            impl = AESCTR_IMPL_AESNI;
+    }
+
+    switch (impl)
+    {
+#ifdef AESCTR_X86
+    case AESCTR_IMPL_AESNI:
+        ctx->blocks = ctr_blocks_aesni;
+        break;
+#ifdef AESCTR_VAES
+    case AESCTR_IMPL_VAES:
+        ctx->blocks = ctr_blocks_vaes;
+        break;
+#endif
+#endif
+    default:
+        ctx->blocks = ctr_blocks_scalar;
+        break;
+    }
+    ctx->impl = impl;
+    return 0;
+}
+
+const char * MC_EXPORT_API aesctrFastImplName(aes_decryptor_t instance)
+{
+    const aes_ctr_fast_s *ctx = reinterpret_cast<const aes_ctr_fast_s*>(instance);
+    switch (ctx->impl)
+    {
+    case AESCTR_IMPL_AESNI: return "aes-ni";
+    case AESCTR_IMPL_VAES:  return "vaes";
+    default:                return "scalar";
+    }
+}
+
+aes_decryptor_t MC_EXPORT_API aesctrFastNew(get_rc_t get_rc)
+{
+    if (get_rc){}; // remove compile warning
+
+    aes_ctr_fast_s *ctx = reinterpret_cast<aes_ctr_fast_s*>(malloc(sizeof(aes_ctr_fast_s)));
+    if (!ctx)
+        return NULL;
+
+    memset(ctx, 0, sizeof(aes_ctr_fast_s));
+    ctx->key_stream_pos = AES_BLOCK_SIZE;
+    aesctrFastSelect(ctx, AESCTR_IMPL_AUTO);
+    return ctx;
+}
+
+void MC_EXPORT_API aesctrFastFree(aes_decryptor_t instance)
+{
+    if (instance)
+    {
+        // do not leave the key behind
+        memset(instance, 0, sizeof(aes_ctr_fast_s));
+        free(instance);
+    }
+}
+
+int32_t MC_EXPORT_API aesctrFastSetIV(aes_decryptor_t instance, uint8_t * data, uint32_t size)
+{
+    aes_ctr_fast_s *ctx = reinterpret_cast<aes_ctr_fast_s*>(instance);
+    if (!ctx || !data || (size != 8 && size != 16))
+        return 1;
+
+    ctx->counter_hi = load_be64(data);
+    ctx->counter_lo = size == 16 ? load_be64(data + 8) : 0;
+    ctx->key_stream_pos = AES_BLOCK_SIZE;
+    return 0;
+}
+
+int32_t MC_EXPORT_API aesctrFastSetKey(aes_decryptor_t instance, uint8_t * data, uint32_t size)
+{
+    aes_ctr_fast_s *ctx = reinterpret_cast<aes_ctr_fast_s*>(instance);
+    if (!ctx || !data || (size != 16 && size != 24 && size != 32))
+        return 1;
+
+    ctx->rounds = size / 4 + 6;
+    expand_key(ctx, data, size);
+    ctx->key_stream_pos = AES_BLOCK_SIZE;
+    return 0;
+}
+
+int32_t MC_EXPORT_API aesctrFastDecrypt(aes_decryptor_t instance, uint8_t * data, uint32_t size)
+{
+    aes_ctr_fast_s *ctx = reinterpret_cast<aes_ctr_fast_s*>(instance);
+    if (!ctx || !ctx->rounds || (!data && size))
+        return 1;
+
+    // rest of the block the previous call ended in
+    while (size && ctx->key_stream_pos < AES_BLOCK_SIZE)
+    {
+        *data++ ^= ctx->key_stream[ctx->key_stream_pos++];
+        size--;
+    }
+
+    const size_t blocks = size / AES_BLOCK_SIZE;
+    if (blocks)
+    {
+        ctx->blocks(ctx, data, blocks);
+        data += blocks * AES_BLOCK_SIZE;
+        size -= static_cast<uint32_t>(blocks * AES_BLOCK_SIZE);
+    }
+
+    if (size)
+    {
+        memset(ctx->key_stream, 0, AES_BLOCK_SIZE);
+        ctx->blocks(ctx, ctx->key_stream, 1);
+
+        for (ctx->key_stream_pos = 0; ctx->key_stream_pos < size; ctx->key_stream_pos++)
+            data[ctx->key_stream_pos] ^= ctx->key_stream[ctx->key_stream_pos];
+    }
+    return 0;
+}
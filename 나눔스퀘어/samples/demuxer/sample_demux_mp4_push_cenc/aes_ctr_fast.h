@@ -0,0 +1,124 @@
+/**
+@file: aes_ctr_fast.h
+@brief AES CTR decryptor using AES-NI / VAES
+
+@verbatim
+File: aes_ctr_fast.h
+Desc: AES CTR decryptor using AES-NI / VAES, same interface as decrypt_aes_ctr.h
+
+Copyright (c) 2016 MainConcept GmbH or its affiliates.  All rights reserved.
+
+MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+This software is protected by copyright law and international treaties.  Unauthorized
+reproduction or distribution of any portion is prohibited by law.
+@endverbatim
+**/
+
+#pragma once
+#ifndef __AES_CTR_FAST_H__
+#define __AES_CTR_FAST_H__
+
+#include "mctypes.h"
+#include "decrypt_aes_ctr.h"
+
+/**
+* @name AES CTR implementations
+* @{
+**/
+#define AESCTR_IMPL_AUTO    -1  /**< @brief the fastest one supported by the CPU */
+#define AESCTR_IMPL_SCALAR   0  /**< @brief portable implementation */
+#define AESCTR_IMPL_AESNI    1  /**< @brief AES-NI, 8 blocks interleaved */
+#define AESCTR_IMPL_VAES     2  /**< @brief VAES with AVX-512 (F, BW), 16 blocks interleaved */
+/**@}*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /**
+    * @brief allocates AES CTR decryptor instance using the fastest implementation available
+
+    * @param get_rc pointer to the resource function, not used
+
+    * @return non-NULL pointer to AES CTR decryptor instance on success, or NULL pointer on failure
+    */
+    aes_decryptor_t MC_EXPORT_API aesctrFastNew(get_rc_t get_rc);
+
+    /**
+    * @brief cleanup AES CTR decryptor instance allocated via aesctrFastNew API
+
+    * @param instance pointer to AES CTR decryptor instance allocated via aesctrFastNew API
+
+    * @return none
+    */
+    void MC_EXPORT_API aesctrFastFree(aes_decryptor_t instance);
+
+    /**
+    * @brief checks if an implementation can be used on this CPU
+
+    * @param impl one of the AESCTR_IMPL_xxx defines
+
+    * @return 1 if supported, 0 otherwise
+    */
+    int32_t MC_EXPORT_API aesctrFastSupported(int32_t impl);
+
+    /**
+    * @brief selects the implementation, may be called at any time, key and counter are kept
+
+    * @param instance pointer to AES CTR decryptor instance allocated via aesctrFastNew API
+    * @param impl one of the AESCTR_IMPL_xxx defines
+
+    * @return 0 if successful, non-zero if the implementation is not supported
+    */
+    int32_t MC_EXPORT_API aesctrFastSelect(aes_decryptor_t instance, int32_t impl);
+
+    /**
+    * @brief name of the implementation used by the instance
+
+    * @param instance pointer to AES CTR decryptor instance allocated via aesctrFastNew API
+
+    * @return "scalar", "aes-ni" or "vaes"
+    */
+    const char * MC_EXPORT_API aesctrFastImplName(aes_decryptor_t instance);
+
+    /**
+    * @brief sets initialization vector, an 8 byte IV is the upper half of the counter block and
+    * the lower half starts at zero (CENC), a 16 byte IV is the whole counter block. The counter
+    * block is incremented as a 128 bit big endian number.
+
+    * @param instance pointer to AES CTR decryptor instance allocated via aesctrFastNew API
+    * @param data pointer to the initialization vector
+    * @param size length of initialization vector, shall be either 8 or 16 bytes
+
+    * @return 0 if successful, non-zero otherwise
+    */
+    int32_t MC_EXPORT_API aesctrFastSetIV(aes_decryptor_t instance, uint8_t * data, uint32_t size);
+
+    /**
+    * @brief sets encryption key
+
+    * @param instance pointer to AES CTR decryptor instance allocated via aesctrFastNew API
+    * @param data pointer to the key
+    * @param size length of key in bytes, 16, 24 or 32
+
+    * @return 0 if successful, non-zero otherwise
+    */
+    int32_t MC_EXPORT_API aesctrFastSetKey(aes_decryptor_t instance, uint8_t * data, uint32_t size);
+
+    /**
+    * @brief performs in-place decryption of data, the key stream continues across calls,
+    * also inside of a block
+
+    * @param instance pointer to AES CTR decryptor instance allocated via aesctrFastNew API
+    * @param data pointer to the actual data to be decrypted, same memory is used as output
+    * @param size length of data to be decrypted
+
+    * @return 0 if successful, non-zero otherwise
+    */
+    int32_t MC_EXPORT_API aesctrFastDecrypt(aes_decryptor_t instance, uint8_t * data, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __AES_CTR_FAST_H__ */
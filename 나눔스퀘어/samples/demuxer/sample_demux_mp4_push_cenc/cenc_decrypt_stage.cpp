@@ -0,0 +1,307 @@
+/*!
+*
+* Copyright (c) 2016 MainConcept GmbH or its affiliates.  All rights reserved.
+*
+* MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+* This software is protected by copyright law and international treaties.  Unauthorized
+* reproduction or distribution of any portion is prohibited by law.
+**/
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+
+#include "cenc_decrypt_stage.h"
+
+static double seconds_since(const std::chrono::steady_clock::time_point & start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+DecryptStage::DecryptStage(const key_map_t & keys, bufstream_tt * output_bs, copybytes_t output_copybytes, int32_t engine, uint32_t depth)
+    : _keys(keys)
+    , _output_bs(output_bs)
+    , _output_copybytes(output_copybytes)
+    , _depth((std::max)(depth, 2u))
+    , _busy(0)
+    , _stop(false)
+    , _current(NULL)
+    , _crypto(engine)
+    , _samples(0)
+    , _ranges(0)
+    , _bytes(0)
+    , _encrypted_bytes(0)
+    , _decrypt_seconds(0)
+    , _wait_seconds(0)
+{
+    _worker = std::thread(&DecryptStage::Worker, this);
+}
+
+DecryptStage::~DecryptStage()
+{
+    Finish();
+
+    for (size_t i(0); i < _all.size(); ++i)
+        delete _all[i];
+}
+
+DecryptStage::Sample * DecryptStage::GetSample()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_pool.empty() && _all.size() >= _depth)
+    {
+        // every sample is queued or being decrypted, let the worker catch up
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        _released.wait(lock, [this] { return !_pool.empty(); });
+        _wait_seconds += seconds_since(start);
+    }
+
+    Sample * sample;
+    if (_pool.empty())
+    {
+        sample = new Sample;
+        _all.push_back(sample);
+    }
+    else
+    {
+        sample = _pool.back();
+        _pool.pop_back();
+    }
+
+    // the buffers keep their capacity, after a few samples no allocations are needed
+    sample->data.clear();
+    sample->ranges.clear();
+    sample->expected_size = 0;
+    sample->encrypted = false;
+    return sample;
+}
+
+void DecryptStage::Submit(Sample * sample)
+{
+    if (sample->encrypted)
+    {
+        const uint32_t size = static_cast<uint32_t>(sample->data.size());
+
+        if (sample->ranges.empty())
+        {
+            // no sub-sampling, entire sample is encrypted
+            sample->ranges.push_back(std::make_pair(0u, size));
+        }
+        else
+        {
+            // an incomplete sample only has the ranges it got data for
+            for (size_t i(0); i < sample->ranges.size(); ++i)
+            {
+                std::pair<uint32_t, uint32_t> & range = sample->ranges[i];
+                if (range.first >= size)
+                {
+                    sample->ranges.resize(i);
+                    break;
+                }
+                range.second = (std::min)(range.second, size - range.first);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queue.push_back(sample);
+    _busy++;
+    _queued.notify_one();
+}
+
+void DecryptStage::BeginSample(const sample_encryption_info_tt * info)
+{
+    Flush();
+
+    if (!info->is_encrypted)
+        return;
+
+    kid_t kid(info->KID, info->KID + 16);
+    if (_keys.find(kid) == _keys.end())
+    {
+        if (kid != _missing_kid)
+        {
+            std::cerr << "key for KID wasn't specified, decryption is impossible if key wasn't set!" << std::endl;
+            _missing_kid = kid;
+        }
+        return;
+    }
+
+    _current = GetSample();
+    _current->encrypted = true;
+    _current->kid.swap(kid);
+    _current->iv.assign(info->IV, info->IV + info->IV_size);
+
+    uint32_t offset(0);
+    for (uint32_t i(0); i < info->sub_sample_count; ++i)
+    {
+        offset += info->sub_samples[i].bytes_of_clear_data;
+        if (info->sub_samples[i].bytes_of_encrypted_data)
+            _current->ranges.push_back(std::make_pair(offset, info->sub_samples[i].bytes_of_encrypted_data));
+        offset += info->sub_samples[i].bytes_of_encrypted_data;
+    }
+    _current->expected_size = offset;
+}
+
+void DecryptStage::Append(const uint8_t * ptr, uint32_t size)
+{
+    while (size)
+    {
+        if (!_current)
+        {
+            // clear data outside of an encrypted sample is passed on chunk by chunk
+            Sample * sample = GetSample();
+            sample->data.assign(ptr, ptr + size);
+            Submit(sample);
+            return;
+        }
+
+        uint32_t count = size;
+        if (_current->expected_size)
+            count = (std::min)(count, _current->expected_size - static_cast<uint32_t>(_current->data.size()));
+
+        _current->data.insert(_current->data.end(), ptr, ptr + count);
+        ptr += count;
+        size -= count;
+
+        if (_current->expected_size && _current->data.size() == _current->expected_size)
+            Flush();
+    }
+}
+
+void DecryptStage::Flush()
+{
+    if (_current)
+    {
+        Submit(_current);
+        _current = NULL;
+    }
+}
+
+void DecryptStage::Drain()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _released.wait(lock, [this] { return _busy == 0; });
+}
+
+void DecryptStage::Finish()
+{
+    Flush();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        _queued.notify_one();
+    }
+
+    if (_worker.joinable())
+        _worker.join();
+}
+
+void DecryptStage::Decrypt(Sample * sample)
+{
+    if (sample->kid != _last_kid)
+    {
+        cenc_key_t key = _keys.find(sample->kid)->second;
+        _crypto.SetKey(&key[0], static_cast<uint32_t>(key.size()));
+        _last_kid = sample->kid;
+        _last_iv.clear();
+    }
+    if (sample->iv != _last_iv)
+    {
+        _crypto.SetIV(&sample->iv[0], static_cast<uint32_t>(sample->iv.size()));
+        _last_iv = sample->iv;
+    }
+
+    const std::vector<std::pair<uint32_t, uint32_t> > & ranges = sample->ranges;
+    uint8_t * data = &sample->data[0];
+
+    if (ranges.size() == 1)
+    {
+        _crypto.Decrypt(data + ranges[0].first, ranges[0].second);
+        _encrypted_bytes += ranges[0].second;
+    }
+    else
+    {
+        // the key stream runs across the subsamples, one call for all of them
+        size_t total(0);
+        for (size_t i(0); i < ranges.size(); ++i)
+            total += ranges[i].second;
+
+        _gather.resize(total);
+
+        uint8_t * p = &_gather[0];
+        for (size_t i(0); i < ranges.size(); ++i)
+        {
+            memcpy(p, data + ranges[i].first, ranges[i].second);
+            p += ranges[i].second;
+        }
+
+        _crypto.Decrypt(&_gather[0], static_cast<uint32_t>(total));
+
+        p = &_gather[0];
+        for (size_t i(0); i < ranges.size(); ++i)
+        {
+            memcpy(data + ranges[i].first, p, ranges[i].second);
+            p += ranges[i].second;
+        }
+        _encrypted_bytes += total;
+    }
+    _ranges += ranges.size();
+}
+
+void DecryptStage::Worker()
+{
+    while (true)
+    {
+        Sample * sample;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queued.wait(lock, [this] { return _stop || !_queue.empty(); });
+            if (_queue.empty())
+                break;
+
+            sample = _queue.front();
+            _queue.pop_front();
+        }
+
+        if (sample->encrypted && !sample->ranges.empty())
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            Decrypt(sample);
+            _decrypt_seconds += seconds_since(start);
+            _samples++;
+        }
+
+        const uint32_t size = static_cast<uint32_t>(sample->data.size());
+        uint32_t written(0);
+        while (written < size)
+        {
+            const uint32_t count = _output_copybytes(_output_bs, &sample->data[0] + written, size - written);
+            if (!count)
+                break;
+            written += count;
+        }
+        _bytes += size;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pool.push_back(sample);
+        _busy--;
+        _released.notify_all();
+    }
+}
+
+void DecryptStage::PrintStatistics() const
+{
+    const double mb = 1024.0 * 1024.0;
+
+    printf("Decrypted %llu samples, %.2f MB of %.2f MB output in %llu subsample ranges (%.1f per sample)\n",
+        static_cast<unsigned long long>(_samples), _encrypted_bytes / mb, _bytes / mb,
+        static_cast<unsigned long long>(_ranges), _samples ? static_cast<double>(_ranges) / _samples : 0.0);
+    printf("Decryption (%s) %.3f s (%.1f MB/s), demuxer waited %.3f s for the decryption thread, %u sample buffers\n",
+        _crypto.Name(), _decrypt_seconds, _decrypt_seconds > 0 ? _encrypted_bytes / mb / _decrypt_seconds : 0.0,
+        _wait_seconds, static_cast<uint32_t>(_all.size()));
+}
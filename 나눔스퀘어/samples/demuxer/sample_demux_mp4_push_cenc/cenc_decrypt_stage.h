@@ -0,0 +1,167 @@
+/*!
+*
+* Copyright (c) 2016 MainConcept GmbH or its affiliates.  All rights reserved.
+*
+* MainConcept and its logos are registered trademarks of MainConcept GmbH or its affiliates.
+* This software is protected by copyright law and international treaties.  Unauthorized
+* reproduction or distribution of any portion is prohibited by law.
+**/
+
+#ifndef CENC_DECRYPT_STAGE_H_INCLUDED
+#define CENC_DECRYPT_STAGE_H_INCLUDED
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "mctypes.h"
+#include "bufstrm.h"
+#include "demux_mp4.h"
+#include "decrypt_aes_ctr.h"
+#include "aes_ctr_fast.h"
+
+// the decrypt_aes_ctr module is a very simple decryption module - only for demonstration purposes (very insecure, naive, slow and simple implementation)
+// aes_ctr_fast has the same interface and uses AES-NI or VAES if the CPU supports them
+
+#define CRYPTO_ENGINE_MODULE    -2      // the decrypt_aes_ctr module, otherwise one of the AESCTR_IMPL_xxx defines
+
+class Crypto
+{
+public:
+    Crypto(int32_t engine = AESCTR_IMPL_AUTO)
+        : _module(engine == CRYPTO_ENGINE_MODULE)
+    {
+        if (_module)
+        {
+            _ctx = aesctrNew(NULL);
+        }
+        else
+        {
+            _ctx = aesctrFastNew(NULL);
+            aesctrFastSelect(_ctx, engine);
+        }
+    }
+    virtual ~Crypto()
+    {
+        if (_module)
+            aesctrFree(_ctx);
+        else
+            aesctrFastFree(_ctx);
+    }
+
+    void SetKey(uint8_t * data, uint32_t size)
+    {
+        if (_module)
+            aesctrSetKey(_ctx, data, size);
+        else
+            aesctrFastSetKey(_ctx, data, size);
+    }
+    void SetIV(uint8_t * data, uint32_t size)
+    {
+        if (_module)
+            aesctrSetIV(_ctx, data, size);
+        else
+            aesctrFastSetIV(_ctx, data, size);
+    }
+    void Decrypt(uint8_t * data, uint32_t size)
+    {
+        if (_module)
+            aesctrDecrypt(_ctx, data, size);
+        else
+            aesctrFastDecrypt(_ctx, data, size);
+    }
+    const char * Name() const
+    {
+        return _module ? "module" : aesctrFastImplName(_ctx);
+    }
+private:
+    bool _module;
+    aes_decryptor_t _ctx;
+};
+
+typedef uint32_t(MC_EXPORT_API * copybytes_t)(bufstream_tt *bs, uint8_t *ptr, uint32_t numSamples);
+
+typedef std::vector<uint8_t> iv_t, kid_t, cenc_key_t;
+typedef std::map<kid_t, cenc_key_t> key_map_t;
+
+// Decrypts the output of the demuxer on a worker thread, so demuxing and decryption overlap.
+//
+// The demuxer delivers a sample in several copybytes calls, they are collected into a pooled
+// buffer until the sample is complete. The encrypted ranges of all subsamples form one CTR key
+// stream, they are gathered into one contiguous buffer, decrypted with a single call and
+// scattered back before the sample is written with the original copybytes of the output.
+// Clear data is passed through the same queue to keep the output in order.
+
+class DecryptStage
+{
+public:
+    // keys must stay unchanged while the stage exists, engine is passed to Crypto, depth is the number of pooled samples
+    DecryptStage(const key_map_t & keys, bufstream_tt * output_bs, copybytes_t output_copybytes, int32_t engine = AESCTR_IMPL_AUTO, uint32_t depth = 8);
+    virtual ~DecryptStage();
+
+    // starts a new sample, a pending incomplete one is submitted first
+    void BeginSample(const sample_encryption_info_tt * info);
+    // adds demuxer output to the current sample
+    void Append(const uint8_t * ptr, uint32_t size);
+    // submits the current sample even if the subsamples do not add up yet
+    void Flush();
+    // blocks until every submitted sample is written
+    void Drain();
+    // drains and stops the worker, called by the destructor as well
+    void Finish();
+
+    void PrintStatistics() const;
+
+private:
+    struct Sample
+    {
+        std::vector<uint8_t> data;
+        std::vector<std::pair<uint32_t, uint32_t> > ranges;     // encrypted (offset, length)
+        uint32_t expected_size;                                 // 0 if not known from the subsamples
+        bool encrypted;
+        kid_t kid;
+        iv_t iv;
+    };
+
+    Sample * GetSample();
+    void Submit(Sample * sample);
+    void Worker();
+    void Decrypt(Sample * sample);
+
+    const key_map_t & _keys;
+    bufstream_tt * _output_bs;
+    copybytes_t _output_copybytes;
+
+    std::mutex _mutex;
+    std::condition_variable _queued;        // signals the worker
+    std::condition_variable _released;      // signals the demuxer thread
+    std::deque<Sample*> _queue;
+    std::vector<Sample*> _pool;
+    std::vector<Sample*> _all;
+    uint32_t _depth;
+    uint32_t _busy;
+    bool _stop;
+    std::thread _worker;
+
+    Sample * _current;                      // collected by the demuxer thread
+    kid_t _missing_kid;
+
+    // worker only
+    Crypto _crypto;
+    kid_t _last_kid;
+    iv_t _last_iv;
+    std::vector<uint8_t> _gather;
+
+    // statistics, read after Finish
+    uint64_t _samples;
+    uint64_t _ranges;
+    uint64_t _bytes;
+    uint64_t _encrypted_bytes;
+    double _decrypt_seconds;
+    double _wait_seconds;                   // time the demuxer thread waited for a free sample
+};
+
+#endif // CENC_DECRYPT_STAGE_H_INCLUDED
@@ -20,6 +20,7 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <chrono>
 
 #include "mctypes.h"
 #include "mcmediatypes.h"
@@ -30,37 +31,7 @@
 #include "sample_common_args.h"
 #include "sample_common_misc.h"
 
-#include "decrypt_aes_ctr.h"
-
-// very simple decryption module - only for demonstration purposes (very insecure, naive, slow and simple implementation)
-
-class Crypto
-{
-public:
-    Crypto()
-    {
-        _ctx = aesctrNew(NULL);
-    }
-    virtual ~Crypto()
-    {
-        aesctrFree(_ctx);
-    }
-
-    void SetKey(uint8_t * data, uint32_t size)
-    {
-        aesctrSetKey(_ctx, data, size);
-    }
-    void SetIV(uint8_t * data, uint32_t size)
-    {
-        aesctrSetIV(_ctx, data, size);
-    }
-    void Decrypt(uint8_t * data, uint32_t size)
-    {
-        aesctrDecrypt(_ctx, data, size);
-    }
-private:
-    aes_decryptor_t _ctx;
-};
+#include "cenc_decrypt_stage.h"
 
 #ifdef __APPLE__
 #include "TargetConditionals.h"
@@ -225,13 +196,9 @@ void print_segment_info(mp4dmx_push_tt* demuxer)
 }
 
 typedef uint32_t(MC_EXPORT_API * auxinfo_t)(bufstream_tt *bs, uint32_t offs, uint32_t info_ID, void *info_ptr, uint32_t info_size);
-typedef uint32_t(MC_EXPORT_API * copybytes_t)(bufstream_tt *bs, uint8_t *ptr, uint32_t numSamples);
 
 //--------------------------------------------------------------------------------------------------
 
-typedef std::vector<uint8_t> iv_t, kid_t, cenc_key_t;
-typedef std::map<kid_t, cenc_key_t> key_map_t;
-
 static uint8_t char2hex(char c)
 {
     if ('0' <= c && c <= '9') return static_cast<uint8_t>(c - '0');
@@ -280,13 +247,9 @@ typedef struct thread_user_data_s {
     bufstream_tt* output_bs;
     auxinfo_t original_auxinfo;
     copybytes_t original_copybytes;
-    sample_encryption_info_tt * sample_encryption_info;
-    uint32_t offset;
-    Crypto crypto;
+    DecryptStage * decrypt_stage;
+    int32_t crypto_engine;
     key_map_t keys;
-    kid_t last_kid;
-    iv_t last_iv;
-    uint8_t annexb_output;
 } thread_user_data_t;
 
 //--------------------------------------------------------------------------------------------------
@@ -299,146 +262,28 @@ static uint32_t MC_EXPORT_API local_auxinfo(bufstream_tt *bs, uint32_t offs, uin
     case DMXU_SAMPLE_ENCRYPTION_INFO:
     if (info_ptr && info_size == sizeof(sample_encryption_info_tt))
     {
-        data->sample_encryption_info = reinterpret_cast<sample_encryption_info_tt*>(info_ptr);
-        data->offset = 0;
-
-        kid_t kid;
-        kid.assign(data->sample_encryption_info->KID, data->sample_encryption_info->KID + 16);
-
-        iv_t iv;
-        iv.assign(data->sample_encryption_info->IV, data->sample_encryption_info->IV + data->sample_encryption_info->IV_size);
-
-        if (kid != data->last_kid)
-        {
-            key_map_t::iterator i = data->keys.find(kid);
-            if (i != data->keys.end())
-            {
-                cenc_key_t & key = i->second;
-                data->crypto.SetKey(&key[0], static_cast<uint32_t>(key.size()));
-
-                data->last_kid = kid;
-            }
-            else
-            {
-                std::cerr << "key for KID wasn't specified" << std::endl;
-            }
-        }
-        if (iv != data->last_iv && data->last_kid != kid_t())
-        {
-            data->crypto.SetIV(&data->sample_encryption_info->IV[0], data->sample_encryption_info->IV_size);
-
-            data->last_iv = iv;
-        }
+        data->decrypt_stage->BeginSample(reinterpret_cast<sample_encryption_info_tt*>(info_ptr));
     }
         break;
+    case BYTECOUNT_INFO:
+    case FLUSH_BUFFER:
+    case SPLIT_OUTPUT:
+        // these depend on the data written so far, wait for the decryption thread
+        data->decrypt_stage->Flush();
+        data->decrypt_stage->Drain();
+        break;
     default:
         break;
     }
     return data->original_auxinfo(bs, offs, info_ID, info_ptr, info_size);
 }
 
-template<typename T>
-static bool check_intersection(T x1, T x2, T y1, T y2, T & z1, T & z2)
-{
-    z1 = (std::max<T>)(x1, y1);
-    z2 = (std::min<T>)(x2, y2);
-    return (x1 <= y2 && y1 <= x2);
-}
-
 static uint32_t MC_EXPORT_API local_copybytes(bufstream_tt *bs, uint8_t *ptr, uint32_t numSamples)
 {
     thread_user_data_t * data = reinterpret_cast<thread_user_data_t*>(bs->drive_ptr);
-    if (data->sample_encryption_info && data->sample_encryption_info->is_encrypted)
-    {
-        if (data->last_kid == kid_t())
-        {
-            std::cerr << "decryption is impossible if key wasn't set!" << std::endl;
-        }
-        else
-        {
-            if (data->sample_encryption_info->sub_sample_count > 0)
-            {
-                uint32_t sub_sample_offset(0);
-                for (uint32_t i(0); i < data->sample_encryption_info->sub_sample_count; ++i)
-                {
-                    sub_sample_offset += data->sample_encryption_info->sub_samples[i].bytes_of_clear_data;
-                    const uint32_t sub_sample_length = data->sample_encryption_info->sub_samples[i].bytes_of_encrypted_data;
-
-                    uint32_t decryption_start(0), decryption_end(0);
-                    // check for intersection of sub-sample and currently supplied data
-                    if (check_intersection<uint32_t>(data->offset, data->offset + numSamples, sub_sample_offset, sub_sample_offset + sub_sample_length, decryption_start, decryption_end))
-                    {
-                        decryption_start -= data->offset;
-                        decryption_end -= data->offset;
-
-                        data->crypto.Decrypt(ptr + decryption_start, decryption_end - decryption_start);
-                    }
-                    sub_sample_offset += sub_sample_length;
-                }
-            }
-            else
-            {
-                // no sub-sampling, entire sample is encrypted
-                data->crypto.Decrypt(ptr, numSamples);
-            }
-        }
-    }
-    data->offset += numSamples;
 
-    return data->original_copybytes(bs, ptr, numSamples);
-}
-
-static uint32_t MC_EXPORT_API local_copybytes_with_accumulate(bufstream_tt *bs, uint8_t *ptr, uint32_t numSamples)
-{
-    static std::vector<uint8_t> cache;
-    static uint32_t g_size = 0;
-
-    thread_user_data_t * data = reinterpret_cast<thread_user_data_t*>(bs->drive_ptr);
-
-    std::copy(ptr, ptr + numSamples, std::back_inserter(cache));
-
-    if (data->sample_encryption_info && data->sample_encryption_info->is_encrypted)
-    {
-        if (data->last_kid == kid_t())
-        {
-            std::cerr << "decryption is impossible if key wasn't set!" << std::endl;
-        }
-        else
-        {
-            if (!g_size) {
-                for (uint32_t i(0); i < data->sample_encryption_info->sub_sample_count; ++i) {
-                    g_size += data->sample_encryption_info->sub_samples[i].bytes_of_clear_data;
-                    g_size += data->sample_encryption_info->sub_samples[i].bytes_of_encrypted_data;
-                }
-            }
-            if (cache.size() == g_size) {
-                uint32_t sub_sample_offset(0);
-
-                for (uint32_t i(0); i < data->sample_encryption_info->sub_sample_count; ++i)
-                {
-                    sub_sample_offset += data->sample_encryption_info->sub_samples[i].bytes_of_clear_data;
-                    const uint32_t sub_sample_length = data->sample_encryption_info->sub_samples[i].bytes_of_encrypted_data;
-
-                    if (sub_sample_length)
-                    {
-                        data->crypto.Decrypt(&cache[0] + sub_sample_offset, sub_sample_length);
-                    }
-                    sub_sample_offset += sub_sample_length;
-                }
-                data->original_copybytes(bs, &cache[0], static_cast<uint32_t>(cache.size()));
-                cache.clear();
-                g_size = 0;
-            }
-        }
-    }
-    else if (!g_size){
-        cache.clear();
-        return local_copybytes(bs,ptr,numSamples);
-    }
-    data->offset += numSamples;
-    if (!cache.empty() && cache.size() == g_size) {
-        data->original_copybytes(bs, &cache[0], static_cast<uint32_t>(cache.size()));
-    }
+    // decrypted and written on the decryption thread
+    data->decrypt_stage->Append(ptr, numSamples);
     return numSamples;
 }
 
@@ -451,12 +296,9 @@ void configure_output(mp4dmx_push_tt* demuxer, thread_user_data_t* data)
         data->original_auxinfo = data->output_bs->auxinfo;
         data->original_copybytes = data->output_bs->copybytes;
 
-        if (data->annexb_output) {
-            data->output_bs->copybytes = local_copybytes_with_accumulate;
-        } else {
-            data->output_bs->copybytes = local_copybytes;
-        }
+        data->decrypt_stage = new DecryptStage(data->keys, data->output_bs, data->original_copybytes, data->crypto_engine);
 
+        data->output_bs->copybytes = local_copybytes;
         data->output_bs->auxinfo = local_auxinfo;
         data->output_bs->drive_ptr = reinterpret_cast<struct drive_struct*>(data);
     }
@@ -470,6 +312,21 @@ void configure_output(mp4dmx_push_tt* demuxer, thread_user_data_t* data)
     mp4DemuxPushSegmentAddStream(demuxer, &stream_settings);
 }
 
+void close_output(thread_user_data_t* data)
+{
+    if (data->decrypt_stage) {
+        data->decrypt_stage->Finish();
+        data->decrypt_stage->PrintStatistics();
+        delete data->decrypt_stage;
+        data->decrypt_stage = NULL;
+    }
+    if (data->output_bs) {
+        data->output_bs->done(data->output_bs, 0);
+        data->output_bs->free(data->output_bs);
+        data->output_bs = NULL;
+    }
+}
+
 //--------------------------------------------------------------------------------------------------
 void callback_func(mp4dmx_push_tt* demuxer, uint32_t event_type, void* user_data)
 {
@@ -490,11 +347,7 @@ void callback_func(mp4dmx_push_tt* demuxer, uint32_t event_type, void* user_data
         
     case MP4PDMUX_EVENT_EOS:
         printf("End of input stream encountered, closing things down\n");
-        if (data->output_bs) {
-            data->output_bs->done(data->output_bs, 0);
-            data->output_bs->free(data->output_bs);
-            data->output_bs = NULL;
-        }
+        close_output(data);
         break;
         
     default:
@@ -503,17 +356,282 @@ void callback_func(mp4dmx_push_tt* demuxer, uint32_t event_type, void* user_data
     }
 }
 
+//--------------------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------------------
+// decryption benchmark on synthetic subsample-heavy content, laid out like cenc protected HEVC with
+// many slices per picture: a short clear NAL unit and slice header followed by encrypted slice data
+
+#define BENCH_SAMPLES       512
+#define BENCH_SUBSAMPLES    64
+#define BENCH_CHUNK_SIZE    2*1024      // size of the copybytes calls of the demuxer
+
+typedef struct bench_output_s {
+    const uint8_t* expected;
+    uint64_t pos;
+    bool match;
+} bench_output_t;
+
+static uint32_t MC_EXPORT_API bench_copybytes(bufstream_tt *bs, uint8_t *ptr, uint32_t numSamples)
+{
+    bench_output_t * output = reinterpret_cast<bench_output_t*>(bs->drive_ptr);
+    if (memcmp(output->expected + output->pos, ptr, numSamples))
+        output->match = false;
+    output->pos += numSamples;
+    return numSamples;
+}
+
+static int run_benchmark(int32_t engine)
+{
+    const double mb = 1024.0 * 1024.0;
+
+    srand(1);
+
+    kid_t kid(16, 0x01);
+    cenc_key_t key(16);
+    for (size_t i(0); i < key.size(); ++i) key[i] = static_cast<uint8_t>(rand());
+    key_map_t keys;
+    keys[kid] = key;
+
+    std::vector<std::vector<sub_sample_encryption_info_tt> > sub_samples(BENCH_SAMPLES);
+    std::vector<uint32_t> sample_sizes(BENCH_SAMPLES);
+    std::vector<uint8_t> clear;
+    for (size_t i(0); i < BENCH_SAMPLES; ++i) {
+        sub_samples[i].resize(BENCH_SUBSAMPLES);
+        sample_sizes[i] = 0;
+        for (size_t j(0); j < BENCH_SUBSAMPLES; ++j) {
+            memset(&sub_samples[i][j], 0, sizeof(sub_sample_encryption_info_tt));
+            sub_samples[i][j].bytes_of_clear_data = 2 + rand() % 40;
+            sub_samples[i][j].bytes_of_encrypted_data = 16 * (16 + rand() % 256);
+            sample_sizes[i] += sub_samples[i][j].bytes_of_clear_data + sub_samples[i][j].bytes_of_encrypted_data;
+        }
+    }
+    for (size_t i(0); i < BENCH_SAMPLES; ++i)
+        for (uint32_t j(0); j < sample_sizes[i]; ++j)
+            clear.push_back(static_cast<uint8_t>(rand()));
+
+    std::vector<sample_encryption_info_tt> infos(BENCH_SAMPLES);
+    for (size_t i(0); i < BENCH_SAMPLES; ++i) {
+        memset(&infos[i], 0, sizeof(sample_encryption_info_tt));
+        infos[i].is_encrypted = 1;
+        infos[i].IV_size = 8;
+        for (uint32_t j(0); j < 8; ++j) infos[i].IV[j] = static_cast<uint8_t>(static_cast<uint64_t>(i + 1) >> (8 * (7 - j)));
+        memcpy(infos[i].KID, &kid[0], 16);
+        infos[i].sub_sample_count = BENCH_SUBSAMPLES;
+        infos[i].sub_samples = &sub_samples[i][0];
+    }
+
+    // encrypt subsample by subsample, CTR mode is symmetric
+    Crypto crypto(engine);
+    crypto.SetKey(&key[0], static_cast<uint32_t>(key.size()));
+    std::vector<uint8_t> encrypted(clear);
+    uint64_t offset(0), encrypted_bytes(0);
+    for (size_t i(0); i < BENCH_SAMPLES; ++i) {
+        crypto.SetIV(infos[i].IV, infos[i].IV_size);
+        uint64_t pos(offset);
+        for (size_t j(0); j < BENCH_SUBSAMPLES; ++j) {
+            pos += sub_samples[i][j].bytes_of_clear_data;
+            crypto.Decrypt(&encrypted[pos], sub_samples[i][j].bytes_of_encrypted_data);
+            pos += sub_samples[i][j].bytes_of_encrypted_data;
+            encrypted_bytes += sub_samples[i][j].bytes_of_encrypted_data;
+        }
+        offset += sample_sizes[i];
+    }
+
+    printf("Benchmark (%s): %d samples, %d subsamples per sample, %.2f MB of which %.2f MB encrypted\n",
+        crypto.Name(), BENCH_SAMPLES, BENCH_SUBSAMPLES, clear.size() / mb, encrypted_bytes / mb);
+
+    bench_output_t output;
+    bufstream_tt output_bs;
+    memset(&output_bs, 0, sizeof(bufstream_tt));
+    output_bs.drive_ptr = reinterpret_cast<struct drive_struct*>(&output);
+
+    // inline, one decryption call per subsample on the demuxer thread
+    output.expected = &clear[0];
+    output.pos = 0;
+    output.match = true;
+
+    std::vector<uint8_t> work;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    offset = 0;
+    for (size_t i(0); i < BENCH_SAMPLES; ++i) {
+        work.assign(encrypted.begin() + offset, encrypted.begin() + offset + sample_sizes[i]);
+        crypto.SetIV(infos[i].IV, infos[i].IV_size);
+        uint32_t pos(0);
+        for (size_t j(0); j < BENCH_SUBSAMPLES; ++j) {
+            pos += sub_samples[i][j].bytes_of_clear_data;
+            crypto.Decrypt(&work[pos], sub_samples[i][j].bytes_of_encrypted_data);
+            pos += sub_samples[i][j].bytes_of_encrypted_data;
+        }
+        bench_copybytes(&output_bs, &work[0], sample_sizes[i]);
+        offset += sample_sizes[i];
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const bool inline_match = output.match && output.pos == clear.size();
+    printf("  per subsample, inline:  %.3f s, %.1f MB/s%s\n", seconds, seconds > 0 ? clear.size() / mb / seconds : 0.0, inline_match ? "" : " (output mismatch)");
+
+    // pipelined, the stage collects the chunks and decrypts a sample with one call
+    output.pos = 0;
+    output.match = true;
+
+    start = std::chrono::steady_clock::now();
+    {
+        DecryptStage stage(keys, &output_bs, bench_copybytes, engine);
+        offset = 0;
+        for (size_t i(0); i < BENCH_SAMPLES; ++i) {
+            stage.BeginSample(&infos[i]);
+            for (uint32_t pos(0); pos < sample_sizes[i]; pos += BENCH_CHUNK_SIZE)
+                stage.Append(&encrypted[offset + pos], (std::min<uint32_t>)(BENCH_CHUNK_SIZE, sample_sizes[i] - pos));
+            offset += sample_sizes[i];
+        }
+        stage.Finish();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stage.PrintStatistics();
+    }
+    const bool stage_match = output.match && output.pos == clear.size();
+    printf("  batched, pipelined:     %.3f s, %.1f MB/s%s\n", seconds, seconds > 0 ? clear.size() / mb / seconds : 0.0, stage_match ? "" : " (output mismatch)");
+
+    return inline_match && stage_match ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//--------------------------------------------------------------------------------------------------
+// checks the AES CTR engines against the NIST SP 800-38A CTR vectors and against the decrypt_aes_ctr
+// module on CENC style input: 8 and 16 byte IVs, counters about to carry and calls ending inside of a block
+
+typedef struct ctr_vector_s {
+    const char* name;
+    const char* key;
+    const char* iv;
+    const char* plain;
+    const char* cipher;
+} ctr_vector_t;
+
+static const ctr_vector_t ctr_vectors[] =
+{
+    { "F.5.1 CTR-AES128", "0x2b7e151628aed2a6abf7158809cf4f3c", "0xf0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+      "0x6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710",
+      "0x874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee" },
+    { "F.5.5 CTR-AES256", "0x603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4", "0xf0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+      "0x6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710",
+      "0x601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c52b0930daa23de94ce87017ba2d84988ddfc9c58db67aada613c2dd08457941a6" },
+};
+
+// decrypts in pieces of 1 to max_piece bytes
+static void decrypt_pieces(Crypto & crypto, uint8_t * data, uint32_t size, uint32_t max_piece)
+{
+    for (uint32_t pos(0); pos < size; ) {
+        const uint32_t piece = (std::min<uint32_t>)(size - pos, 1 + rand() % max_piece);
+        crypto.Decrypt(data + pos, piece);
+        pos += piece;
+    }
+}
+
+static int run_verify()
+{
+    static const int32_t engines[] = { CRYPTO_ENGINE_MODULE, AESCTR_IMPL_SCALAR, AESCTR_IMPL_AESNI, AESCTR_IMPL_VAES };
+    int failures(0);
+
+    srand(1);
+
+    for (size_t e(0); e < sizeof(engines) / sizeof(engines[0]); ++e) {
+        if (engines[e] != CRYPTO_ENGINE_MODULE && !aesctrFastSupported(engines[e]))
+            continue;
+
+        Crypto crypto(engines[e]);
+
+        for (size_t v(0); v < sizeof(ctr_vectors) / sizeof(ctr_vectors[0]); ++v) {
+            cenc_key_t key = key2bin(ctr_vectors[v].key);
+            iv_t iv = key2bin(ctr_vectors[v].iv);
+            std::vector<uint8_t> plain = key2bin(ctr_vectors[v].plain);
+            std::vector<uint8_t> data = key2bin(ctr_vectors[v].cipher);
+
+            crypto.SetKey(&key[0], static_cast<uint32_t>(key.size()));
+            crypto.SetIV(&iv[0], static_cast<uint32_t>(iv.size()));
+            decrypt_pieces(crypto, &data[0], static_cast<uint32_t>(data.size()), 23);
+
+            const bool ok = data == plain;
+            printf("%-8s %-32s %s\n", crypto.Name(), ctr_vectors[v].name, ok ? "ok" : "FAILED");
+            failures += ok ? 0 : 1;
+        }
+    }
+
+    // CENC: 8 byte IVs start the block counter at zero, 16 byte IVs are the whole counter block
+    static const char* cenc_ivs[] = {
+        "0x0123456789abcdef",
+        "0xfedcba9876543210ffffffffffffffd0",
+        "0x0123456789abcdefffffffffffffffff",
+    };
+
+    Crypto module(CRYPTO_ENGINE_MODULE);
+    cenc_key_t key(16);
+    for (size_t i(0); i < key.size(); ++i) key[i] = static_cast<uint8_t>(rand());
+
+    for (size_t e(1); e < sizeof(engines) / sizeof(engines[0]); ++e) {
+        if (!aesctrFastSupported(engines[e]))
+            continue;
+
+        Crypto crypto(engines[e]);
+
+        for (size_t v(0); v < sizeof(cenc_ivs) / sizeof(cenc_ivs[0]); ++v) {
+            iv_t iv = key2bin(cenc_ivs[v]);
+            std::vector<uint8_t> expected(64 * 1024 + 1 + rand() % 1000);
+            for (size_t i(0); i < expected.size(); ++i) expected[i] = static_cast<uint8_t>(rand());
+            std::vector<uint8_t> data(expected);
+
+            module.SetKey(&key[0], static_cast<uint32_t>(key.size()));
+            module.SetIV(&iv[0], static_cast<uint32_t>(iv.size()));
+            module.Decrypt(&expected[0], static_cast<uint32_t>(expected.size()));
+
+            crypto.SetKey(&key[0], static_cast<uint32_t>(key.size()));
+            crypto.SetIV(&iv[0], static_cast<uint32_t>(iv.size()));
+            decrypt_pieces(crypto, &data[0], static_cast<uint32_t>(data.size()), v ? 4096 : 100);
+
+            const bool ok = data == expected;
+            printf("%-8s CENC, %2u byte IV %-34s %s\n", crypto.Name(), static_cast<uint32_t>(iv.size()), cenc_ivs[v], ok ? "ok" : "differs from module");
+            failures += ok ? 0 : 1;
+        }
+    }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 //--------------------------------------------------------------------------------------------------
 typedef struct app_args_s {
     char* in_file;
     char* out_file;
     char* config_file;
     int32_t sid;
+    int32_t benchmark;
+    int32_t verify;
+    char* engine;
 } app_args_t;
 
 #define INPUT_BUFFER_SIZE 64*1024
 #define READ_CHUNK_SIZE 2*1024
 
+#define IDN_BENCHMARK       (IDC_CUSTOM_START_ID + 1)
+#define IDN_AES_VERIFY      (IDC_CUSTOM_START_ID + 2)
+#define IDS_AES_ENGINE      (IDC_CUSTOM_START_ID + 3)
+
+static void print_usage()
+{
+    printf("\n==== MainConcept MP4 Push Mode Demuxer file sample ====\n"
+        "Usage:\nsample_demux_mp4_push -i file.mp4 -sid 1 -o stream.out -c keys.conf\n"
+        "keys.conf file contains hexadecimal <key-id> - <key pairs> separated by new lines, for instance\n"
+        "\t0x279926496a7f5d25da69f2b3b2799a7f\n"
+        "\t0xccc0f2b3b279926496a7f5d25da692f6\n"
+        "\t0x676cb88f302d10227992649885984045\n"
+        "\t0xccc0f2b3b279926496a7f5d25da692d6\n"
+        "\n"
+        "sample_demux_mp4_push -bench\n"
+        "measures the decryption throughput on synthetic subsample encrypted content\n"
+        "sample_demux_mp4_push -aes_verify\n"
+        "checks the AES CTR implementations with test vectors and against the decrypt_aes_ctr module\n"
+        "\n"
+        "-aes <auto|scalar|aesni|vaes|module> selects the AES CTR implementation, default is auto\n"
+        "\n"
+    );
+}
+
 //--------------------------------------------------------------------------------------------------
 int main(int argc, char* argv[])
 {
@@ -524,24 +642,57 @@ int main(int argc, char* argv[])
 
     arg_item_t params[] =
     {
-        { IDS_INPUT_FILE, 1, &args.in_file },
+        { IDS_INPUT_FILE, 0, &args.in_file },
         { IDI_C_STREAM_ID, 0, &args.sid },
-        { IDS_OUTPUT_FILE, 1, &args.out_file },
-        { IDS_CONFIG_FILE, 0, &args.config_file }
+        { IDS_OUTPUT_FILE, 0, &args.out_file },
+        { IDS_CONFIG_FILE, 0, &args.config_file },
+        { IDN_BENCHMARK, 0, &args.benchmark },
+        { IDN_AES_VERIFY, 0, &args.verify },
+        { IDS_AES_ENGINE, 0, &args.engine }
+    };
+
+    static const arg_item_desc_t custom_args[] =
+    {
+        { IDN_BENCHMARK, { "bench", 0 }, ItemTypeNoArg, 1, "decryption benchmark" },
+        { IDN_AES_VERIFY, { "aes_verify", 0 }, ItemTypeNoArg, 1, "check the AES CTR implementations" },
+        { IDS_AES_ENGINE, { "aes", 0 }, ItemTypeString, 0, "AES CTR implementation" },
     };
 
     memset(&args, 0, sizeof(app_args_t));
 
-    if (parse_args(argc - 1, argv + 1, sizeof(params) / sizeof(params[0]), params) < 0) {
-        printf("\n==== MainConcept MP4 Push Mode Demuxer file sample ====\n"
-            "Usage:\nsample_demux_mp4_push -i file.mp4 -sid 1 -o stream.out -c keys.conf\n"
-            "keys.conf file contains hexadecimal <key-id> - <key pairs> separated by new lines, for instance\n"
-            "\t0x279926496a7f5d25da69f2b3b2799a7f\n"
-            "\t0xccc0f2b3b279926496a7f5d25da692f6\n"
-            "\t0x676cb88f302d10227992649885984045\n"
-            "\t0xccc0f2b3b279926496a7f5d25da692d6\n"
-            "\n"
-        );
+    if (parse_args(argc - 1, argv + 1, sizeof(params) / sizeof(params[0]), params, custom_args, sizeof(custom_args) / sizeof(custom_args[0])) < 0) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    int32_t engine = AESCTR_IMPL_AUTO;
+    if (args.engine) {
+        static const struct { const char* name; int32_t engine; } engine_names[] = {
+            { "auto", AESCTR_IMPL_AUTO }, { "scalar", AESCTR_IMPL_SCALAR }, { "aesni", AESCTR_IMPL_AESNI },
+            { "vaes", AESCTR_IMPL_VAES }, { "module", CRYPTO_ENGINE_MODULE } };
+
+        size_t i(0);
+        while (i < sizeof(engine_names) / sizeof(engine_names[0]) && strcmp(args.engine, engine_names[i].name))
+            ++i;
+        if (i == sizeof(engine_names) / sizeof(engine_names[0])) {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+        engine = engine_names[i].engine;
+        if (engine != CRYPTO_ENGINE_MODULE && !aesctrFastSupported(engine)) {
+            printf("%s is not supported by this CPU\n", args.engine);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (args.verify == 1)
+        return run_verify();
+
+    if (args.benchmark == 1)
+        return run_benchmark(engine);
+
+    if (!args.in_file || !args.out_file) {
+        print_usage();
         return EXIT_FAILURE;
     }
 
@@ -556,6 +707,7 @@ int main(int argc, char* argv[])
     thread_user_data_t user_data = { };
     user_data.track_id = args.sid;
     user_data.output = args.out_file;
+    user_data.crypto_engine = engine;
 
     if (args.config_file)
     {
@@ -587,7 +739,6 @@ int main(int argc, char* argv[])
     memset(demuxer_settings, 0, sizeof(mp4dmux_push_settings));
     demuxer_settings->add_adts_headers = 1;
     demuxer_settings->annexb_output = 1;
-    user_data.annexb_output = demuxer_settings->annexb_output;
     demuxer_settings->add_amr_header = 1;
     demuxer_settings->segment_callback = &callback_func;
     demuxer_settings->segment_callback_user_data = &user_data;
@@ -627,7 +778,10 @@ int main(int argc, char* argv[])
     mp4DemuxPushWaitDone(demuxer);
     mp4DemuxPushCloseStream(demuxer);
     mp4DemuxPushFree(demuxer);
-    
+
+    // no end of stream event after a failure
+    close_output(&user_data);
+
     printf("Done!\n");
     return EXIT_SUCCESS;
 }
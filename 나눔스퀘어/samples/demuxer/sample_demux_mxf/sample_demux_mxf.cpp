@@ -20,11 +20,6 @@
 #else
 #include <unistd.h>
 #endif
-#if defined(__APPLE__)
-#include <mach/mach_time.h>
-#else
-#include <ctime>
-#endif
 
 #include "demux_mxf.h"
 #include "auxinfo.h"
@@ -32,10 +27,12 @@
 
 #include "dm_reader.h"
 #include "sample_common_misc.h"
+#include "growing_file_watch.h"
 
  //#define SHOW_AUX_INFO // catch demuxer auxinfo and print timecode and chunk info
 
 #define MAX_STREAMS		64	// the max streams we will handle
+#define GROWING_FILE_STALL_MS	10000	// a growing file is complete if it does not grow for this long
 
 struct global_vars_struct;
 
@@ -430,21 +427,6 @@ void cleanup(global_vars_struct& global_vars){
     printf("\n");
 }
 
-static long long int monotonic_time()
-{
-#if defined(_WIN32) || defined(_WIN64)
-    return static_cast<long long int>(clock() / CLOCKS_PER_SEC);
-#elif defined(__APPLE__)
-    mach_timebase_info_data_t info;
-    mach_timebase_info(&info);
-    return static_cast<long long int>(mach_absolute_time() * info.numer / info.denom / 1000000000);
-#else
-    timespec time;
-    clock_gettime(CLOCK_MONOTONIC, &time);
-    return static_cast<long long int>(time.tv_sec);
-#endif
-}
-
 int main(int argc, char *argv[])
 {
     global_vars_struct global_vars = { 0 };
@@ -657,47 +639,67 @@ int main(int argc, char *argv[])
     else if (seek_set.seek_flags & (SEEKING_FLAG_BY_FRAME | SEEKING_FLAG_RETURN_REF_FRAME))
         printf("\nPositioned to ref frame #%ld, start sending data...\n\n", seek_set.ref_frame);
 
-    // now do the demuxing
-    int64_t previous_file_size = global_vars.file_info.file_size;
-    long long int file_size_update_time = monotonic_time();
+    // now do the demuxing, a growing file is watched so that the demuxer
+    // continues as soon as data is appended
+    growing_file_watch_t *watch = NULL;
+    bool writer_closed = false;
+    if (global_vars.is_growing_file) {
+        watch = growing_file_watch_open(global_vars.input_file);
+        if (!watch) {
+            printf("Unable to watch the growing file\n");
+            cleanup(global_vars);
+            return -1;
+        }
+    }
+
+    int32_t ret = 0;
     while (true) {
         const int32_t i = mxfDemuxPush(global_vars.demuxer, global_vars.parser);
-        if (global_vars.is_growing_file) {
-            mxfDemuxUpdateFilesize(global_vars.demuxer, global_vars.parser, 0);
-            mxfDemuxGetFileInfo(global_vars.demuxer, &global_vars.file_info);
+        if (i < 0) {
+            // an error of the demuxer, a growing file is not waited for
+            printf("mxfDemuxPush returned negative value\n");
+            ret = -1;
+            break;
         }
-        if (i > 0) {
+        else if (i > 0) {
+            if (watch)
+                growing_file_consumed(watch);
             if (global_vars.curr_processed > global_vars.prev_processed) {
                 printf("Processed %lld bytes of %lld ...\n", global_vars.curr_processed, global_vars.file_info.file_size);
                 global_vars.prev_processed = global_vars.curr_processed;
             }
         }
-        else if (global_vars.is_growing_file) {
-            if (previous_file_size < global_vars.file_info.file_size) {
-                // File is still growing ...
-                previous_file_size = global_vars.file_info.file_size;
-                file_size_update_time = monotonic_time();
+        else if (watch && !writer_closed) {
+            const int32_t result = growing_file_wait(watch, GROWING_FILE_STALL_MS, NULL);
+            if (result == GROWING_FILE_CLOSED) {
+                // Demux what is left up to the end of the file
+                printf("File was closed by the writer, finishing ...\n");
+                writer_closed = true;
+            }
+            else if (result == GROWING_FILE_ERROR) {
+                printf("Error: unable to check the growing file, exiting ...\n");
+                ret = -1;
+                break;
             }
-            else if (monotonic_time() - file_size_update_time > 10) {
+            else if (result == GROWING_FILE_TIMEOUT) {
                 // File is not growing for last 10 seconds
                 printf("File is not growing anymore, exiting ...\n");
                 break;
             }
-            // File is still growing, sleep and continue ...
-#if defined(_WIN32) || defined(_WIN64)
-            Sleep(100);
-#else
-            usleep(100 * 1000);
-#endif
+            mxfDemuxUpdateFilesize(global_vars.demuxer, global_vars.parser, 0);
+            mxfDemuxGetFileInfo(global_vars.demuxer, &global_vars.file_info);
         }
         else {
-            if (i < 0)
-                printf("mxfDemuxPush returned negative value\n");
             break;
         }
     }
 
+    if (watch) {
+        growing_file_watch_report(watch);
+        growing_file_watch_close(watch);
+    }
+
     cleanup(global_vars);
-    return 0;
+    return ret;
 }
 
@@ -0,0 +1,313 @@
+/********************************************************************
+ File name: decoded_frame_cache.cpp
+ Purpose: decoded frame cache over a mfimport video stream
+
+ Copyright (c) 2007-2009 MainConcept GmbH. All rights reserved.
+
+ This software is the confidential and proprietary information of
+ MainConcept GmbH and may be used only in accordance with the terms of
+ your license from MainConcept GmbH.
+
+*********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "mccolorspace.h"
+#include "decoded_frame_cache.h"
+
+#define SAMPLE_FREE     -1
+#define SAMPLE_BUSY     -2
+
+#define MAX_FRAMES      1024
+
+DecodedFrameCache::DecodedFrameCache(mfimport_stream_tt * stream, const frame_colorspace_info_tt & cs_info, int64_t total_samples, int64_t budget, int32_t look_ahead)
+    : _stream(stream)
+    , _total_samples(total_samples)
+    , _look_ahead(look_ahead)
+    , _stream_next(-1)
+    , _position(0)
+    , _pinned(-1)
+    , _requests(0)
+    , _waiting(0)
+    , _stop(false)
+    , _hits(0)
+    , _speculative_hits(0)
+    , _misses(0)
+    , _speculative_frames(0)
+    , _seeks(0)
+{
+    // one slot is pinned by the caller, one is decoded into, the rest is the cache. The slots are
+    // searched linearly, small frames do not get more than MAX_FRAMES.
+    const int64_t count = (std::min)(budget / (std::max)(cs_info.frame_size, 1u), static_cast<int64_t>(MAX_FRAMES));
+    _slots.resize(static_cast<size_t>((std::max)(count, static_cast<int64_t>(3))));
+
+    // the look-ahead has to fit next to the pinned and the decoded slot, the budget is not exceeded for it
+    const int32_t max_look_ahead = static_cast<int32_t>(_slots.size()) - 2;
+    if (_look_ahead > max_look_ahead)
+    {
+        printf("Warning: the frame cache holds %u frames, the look-ahead is reduced from %d to %d frames\n",
+            static_cast<uint32_t>(_slots.size()), _look_ahead, max_look_ahead);
+        _look_ahead = max_look_ahead;
+    }
+    for (size_t i(0); i < _slots.size(); ++i)
+    {
+        Slot & slot = _slots[i];
+        slot.buffer.resize(cs_info.frame_size);
+        memset(&slot.frame, 0, sizeof(slot.frame));
+        fill_frame_from_colorspace_info(&cs_info, &slot.buffer[0], &slot.frame);
+        memset(&slot.info, 0, sizeof(slot.info));
+        slot.sample = SAMPLE_FREE;
+        slot.speculative = false;
+    }
+
+    // the decoder has to be stepped through cached frames to continue, one more buffer for those
+    _scratch.buffer.resize(cs_info.frame_size);
+    memset(&_scratch.frame, 0, sizeof(_scratch.frame));
+    fill_frame_from_colorspace_info(&cs_info, &_scratch.buffer[0], &_scratch.frame);
+
+    if (_look_ahead > 0)
+        _worker = std::thread(&DecodedFrameCache::Worker, this);
+}
+
+DecodedFrameCache::~DecodedFrameCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        _changed.notify_all();
+    }
+
+    if (_worker.joinable())
+        _worker.join();
+}
+
+int32_t DecodedFrameCache::FindSlot(int64_t sample) const
+{
+    for (size_t i(0); i < _slots.size(); ++i)
+    {
+        if (_slots[i].sample == sample)
+            return static_cast<int32_t>(i);
+    }
+    return -1;
+}
+
+// a free slot or the one farthest from the current position, with keep_nearer only if that
+// frame is farther away than the new one, returns -1 if there is none
+int32_t DecodedFrameCache::ReplaceSlot(int64_t sample, bool keep_nearer)
+{
+    int32_t found = -1;
+    int64_t found_distance = keep_nearer ? std::abs(sample - _position) : -1;
+
+    for (size_t i(0); i < _slots.size(); ++i)
+    {
+        const Slot & slot = _slots[i];
+        if (slot.sample == SAMPLE_FREE)
+        {
+            found = static_cast<int32_t>(i);
+            break;
+        }
+        if (slot.sample == SAMPLE_BUSY || static_cast<int32_t>(i) == _pinned)
+            continue;
+
+        const int64_t distance = std::abs(slot.sample - _position);
+        if (distance > found_distance)
+        {
+            found = static_cast<int32_t>(i);
+            found_distance = distance;
+        }
+    }
+
+    if (found >= 0)
+    {
+        _slots[found].sample = SAMPLE_BUSY;
+        _slots[found].speculative = false;
+    }
+    return found;
+}
+
+// the first frame of the look-ahead that is not cached, -1 if there is none
+int64_t DecodedFrameCache::NextSpeculative() const
+{
+    const int64_t end = (std::min)(_position + _look_ahead, _total_samples - 1);
+    for (int64_t sample = _position + 1; sample <= end; sample++)
+    {
+        if (FindSlot(sample) < 0)
+            return sample;
+    }
+    return -1;
+}
+
+// called with _decoder_mutex held
+int32_t DecodedFrameCache::Decode(Slot & slot, int64_t sample, bool & seeked)
+{
+    mfi_sample_settings_t sample_set;
+    memset(&sample_set, 0, sizeof(sample_set));
+    sample_set.num_samples = 1;
+    sample_set.p_frame = &slot.frame;
+
+    int32_t ret;
+    seeked = sample != _stream_next;
+    if (seeked)
+    {
+        mfi_seek_settings_t seek_info;
+        memset(&seek_info, 0, sizeof(seek_info));
+        seek_info.flags = MFI_SEEK_BY_SAMPLE_NUMBER;
+        seek_info.sample_start = sample;
+        ret = mfimportStreamSeek(_stream, &seek_info, &sample_set, &slot.info);
+    }
+    else
+    {
+        ret = mfimportStreamGetNext(_stream, &sample_set, &slot.info);
+    }
+
+    _stream_next = ret ? -1 : sample + 1;
+    return ret;
+}
+
+// called with _mutex held
+const uint8_t * DecodedFrameCache::Deliver(int32_t index, mfi_sample_info_t * info)
+{
+    Slot & slot = _slots[index];
+    if (slot.speculative)
+    {
+        _speculative_hits++;
+        slot.speculative = false;
+    }
+    _pinned = index;
+
+    if (info)
+        *info = slot.info;
+    return &slot.buffer[0];
+}
+
+const uint8_t * DecodedFrameCache::GetFrame(int64_t sample, mfi_sample_info_t * info)
+{
+    if (sample < 0 || sample >= _total_samples)
+        return NULL;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _position = sample;
+        _pinned = -1;
+        _requests++;
+        _changed.notify_all();
+
+        const int32_t index = FindSlot(sample);
+        if (index >= 0)
+        {
+            _hits++;
+            return Deliver(index, info);
+        }
+        _waiting++;
+    }
+
+    std::lock_guard<std::mutex> decoder(_decoder_mutex);
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waiting--;
+    _changed.notify_all();
+
+    // the worker may have decoded it in the meantime
+    int32_t index = FindSlot(sample);
+    if (index >= 0)
+    {
+        _hits++;
+        return Deliver(index, info);
+    }
+
+    _misses++;
+    index = ReplaceSlot(sample, false);
+    lock.unlock();
+
+    bool seeked;
+    const int32_t ret = Decode(_slots[index], sample, seeked);
+
+    lock.lock();
+    _seeks += seeked;
+    if (ret)
+    {
+        _slots[index].sample = SAMPLE_FREE;
+        return NULL;
+    }
+    _slots[index].sample = sample;
+    return Deliver(index, info);
+}
+
+void DecodedFrameCache::Worker()
+{
+    bool full = false;
+    uint32_t full_at = 0;
+
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [&] { return _stop || (!_waiting && !(full && full_at == _requests) && NextSpeculative() >= 0); });
+        if (_stop)
+            break;
+        lock.unlock();
+
+        std::lock_guard<std::mutex> decoder(_decoder_mutex);
+        lock.lock();
+
+        // requests go first
+        if (_waiting)
+            continue;
+
+        int64_t sample = NextSpeculative();
+        if (sample < 0)
+            continue;
+
+        // the decoder is continued if it is inside of the look-ahead, a seek decodes from the key frame again
+        Slot * slot = &_scratch;
+        int32_t index = -1;
+        if (_stream_next > _position && _stream_next < sample)
+        {
+            sample = _stream_next;
+        }
+        else
+        {
+            index = ReplaceSlot(sample, true);
+            if (index < 0)
+            {
+                // everything cached is nearer, wait for the next request
+                full = true;
+                full_at = _requests;
+                continue;
+            }
+            slot = &_slots[index];
+        }
+        full = false;
+        lock.unlock();
+
+        bool seeked;
+        const int32_t ret = Decode(*slot, sample, seeked);
+
+        lock.lock();
+        _seeks += seeked;
+        _speculative_frames++;
+        if (index >= 0)
+        {
+            slot->sample = ret ? SAMPLE_FREE : sample;
+            slot->speculative = !ret;
+        }
+        if (ret)
+        {
+            full = true;
+            full_at = _requests;
+        }
+    }
+}
+
+void DecodedFrameCache::PrintStatistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const uint64_t requests = _hits + _misses;
+    printf("Frame cache: %u frames, %llu requests, %llu hits (%.1f%%, %llu decoded ahead), %llu decoded on request\n",
+        static_cast<uint32_t>(_slots.size()), static_cast<unsigned long long>(requests), static_cast<unsigned long long>(_hits),
+        requests ? 100.0 * _hits / requests : 0.0, static_cast<unsigned long long>(_speculative_hits), static_cast<unsigned long long>(_misses));
+    printf("             %llu frames decoded ahead, %llu seeks\n",
+        static_cast<unsigned long long>(_speculative_frames), static_cast<unsigned long long>(_seeks));
+}
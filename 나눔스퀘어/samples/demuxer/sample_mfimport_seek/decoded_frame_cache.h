@@ -0,0 +1,91 @@
+/********************************************************************
+ File name: decoded_frame_cache.h
+ Purpose: decoded frame cache over a mfimport video stream
+
+ Copyright (c) 2007-2009 MainConcept GmbH. All rights reserved.
+
+ This software is the confidential and proprietary information of
+ MainConcept GmbH and may be used only in accordance with the terms of
+ your license from MainConcept GmbH.
+
+*********************************************************************/
+
+#ifndef DECODED_FRAME_CACHE_H_INCLUDED
+#define DECODED_FRAME_CACHE_H_INCLUDED
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "mctypes.h"
+#include "mfimport.h"
+
+// Keeps decoded frames of a video stream, keyed by sample number, for scrubbing: many short seeks
+// around nearby positions. A seek to a cached frame does not touch the decoder. When the cache is
+// full the frames farthest from the current position are dropped, so the current and neighbouring
+// GOPs stay cached. A worker thread decodes forward from the current position speculatively, it
+// continues the decoder where it is and only seeks if that is outside of the look-ahead.
+//
+// Every frame is decoded straight into a cache buffer, the stream must not be used by anyone else
+// while the cache exists.
+
+class DecodedFrameCache
+{
+public:
+    // cs_info describes the output frames, budget is the memory for decoded frames in bytes,
+    // look_ahead the number of frames decoded ahead, at most the frames of the budget less two,
+    // 0 disables the worker
+    DecodedFrameCache(mfimport_stream_tt * stream, const frame_colorspace_info_tt & cs_info, int64_t total_samples, int64_t budget, int32_t look_ahead);
+    virtual ~DecodedFrameCache();
+
+    // returns the decoded frame, valid until the next call, or NULL if it cannot be decoded
+    const uint8_t * GetFrame(int64_t sample, mfi_sample_info_t * info);
+
+    uint32_t Frames() const { return static_cast<uint32_t>(_slots.size()); }
+    void PrintStatistics() const;
+
+private:
+    struct Slot
+    {
+        std::vector<uint8_t> buffer;
+        frame_tt frame;
+        mfi_sample_info_t info;
+        int64_t sample;                     // -1 if free or being decoded
+        bool speculative;                   // decoded by the worker and not requested yet
+    };
+
+    int32_t FindSlot(int64_t sample) const;
+    int32_t ReplaceSlot(int64_t sample, bool keep_nearer);
+    int64_t NextSpeculative() const;
+    int32_t Decode(Slot & slot, int64_t sample, bool & seeked);
+    const uint8_t * Deliver(int32_t index, mfi_sample_info_t * info);
+    void Worker();
+
+    mfimport_stream_tt * _stream;
+    const int64_t _total_samples;
+    int32_t _look_ahead;                    // reduced to what fits in the budget
+
+    std::mutex _decoder_mutex;              // serializes the stream, taken before _mutex
+    int64_t _stream_next;                   // sample GetNext returns, -1 if unknown
+
+    mutable std::mutex _mutex;
+    std::condition_variable _changed;
+    std::vector<Slot> _slots;
+    Slot _scratch;                          // for frames decoded only to continue the decoder
+    int64_t _position;                      // sample requested last
+    int32_t _pinned;                        // slot returned last
+    uint32_t _requests;                     // changes with every request, wakes the worker
+    uint32_t _waiting;                      // requests waiting for the decoder
+    bool _stop;
+    std::thread _worker;
+
+    // statistics
+    uint64_t _hits;
+    uint64_t _speculative_hits;
+    uint64_t _misses;
+    uint64_t _speculative_frames;
+    uint64_t _seeks;
+};
+
+#endif // DECODED_FRAME_CACHE_H_INCLUDED
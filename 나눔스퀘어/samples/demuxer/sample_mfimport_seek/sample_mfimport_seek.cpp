@@ -17,6 +17,10 @@
 #include <string.h>
 #include <limits.h>
 
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
 #include "mctypes.h"
 #include "bufstrm.h"
 #include "sample_common_args.h"
@@ -24,6 +28,7 @@
 #include "mfimport.h"
 #include "mcfourcc.h"
 #include "mccolorspace.h"
+#include "decoded_frame_cache.h"
 
 #include <time.h>
 #if !defined(__linux__) && !defined(__APPLE__)
@@ -179,6 +184,7 @@ typedef struct app_vars_s
     mfi_seek_settings_t seek_info;
     mfi_sample_settings_t sample_set;
     mfi_sample_info_t sample_info;
+    DecodedFrameCache *frame_cache;
 } app_vars_t;
 
 static int32_t display_file_info(app_vars_t *pVars)
@@ -430,6 +436,123 @@ void print_frame_info(char* chFrameInfo, mfi_sample_info_t *SampleInfo)
 #define IDC_SHOW_PREROLL (IDC_CUSTOM_START_ID + 2)
 #define IDC_DISABLE_SYNC (IDC_CUSTOM_START_ID + 3)
 #define IDC_INDEX_ES (IDC_CUSTOM_START_ID + 4)
+#define IDC_FRAME_CACHE (IDC_CUSTOM_START_ID + 5)
+#define IDC_SEEK_BENCH (IDC_CUSTOM_START_ID + 6)
+
+// frames the decoded frame cache decodes ahead of the requested one
+#define FRAME_CACHE_LOOK_AHEAD 30
+
+static double percentile(std::vector<double> &values, double p)
+{
+    std::sort(values.begin(), values.end());
+    return values.empty() ? 0.0 : values[(size_t)(p * (values.size() - 1) + 0.5)];
+}
+
+// seek latency benchmark, short seeks around a moving position like scrubbing in an editor,
+// the latency is the time until the first frame of a seek is decoded
+static int32_t run_seek_benchmark(app_vars_t *pVars, int32_t seeks, int32_t cache_mb, int64_t start)
+{
+    if ((pVars->stream_info.format.stream_mediatype < mctMinVideoType) ||
+        (pVars->stream_info.format.stream_mediatype > mctMaxVideoType))
+    {
+        printf("The seek benchmark needs a video stream.\n");
+        return 1;
+    }
+
+    const int64_t total = (int64_t)pVars->stream_info.total_samples;
+    mc_video_format_t *pVideoFormat = (mc_video_format_t*)pVars->stream_info.format.pFormat;
+    frame_colorspace_info_tt cs_info;
+    memset(&cs_info, 0, sizeof(frame_colorspace_info_tt));
+    get_frame_colorspace_info(&cs_info, pVideoFormat->width, pVideoFormat->height, pVars->fourcc, 0);
+
+    std::vector<uint8_t> buffer(cs_info.frame_size);
+    frame_tt frame;
+    memset(&frame, 0, sizeof(frame_tt));
+    fill_frame_from_colorspace_info(&cs_info, &buffer[0], &frame);
+
+    printf("\nSeek benchmark, %d seeks over %lld frames starting at frame %lld\n", seeks, (long long)total, (long long)start);
+
+    // the same seeks without and with the cache
+    for (int32_t pass = 0; pass < (cache_mb > 0 ? 2 : 1); pass++)
+    {
+        DecodedFrameCache *cache = NULL;
+        if (pass)
+            cache = new DecodedFrameCache(pVars->pStream, cs_info, total, (int64_t)cache_mb << 20, FRAME_CACHE_LOOK_AHEAD);
+
+        std::vector<double> latency;
+        latency.reserve(seeks);
+        uint32_t seed = 12345;
+        int64_t position = start;
+        int64_t frames = 0;
+        const std::chrono::steady_clock::time_point bench_start = std::chrono::steady_clock::now();
+
+        for (int32_t i = 0; i < seeks; i++)
+        {
+            // move by up to 48 frames in either direction and read 1 to 4 frames there
+            seed = seed * 1103515245 + 12345;
+            position += (int64_t)((seed >> 16) % 97) - 48;
+            position = (std::max)((int64_t)0, (std::min)(position, total - 1));
+            const int32_t reads = 1 + (int32_t)((seed >> 8) % 4);
+
+            const std::chrono::steady_clock::time_point seek_start = std::chrono::steady_clock::now();
+            if (cache)
+            {
+                if (!cache->GetFrame(position, &pVars->sample_info))
+                {
+                    printf("Seeking error.\n");
+                    delete cache;
+                    return 1;
+                }
+            }
+            else
+            {
+                pVars->seek_info.flags = MFI_SEEK_BY_SAMPLE_NUMBER;
+                pVars->seek_info.sample_start = position;
+                pVars->sample_set.num_samples = 1;
+                pVars->sample_set.p_frame = &frame;
+                if (mfimportStreamSeek(pVars->pStream, &pVars->seek_info, &pVars->sample_set, &pVars->sample_info))
+                {
+                    printf("Seeking error.\n");
+                    return 1;
+                }
+            }
+            latency.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - seek_start).count());
+            frames++;
+
+            for (int32_t r = 1; r < reads && position + r < total; r++)
+            {
+                if (cache)
+                {
+                    if (!cache->GetFrame(position + r, &pVars->sample_info))
+                        break;
+                }
+                else
+                {
+                    pVars->sample_set.num_samples = 1;
+                    if (mfimportStreamGetNext(pVars->pStream, &pVars->sample_set, &pVars->sample_info))
+                        break;
+                }
+                frames++;
+            }
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - bench_start).count();
+        double sum = 0;
+        for (size_t i = 0; i < latency.size(); i++)
+            sum += latency[i];
+
+        printf("%-10s seek latency p50 %.2f ms, p99 %.2f ms, max %.2f ms, mean %.2f ms, %lld frames in %.2f s\n",
+            cache ? "cached:" : "direct:", percentile(latency, 0.5), percentile(latency, 0.99), percentile(latency, 1.0),
+            latency.empty() ? 0.0 : sum / latency.size(), (long long)frames, seconds);
+
+        if (cache)
+        {
+            cache->PrintStatistics();
+            delete cache;
+        }
+    }
+    return 0;
+}
 
 int32_t main_new_api(int32_t argc, char * argv[])
 {
@@ -440,7 +563,9 @@ int32_t main_new_api(int32_t argc, char * argv[])
     FILE *fp_out = NULL;
     uint8_t *sample_bfr = NULL;
     int32_t sample_bfr_size;
-    app_vars_t vars = {0};
+    app_vars_t vars;
+    memset(&vars, 0, sizeof(app_vars_t));
+    vars.frame_cache = NULL;
 
     int32_t pos;
     bool absolute;
@@ -455,6 +580,10 @@ int32_t main_new_api(int32_t argc, char * argv[])
     int32_t show_preroll = 0;
     int32_t index_es = 0;
     int32_t write_wav_header = 0;
+    int32_t frame_cache_mb = 0;
+    int32_t seek_bench = 0;
+    int64_t nextFrame = 0;
+    const uint8_t *p_out = NULL;
 
     arg_item_t params[] =
     {
@@ -468,6 +597,8 @@ int32_t main_new_api(int32_t argc, char * argv[])
         { IDC_NO_EDIT_LISTS,    0, &noelst },
         { IDC_SHOW_PREROLL,     0, &show_preroll },
         { IDC_INDEX_ES,         0, &index_es },
+        { IDC_FRAME_CACHE,      0, &frame_cache_mb },
+        { IDC_SEEK_BENCH,       0, &seek_bench },
     };
 
     const arg_item_desc_t custom_args[] =
@@ -475,6 +606,8 @@ int32_t main_new_api(int32_t argc, char * argv[])
         { IDC_NO_EDIT_LISTS, {"ignore_edit_lists",  ""}, ItemTypeInt, 0, "Enable to ignore mp4 edit lists" },
         { IDC_SHOW_PREROLL, {"show_preroll_frames", ""}, ItemTypeInt, 0, "Enable to show preroll frames" },
         { IDC_INDEX_ES, {"index_es", ""}, ItemTypeInt, 0, "Enable indexing of elementary streams" },
+        { IDC_FRAME_CACHE, {"frame_cache", ""}, ItemTypeInt, 0, "Size of the decoded frame cache in MB" },
+        { IDC_SEEK_BENCH, {"seek_bench", ""}, ItemTypeInt, 0, "Number of seeks for the seek latency benchmark" },
     };
 
     if (argc <= 5)
@@ -505,6 +638,10 @@ int32_t main_new_api(int32_t argc, char * argv[])
             "                               0 = do not show pre-roll frames (default)\n"
             "                               1 = show pre-roll frames\n"
             "  -o <filename>           output filename\n"
+            "  -frame_cache <MB>       keep decoded video frames around the seek position, decode ahead\n"
+            "                            on a worker thread, 0 = disabled (default)\n"
+            "  -seek_bench <count>     run <count> short seeks around the first <seek-seq> position and\n"
+            "                            report the seek latency, with -frame_cache also with the cache\n"
             "  -lf <file_name>         path to license file\n"
             "  <seek-seq>              seek sequence, examples:\n"
             "                           +29:20   seek forward 29 frames, read 20 frames\n"
@@ -595,6 +732,14 @@ int32_t main_new_api(int32_t argc, char * argv[])
          vars.stream_info.format.stream_mediatype == mctMPEG2V))
       stream_instance_info.p_decoder_instance->auxinfo(stream_instance_info.p_decoder_instance, vars.smp_mode -1, SET_SMP_MODE, NULL, 0);
 
+    if (seek_bench > 0)
+    {
+        // the first seek sequence gives the position the seeks start at
+        parse_seek_string(seekStr, maxLen, 0, absolute, startPos, length);
+        ret = run_seek_benchmark(&vars, seek_bench, frame_cache_mb, (std::max)(startPos, 0));
+        goto err_exit;
+    }
+
     if (vars.out_file == 0)
     {
         printf("Output file was not specified.\n");
@@ -646,6 +791,10 @@ int32_t main_new_api(int32_t argc, char * argv[])
         fill_frame_from_colorspace_info(&cs_info, sample_bfr, &frame);
 
         vars.sample_set.p_frame = &frame;
+        p_out = sample_bfr;
+
+        if (frame_cache_mb > 0)
+            vars.frame_cache = new DecodedFrameCache(vars.pStream, cs_info, vars.stream_info.total_samples, (int64_t)frame_cache_mb << 20, FRAME_CACHE_LOOK_AHEAD);
 
         printf("\nTotal frames = %llu, FOURCC=\'%c%c%c%c\'\n",
             vars.stream_info.total_samples, frame.four_cc&255, (frame.four_cc>>8)&255,
@@ -710,11 +859,22 @@ int32_t main_new_api(int32_t argc, char * argv[])
             vars.seek_info.sample_start = currentFrame;
             vars.sample_set.num_samples = 1;
 
-            if (mfimportStreamSeek(vars.pStream, &vars.seek_info, &vars.sample_set, &vars.sample_info))
+            if (vars.frame_cache)
+            {
+                // the frame is decoded into the cache, it is written from there
+                p_out = vars.frame_cache->GetFrame(currentFrame, &vars.sample_info);
+                if (!p_out)
+                {
+                    printf("Seeking error.\n");
+                    goto err_exit;
+                }
+            }
+            else if (mfimportStreamSeek(vars.pStream, &vars.seek_info, &vars.sample_set, &vars.sample_info))
             {
                 printf("Seeking error.\n");
                 goto err_exit;
             }
+            nextFrame = currentFrame + 1;
 
             printf("Flags: 0x%x\n", vars.sample_info.flags);
 
@@ -742,7 +902,7 @@ int32_t main_new_api(int32_t argc, char * argv[])
             if (bOutputFlag)
             {
                 // write the frame out
-                if (fwrite(sample_bfr, 1, sample_bfr_size, fp_out) != sample_bfr_size)
+                if (fwrite(p_out, 1, sample_bfr_size, fp_out) != sample_bfr_size)
                 {
                     printf("Unable to write to output file.\n");
                     goto err_exit;
@@ -758,17 +918,35 @@ int32_t main_new_api(int32_t argc, char * argv[])
               // get the next frame
               vars.sample_set.num_samples = 1;
 
-              ret = mfimportStreamGetNext(vars.pStream, &vars.sample_set, &vars.sample_info);
-              if(ret == mfiErrorEndOfStream)
+              if (vars.frame_cache)
               {
-                  end = true;
-                  break;
+                  if (nextFrame >= (int64_t)vars.stream_info.total_samples)
+                  {
+                      end = true;
+                      break;
+                  }
+                  p_out = vars.frame_cache->GetFrame(nextFrame, &vars.sample_info);
+                  if (!p_out)
+                  {
+                      printf("Unable to decode frame %lld.\n", (long long)nextFrame);
+                      goto err_exit;
+                  }
               }
-              else if(ret)
+              else
               {
-                  printf("mfimportStreamGetNext() failed.\n");
-                  goto err_exit;
+                  ret = mfimportStreamGetNext(vars.pStream, &vars.sample_set, &vars.sample_info);
+                  if(ret == mfiErrorEndOfStream)
+                  {
+                      end = true;
+                      break;
+                  }
+                  else if(ret)
+                  {
+                      printf("mfimportStreamGetNext() failed.\n");
+                      goto err_exit;
+                  }
               }
+              nextFrame++;
 
 
               print_frame_info(chFrameInfo, &vars.sample_info);
@@ -776,7 +954,7 @@ int32_t main_new_api(int32_t argc, char * argv[])
               if (bOutputFlag)
               {
                   // write the frame out
-                  if (fwrite(sample_bfr, 1, sample_bfr_size, fp_out) != sample_bfr_size)
+                  if (fwrite(p_out, 1, sample_bfr_size, fp_out) != sample_bfr_size)
                   {
                       printf("Unable to write to output file.\n");
                       goto err_exit;
@@ -946,6 +1124,12 @@ int32_t main_new_api(int32_t argc, char * argv[])
 err_exit:
 
     // close everything
+    if (vars.frame_cache)
+    {
+        vars.frame_cache->PrintStatistics();
+        delete vars.frame_cache;
+    }
+
     if (vars.pStream)
         mfimportStreamFree(vars.pStream);
 